@@ -6,35 +6,285 @@
 #include "manifest.hpp"
 #include "cert.hpp"
 #include "patterns.hpp"
+#include "entropy.hpp"
+#include "regex.hpp"
+#include "indicators.hpp"
+#include "query.hpp"
+#include "name_index.hpp"
+#include "task_graph.hpp"
+
+#include "thread_pool.hpp"
+#include "benchmark.hpp"
+#include "mapped_file.hpp"
+#include "zip_index.hpp"
+#include "multi_hasher.hpp"
+#include "elf.hpp"
+#include "resources.hpp"
+#include "signing_block.hpp"
+#include "json_writer.hpp"
 
 #include "digestpp/digestpp.hpp"
+#include "slicer/chronometer.h"
+
+#include <map>
+#include <numeric>
+#include <set>
 
 namespace andromeda
 {
 	class apk
 	{
+		// the APK itself, mapped once: archive reads and whole file digests work on it directly
+		std::string apk_path_;
+		std::shared_ptr<utils::mapped_file> apk_file_;
+
+		// APK Signature Scheme v2/v3 block, signers are parsed when first needed
+		std::shared_ptr<apk_signing_block> signing_block_;
+
+		// central directory of the mapped APK, opened once; entries are looked up by name
+		std::shared_ptr<utils::zip_index> zip_;
+
+		using zip_entry = utils::zip_index::entry;
+		using entry_content = utils::zip_index::entry_content;
+		using extract_status = utils::zip_index::extract_status;
+
+		// files of the archive whose names start with prefix
+		std::vector<zip_entry> get_zip_entries(const std::string& prefix) const
+		{
+			return zip_->get_entries(prefix);
+		}
+
+		entry_content get_entry_content(const zip_entry& entry) const
+		{
+			return zip_->get_content(entry);
+		}
+
+		// resources.arsc index, built on first use
+		std::shared_ptr<resource_table> resources_{};
+		bool resources_loaded_ = false;
+
+		// names of all DEX files' tables, each distinct one stored once
+		std::shared_ptr<utils::string_arena> names_ = std::make_shared<utils::string_arena>();
+
+		// trigram index and completions of class and method names
+		std::shared_ptr<name_index> name_index_{};
+		static constexpr size_t max_completions = 50;
+
+		std::shared_ptr<manifest> app_manifest_{};
+		std::shared_ptr<andromeda::certificate> cert_{};
+		std::vector<parsed_dex> parsed_dexes_{};
+
+		/*
+			Everything but the central directory and the signing block is read in the background once the
+			constructor returns, in this order: certificate, manifest, DEX files, their tables, then the name index
+			and the xrefs of the tables. Commands only wait for the task of what they use (the getters below).
+		*/
+		std::unique_ptr<utils::task_graph> tasks_ = std::make_unique<utils::task_graph>();
+		size_t certificate_task_ = 0;
+		size_t manifest_task_ = 0;
+		size_t dex_task_ = 0;
+		size_t tables_task_ = 0;
+		size_t names_task_ = 0;
+		size_t xrefs_task_ = 0;
+
+		void add_tasks()
+		{
+			certificate_task_ = tasks_->add("certificate", {}, [this](utils::task_graph::progress&)
+			{
+				cert_ = std::make_shared<certificate>();
+				for (const auto& entry : get_zip_entries("META-INF/"))
+				{
+					const auto extension = fs::path(entry.file_name).extension();
+					if (extension == ".RSA" || extension == ".EC" || extension == ".DSA")
+					{
+						const auto content = get_entry_content(entry);
+						if (cert_->load_pkcs7(content.data, content.size))
+						{
+							return "v1: " + entry.file_name;
+						}
+					}
+				}
+				// no v1 (JAR) signature, use the certificate of the newest v2/v3 signer
+				for (const auto scheme : {apk_signing_block::scheme_v31, apk_signing_block::scheme_v3, apk_signing_block::scheme_v2})
+				{
+					const auto& signers = signing_block_->signers(scheme);
+					if (!signers.empty() && !signers.front().certificates.empty())
+					{
+						const auto& der = signers.front().certificates.front();
+						cert_->load_der(der.data, der.size);
+						return std::string("signing block");
+					}
+				}
+				return std::string("none");
+			});
+
+			manifest_task_ = tasks_->add("manifest", {}, [this](utils::task_graph::progress&)
+			{
+				const auto content = get_entry_content(*zip_->find("AndroidManifest.xml"));
+				app_manifest_ = std::shared_ptr<manifest>{new manifest(std::string(reinterpret_cast<const char*>(content.data), content.size))};
+				return std::to_string(content.size) + " bytes";
+			});
+
+			// root level files inflated in parallel, stored ones are parsed straight from the mapping
+			dex_task_ = tasks_->add("dex", {}, [this](utils::task_graph::progress&)
+			{
+				const auto dex_entries = get_dex_entries();
+				const auto dex_contents = zip_->get_contents(dex_entries);
+				size_t dex_bytes = 0;
+				for (size_t i = 0; i < dex_entries.size(); i++)
+				{
+					const auto& content = dex_contents[i];
+					if (content.data == nullptr)
+					{
+						continue;
+					}
+					const auto owner = content.is_stored ? std::shared_ptr<void>{apk_file_} : content.inflated;
+					parsed_dexes_.emplace_back(dex_entries[i].file_name, std::shared_ptr<char>{owner, reinterpret_cast<char*>(const_cast<unsigned char*>(content.data))}, content.size);
+					dex_bytes += content.size;
+				}
+				return std::to_string(parsed_dexes_.size()) + " DEX files, " + std::to_string(dex_bytes / 1024) + " KB";
+			});
+
+			// the tables of the DEX files are built in parallel, their names go to one arena
+			tables_task_ = tasks_->add("tables", {dex_task_}, [this](utils::task_graph::progress& progress)
+			{
+				progress.total = parsed_dexes_.size();
+				utils::thread_pool::shared().parallel_for(parsed_dexes_.size(), [&](size_t, const size_t dex_index)
+				{
+					parsed_dexes_[dex_index].build_tables(static_cast<uint32_t>(dex_index), names_);
+					progress.done++;
+				});
+				return std::to_string(names_->size()) + " names, " + std::to_string(names_->bytes() / 1024) + " KB";
+			});
+
+			names_task_ = tasks_->add("name index", {tables_task_}, [this](utils::task_graph::progress&)
+			{
+				name_index_ = std::make_shared<name_index>(parsed_dexes_, names_);
+				return std::to_string(name_index_->classes_count()) + " classes, " + std::to_string(name_index_->methods_count()) + " method names";
+			});
+
+			xrefs_task_ = tasks_->add("xrefs", {tables_task_}, [this](utils::task_graph::progress& progress)
+			{
+				progress.total = parsed_dexes_.size();
+				std::vector<size_t> counts(parsed_dexes_.size());
+				utils::thread_pool::shared().parallel_for(parsed_dexes_.size(), [&](size_t, const size_t dex_index)
+				{
+					counts[dex_index] = parsed_dexes_[dex_index].get_tables().xrefs().from.size();
+					progress.done++;
+				});
+				return std::to_string(std::accumulate(counts.begin(), counts.end(), size_t{0})) + " xrefs";
+			});
+		}
+
+		// DEX files of the APK: .dex files at the root of the archive
+		std::vector<zip_entry> get_dex_entries() const
+		{
+			std::vector<zip_entry> dex_entries{};
+			for (const auto& entry : zip_->entries())
+			{
+				if (entry.file_name.find('/') == std::string::npos && fs::path(entry.file_name).extension() == ".dex")
+				{
+					dex_entries.push_back(entry);
+				}
+			}
+			return dex_entries;
+		}
+
+		// JNI method path (class.method) -> libs exporting its Java_ symbol, built on first use
+		std::map<std::string, std::vector<std::string>> jni_exports_{};
+		bool jni_exports_indexed_ = false;
+
+		struct digest_job
+		{
+			std::string name;
+			uint64_t size;
+			// feeds the whole input into the hasher, the archive is the calling worker's own reader
+			std::function<bool(utils::multi_hasher&, mz_zip_archive&)> feed;
+			std::vector<std::pair<std::string, std::string>> digests{};
+			bool is_okay = false;
+		};
+
+		/*
+			Runs the jobs on the thread pool, largest first so one big input doesn't end up alone at the tail.
+			Each worker gets its own miniz reader over the mapped APK since one can't be shared between threads.
+		*/
+		void run_digest_jobs(std::vector<digest_job>& jobs, const std::vector<std::string>& algorithms) const
+		{
+			std::vector<size_t> order(jobs.size());
+			for (size_t i = 0; i < order.size(); i++)
+			{
+				order[i] = i;
+			}
+			std::sort(order.begin(), order.end(), [&jobs](const size_t a, const size_t b)
+			{
+				return jobs[a].size > jobs[b].size;
+			});
+
+			auto& pool = utils::thread_pool::shared();
+			utils::zip_index::reader_pool readers(apk_file_->data(), apk_file_->size(), pool.size() + 1);
+			pool.parallel_for(order.size(), [&](const size_t worker_index, const size_t item_index)
+			{
+				auto& job = jobs[order[item_index]];
+				const auto zip_archive = readers.get(worker_index);
+				if (zip_archive == nullptr)
+				{
+					return;
+				}
+
+				utils::multi_hasher hasher(algorithms);
+				job.is_okay = job.feed(hasher, *zip_archive);
+				if (job.is_okay)
+				{
+					job.digests = hasher.hexdigests();
+				}
+			});
+		}
+
+		// job hashing an archive entry while it is being inflated
+		digest_job make_zip_entry_job(const zip_entry& entry) const
+		{
+			const auto zip = zip_;
+			return digest_job{entry.file_name, entry.size, [zip, entry](utils::multi_hasher& hasher, mz_zip_archive& zip_archive)
+			{
+				if (entry.method == MZ_DEFLATED)
+				{
+					return zip->inflate_chunks(entry, [&hasher](const unsigned char* data, const size_t size)
+					{
+						hasher.absorb(data, size);
+					});
+				}
+
+				return mz_zip_reader_extract_to_callback(&zip_archive, entry.file_index,
+					[](void* opaque, mz_uint64, const void* buffer, const size_t size) -> size_t
+					{
+						static_cast<utils::multi_hasher*>(opaque)->absorb(buffer, size);
+						return size;
+					}, &hasher, 0) != MZ_FALSE;
+			}};
+		}
+
 	public:
 		bool is_valid = false;
-		std::shared_ptr<manifest> app_manifest;
-		std::shared_ptr<andromeda::certificate> cert;
-		std::vector<parsed_dex> parsed_dexes{};
-		std::string unzip_path{};
-		std::vector<std::string> file_pathes{};
-
 		explicit apk(const std::string& full_path)
 		{
 			is_valid = true;
-			// Unzip APK file
 
+			// only the central directory is read here, files are read from the mapping when they are needed
 			if (utils::ends_with(full_path, ".apk"))
 			{
-				const auto unzip_result = utils::unzip_file(full_path, false);
-				this->unzip_path = std::get<0>(unzip_result);
-				this->file_pathes = std::get<1>(unzip_result);
+				apk_path_ = full_path;
+				apk_file_ = std::make_shared<utils::mapped_file>(full_path);
+				if (!apk_file_->is_valid())
+				{
+					color_printf(color::FG_RED, "Failed to map the file: %s\n", full_path.c_str());
+					is_valid = false;
+					return;
+				}
 
-				if (unzip_path.empty())
+				zip_ = std::make_shared<utils::zip_index>(apk_file_->data(), apk_file_->size());
+				if (!zip_->is_valid() || zip_->entries().empty())
 				{
-					color_printf(color::FG_RED, "Failed to unpack the file: %s\n",
+					color_printf(color::FG_RED, "Failed to read the archive: %s\n",
 					             full_path.c_str());
 					is_valid = false;
 					return;
@@ -42,445 +292,2308 @@ namespace andromeda
 			}
 			else
 			{
-				printf("invalid valid format\npath: %s\n", full_path.c_str());
+				color::out_printf("invalid valid format\npath: %s\n", full_path.c_str());
 				is_valid = false;
 				return;
 			}
 
-			// certificate
-			const auto certificate_dir = unzip_path + '/' + "META-INF";
-			cert = std::shared_ptr<certificate>{new certificate(certificate_dir)};
-			
+			signing_block_ = std::make_shared<apk_signing_block>(apk_file_->data(), apk_file_->size());
 
-			// manifest
-			const auto manifest_path = unzip_path + '/' + "AndroidManifest.xml";
-			if (fs::exists(manifest_path))
+			// the rest is read in the background, here only the manifest and the DEX files are looked up
+			if (zip_->find("AndroidManifest.xml") == nullptr)
 			{
-				app_manifest = std::shared_ptr<manifest>{new manifest(manifest_path)};
+				color::out_printf("Failed to locate AndroidManifest.xml file\nPath: %s\n",
+				       full_path.c_str());
+				is_valid = false;
+				return;
 			}
-			else
+			if (get_dex_entries().empty())
 			{
-				printf("Failed to locate AndroidManifest.xml file\nPath: %s\n",
-				       manifest_path.c_str());
+				color::out_printf("Failed to parse DEX files\n");
 				is_valid = false;
 				return;
 			}
 
-			// dex
-			for (auto& p : fs::directory_iterator(unzip_path))
+			add_tasks();
+			tasks_->start();
+
+			// ctor end
+		}
+
+		// the background tasks use the members: the running one is finished (the others dropped) before they go
+		~apk()
+		{
+			tasks_.reset();
+		}
+
+		apk(const apk&) = delete;
+		apk& operator=(const apk&) = delete;
+
+		const std::shared_ptr<manifest>& get_manifest() const
+		{
+			tasks_->wait(manifest_task_);
+			return app_manifest_;
+		}
+
+		const std::shared_ptr<andromeda::certificate>& get_certificate() const
+		{
+			tasks_->wait(certificate_task_);
+			return cert_;
+		}
+
+		std::vector<parsed_dex>& get_dexes()
+		{
+			tasks_->wait(dex_task_);
+			return parsed_dexes_;
+		}
+
+		const std::vector<parsed_dex>& get_dexes() const
+		{
+			tasks_->wait(dex_task_);
+			return parsed_dexes_;
+		}
+
+		// indexing progress: the background tasks, their state and what they built
+		void dump_status() const
+		{
+			using state = utils::task_graph::state;
+			const auto json = utils::json_writer::current();
+			for (const auto& task : tasks_->status())
 			{
-				const auto& dex_path = p.path();
-				if (dex_path.extension() == ".dex")
+				const auto text_color = task.value == state::done ? color::FG_GREEN : task.value == state::failed ? color::FG_LIGHT_RED :
+					task.value == state::running ? color::FG_YELLOW : color::FG_DARK_GRAY;
+				const auto state_name = task.value == state::done ? "done" : task.value == state::failed ? "failed" : task.value == state::running ? "running" : "pending";
+				if (json != nullptr)
+				{
+					json->begin_record("task");
+					json->string_field("name", task.name);
+					json->string_field("state", state_name);
+					json->real_field("elapsed_ms", task.elapsed_ms);
+					json->number_field("done", task.done);
+					json->number_field("total", task.total);
+					json->string_field("summary", task.summary);
+					json->end_record();
+					continue;
+				}
+				color::color_printf(text_color, "%-12s %-8s", task.name.c_str(), state_name);
+				if (task.value != state::pending)
+				{
+					color::color_printf(color::FG_DARK_GRAY, " %8.1f ms", task.elapsed_ms);
+				}
+				if (task.value == state::running && task.total != 0)
+				{
+					color::color_printf(color::FG_DARK_GRAY, "  %zu/%zu", task.done, task.total);
+				}
+				if (!task.summary.empty())
 				{
-					parsed_dex current_dex(dex_path);
-					parsed_dexes.emplace_back(current_dex);
+					color::color_printf(color::FG_DARK_GRAY, "  %s", task.summary.c_str());
 				}
+				color::out_printf("\n");
 			}
-			if (parsed_dexes.empty())
+		}
+
+		std::vector<std::string> get_libs(bool extract = false, const std::string& target_lib_path = "", const bool get_hash = false)
+		{
+			if (get_hash == true)
 			{
-				printf("Failed to parse DEX files\n");
-				is_valid = false;
-				return;
+				return hash_libs();
 			}
 
-			// ctor end
+			std::vector<std::string> libs{};
+			std::vector<zip_entry> to_extract{};
+			for (const auto& entry : get_zip_entries("lib/"))
+			{
+				const auto [_, lib_path] = utils::split(entry.file_name, '/');
+				if (!extract)
+				{
+					if (!lib_path.empty())
+					{
+						libs.emplace_back(lib_path);
+					}
+					continue;
+				}
+				else if (extract && !target_lib_path.empty())
+				{
+					if (target_lib_path != lib_path)
+					{
+						continue;
+					}
+				}
+				to_extract.push_back(entry);
+			}
+
+			const auto dest_dir = fs::current_path().string() + '/' + "libs";
+			const auto statuses = zip_->extract_to_directory(to_extract, dest_dir);
+			for (size_t i = 0; i < to_extract.size(); i++)
+			{
+				const auto& file_name = to_extract[i].file_name;
+				if (statuses[i] == extract_status::replaced)
+				{
+					color::color_printf(color::FG_YELLOW, "Skipped duplicate entry (a later one has the same path): %s\n", file_name.c_str());
+				}
+				else if (statuses[i] == extract_status::failed)
+				{
+					color::color_printf(color::FG_LIGHT_RED, "[APK.hpp] Failed to unpack file: %s\n", file_name.c_str());
+				}
+				else
+				{
+					color::color_printf(color::FG_GREEN, "unpacked lib: %s/%s\n", dest_dir.c_str(), file_name.c_str());
+				}
+			}
+
+			return libs;
 		}
 
-		apk(const apk&) = default;
-		apk& operator=(const apk&) = default;
+		// writes every file of the APK under directory (default: next to the APK, <name>.apk_unpacked)
+		void unpack(std::string directory = "") const
+		{
+			if (directory.empty())
+			{
+				directory = apk_path_ + "_unpacked";
+			}
+
+			double unpack_ms = 0;
+			std::vector<extract_status> statuses{};
+			{
+				slicer::Chronometer chronometer(unpack_ms);
+				statuses = zip_->extract_to_directory(zip_->entries(), directory);
+			}
+
+			size_t files_count = 0;
+			uint64_t bytes_count = 0;
+			for (size_t i = 0; i < statuses.size(); i++)
+			{
+				const auto& entry = zip_->entries()[i];
+				if (statuses[i] == extract_status::replaced)
+				{
+					color::color_printf(color::FG_YELLOW, "Skipped duplicate entry (a later one has the same path): %s\n", entry.file_name.c_str());
+					continue;
+				}
+				if (statuses[i] == extract_status::failed)
+				{
+					color::color_printf(color::FG_LIGHT_RED, "[APK.hpp] Failed to unpack file: %s\n", entry.file_name.c_str());
+					continue;
+				}
+				files_count++;
+				bytes_count += entry.size;
+			}
+			color::color_printf(color::FG_GREEN, "unpacked %zu files (%.1f MB) to %s in %.1f ms\n", files_count,
+			                    bytes_count / (1024.0 * 1024.0), directory.c_str(), unpack_ms);
+		}
 
-		std::vector<std::string> get_libs(const fs::path& file_path, bool extract = false, const std::string& target_lib_path = "", const bool get_hash = false)
+		// SHA-1 of every entry under lib/, hashed while it is being inflated: nothing is written to disk
+		std::vector<std::string> hash_libs() const
 		{
-			if (get_hash == true)
+			std::vector<digest_job> jobs{};
+			for (const auto& entry : get_zip_entries("lib/"))
 			{
-				extract = true;
+				jobs.emplace_back(make_zip_entry_job(entry));
 			}
+			run_digest_jobs(jobs, {"sha1"});
 
 			std::vector<std::string> libs{};
+			for (const auto& job : jobs)
+			{
+				if (!job.is_okay)
+				{
+					color::color_printf(color::FG_LIGHT_RED, "[APK.hpp] Failed to unpack file: %s\n", job.name.c_str());
+					continue;
+				}
+
+				if (const auto json = utils::json_writer::current())
+				{
+					write_digests(*json, job);
+				}
+				else
+				{
+					color::color_printf(color::FG_GREEN, "%s: ", job.name.c_str());
+					color::color_printf(color::FG_DARK_GRAY, "%s\n", job.digests[0].second.c_str());
+				}
+
+				const auto [_, lib_path] = utils::split(job.name, '/');
+				libs.emplace_back(lib_path);
+			}
+
+			return libs;
+		}
+
+		// {"type": "digest", "name": ..., "size": ..., algorithm: digest...}
+		static void write_digests(utils::json_writer& json, const digest_job& job)
+		{
+			json.begin_record("digest");
+			json.string_field("name", job.name);
+			json.number_field("size", job.size);
+			for (const auto& [algorithm, digest] : job.digests)
+			{
+				json.string_field(algorithm, digest);
+			}
+			json.end_record();
+		}
+
+		/*
+			Digests of the APK, every DEX file and every native lib, all requested algorithms in one read of each input.
+			The APK is hashed straight from its mapping, DEX files from memory, libs while they are being inflated;
+			the inputs themselves are processed in parallel.
+		*/
+		void dump_hashes(const std::vector<std::string>& algorithms) const
+		{
+			const auto& parsed_dexes = get_dexes();
+			for (const auto& algorithm : algorithms)
+			{
+				if (!utils::multi_hasher::is_supported(algorithm))
+				{
+					color::color_printf(color::FG_LIGHT_RED, "Unknown hash algorithm: %s\nSupported:", algorithm.c_str());
+					for (const auto& name : utils::multi_hasher::supported())
+					{
+						color::out_printf(" %s", name.c_str());
+					}
+					color::out_printf("\n");
+					return;
+				}
+			}
+
+			std::vector<digest_job> jobs{};
+			const auto apk_file = apk_file_;
+			jobs.push_back(digest_job{"APK", apk_file->size(), [apk_file](utils::multi_hasher& hasher, mz_zip_archive&)
+			{
+				apk_file->advise(MADV_SEQUENTIAL);
+				constexpr size_t chunk_size = 1 << 20;
+				for (size_t offset = 0; offset < apk_file->size(); offset += chunk_size)
+				{
+					hasher.absorb(apk_file->data() + offset, std::min(chunk_size, apk_file->size() - offset));
+				}
+				return true;
+			}});
+			for (const auto& dex : parsed_dexes)
+			{
+				const auto [dex_data, dex_size] = dex.get_dex_content();
+				jobs.push_back(digest_job{dex.get_dex_name(), dex_size, [dex_data = dex_data, dex_size = dex_size](utils::multi_hasher& hasher, mz_zip_archive&)
+				{
+					hasher.absorb(dex_data, dex_size);
+					return true;
+				}});
+			}
+			for (const auto& entry : get_zip_entries("lib/"))
+			{
+				jobs.emplace_back(make_zip_entry_job(entry));
+			}
+
+			run_digest_jobs(jobs, algorithms);
+
+			const auto json = utils::json_writer::current();
+			for (const auto& job : jobs)
+			{
+				if (!job.is_okay)
+				{
+					color::color_printf(color::FG_LIGHT_RED, "[APK.hpp] Failed to read: %s\n", job.name.c_str());
+					continue;
+				}
+				if (json != nullptr)
+				{
+					write_digests(*json, job);
+					continue;
+				}
+
+				color::color_printf(color::FG_GREEN, "%s\n", job.name.c_str());
+				for (const auto& [algorithm, digest] : job.digests)
+				{
+					color::color_printf(color::FG_DARK_GRAY, "\t%-10s", algorithm.c_str());
+					color::color_printf(color::FG_DEFAULT, " %s\n", digest.c_str());
+				}
+			}
+		}
+
+		/*
+			ELF metadata of the native libs, read from the archive without extracting them.
+			Without target a summary of every lib, otherwise the details of the libs matching it ("arm64-v8a/libfoo.so" or "libfoo.so")
+		*/
+		void dump_lib_info(const std::string& target = "") const
+		{
+			const auto json = utils::json_writer::current();
+			auto found = false;
+			for (const auto& entry : get_zip_entries("lib/"))
+			{
+				const auto [_, lib_path] = utils::split(entry.file_name, '/');
+				const auto [abi, lib_name] = utils::split(lib_path, '/');
+				if (!target.empty() && target != lib_path && target != lib_name)
+				{
+					continue;
+				}
+				found = true;
 
-			mz_zip_archive zip_archive;
-			memset(&zip_archive, 0, sizeof(zip_archive));
+				const auto content = get_entry_content(entry);
+				const elf_file elf(content.data, content.size);
+				if (json != nullptr)
+				{
+					write_lib_info(*json, entry.file_name, abi, content, elf, !target.empty());
+					continue;
+				}
+				color::color_printf(color::FG_GREEN, "%s", entry.file_name.c_str());
+				color::color_printf(color::FG_DARK_GRAY, " (%zu bytes, %s)\n", content.size, content.is_stored ? "stored" : "deflated");
+				if (!elf.is_valid())
+				{
+					color::color_printf(color::FG_LIGHT_RED, "\tnot an ELF file\n");
+					continue;
+				}
+
+				const auto exports = elf.exports();
+				const auto imports = elf.imports();
+				color::out_printf("\tABI: %s, %s %s\n", abi.c_str(), elf.machine_name().c_str(), elf.is_64() ? "64-bit" : "32-bit");
+				if (!elf.soname().empty())
+				{
+					color::out_printf("\tSONAME: %.*s\n", static_cast<int>(elf.soname().size()), elf.soname().data());
+				}
+				for (const auto& needed : elf.needed())
+				{
+					color::out_printf("\tNEEDED: %.*s\n", static_cast<int>(needed.size()), needed.data());
+				}
+				color::out_printf("\tSections: %zu, exports: %zu, imports: %zu\n", elf.sections().size(), exports.size(), imports.size());
+				for (const auto& signature : elf.packer_signatures())
+				{
+					color::color_printf(color::FG_LIGHT_RED, "\tPacker/protector: %s\n", signature.c_str());
+				}
+
+				// JNI entry points are always listed
+				for (const auto& name : exports)
+				{
+					if (name == "JNI_OnLoad" || name == "JNI_OnUnload" || name.substr(0, 5) == "Java_")
+					{
+						color::color_printf(color::FG_LIGHT_CYAN, "\t%.*s\n", static_cast<int>(name.size()), name.data());
+					}
+				}
+
+				if (target.empty())
+				{
+					continue;
+				}
 
-			const auto status = mz_zip_reader_init_file(&zip_archive, file_path.string().c_str(), 0);
-			if (!status)
-				return libs;
+				color::color_printf(color::FG_LIGHT_GRAY, "\tSections:\n");
+				for (const auto& section : elf.sections())
+				{
+					if (!section.name.empty())
+					{
+						color::out_printf("\t\t%-24.*s %10llu bytes\n", static_cast<int>(section.name.size()), section.name.data(),
+						       static_cast<unsigned long long>(section.size));
+					}
+				}
+				color::color_printf(color::FG_LIGHT_GRAY, "\tExports:\n");
+				for (const auto& name : exports)
+				{
+					color::out_printf("\t\t%.*s\n", static_cast<int>(name.size()), name.data());
+				}
+				color::color_printf(color::FG_LIGHT_GRAY, "\tImports:\n");
+				for (const auto& name : imports)
+				{
+					color::out_printf("\t\t%.*s\n", static_cast<int>(name.size()), name.data());
+				}
+			}
 
-			const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
-			if (file_count == 0)
+			if (!found)
 			{
-				mz_zip_reader_end(&zip_archive);
-				return libs;
+				color::color_printf(color::FG_LIGHT_RED, "No native lib found%s%s\n", target.empty() ? "" : ": ", target.c_str());
 			}
-			// printf("number_of_files: %zu\n", file_count);
+		}
+
+		// dump_lib_info() of one lib as records: the lib, then its sections if it's detailed
+		static void write_lib_info(utils::json_writer& json, const std::string& file_name, const std::string& abi,
+		                           const entry_content& content, const elf_file& elf, const bool is_detailed)
+		{
+			const auto write_names = [&json](const char* name, const std::vector<std::string_view>& names)
+			{
+				json.begin_array(name);
+				for (const auto& current : names)
+				{
+					json.string_element(current);
+				}
+				json.end_array();
+			};
+
+			json.begin_record("lib");
+			json.string_field("path", file_name);
+			json.number_field("size", content.size);
+			json.boolean_field("stored", content.is_stored);
+			json.boolean_field("elf", elf.is_valid());
+			if (!elf.is_valid())
+			{
+				json.end_record();
+				return;
+			}
+
+			const auto exports = elf.exports();
+			const auto imports = elf.imports();
+			json.string_field("abi", abi);
+			json.string_field("machine", elf.machine_name());
+			json.number_field("bits", elf.is_64() ? 64 : 32);
+			json.string_field("soname", elf.soname());
+			write_names("needed", elf.needed());
+			json.number_field("sections_count", elf.sections().size());
+			json.number_field("exports_count", exports.size());
+			json.number_field("imports_count", imports.size());
+			json.begin_array("packers");
+			for (const auto& signature : elf.packer_signatures())
+			{
+				json.string_element(signature);
+			}
+			json.end_array();
+			json.begin_array("jni");
+			for (const auto& name : exports)
+			{
+				if (name == "JNI_OnLoad" || name == "JNI_OnUnload" || name.substr(0, 5) == "Java_")
+				{
+					json.string_element(name);
+				}
+			}
+			json.end_array();
+			if (is_detailed)
+			{
+				write_names("exports", exports);
+				write_names("imports", imports);
+			}
+			json.end_record();
+
+			if (!is_detailed)
+			{
+				return;
+			}
+			for (const auto& section : elf.sections())
+			{
+				if (!section.name.empty())
+				{
+					json.begin_record("section");
+					json.string_field("lib", file_name);
+					json.string_field("name", section.name);
+					json.number_field("size", section.size);
+					json.end_record();
+				}
+			}
+		}
+
+		// see resources_; nullptr if the APK has no resources.arsc
+		std::shared_ptr<resource_table> get_resources()
+		{
+			if (resources_loaded_)
+			{
+				return resources_;
+			}
+			resources_loaded_ = true;
+
+			for (const auto& entry : get_zip_entries("resources.arsc"))
+			{
+				if (entry.file_name != "resources.arsc")
+				{
+					continue;
+				}
+
+				// stored (as required since Android 11): the table is read straight from the mapping
+				const auto content = get_entry_content(entry);
+				auto owner = content.is_stored ? std::shared_ptr<const void>{apk_file_} : std::shared_ptr<const void>{content.inflated};
+				resources_ = std::make_shared<resource_table>(std::move(owner), content.data, content.size);
+				break;
+			}
+			// attached once, the text manifest resolves its references from now on
+			if (resources_ != nullptr && get_manifest() != nullptr)
+			{
+				get_manifest()->set_resources(resources_);
+			}
+			return resources_;
+		}
+
+		// see jni_exports_
+		const std::map<std::string, std::vector<std::string>>& get_jni_exports()
+		{
+			if (jni_exports_indexed_)
+			{
+				return jni_exports_;
+			}
+			jni_exports_indexed_ = true;
+
+			for (const auto& entry : get_zip_entries("lib/"))
+			{
+				const auto content = get_entry_content(entry);
+				const elf_file elf(content.data, content.size);
+				for (const auto& name : elf.exports())
+				{
+					std::string class_path, method_name;
+					if (demangle_jni_name(name, class_path, method_name))
+					{
+						auto& libs = jni_exports_[class_path + '.' + method_name];
+						if (std::find(libs.begin(), libs.end(), entry.file_name) == libs.end())
+						{
+							libs.emplace_back(entry.file_name);
+						}
+					}
+				}
+			}
+			return jni_exports_;
+		}
+
+		/*
+			Links the DEX native methods to the libs exporting their Java_ symbols.
+			Methods without one are registered at runtime (RegisterNatives, usually from JNI_OnLoad) or unused.
+		*/
+		void dump_native_methods()
+		{
+			auto& parsed_dexes = get_dexes();
+			const auto& jni_exports = get_jni_exports();
+			const auto json = utils::json_writer::current();
+			std::set<std::string> linked{};
+
+			wait_for_tables();
+			for (auto& dex : parsed_dexes)
+			{
+				const auto& tables = dex.get_tables();
+				const auto& methods = tables.methods();
+				for (uint32_t method = 0; method < methods.access.size(); method++)
+				{
+					if ((methods.access[method] & dex::kAccNative) == 0)
+					{
+						continue;
+					}
+					const auto method_path = tables.method_path(method);
+					const auto found = jni_exports.find(method_path);
+					if (json != nullptr)
+					{
+						write_native(*json, "native_method", method_path, found != jni_exports.end() ? found->second : std::vector<std::string>{});
+						if (found != jni_exports.end())
+						{
+							linked.insert(method_path);
+						}
+						continue;
+					}
+					color::color_printf(color::FG_GREEN, "%s\n", method_path.c_str());
+
+					if (found == jni_exports.end())
+					{
+						color::color_printf(color::FG_DARK_GRAY, "\tno Java_ export (registered dynamically?)\n");
+						continue;
+					}
+					linked.insert(method_path);
+					for (const auto& lib : found->second)
+					{
+						color::color_printf(color::FG_LIGHT_CYAN, "\t%s\n", lib.c_str());
+					}
+				}
+			}
+
+			auto header_printed = false;
+			for (const auto& [method_path, libs] : jni_exports)
+			{
+				if (linked.count(method_path) != 0)
+				{
+					continue;
+				}
+				if (json != nullptr)
+				{
+					write_native(*json, "jni_export", method_path, libs);
+					continue;
+				}
+				if (!header_printed)
+				{
+					color::color_printf(color::FG_LIGHT_GRAY, "Java_ exports without a native method in the DEX files:\n");
+					header_printed = true;
+				}
+				color::color_printf(color::FG_YELLOW, "\t%s", method_path.c_str());
+				color::color_printf(color::FG_DARK_GRAY, " (%s)\n", libs.front().c_str());
+			}
+		}
+
+		// {"type": type, "method": method_path, "libs": [libs exporting it]}
+		static void write_native(utils::json_writer& json, const char* type, const std::string& method_path, const std::vector<std::string>& libs)
+		{
+			json.begin_record(type);
+			json.string_field("method", method_path);
+			json.begin_array("libs");
+			for (const auto& lib : libs)
+			{
+				json.string_element(lib);
+			}
+			json.end_array();
+			json.end_record();
+		}
+
+		void dump_classes()
+		{
+			auto& parsed_dexes = get_dexes();
+			const auto json = utils::json_writer::current();
+			wait_for_tables();
+			for (auto& dex : parsed_dexes)
+			{
+				const auto& tables = dex.get_tables();
+				const auto& classes = tables.classes();
+				if (json != nullptr)
+				{
+					for (const auto type : classes.type)
+					{
+						write_class(*json, dex.get_dex_name(), tables.type_name(type));
+					}
+				}
+				else if (!classes.type.empty())
+				{
+					color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", dex.get_dex_name().c_str());
+					for (const auto type : classes.type)
+					{
+						print_text(color::FG_GREEN, "\t", tables.type_name(type));
+					}
+				}
+			}
+
+		}
+
+		void find_dump_class(const std::string& class_part)
+		{
+			auto& parsed_dexes = get_dexes();
+			const utils::text_query query(class_part);
+			if (!is_valid_query(query))
+			{
+				return;
+			}
+
+			const auto found = search_tables(query, [](const dex_tables& tables) { return tables.classes().type.size(); },
+			                                 [](const dex_tables& tables, const uint32_t row) { return tables.type_name_id(tables.classes().type[row]); },
+			                                 get_name_index().match_classes(query));
+			for (size_t dex_index = 0; dex_index < parsed_dexes.size(); dex_index++)
+			{
+				auto& dex = parsed_dexes[dex_index];
+				const auto& tables = dex.get_tables();
+				for (const auto row : found[dex_index])
+				{
+					if (const auto json = utils::json_writer::current())
+					{
+						write_class(*json, dex.get_dex_name(), tables.type_name(tables.classes().type[row]));
+						continue;
+					}
+					color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", dex.get_dex_name().c_str());
+					print_text(color::FG_GREEN, "\t", tables.type_name(tables.classes().type[row]));
+				}
+			}
+		}
+
+		void dump_methods()
+		{
+			auto& parsed_dexes = get_dexes();
+			const auto json = utils::json_writer::current();
+			wait_for_tables();
+			for (auto& parsed_dex : parsed_dexes)
+			{
+				const auto& tables = parsed_dex.get_tables();
+				const auto& methods = tables.methods();
+				if (json != nullptr)
+				{
+					for (uint32_t method = 0; method < methods.name.size(); method++)
+					{
+						write_method(*json, parsed_dex.get_dex_name(), tables, method);
+					}
+				}
+				else if (!methods.name.empty())
+				{
+					color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", parsed_dex.get_dex_name().c_str());
+					for (uint32_t method = 0; method < methods.name.size(); method++)
+					{
+						dump_method_path(tables, method);
+					}
+				}
+			}
+		}
+
+		void fin_dump_method(const std::string& target_method_name)
+		{
+			auto& parsed_dexes = get_dexes();
+			const utils::text_query query(target_method_name);
+			if (!is_valid_query(query))
+			{
+				return;
+			}
+
+			const auto found = search_tables(query, [](const dex_tables& tables) { return tables.methods().name.size(); },
+			                                 [](const dex_tables& tables, const uint32_t row) { return tables.methods().name[row]; },
+			                                 get_name_index().match_methods(query));
+			for (size_t dex_index = 0; dex_index < parsed_dexes.size(); dex_index++)
+			{
+				auto& parsed_dex = parsed_dexes[dex_index];
+				for (const auto method : found[dex_index])
+				{
+					if (const auto json = utils::json_writer::current())
+					{
+						write_method(*json, parsed_dex.get_dex_name(), parsed_dex.get_tables(), method);
+						continue;
+					}
+					color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", parsed_dex.get_dex_name().c_str());
+					dump_method_path(parsed_dex.get_tables(), method);
+				}
+			}
+		}
+
+		// prints why a /regex/ can't be used
+		static bool is_valid_query(const utils::text_query& query)
+		{
+			if (!query.is_valid())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Invalid regex: %s\n", query.error().c_str());
+				return false;
+			}
+			return true;
+		}
+
+		// columns of all DEX files, the DEX files are parsed too
+		void wait_for_tables()
+		{
+			tasks_->wait(tables_task_);
+		}
+
+		// class and method names of all DEX files
+		name_index& get_name_index()
+		{
+			tasks_->wait(names_task_);
+			return *name_index_;
+		}
+
+		/*
+			Rows of every DEX file's table (rows_count of them) whose name matches query, get_name gives a row's arena id.
+			Names are matched as they are printed (stripped), each distinct one once per DEX file however many rows share it.
+			known_names is what name_index already matched (2 yes, 1 no, by arena id), empty to match them here.
+			The DEX files are searched in parallel, each one with its own copy of the query (regex DFA cache).
+		*/
+		template <typename RowsCount, typename GetName>
+		std::vector<std::vector<uint32_t>> search_tables(const utils::text_query& query, RowsCount rows_count, GetName get_name,
+		                                                 const std::vector<uint8_t>& known_names = {})
+		{
+			auto& parsed_dexes = get_dexes();
+			wait_for_tables();
+			std::vector<std::vector<uint32_t>> found(parsed_dexes.size());
+			utils::thread_pool::shared().parallel_for(parsed_dexes.size(), [&](size_t, const size_t dex_index)
+			{
+				auto dex_query = query;
+				const auto& tables = parsed_dexes[dex_index].get_tables();
+				auto matched = known_names.empty() ? std::vector<uint8_t>(tables.arena().size(), 0) : std::vector<uint8_t>{}; // 0 unknown, 1 no, 2 yes
+				const auto& names = known_names.empty() ? matched : known_names;
+				const auto count = static_cast<uint32_t>(rows_count(tables));
+				for (uint32_t row = 0; row < count; row++)
+				{
+					const auto name = get_name(tables, row);
+					if (names[name] == 0)
+					{
+						matched[name] = dex_query.matches(utils::strip_view(tables.text(name))) ? 2 : 1;
+					}
+					if (names[name] == 2)
+					{
+						found[dex_index].push_back(row);
+					}
+				}
+			});
+			return found;
+		}
+
+		// class_info arguments: class paths
+		std::vector<std::string> complete_class_path(const std::string& prefix)
+		{
+			return get_name_index().complete_class(prefix, max_completions);
+		}
+
+		// dis arguments: class.method paths
+		std::vector<std::string> complete_method_path(const std::string& path)
+		{
+			return get_name_index().complete_method(path, max_completions);
+		}
+
+		static void print_text(const color::code text_color, const char* prefix, const std::string_view text)
+		{
+			color::color_printf(text_color, "%s%.*s\n", prefix, static_cast<int>(text.size()), text.data());
+		}
+
+		// class.method
+		static void dump_method_path(const dex_tables& tables, const uint32_t method)
+		{
+			const auto class_name = tables.type_name(tables.methods().class_type[method]);
+			const auto name = tables.text(tables.methods().name[method]);
+			color::color_printf(color::FG_DARK_GRAY, "%.*s.", static_cast<int>(class_name.size()), class_name.data());
+			color::color_printf(color::FG_GREEN, "%.*s\n", static_cast<int>(name.size()), name.data());
+		}
+
+		// {"type": "class", "dex": ..., "name": ...}
+		static void write_class(utils::json_writer& json, const std::string& dex_name, const std::string_view name)
+		{
+			json.begin_record("class");
+			json.string_field("dex", dex_name);
+			json.string_field("name", name);
+			json.end_record();
+		}
+
+		// {"type": "method", "dex": ..., "class": ..., "name": ..., "proto": ...}
+		static void write_method(utils::json_writer& json, const std::string& dex_name, const dex_tables& tables, const uint32_t method)
+		{
+			const auto& methods = tables.methods();
+			json.begin_record("method");
+			json.string_field("dex", dex_name);
+			json.string_field("class", tables.type_name(methods.class_type[method]));
+			json.string_field("name", tables.text(methods.name[method]));
+			json.string_field("proto", tables.text(methods.proto[method]));
+			json.end_record();
+		}
+
+		// {"type": "string", "dex": ..., "value": ...}
+		static void write_string(utils::json_writer& json, const std::string& dex_name, const std::string_view value)
+		{
+			json.begin_record("string");
+			json.string_field("dex", dex_name);
+			json.string_field("value", value);
+			json.end_record();
+		}
+
+		void dump_class_methods(const std::string& class_path)
+		{
+			auto& parsed_dexes = get_dexes();
+			const auto json = utils::json_writer::current();
+			auto found = false;
+			if (json == nullptr)
+			{
+				color::color_printf(color::FG_LIGHT_GRAY, "Class: %s\n",
+				                    class_path.c_str());
+			}
+			wait_for_tables();
+			for (auto& parsed_dex : parsed_dexes)
+			{
+				// methods the class declares, not the ones of other classes it calls
+				const auto& tables = parsed_dex.get_tables();
+				const auto& methods = tables.methods();
+				auto dex_printed = false;
+				for (uint32_t method = 0; method < methods.name.size(); method++)
+				{
+					if (!tables.is_defined(method) || tables.type_name(methods.class_type[method]) != class_path)
+					{
+						continue;
+					}
+					found = true;
+					if (json != nullptr)
+					{
+						write_method(*json, parsed_dex.get_dex_name(), tables, method);
+						continue;
+					}
+					if (!dex_printed)
+					{
+						color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n",
+						                    parsed_dex.get_dex_name().c_str());
+						dex_printed = true;
+					}
+					print_text(color::FG_GREEN, "\t", tables.text(methods.name[method]));
+				}
+			}
+
+			if (!found)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Failed to locate a class\n");
+			}
+		}
+
+		// disassembles to the output (stdout), or to 'out_path' (plain text) if it's specified
+		void disasm_method(const std::string& method_path,
+		                   const DexDissasembler::CfgType type = DexDissasembler::CfgType::None,
+		                   const std::string& out_path = "")
+		{
+			auto& parsed_dexes = get_dexes();
+			FILE* out_file = color::output();
+			if (!out_path.empty())
+			{
+				out_file = fopen(out_path.c_str(), "wb");
+				if (out_file == nullptr)
+				{
+					color::color_printf(color::FG_LIGHT_RED, "Failed to open file: %s\n", out_path.c_str());
+					return;
+				}
+			}
+
+			auto found = false;
+			{
+				FileSink sink(out_file, out_path.empty());
+				OutputBuffer out(&sink);
+				for (auto& parsed_dex : parsed_dexes)
+				{
+					const auto current_found = parsed_dex.dump_method(method_path, type, &out);
+					found = found ? found : current_found;
+				}
+			}
+
+			if (out_file != color::output())
+			{
+				fclose(out_file);
+			}
+
+			if (!found)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Failed to locale method: %s\n",
+				                    method_path.c_str());
+			}
+		}
+
+		// writes CFG of a method to 'file_path', *.json files get JSON, everything else Graphviz DOT
+		void export_method_cfg(const std::string& method_path, const std::string& file_path)
+		{
+			auto& parsed_dexes = get_dexes();
+			const auto out_file = fopen(file_path.c_str(), "wb");
+			if (out_file == nullptr)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Failed to open file: %s\n", file_path.c_str());
+				return;
+			}
+
+			size_t exported = 0;
+			{
+				FileSink sink(out_file);
+				OutputBuffer out(&sink);
+				const auto format = utils::ends_with(file_path, ".json") ? CfgExporter::Format::Json : CfgExporter::Format::Dot;
+				CfgExporter exporter(&out, format);
+				for (auto& parsed_dex : parsed_dexes)
+				{
+					exported += parsed_dex.export_method_cfg(method_path, exporter);
+				}
+			}
+			fclose(out_file);
+
+			if (exported == 0)
+			{
+				fs::remove(file_path);
+				color::color_printf(color::FG_LIGHT_RED, "Failed to locale method: %s\n", method_path.c_str());
+				return;
+			}
+			color::color_printf(color::FG_GREEN, "CFG of %zu method(s) written to %s\n", exported, file_path.c_str());
+		}
+
+		// "Lcom/example/Main$1;" -> "com/example/Main$1.smali", no way out of the export directory
+		static fs::path class_file_path(const std::string& descriptor)
+		{
+			fs::path file_path{};
+			std::stringstream class_path{descriptor.substr(1, descriptor.size() - 2)};
+			std::string part{};
+			while (std::getline(class_path, part, '/'))
+			{
+				if (part.empty() || part == "." || part == "..")
+				{
+					part = "_";
+				}
+				file_path /= part;
+			}
+
+			return file_path.string() + ".smali";
+		}
+
+		// writes one smali-like file per class, classes are disassembled in parallel
+		void export_disassembly(const std::string& out_dir)
+		{
+			auto& parsed_dexes = get_dexes();
+			struct class_job
+			{
+				std::shared_ptr<ir::DexFile> dex_ir;
+				ir::Class* ir_class = nullptr;
+				std::string file_path{};
+				double elapsed_ms = 0;
+				size_t written = 0;
+			};
+
+			// IR creation is not thread-safe, build everything before the workers start
+			double ir_ms = 0;
+			std::vector<class_job> jobs{};
+			std::set<std::string> file_pathes{};
+			// paths case-folded: on case-insensitive filesystems (macOS) La; and LA; are the same file
+			std::set<std::string> folded_pathes{};
+			const auto claim = [&folded_pathes](const std::string& file_path)
+			{
+				auto folded = file_path;
+				std::transform(folded.begin(), folded.end(), folded.begin(), [](const unsigned char chr) { return static_cast<char>(tolower(chr)); });
+				return folded_pathes.insert(folded).second;
+			};
+			{
+				slicer::Chronometer chronometer(ir_ms);
+				for (auto& dex : parsed_dexes)
+				{
+					const auto dex_ir = dex.get_full_ir();
+					for (const auto& ir_class : dex_ir->classes)
+					{
+						auto file_path = (fs::path(out_dir) / class_file_path(ir_class->type->descriptor->c_str())).string();
+						if (!claim(file_path))
+						{
+							// the same class in several DEX files, or classes differing only by case
+							const auto base_path = file_path + "." + dex.get_dex_name();
+							file_path = base_path;
+							for (size_t suffix = 2; !claim(file_path); suffix++)
+							{
+								file_path = base_path + "." + std::to_string(suffix);
+							}
+						}
+						file_pathes.insert(file_path);
+						jobs.push_back({dex_ir, ir_class.get(), file_path});
+					}
+				}
+			}
+
+			for (const auto& file_path : file_pathes)
+			{
+				fs::create_directories(fs::path(file_path).parent_path());
+			}
+
+			// every worker owns a buffer, it's retargeted to the file of the current class
+			struct worker_state
+			{
+				FileSink sink{nullptr};
+				OutputBuffer out{&sink};
+			};
+			auto& pool = utils::thread_pool::shared();
+			std::vector<std::unique_ptr<worker_state>> workers{};
+			for (size_t i = 0; i < pool.size() + 1; i++)
+			{
+				workers.emplace_back(new worker_state());
+			}
+
+			double total_ms = 0;
+			{
+				slicer::Chronometer chronometer(total_ms);
+				pool.parallel_for(jobs.size(), [&](const size_t worker_index, const size_t job_index)
+				{
+					auto& job = jobs[job_index];
+					auto& worker = *workers[worker_index];
+					slicer::Chronometer class_chronometer(job.elapsed_ms);
+
+					const auto out_file = fopen(job.file_path.c_str(), "wb");
+					if (out_file == nullptr)
+					{
+						return;
+					}
+					// the worker buffer already writes in large chunks
+					setvbuf(out_file, nullptr, _IONBF, 0);
+					worker.sink.Reset(out_file);
+
+					DexDissasembler disasm(job.dex_ir, DexDissasembler::CfgType::None, &worker.out);
+					disasm.DumpClass(job.ir_class);
+					worker.out.Flush();
+
+					job.written = ftell(out_file);
+					fclose(out_file);
+				});
+			}
+
+			size_t written = 0;
+			size_t failed = 0;
+			double classes_ms = 0;
+			for (const auto& job : jobs)
+			{
+				written += job.written;
+				failed += job.written == 0 ? 1 : 0;
+				classes_ms += job.elapsed_ms;
+			}
+
+			color::color_printf(color::FG_GREEN, "Exported %zu classes to %s\n", jobs.size() - failed, out_dir.c_str());
+			if (failed != 0)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Failed to write %zu classes\n", failed);
+			}
+			const auto mb_written = written / (1024.0 * 1024.0);
+			color::color_printf(color::FG_DARK_GRAY, "IR: %.1f ms, disassembly: %.1f ms on %zu threads, %.2f MB (%.1f MB/s)\n",
+			                    ir_ms, total_ms, pool.size() + 1, mb_written,
+			                    total_ms > 0 ? mb_written * 1000.0 / total_ms : 0.0);
+
+			// per-class timing, the slowest classes are the interesting ones
+			std::sort(jobs.begin(), jobs.end(), [](const class_job& a, const class_job& b)
+			{
+				return a.elapsed_ms > b.elapsed_ms;
+			});
+			color::color_printf(color::FG_DARK_GRAY, "Slowest classes (avg %.3f ms):\n",
+			                    jobs.empty() ? 0.0 : classes_ms / jobs.size());
+			for (size_t i = 0; i < jobs.size() && i < 10; i++)
+			{
+				color::color_printf(color::FG_GREEN, "\t%9.3f ms %9zu bytes  %s\n", jobs[i].elapsed_ms, jobs[i].written,
+				                    jobs[i].ir_class->type->Decl().c_str());
+			}
+		}
+
+		void dump_permissions() const 
+		{
+			if (const auto json = utils::json_writer::current())
+			{
+				for (const auto& perm : get_manifest()->permissions)
+				{
+					json->begin_record("permission");
+					json->string_field("name", perm);
+					json->end_record();
+				}
+				return;
+			}
+			if (!get_manifest()->permissions.empty())
+			{
+				color::color_printf(color::FG_DARK_GRAY, "Permissions:\n");
+				for (const auto& perm : get_manifest()->permissions)
+				{
+					color::color_printf(color::FG_GREEN, "\t%s\n", perm.c_str());
+				}
+			}
+		}
+
+		
+		void dump_activities() const 
+		{
+			if (const auto json = utils::json_writer::current())
+			{
+				manifest::write_components(*json, "activity", get_manifest()->activities);
+				return;
+			}
+			if (!get_manifest()->activities.empty())
+			{
+				color::color_printf(color::FG_DARK_GRAY, "Activities:\n");
+				for (const auto& [name, intents]  : get_manifest()->activities)
+				{
+					auto full_class_name = name;
+					if (!full_class_name.empty() && full_class_name[0] == '.')
+					{
+						if (!get_manifest()->manifest_package.empty())
+						{
+							full_class_name = get_manifest()->manifest_package + full_class_name;
+						}
+					}
+
+					color_printf(color::FG_GREEN, "\t%s\n", full_class_name.c_str());
+				}
+			}
+		}
+
+		void dump_services() const
+		{
+			if (const auto json = utils::json_writer::current())
+			{
+				manifest::write_components(*json, "service", get_manifest()->services);
+				return;
+			}
+			if (!get_manifest()->services.empty())
+			{
+				color::color_printf(color::FG_DARK_GRAY, "Services:\n");
+				for (const auto& [name, intents]  : get_manifest()->services)
+				{
+					color_printf(color::FG_GREEN, "\t%s\n", name.c_str());
+				}
+			}
+		}
+
+		void dump_receivers() const
+		{
+			if (const auto json = utils::json_writer::current())
+			{
+				manifest::write_components(*json, "receiver", get_manifest()->receivers);
+				return;
+			}
+			if (!get_manifest()->receivers.empty())
+			{
+				color::color_printf(color::FG_DARK_GRAY, "Receivers:\n");
+				for (const auto& [name, intents]  : get_manifest()->receivers)
+				{
+					color_printf(color::FG_GREEN, "\t%s\n", name.c_str());
+				}
+			}
+		}
+
+		void is_debuggable() const
+		{
+			const auto is_debug = get_manifest()->is_debuggable();
+			if (const auto json = utils::json_writer::current())
+			{
+				json->begin_record("debuggable");
+				json->boolean_field("value", is_debug);
+				json->end_record();
+				return;
+			}
+			if (is_debug)
+			{
+				color::color_printf(color::FG_LIGHT_GREEN, "Yes\n");
+			}
+			else
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No\n");
+			}
+		}
+
+		void dump_manifest_file()
+		{
+			get_resources();
+			if (const auto json = utils::json_writer::current())
+			{
+				json->begin_record("manifest");
+				json->string_field("xml", get_manifest()->get_content());
+				json->end_record();
+				return;
+			}
+			color::color_printf(color::FG_LIGHT_GREEN, "----------- BEGIN -----------\n");
+			color::out_printf("%s\n", get_manifest()->get_content().c_str());
+			color::color_printf(color::FG_LIGHT_GREEN, "----------- EOF -----------\n");
+		}
+
+		// resource of resources.arsc by ID, its value in the default configuration
+		void dump_resource(const uint32_t resource_id)
+		{
+			const auto resources = get_resources();
+			if (resources == nullptr || !resources->is_valid())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No resources.arsc\n");
+				return;
+			}
+
+			const auto name = resources->name(resource_id);
+			if (name.empty())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Unknown resource: 0x%08x\n", resource_id);
+				return;
+			}
+			if (const auto json = utils::json_writer::current())
+			{
+				write_resource(*json, name, resources->value(resource_id), resource_id);
+				return;
+			}
+			color::color_printf(color::FG_DARK_GRAY, "@%s: ", name.c_str());
+			color::color_printf(color::FG_GREEN, "%s\n", resources->value(resource_id).c_str());
+		}
+
+		// {"type": "resource", "name": type/name, "value": ..., "id": ...}, without the id if it's 0
+		static void write_resource(utils::json_writer& json, const std::string& name, const std::string& value, const uint32_t resource_id = 0)
+		{
+			json.begin_record("resource");
+			json.string_field("name", name);
+			json.string_field("value", value);
+			if (resource_id != 0)
+			{
+				json.number_field("id", resource_id);
+			}
+			json.end_record();
+		}
+
+		/*
+			Micro benchmarks of the parsers on this APK's own data
+			target: "manifest", "hash" (or empty for all of them)
+		*/
+		void run_benchmark(const std::string& target) const
+		{
+			utils::benchmark bench;
+			auto ran = false;
+
+			if (target.empty() || target == "manifest")
+			{
+				ran = true;
+				auto axml_content = get_manifest()->get_binary_content();
+				const auto size = axml_content.size();
+				color::color_printf(color::FG_LIGHT_GRAY, "AndroidManifest.xml (%zu bytes):\n", size);
+
+				bench.run("string pool decode", size, [&]
+				{
+					const auto axml = AxmlOpen(&axml_content[0], size);
+					if (axml != nullptr)
+					{
+						AxmlClose(axml);
+					}
+				});
+				bench.run("streaming decode (entry points)", size, [&]
+				{
+					const manifest decoded(axml_content);
+				});
+				bench.run("AXML to XML text", size, [&]
+				{
+					char* xml_content = nullptr;
+					size_t xml_size = 0;
+					if (AxmlToXml(&xml_content, &xml_size, &axml_content[0], size) == 0)
+					{
+						free(xml_content);
+					}
+				});
+			}
+
+			if (target.empty() || target == "hash")
+			{
+				ran = true;
+				std::vector<unsigned char> data(8 << 20);
+				uint32_t seed = 0x12345678;
+				for (auto& byte : data)
+				{
+					seed = seed * 1664525 + 1013904223;
+					byte = static_cast<unsigned char>(seed >> 24);
+				}
+
+				const auto hash = [&data](const std::vector<std::string>& algorithms)
+				{
+					utils::multi_hasher hasher(algorithms);
+					hasher.absorb(data.data(), data.size());
+					hasher.hexdigests();
+				};
+
+				auto& use_sha_ni = digestpp::detail::sha_ni::enabled();
+				color::color_printf(color::FG_LIGHT_GRAY, "Digests of %zu MB (SHA-NI %s):\n", data.size() >> 20,
+				                    digestpp::detail::sha_ni::supported() ? "supported" : "not supported");
+				for (const auto& algorithm : {"md5", "sha1", "sha256", "sha512", "sha3-256", "blake2b"})
+				{
+					bench.run(algorithm, data.size(), [&] { hash({algorithm}); });
+				}
+				if (use_sha_ni.load(std::memory_order_relaxed))
+				{
+					use_sha_ni.store(false, std::memory_order_relaxed);
+					bench.run("sha1 (portable)", data.size(), [&] { hash({"sha1"}); });
+					bench.run("sha256 (portable)", data.size(), [&] { hash({"sha256"}); });
+					use_sha_ni.store(true, std::memory_order_relaxed);
+				}
+				bench.run("md5+sha1+sha256 (one pass)", data.size(), [&] { hash({"md5", "sha1", "sha256"}); });
+			}
+
+			if (target.empty() || target == "inflate")
+			{
+				ran = true;
+				// DEX files and native libraries, what gets inflated on every load; any deflated entry otherwise
+				std::vector<zip_entry> deflated{};
+				for (const auto& entry : zip_->entries())
+				{
+					const auto is_code = (entry.file_name.find('/') == std::string::npos && utils::ends_with(entry.file_name, ".dex")) ||
+						utils::starts_with(entry.file_name, "lib/");
+					if (entry.method == MZ_DEFLATED && is_code)
+					{
+						deflated.push_back(entry);
+					}
+				}
+				if (deflated.empty())
+				{
+					std::copy_if(zip_->entries().begin(), zip_->entries().end(), std::back_inserter(deflated),
+					             [](const zip_entry& entry) { return entry.method == MZ_DEFLATED; });
+				}
+
+				size_t total_size = 0;
+				for (const auto& entry : deflated)
+				{
+					total_size += entry.size;
+				}
+				color::color_printf(color::FG_LIGHT_GRAY, "Inflating %zu entries (%zu bytes):\n", deflated.size(), total_size);
+
+				const auto inflate_all = [&](const utils::zip_index::inflate_backend backend)
+				{
+					for (const auto& entry : deflated)
+					{
+						zip_->get_content(entry, backend);
+					}
+				};
+				bench.run("miniz (extract to heap)", total_size, [&] { inflate_all(utils::zip_index::inflate_backend::miniz); });
+				bench.run("zlib (into final buffer)", total_size, [&] { inflate_all(utils::zip_index::inflate_backend::zlib); });
+				bench.run("zlib (streamed, 256 KB chunks)", total_size, [&]
+				{
+					for (const auto& entry : deflated)
+					{
+						zip_->inflate_chunks(entry, [](const unsigned char*, size_t) {});
+					}
+				});
+			}
+
+			if (!ran)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Unknown benchmark: %s (available: manifest, hash, inflate)\n", target.c_str());
+			}
+		}
+
+		// certificate
+		void dump_certificate() const
+		{
+			if (const auto json = utils::json_writer::current())
+			{
+				write_value(*json, "certificate", get_certificate()->get_certificate().get());
+				return;
+			}
+			color::color_printf(color::FG_LIGHT_GREEN, "----------- BEGIN -----------\n");
+			color::out_printf("%s\n", get_certificate()->get_certificate().get());
+			color::color_printf(color::FG_LIGHT_GREEN, "----------- EOF -----------\n");
+		}
+
+		void dump_creation_date() const 
+		{
+			if (const auto json = utils::json_writer::current())
+			{
+				write_value(*json, "creation_date", get_certificate()->get_creation_date().get());
+				return;
+			}
+			color::out_printf("%s\n", get_certificate()->get_creation_date().get());
+		}
+
+		void dump_revoke_date() const 
+		{
+			if (const auto json = utils::json_writer::current())
+			{
+				write_value(*json, "revoke_date", get_certificate()->get_revoke_date().get());
+				return;
+			}
+			color::out_printf("%s\n", get_certificate()->get_revoke_date().get());
+		}
+
+		// {"type": type, "value": value}
+		static void write_value(utils::json_writer& json, const char* type, const char* value)
+		{
+			json.begin_record(type);
+			json.string_field("value", value != nullptr ? value : "");
+			json.end_record();
+		}
+
+		// APK Signing Block: schemes, signers, certificates
+		void dump_signatures() const
+		{
+			if (!signing_block_->is_present())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No APK Signing Block (v1 only or unsigned)\n");
+				return;
+			}
+
+			const auto json = utils::json_writer::current();
+			if (json != nullptr)
+			{
+				json->begin_record("signing_block");
+				json->number_field("offset", signing_block_->offset());
+				json->number_field("size", signing_block_->size());
+				json->end_record();
+			}
+			else
+			{
+				color::color_printf(color::FG_LIGHT_GREEN, "APK Signing Block: offset %llu, %llu bytes\n",
+				                    static_cast<unsigned long long>(signing_block_->offset()),
+				                    static_cast<unsigned long long>(signing_block_->size()));
+			}
+			for (const auto& [id, value] : signing_block_->pairs())
+			{
+				if (json != nullptr)
+				{
+					json->begin_record("signing_pair");
+					json->string_field("scheme", apk_signing_block::scheme_name(id));
+					json->number_field("size", value.size);
+					json->end_record();
+					continue;
+				}
+				color::out_printf("\t%-16s %zu bytes\n", apk_signing_block::scheme_name(id).c_str(), value.size);
+			}
+
+			for (const auto scheme : {apk_signing_block::scheme_v2, apk_signing_block::scheme_v3, apk_signing_block::scheme_v31})
+			{
+				if (!signing_block_->has_scheme(scheme))
+				{
+					continue;
+				}
+
+				const auto& signers = signing_block_->signers(scheme);
+				const auto scheme_name = apk_signing_block::scheme_name(scheme);
+				if (json == nullptr)
+				{
+					color::color_printf(color::FG_LIGHT_BLUE, "\nScheme %s: %zu signer(s)\n", scheme_name.c_str(), signers.size());
+				}
+				for (size_t i = 0; i < signers.size(); i++)
+				{
+					const auto& signer = signers[i];
+					if (json != nullptr)
+					{
+						json->begin_record("signer");
+						json->string_field("scheme", scheme_name);
+						json->number_field("index", i);
+						if (scheme != apk_signing_block::scheme_v2)
+						{
+							json->number_field("min_sdk", signer.min_sdk);
+							json->number_field("max_sdk", signer.max_sdk);
+						}
+						json->begin_array("signatures");
+						for (const auto& [algorithm, signature] : signer.signatures)
+						{
+							json->string_element(apk_signing_block::algorithm_name(algorithm));
+						}
+						json->end_array();
+					}
+					else
+					{
+						color::color_printf(color::FG_YELLOW, "Signer #%zu\n", i);
+						if (scheme != apk_signing_block::scheme_v2)
+						{
+							color::out_printf("\tSDK: %u - %u\n", signer.min_sdk, signer.max_sdk);
+						}
+						for (const auto& [algorithm, signature] : signer.signatures)
+						{
+							color::out_printf("\tSignature: %s (%zu bytes)\n", apk_signing_block::algorithm_name(algorithm).c_str(), signature.size);
+						}
+					}
+
+					auto key_data = signer.public_key.data;
+					const auto public_key = d2i_PUBKEY(nullptr, &key_data, static_cast<long>(signer.public_key.size));
+					if (public_key != nullptr)
+					{
+						if (json != nullptr)
+						{
+							json->string_field("public_key", OBJ_nid2sn(EVP_PKEY_base_id(public_key)));
+							json->number_field("key_bits", EVP_PKEY_bits(public_key));
+						}
+						else
+						{
+							color::out_printf("\tPublic key: %s %d bits\n", OBJ_nid2sn(EVP_PKEY_base_id(public_key)), EVP_PKEY_bits(public_key));
+						}
+						EVP_PKEY_free(public_key);
+					}
+					if (json != nullptr)
+					{
+						json->end_record();
+					}
+
+					for (const auto& der : signer.certificates)
+					{
+						auto der_data = der.data;
+						const auto x509 = d2i_X509(nullptr, &der_data, static_cast<long>(der.size));
+						if (x509 == nullptr)
+						{
+							continue;
+						}
+						char subject[256];
+						char issuer[256];
+						X509_NAME_oneline(X509_get_subject_name(x509), subject, sizeof(subject));
+						X509_NAME_oneline(X509_get_issuer_name(x509), issuer, sizeof(issuer));
+						const auto sha256 = digestpp::sha256().absorb(der.data, der.size).hexdigest();
+						X509_free(x509);
+						if (json != nullptr)
+						{
+							json->begin_record("signer_certificate");
+							json->string_field("scheme", scheme_name);
+							json->number_field("signer", i);
+							json->string_field("subject", subject);
+							json->string_field("issuer", issuer);
+							json->string_field("sha256", sha256);
+							json->end_record();
+							continue;
+						}
+						color::out_printf("\tCertificate: %s\n", subject);
+						color::out_printf("\t\tIssuer: %s\n", issuer);
+						color::out_printf("\t\tSHA-256: %s\n", sha256.c_str());
+					}
+				}
+			}
+		}
+
+		/*
+			v2/v3 verification: the content digests are recomputed from the mapped APK on all cores
+			(1 MB chunks, see apk_signing_block) and compared with the ones in the signed data of each signer,
+			trusted only when the signer has a valid signature of it for every digest algorithm (as apksigner)
+			and its public key matches its certificate.
+		*/
+		bool verify() const
+		{
+			if (!signing_block_->is_present())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No APK Signing Block (v1 only or unsigned)\n");
+				return false;
+			}
+
+			// chunks are read once each, by whichever worker takes them
+			apk_file_->advise(MADV_WILLNEED);
 
-			const auto dest_dir = fs::current_path().string() + '/' + "libs";
+			// {"type": type, "scheme": ..., "signer": ..., "algorithm": ..., "result": ...}
+			const auto json = utils::json_writer::current();
+			const auto write_check = [json](const char* type, const std::string& scheme, const size_t signer, const std::string& algorithm, const char* result)
+			{
+				json->begin_record(type);
+				json->string_field("scheme", scheme);
+				json->number_field("signer", signer);
+				json->string_field("algorithm", algorithm);
+				json->string_field("result", result);
+				json->end_record();
+			};
 
-			const auto current_path = fs::current_path().string();
-			for (auto i = 0; i < file_count; i++)
+			double digest_ms = 0;
+			auto is_verified = true;
+			auto schemes_count = 0;
+			for (const auto scheme : {apk_signing_block::scheme_v2, apk_signing_block::scheme_v3, apk_signing_block::scheme_v31})
 			{
-				mz_zip_archive_file_stat file_stat;
-				if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat))
+				if (!signing_block_->has_scheme(scheme))
 				{
-					printf("failed to get file stat. index: %d\n", i);
 					continue;
 				}
-				if (mz_zip_reader_is_file_a_directory(&zip_archive, i))
+				schemes_count++;
+
+				const auto& signers = signing_block_->signers(scheme);
+				const auto name = apk_signing_block::scheme_name(scheme);
+				if (signers.empty())
 				{
+					color::color_printf(color::FG_LIGHT_RED, "%s: no signers\n", name.c_str());
+					is_verified = false;
 					continue;
 				}
 
-				const std::string file_name{file_stat.m_filename};
-				const auto dest_file = dest_dir + '/' + file_name;
-
-				if (utils::starts_with(file_name, "lib/"))
+				// the digests in the signed data are only trusted once a signature of it is valid
+				std::vector<bool> is_signer_trusted(signers.size(), false);
+				for (const auto& check : signing_block_->verify_signatures(scheme))
 				{
-					const auto [_, lib_path] = utils::split(file_name, '/');
-					if (!extract)
+					const auto algorithm = apk_signing_block::algorithm_name(check.algorithm);
+					is_verified &= check.is_valid;
+					if (check.is_valid)
 					{
-						if (!lib_path.empty())
-						{
-							libs.emplace_back(lib_path);
-						}
-						continue;
+						is_signer_trusted[check.signer_index] = true;
 					}
-					else if (extract && !target_lib_path.empty())
+					if (json != nullptr)
 					{
-						if (target_lib_path != lib_path)
-						{
-							continue;
-						}
+						write_check("signature_check", name, check.signer_index, algorithm, !check.is_supported ? "unsupported" : check.is_valid ? "OK" : "INVALID");
+						continue;
 					}
+					color::color_printf(check.is_valid ? color::FG_LIGHT_GREEN : color::FG_LIGHT_RED, "%s signer #%zu signature (%s): %s\n",
+					                    name.c_str(), check.signer_index, algorithm.c_str(),
+					                    !check.is_supported ? "unsupported" : check.is_valid ? "OK" : "INVALID");
+				}
 
-					const fs::path under_dir_path{dest_file};
-					const std::string under_dir_full = under_dir_path.parent_path();
-					if (!fs::exists(under_dir_full))
+				for (size_t i = 0; i < signers.size(); i++)
+				{
+					const char* failure = nullptr;
+					if (signers[i].signatures.empty())
+					{
+						failure = "no signatures";
+					}
+					else if (!is_signer_trusted[i])
+					{
+						failure = "no supported, valid signature";
+					}
+					else if (!apk_signing_block::has_matching_algorithms(signers[i]))
+					{
+						failure = "signature algorithms differ from the digest algorithms";
+					}
+					else if (!apk_signing_block::is_public_key_certified(signers[i]))
+					{
+						failure = "public key does not match the certificate";
+					}
+					if (failure == nullptr)
 					{
-						fs::create_directories(under_dir_full);
+						continue;
 					}
 
-					const auto is_okay = mz_zip_reader_extract_to_file(&zip_archive, i, dest_file.c_str(), 0);
-					if (!is_okay)
+					is_signer_trusted[i] = false;
+					is_verified = false;
+					if (json != nullptr)
 					{
-						color::color_printf(color::FG_LIGHT_RED, "[APK.hpp] Failed to unpack file: %s\n", file_name.c_str());
+						write_check("signer_check", name, i, "", failure);
+						continue;
 					}
-					else
+					color::color_printf(color::FG_LIGHT_RED, "%s signer #%zu: %s\n", name.c_str(), i, failure);
+				}
+
+				std::vector<apk_signing_block::digest_check> digest_checks{};
+				double scheme_ms = 0;
+				{
+					slicer::Chronometer chronometer(scheme_ms);
+					digest_checks = signing_block_->verify_content_digests(scheme);
+				}
+				digest_ms += scheme_ms;
+
+				auto is_digest_checked = false;
+				for (const auto& check : digest_checks)
+				{
+					const auto algorithm = apk_signing_block::algorithm_name(check.algorithm);
+					if (!check.is_supported || !is_signer_trusted[check.signer_index])
 					{
-						if (get_hash == true)
-						{
-							const auto file_content = utils::read_file_content(dest_file);
-							const auto file_sha1_ascii = digestpp::sha1().absorb(file_content).hexdigest();
-							color::color_printf(color::FG_GREEN, "%s: ", file_name.c_str());
-							color::color_printf(color::FG_DARK_GRAY, "%s\n", file_sha1_ascii.c_str());
-						}
-						else
+						const auto result = check.is_supported ? "not trusted" : "not checked";
+						if (json != nullptr)
 						{
-							color::color_printf(color::FG_GREEN, "unpacked lib: %s\n", dest_file.c_str());
+							write_check("digest_check", name, check.signer_index, algorithm, result);
+							continue;
 						}
+						color::color_printf(color::FG_DARK_GRAY, "%s signer #%zu digest (%s): %s\n",
+						                    name.c_str(), check.signer_index, algorithm.c_str(), result);
+						continue;
 					}
-				}
 
+					is_digest_checked = true;
+					is_verified &= check.is_matching;
+					if (json != nullptr)
+					{
+						write_check("digest_check", name, check.signer_index, algorithm, check.is_matching ? "OK" : "MISMATCH");
+						continue;
+					}
+					color::color_printf(check.is_matching ? color::FG_LIGHT_GREEN : color::FG_LIGHT_RED, "%s signer #%zu digest (%s): %s\n",
+					                    name.c_str(), check.signer_index, algorithm.c_str(), check.is_matching ? "OK" : "MISMATCH");
+				}
+				is_verified &= is_digest_checked;
 			}
 
-			mz_zip_reader_end(&zip_archive);
+			if (schemes_count == 0)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "No v2/v3 signature in the APK Signing Block\n");
+				return false;
+			}
 
-			return libs;
+			const auto mb_hashed = signing_block_->content_size() / (1024.0 * 1024.0);
+			if (json != nullptr)
+			{
+				json->begin_record("verification");
+				json->boolean_field("verified", is_verified);
+				json->number_field("content_size", signing_block_->content_size());
+				json->real_field("digest_ms", digest_ms);
+				json->number_field("threads", utils::thread_pool::shared().size() + 1);
+				json->end_record();
+				return is_verified;
+			}
+			color::color_printf(color::FG_DARK_GRAY, "Content digests: %.2f MB in %.1f ms on %zu threads (%.1f MB/s)\n",
+			                    mb_hashed, digest_ms, utils::thread_pool::shared().size() + 1,
+			                    digest_ms > 0 ? mb_hashed * 1000.0 / digest_ms : 0.0);
+			color::color_printf(is_verified ? color::FG_LIGHT_GREEN : color::FG_LIGHT_RED, "%s\n", is_verified ? "Verified" : "Verification FAILED");
+			return is_verified;
 		}
 
-		void dump_classes()
+		// strings
+		void dump_strings()
 		{
-			for (auto& dex : parsed_dexes)
+			auto& parsed_dexes = get_dexes();
+			const auto json = utils::json_writer::current();
+			wait_for_tables();
+			for (auto& parsed_dex : parsed_dexes)
 			{
-				const auto dex_classes = dex.get_classes();
-				if (!dex_classes.empty())
+				const auto& tables = parsed_dex.get_tables();
+				if (json != nullptr)
 				{
-					color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", dex.get_dex_name().c_str());
-					for (const auto& i_class : dex_classes)
+					for (uint32_t i = 0; i < tables.strings_count(); i++)
 					{
-						color::color_printf(color::FG_GREEN, "\t%s\n", i_class.c_str());
+						const auto str = tables.string(i);
+						if (!str.empty())
+						{
+							write_string(*json, parsed_dex.get_dex_name(), utils::strip_view(str));
+						}
 					}
 				}
-			}
-
-		}
-
-		void find_dump_class(const std::string& class_part)
-		{
-			for (auto& dex : parsed_dexes)
-			{
-				const auto dex_classes = dex.get_classes();
-				if (!dex_classes.empty())
+				else if (tables.strings_count() != 0)
 				{
-					for (const auto& i_class : dex_classes)
+					color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", parsed_dex.get_dex_name().c_str());
+					for (uint32_t i = 0; i < tables.strings_count(); i++)
 					{
-						if (utils::find_case_insensitive(i_class, class_part) != std::string::npos)
+						const auto str = tables.string(i);
+						if (!str.empty())
 						{
-							color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", dex.get_dex_name().c_str());
-							color::color_printf(color::FG_GREEN, "\t%s\n", i_class.c_str());
+							print_text(color::FG_GREEN, "\t", utils::strip_view(str));
 						}
 					}
 				}
 			}
 		}
 
-		void dump_methods()
+		/*
+			Tokens of the DEX strings (URLs, e-mails, domains, IPs, keys, ...) with their counts, then the strings
+			matching the indicator rules (the built in ones, or the rules file's) by category.
+			Both are a single pass per string, the string pools are scanned in parallel.
+		*/
+		void dump_interesting_strings(const std::string& rules_file = "")
 		{
-			for (auto& parsed_dex : parsed_dexes)
+			auto& parsed_dexes = get_dexes();
+			indicator_rules rules{};
+			const auto is_loaded = rules_file.empty() ? rules.load(indicator_rules::default_rules(), "built-in rules") : rules.load_file(rules_file);
+			if (!is_loaded && rules.rules().empty())
 			{
-				const auto dex_methods = parsed_dex.get_methods();
-				if (!dex_methods.empty())
+				return;
+			}
+			rules.build();
+
+			struct string_hit
+			{
+				std::string_view str;
+				std::vector<uint32_t> rules;
+			};
+			std::vector<std::vector<string_hit>> dex_hits(parsed_dexes.size());
+			std::vector<token_counts> dex_tokens(parsed_dexes.size());
+			wait_for_tables();
+			utils::thread_pool::shared().parallel_for(parsed_dexes.size(), [&](size_t, const size_t dex_index)
+			{
+				std::vector<uint32_t> hits{};
+				const auto& tables = parsed_dexes[dex_index].get_tables();
+				for (uint32_t i = 0; i < tables.strings_count(); i++)
 				{
-					color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", parsed_dex.get_dex_name().c_str());
-					for (const auto& [class_path, method_name] : dex_methods)
+					const auto str = utils::strip_view(tables.string(i));
+					if (str.empty())
+					{
+						continue;
+					}
+					rules.scan(str, hits);
+					if (!hits.empty())
 					{
-						color::color_printf(color::FG_DARK_GRAY, "%s.", class_path.c_str());
-						color::color_printf(color::FG_GREEN, "%s\n", method_name.c_str());
+						dex_hits[dex_index].push_back(string_hit{str, hits});
 					}
+					scan_tokens(str, [&](const token_kind kind, const std::string_view token)
+					{
+						dex_tokens[dex_index].add(kind, token);
+					});
+				}
+			});
+
+			token_counts tokens{};
+			for (const auto& counts : dex_tokens)
+			{
+				tokens.merge(counts);
+			}
+			const auto json = utils::json_writer::current();
+			for (size_t kind = 0; kind < static_cast<size_t>(token_kind::count); kind++)
+			{
+				const auto sorted = tokens.sorted(static_cast<token_kind>(kind));
+				if (json != nullptr)
+				{
+					for (const auto& token : sorted)
+					{
+						json->begin_record("token");
+						json->string_field("kind", token_kind_name(static_cast<token_kind>(kind)));
+						json->string_field("value", token.first);
+						json->number_field("count", token.second);
+						json->end_record();
+					}
+					continue;
+				}
+				if (sorted.empty())
+				{
+					continue;
+				}
+				color::color_printf(color::FG_DARK_GRAY, "%s:\n", token_kind_name(static_cast<token_kind>(kind)));
+				for (const auto& token : sorted)
+				{
+					color::color_printf(color::FG_GREEN, "\t%.*s", static_cast<int>(token.first.size()), token.first.data());
+					if (token.second > 1)
+					{
+						color::color_printf(color::FG_DARK_GRAY, " (%zu)", token.second);
+					}
+					color::out_printf("\n");
 				}
 			}
-		}
 
-		void fin_dump_method(const std::string& target_method_name)
-		{
-			for (auto& parsed_dex : parsed_dexes)
+			// by category in the order of the rules, a string shared by several DEX files once
+			const auto& categories = rules.categories();
+			std::vector<std::vector<std::pair<std::string_view, std::string>>> by_category(categories.size());
+			std::vector<std::set<std::string_view>> seen(categories.size());
+			for (const auto& hits : dex_hits)
 			{
-				const auto dex_methods = parsed_dex.get_methods();
-				if (!dex_methods.empty())
+				for (const auto& hit : hits)
 				{
-					for (const auto& [class_path, method_name] : dex_methods)
+					std::map<size_t, std::string> tags{};
+					for (const auto rule_index : hit.rules)
+					{
+						const auto& rule = rules.rules()[rule_index];
+						auto& tag = tags[rule.category];
+						tag += tag.empty() ? rule.pattern : ", " + rule.pattern;
+					}
+					for (const auto& tag : tags)
 					{
-						if (utils::find_case_insensitive(method_name, target_method_name) != std::string::npos)
+						if (seen[tag.first].insert(hit.str).second)
 						{
-							color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", parsed_dex.get_dex_name().c_str());
-							color::color_printf(color::FG_DARK_GRAY, "%s.", class_path.c_str());
-							color::color_printf(color::FG_GREEN, "%s\n", method_name.c_str());
+							by_category[tag.first].emplace_back(hit.str, tag.second);
 						}
 					}
 				}
 			}
-		}
 
-		void dump_class_methods(const std::string& class_path)
-		{
-			auto found = false;
-			color::color_printf(color::FG_LIGHT_GRAY, "Class: %s\n",
-			                    class_path.c_str());
-			for (auto& parsed_dex : parsed_dexes)
+			for (size_t i = 0; i < categories.size(); i++)
 			{
-				const auto methods = parsed_dex.get_class_methods(class_path);
-				if (methods.empty())
+				if (json != nullptr)
 				{
+					for (const auto& found : by_category[i])
+					{
+						json->begin_record("indicator");
+						json->string_field("category", categories[i]);
+						json->string_field("value", found.first);
+						json->string_field("rules", found.second);
+						json->end_record();
+					}
 					continue;
 				}
-				const auto dex_name = parsed_dex.get_dex_name();
-				color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n",
-				                    dex_name.c_str());
-				for (const auto& i_method : methods)
+				if (by_category[i].empty())
 				{
-					color::color_printf(color::FG_GREEN, "\t%s\n", i_method.c_str());
-					found = true;
+					continue;
+				}
+				color::color_printf(color::FG_DARK_GRAY, "%s:\n", categories[i].c_str());
+				for (const auto& found : by_category[i])
+				{
+					color::color_printf(color::FG_GREEN, "\t%.*s", static_cast<int>(found.first.size()), found.first.data());
+					color::color_printf(color::FG_DARK_GRAY, " [%s]\n", found.second.c_str());
 				}
-			}
-
-			if (!found)
-			{
-				color::color_printf(color::FG_LIGHT_RED, "Failed to locate a class\n");
 			}
 		}
 
-		void disasm_method(const std::string& method_path)
+		/*
+			Strings of the DEX files and files of the APK ranked by how random they look: entropy relative to
+			their size and alphabet, length, Base64/hex. Packed payloads and encrypted strings come first.
+			Media, code and the standard APK files are left out; the strings and files are profiled in parallel.
+		*/
+		void dump_suspicious_blobs(const size_t max_count = 50)
 		{
-			auto found = false;
-			for (auto& parsed_dex : parsed_dexes)
+			auto& parsed_dexes = get_dexes();
+			struct blob
 			{
-				const auto current_found = parsed_dex.dump_method(method_path);
-				found = found ? found : current_found;
-			}
-
-			if (!found)
+				double score;
+				utils::byte_profile profile;
+				std::string source;
+				std::string preview;
+			};
+			// short identifiers are all distinct characters too, plain text has to be longer to count
+			const auto is_candidate = [](const utils::byte_profile& profile, const size_t min_size)
 			{
-				color::color_printf(color::FG_LIGHT_RED, "Failed to locale method: %s\n",
-				                    method_path.c_str());
-			}
-		}
-
-		void dump_permissions() const 
-		{
-			if (!app_manifest->permissions.empty())
+				const auto encoding = profile.guess_encoding();
+				const auto is_encoded = encoding == utils::byte_profile::encoding::base64 || encoding == utils::byte_profile::encoding::hex;
+				return profile.size() >= (is_encoded ? min_size : 2 * min_size) && profile.normalized_entropy() >= 0.85;
+			};
+			const auto make_preview = [](const unsigned char* data, const size_t size)
 			{
-				color::color_printf(color::FG_DARK_GRAY, "Permissions:\n");
-				for (const auto& perm : app_manifest->permissions)
+				std::string preview{};
+				for (size_t i = 0; i < size && preview.size() < 48; i++)
 				{
-					color::color_printf(color::FG_GREEN, "\t%s\n", perm.c_str());
+					preview += data[i] >= 0x20 && data[i] < 0x7f ? static_cast<char>(data[i]) : '.';
 				}
-			}
-		}
+				return size > 48 ? preview + "..." : preview;
+			};
 
-		
-		void dump_activities() const 
-		{
-			if (!app_manifest->activities.empty())
+			double profile_ms = 0;
+			size_t strings_count = 0;
+			std::vector<blob> blobs{};
+			std::vector<zip_entry> files{};
 			{
-				color::color_printf(color::FG_DARK_GRAY, "Activities:\n");
-				for (const auto& [name, intents]  : app_manifest->activities)
+				slicer::Chronometer chronometer(profile_ms);
+
+				wait_for_tables();
+				for (auto& parsed_dex : parsed_dexes)
 				{
-					auto full_class_name = name;
-					if (!full_class_name.empty() && full_class_name[0] == '.')
+					strings_count += parsed_dex.get_tables().strings_count();
+				}
+				std::vector<std::vector<blob>> dex_blobs(parsed_dexes.size());
+				utils::thread_pool::shared().parallel_for(parsed_dexes.size(), [&](size_t, const size_t dex_index)
+				{
+					const auto& tables = parsed_dexes[dex_index].get_tables();
+					for (uint32_t i = 0; i < tables.strings_count(); i++)
 					{
-						if (!app_manifest->manifest_package.empty())
+						const auto str = utils::strip_view(tables.string(i));
+						// type descriptors are never random
+						if (str.size() < 16 || (str.front() == 'L' && str.back() == ';'))
+						{
+							continue;
+						}
+						const auto data = reinterpret_cast<const unsigned char*>(str.data());
+						const utils::byte_profile profile(data, str.size());
+						if (is_candidate(profile, 16))
 						{
-							full_class_name = app_manifest->manifest_package + full_class_name;
+							dex_blobs[dex_index].push_back(blob{profile.suspicion_score(), profile, parsed_dexes[dex_index].get_dex_name(),
+							                                    make_preview(data, str.size())});
 						}
 					}
-
-					color_printf(color::FG_GREEN, "\t%s\n", full_class_name.c_str());
+				});
+				for (auto& current : dex_blobs)
+				{
+					std::move(current.begin(), current.end(), std::back_inserter(blobs));
 				}
-			}
-		}
 
-		void dump_services() const
-		{
-			if (!app_manifest->services.empty())
-			{
-				color::color_printf(color::FG_DARK_GRAY, "Services:\n");
-				for (const auto& [name, intents]  : app_manifest->services)
+				// assets and raw resources, anything but code, signatures and compiled resources
+				for (const auto& entry : zip_->entries())
 				{
-					color_printf(color::FG_GREEN, "\t%s\n", name.c_str());
+					const auto& name = entry.file_name;
+					const auto is_standard = (name.find('/') == std::string::npos && utils::ends_with(name, ".dex")) ||
+						name == "AndroidManifest.xml" || name == "resources.arsc" || utils::starts_with(name, "META-INF/") ||
+						utils::starts_with(name, "lib/") || (utils::starts_with(name, "res/") && !utils::starts_with(name, "res/raw/"));
+					if (!is_standard && entry.size >= 256)
+					{
+						files.push_back(entry);
+					}
+				}
+				std::vector<std::unique_ptr<blob>> file_blobs(files.size());
+				zip_->for_each_content(files, [&](const size_t index, const entry_content& content)
+				{
+					const auto format = file_format(content.data, content.size);
+					if (content.data == nullptr || format == nullptr)
+					{
+						return;
+					}
+					const utils::byte_profile profile(content.data, content.size);
+					if (is_candidate(profile, 256))
+					{
+						file_blobs[index].reset(new blob{profile.suspicion_score(), profile, files[index].file_name,
+						                                 *format != '\0' ? std::string("[") + format + "]" : make_preview(content.data, content.size)});
+					}
+				});
+				for (auto& current : file_blobs)
+				{
+					if (current != nullptr)
+					{
+						blobs.push_back(std::move(*current));
+					}
 				}
+
+				const auto count = std::min(max_count, blobs.size());
+				std::partial_sort(blobs.begin(), blobs.begin() + count, blobs.end(), [](const blob& a, const blob& b)
+				{
+					return a.score > b.score;
+				});
+				blobs.resize(count);
 			}
-		}
 
-		void dump_receivers() const
-		{
-			if (!app_manifest->receivers.empty())
+			if (const auto json = utils::json_writer::current())
 			{
-				color::color_printf(color::FG_DARK_GRAY, "Receivers:\n");
-				for (const auto& [name, intents]  : app_manifest->receivers)
+				for (const auto& current : blobs)
 				{
-					color_printf(color::FG_GREEN, "\t%s\n", name.c_str());
+					json->begin_record("blob");
+					json->real_field("score", current.score);
+					json->real_field("entropy", current.profile.entropy());
+					json->number_field("size", current.profile.size());
+					json->string_field("encoding", utils::byte_profile::encoding_name(current.profile.guess_encoding()));
+					json->string_field("source", current.source);
+					json->string_field("content", current.preview);
+					json->end_record();
 				}
+				json->begin_record("summary");
+				json->number_field("strings", strings_count);
+				json->number_field("files", files.size());
+				json->real_field("elapsed_ms", profile_ms);
+				json->end_record();
+				return;
 			}
-		}
 
-		void is_debuggable() const
-		{
-			const auto is_debug = app_manifest->is_debuggable();
-			if (is_debug)
+			if (!blobs.empty())
 			{
-				color::color_printf(color::FG_LIGHT_GREEN, "Yes\n");
+				color::color_printf(color::FG_DARK_GRAY, "%6s %8s %9s %-7s %-20s %s\n", "score", "entropy", "size", "coding", "source", "content");
 			}
-			else
+			for (const auto& current : blobs)
 			{
-				color::color_printf(color::FG_LIGHT_RED, "No\n");
+				color::color_printf(color::FG_LIGHT_GRAY, "%6.2f %8.2f %9zu %-7s ", current.score, current.profile.entropy(), current.profile.size(),
+				                    utils::byte_profile::encoding_name(current.profile.guess_encoding()));
+				color::color_printf(color::FG_DARK_GRAY, "%-20s ", current.source.c_str());
+				color::color_printf(color::FG_GREEN, "%s\n", current.preview.c_str());
 			}
+			color::color_printf(color::FG_DARK_GRAY, "%zu strings and %zu files profiled in %.1f ms\n", strings_count, files.size(), profile_ms);
 		}
 
-		void dump_manifest_file() const
+		// name of a known format by its magic, "" if unknown; nullptr for media, which is compressed but never a payload
+		static const char* file_format(const unsigned char* data, const size_t size)
 		{
-			color::color_printf(color::FG_LIGHT_GREEN, "----------- BEGIN -----------\n");
-			printf("%s\n", app_manifest->manifest_content.c_str());
-			color::color_printf(color::FG_LIGHT_GREEN, "----------- EOF -----------\n");
-		}
-
-		// certificate
-		void dump_certificate() const
-		{
-			color::color_printf(color::FG_LIGHT_GREEN, "----------- BEGIN -----------\n");
-			printf("%s\n", cert->get_certificate().get());
-			color::color_printf(color::FG_LIGHT_GREEN, "----------- EOF -----------\n");
+			const auto starts_with = [data, size](const char* magic, const size_t magic_size, const size_t offset = 0)
+			{
+				return size >= offset + magic_size && memcmp(data + offset, magic, magic_size) == 0;
+			};
+			if (data == nullptr || starts_with("\x89PNG", 4) || starts_with("\xff\xd8\xff", 3) || starts_with("GIF8", 4) ||
+				(starts_with("RIFF", 4) && starts_with("WEBP", 4, 8)) || starts_with("OggS", 4) || starts_with("ID3", 3) ||
+				starts_with("fLaC", 4) || starts_with("ftyp", 4, 4) || starts_with("wOFF", 4) || starts_with("wOF2", 4))
+			{
+				return nullptr;
+			}
+			if (starts_with("PK\x03\x04", 4)) return "ZIP";
+			if (starts_with("\x1f\x8b", 2)) return "gzip";
+			if (starts_with("dex\n", 4)) return "DEX";
+			if (starts_with("\x7f" "ELF", 4)) return "ELF";
+			return "";
 		}
 
-		void dump_creation_date() const 
+		void search_string(std::string& target_string)
 		{
-			printf("%s\n", cert->get_creation_date().get());
-		}
+			auto& parsed_dexes = get_dexes();
+			const utils::text_query query(target_string);
+			if (!is_valid_query(query))
+			{
+				return;
+			}
 
-		void dump_revoke_date() const 
-		{
-			printf("%s\n", cert->get_revoke_date().get());
-		}
+			const auto found = search_tables(query, [](const dex_tables& tables) { return tables.strings_count(); },
+			                                 [](const dex_tables& tables, const uint32_t row) { return tables.string_id(row); });
+			for (size_t dex_index = 0; dex_index < parsed_dexes.size(); dex_index++)
+			{
+				auto& parsed_dex = parsed_dexes[dex_index];
+				const auto& tables = parsed_dex.get_tables();
+				for (const auto string_index : found[dex_index])
+				{
+					const auto str = tables.string(string_index);
+					if (str.empty())
+					{
+						continue;
+					}
+					if (const auto json = utils::json_writer::current())
+					{
+						write_string(*json, parsed_dex.get_dex_name(), utils::strip_view(str));
+						continue;
+					}
+					color::color_printf(color::FG_DARK_GRAY, "%s: ", parsed_dex.get_dex_name().c_str());
+					print_text(color::FG_GREEN, "", utils::strip_view(str));
+				}
+			}
 
-		// strings
-		void dump_strings()
-		{
-			for (auto parsed_dex : parsed_dexes)
+			// string resources, the pool was decoded once when the table was loaded
+			const auto resources = get_resources();
+			if (resources != nullptr && resources->is_valid())
 			{
-				const auto dex_strings = parsed_dex.get_strings();
-				if (!dex_strings.empty())
+				auto resources_query = query;
+				for (const auto& [name, value] : resources->search_strings([&](const std::string_view text) { return resources_query.matches(text); }))
 				{
-					color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", parsed_dex.get_dex_name().c_str());
-					for (const auto& str : dex_strings)
+					if (const auto json = utils::json_writer::current())
 					{
-						color::color_printf(color::FG_GREEN, "\t%s\n", str.c_str());
+						write_resource(*json, name, value);
+						continue;
 					}
+					color::color_printf(color::FG_DARK_GRAY, "resources.arsc: @%s: ", name.c_str());
+					color::color_printf(color::FG_GREEN, "%s\n", value.c_str());
 				}
 			}
 		}
 
-		void dump_interesting_strings()
+		/*
+			Runs a query (query.hpp) on all DEX files in parallel, their tables are built on the first one.
+			"explain select ..." prints the plan instead of the rows.
+		*/
+		void run_query(const std::string& text)
 		{
-			std::vector<std::string> urls{};
-			std::vector<std::string> emails{};
-
-			for (auto parsed_dex : parsed_dexes)
+			auto& parsed_dexes = get_dexes();
+			const auto is_explain = utils::starts_with(text, "explain ");
+			const query statement(is_explain ? text.substr(strlen("explain ")) : text);
+			if (!statement.is_valid())
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Invalid query: %s\n", statement.error().c_str());
+				return;
+			}
+			if (is_explain)
 			{
-				const auto dex_strings = parsed_dex.get_strings();
-				if (!dex_strings.empty())
+				for (const auto& [depth, line] : statement.describe_plan())
 				{
-					for (const auto& str : dex_strings)
+					if (const auto json = utils::json_writer::current())
 					{
-						if (is_url(str))
-						{
-							urls.emplace_back(str);
-						}
-						
-						if(is_email(str))
-						{
-							emails.emplace_back(str);
-						}
+						json->begin_record("plan");
+						json->number_field("depth", depth);
+						json->string_field("text", line);
+						json->end_record();
+						continue;
 					}
+					color::color_printf(depth == 0 ? color::FG_LIGHT_GRAY : color::FG_GREEN, "%s%s\n", std::string(depth, '\t').c_str(), line.c_str());
 				}
+				return;
 			}
 
-			// URLs:
-			if (!urls.empty())
+			const auto json = utils::json_writer::current();
+			double query_ms = 0;
+			std::vector<std::vector<uint32_t>> dex_rows(parsed_dexes.size());
 			{
-				color::color_printf(color::FG_DARK_GRAY, "URLs:\n");
-				for (const auto& url : urls)
+				slicer::Chronometer chronometer(query_ms);
+				wait_for_tables();
+				if (statement.needs_xrefs())
 				{
-					color::color_printf(color::FG_GREEN, "\t%s\n", url.c_str());
+					tasks_->wait(xrefs_task_);
 				}
+				utils::thread_pool::shared().parallel_for(parsed_dexes.size(), [&](size_t, const size_t dex_index)
+				{
+					auto& dex = parsed_dexes[dex_index];
+					query::execution execution(statement, dex.get_tables(), dex.get_dex_name());
+					dex_rows[dex_index] = execution.run();
+				});
 			}
 
-			// emails
-			if (!emails.empty())
+			size_t rows_count = 0;
+			for (size_t dex_index = 0; dex_index < parsed_dexes.size(); dex_index++)
 			{
-				color::color_printf(color::FG_DARK_GRAY, "e-Mails:\n");
-				for (const auto& email : emails)
+				auto& rows = dex_rows[dex_index];
+				if (statement.limit() != 0)
+				{
+					rows.resize(std::min(rows.size(), statement.limit() - rows_count));
+				}
+				if (rows.empty())
+				{
+					continue;
+				}
+				const auto& dex_name = parsed_dexes[dex_index].get_dex_name();
+				auto& tables = parsed_dexes[dex_index].get_tables();
+				if (json != nullptr)
+				{
+					for (const auto row : rows)
+					{
+						write_query_row(*json, statement.target_table(), dex_name, tables, row);
+					}
+				}
+				else
 				{
-					color::color_printf(color::FG_GREEN, "\t%s\n", email.c_str());
+					color::color_printf(color::FG_DARK_GRAY, "DEX file: %s\n", dex_name.c_str());
+					for (const auto row : rows)
+					{
+						dump_query_row(statement.target_table(), tables, row);
+					}
 				}
+				rows_count += rows.size();
+			}
+			if (json != nullptr)
+			{
+				json->begin_record("summary");
+				json->number_field("rows", rows_count);
+				json->real_field("elapsed_ms", query_ms);
+				json->end_record();
+				return;
 			}
+			color::color_printf(color::FG_DARK_GRAY, "%zu rows in %.1f ms\n", rows_count, query_ms);
+		}
 
+		// a row of the target table: {"type": "class"|"method"|"field"|"string"|"xref", "dex": ..., columns...}
+		static void write_query_row(utils::json_writer& json, const query::table target, const std::string& dex_name, dex_tables& tables, const uint32_t row)
+		{
+			switch (target)
+			{
+			case query::table::classes:
+				json.begin_record("class");
+				json.string_field("dex", dex_name);
+				json.string_field("name", tables.type_name(tables.classes().type[row]));
+				if (tables.classes().super[row] != dex::kNoIndex)
+				{
+					json.string_field("super", tables.type_name(tables.classes().super[row]));
+				}
+				json.end_record();
+				break;
+			case query::table::methods:
+				write_method(json, dex_name, tables, row);
+				break;
+			case query::table::fields:
+				json.begin_record("field");
+				json.string_field("dex", dex_name);
+				json.string_field("class", tables.type_name(tables.fields().class_type[row]));
+				json.string_field("name", tables.text(tables.fields().name[row]));
+				json.string_field("field_type", tables.type_name(tables.fields().type[row]));
+				json.end_record();
+				break;
+			case query::table::strings:
+				write_string(json, dex_name, tables.string(row));
+				break;
+			case query::table::xrefs:
+			{
+				const auto& xrefs = tables.xrefs();
+				std::string target_text{};
+				json.begin_record("xref");
+				json.string_field("dex", dex_name);
+				json.string_field("from", tables.method_path(xrefs.from[row]));
+				json.string_field("to", tables.xref_target(xrefs.kind[row], xrefs.to[row], target_text));
+				json.string_field("kind", dex_tables::xref_kind_name(xrefs.kind[row]));
+				json.end_record();
+				break;
+			}
+			}
 		}
 
-		void search_string(std::string& target_string)
+		static void dump_query_row(const query::table target, dex_tables& tables, const uint32_t row)
 		{
-			for (auto parsed_dex : parsed_dexes)
+			const auto print = [](const color::code text_color, const std::string_view text)
 			{
-				auto dex_strings = parsed_dex.get_strings();
-				if (!dex_strings.empty())
+				color::color_printf(text_color, "%.*s", static_cast<int>(text.size()), text.data());
+			};
+			color::out_printf("\t");
+			switch (target)
+			{
+			case query::table::classes:
+				print(color::FG_GREEN, tables.type_name(tables.classes().type[row]));
+				if (tables.classes().super[row] != dex::kNoIndex)
 				{
-					for (auto& str : dex_strings)
-					{
-						if (!str.empty() &&
-							utils::find_case_insensitive(str, target_string) != std::string::npos )
-						{
-							color::color_printf(color::FG_DARK_GRAY, "%s: ", parsed_dex.get_dex_name().c_str());
-							color::color_printf(color::FG_GREEN, "%s\n", str.c_str());
-						}
-					}
+					print(color::FG_DARK_GRAY, " : ");
+					print(color::FG_DARK_GRAY, tables.type_name(tables.classes().super[row]));
 				}
+				break;
+			case query::table::methods:
+				print(color::FG_DARK_GRAY, tables.type_name(tables.methods().class_type[row]));
+				print(color::FG_DARK_GRAY, ".");
+				print(color::FG_GREEN, tables.text(tables.methods().name[row]));
+				print(color::FG_DARK_GRAY, tables.text(tables.methods().proto[row]));
+				break;
+			case query::table::fields:
+				print(color::FG_DARK_GRAY, tables.type_name(tables.fields().class_type[row]));
+				print(color::FG_DARK_GRAY, ".");
+				print(color::FG_GREEN, tables.text(tables.fields().name[row]));
+				print(color::FG_DARK_GRAY, " : ");
+				print(color::FG_DARK_GRAY, tables.type_name(tables.fields().type[row]));
+				break;
+			case query::table::strings:
+				print(color::FG_GREEN, tables.string(row));
+				break;
+			case query::table::xrefs:
+			{
+				const auto& xrefs = tables.xrefs();
+				print(color::FG_DARK_GRAY, tables.method_path(xrefs.from[row]));
+				print(color::FG_LIGHT_GRAY, " -> ");
+				std::string target{};
+				print(color::FG_GREEN, tables.xref_target(xrefs.kind[row], xrefs.to[row], target));
+				print(color::FG_DARK_GRAY, std::string(" (") + dex_tables::xref_kind_name(xrefs.kind[row]) + ")");
+				break;
 			}
+			}
+			color::out_printf("\n");
 		}
 
 		void dump_language()
@@ -488,8 +2601,9 @@ namespace andromeda
 			std::string lang = "Java";
 			auto print_color = color::FG_LIGHT_RED;
 
-			for (const auto& file_path : this->file_pathes)
+			for (const auto& entry : zip_->entries())
 			{
+				const auto& file_path = entry.file_name;
 				if (file_path.find("kotlin/") == 0) // starts_with
 				{
 					lang = "Kotlin";
@@ -504,6 +2618,11 @@ namespace andromeda
 				}
 			}
 
+			if (const auto json = utils::json_writer::current())
+			{
+				write_value(*json, "language", lang.c_str());
+				return;
+			}
 			color::color_printf(print_color, "%s\n", lang.c_str());
 		}
 
@@ -3,12 +3,208 @@
 #include "utils.hpp"
 
 #include "APK.hpp"
+#include "json_writer.hpp"
+#include "server.hpp"
 
 #include "linenoise/linenoise.hpp"
 
+/*
+	"method_path > file_path" of dis: only a separate " > " redirects, method names like <init> and <clinit>
+	contain '>' themselves. Both parts are stripped, the file path is empty without a redirect.
+*/
+std::pair<std::string, std::string> split_output_redirect(const std::string& argument)
+{
+	const auto found = argument.rfind(" > ");
+	if (found == std::string::npos)
+	{
+		return std::make_pair(utils::strip(argument), "");
+	}
+	return std::make_pair(utils::strip(argument.substr(0, found)), utils::strip(argument.substr(found + 3)));
+}
+
+/*
+	Class paths after class/class_info, method paths after dis/disassemble (and its --cfg options):
+	the whole line with each completion of the argument being typed. False for other commands.
+*/
+bool complete_argument(andromeda::apk& apk, const std::string& line, std::vector<std::string>& completions)
+{
+	const auto [command, argument] = utils::split(line, ' ');
+	if (line.find(' ') == std::string::npos)
+	{
+		return false;
+	}
+
+	if (command == "class" || command == "class_info")
+	{
+		for (const auto& class_path : apk.complete_class_path(argument))
+		{
+			completions.push_back(command + ' ' + class_path);
+		}
+		return true;
+	}
+	if (command == "dis" || command == "disassemble")
+	{
+		auto head = command + ' ';
+		auto method_path = argument;
+		if (utils::starts_with(method_path, "--"))
+		{
+			const auto [cfg_option, path] = utils::split(method_path, ' ');
+			if (method_path.find(' ') == std::string::npos || (cfg_option != "--cfg" && cfg_option != "--cfg-verbose"))
+			{
+				return true;
+			}
+			head += cfg_option + ' ';
+			method_path = path;
+		}
+		if (method_path.find(" > ") != std::string::npos)
+		{
+			return true;
+		}
+		for (const auto& path : apk.complete_method_path(method_path))
+		{
+			completions.push_back(head + path);
+		}
+		return true;
+	}
+	return false;
+}
+
+// command names for the first letters typed
+void complete_command(const char* editBuffer, std::vector<std::string>& completions)
+{
+	if (editBuffer[0] == 'e')
+	{
+		if (strlen(editBuffer) > 1 && editBuffer[1] == 'x')
+		{
+			completions.emplace_back("exit");
+		}
+
+		completions.emplace_back("export_disasm ");
+		completions.emplace_back("explain select ");
+
+		completions.emplace_back("ep");
+		completions.emplace_back("entry_points");
+		completions.emplace_back("epe");
+		completions.emplace_back("entry_points_extended");
+	}
+	else if (editBuffer[0] == 'a')
+	{
+		completions.emplace_back("activities");
+	}
+	else if (editBuffer[0] == 'b')
+	{
+		completions.emplace_back("benchmark ");
+		completions.emplace_back("bench ");
+	}
+	else if (editBuffer[0] == 'd')
+	{
+		completions.emplace_back("dis ");
+		completions.emplace_back("disassemble ");
+
+		completions.emplace_back("dump_lib ");
+		completions.emplace_back("dump_libs");
+	}
+	else if (editBuffer[0] == 'c')
+	{
+		completions.emplace_back("cfg_export ");
+
+		completions.emplace_back("class ");
+		completions.emplace_back("class_info ");
+		completions.emplace_back("classes");
+
+		completions.emplace_back("certificate");
+		completions.emplace_back("creation_date");
+
+		if (strlen(editBuffer) > 1 && editBuffer[1] == 'l')
+		{
+			completions.emplace_back("cls");
+			completions.emplace_back("clr");
+		}
+	}
+	else if (editBuffer[0] == 'f')
+	{
+		completions.emplace_back("find_class ");
+		completions.emplace_back("find_method ");
+		completions.emplace_back("find_func ");
+
+		completions.emplace_back("funcs ");
+	}
+	else if (editBuffer[0] == 'm')
+	{
+		completions.emplace_back("manifest");
+		completions.emplace_back("methods");
+	}
+	else if (editBuffer[0] == 'r')
+	{
+		completions.emplace_back("revoke_date");
+		completions.emplace_back("receivers");
+		completions.emplace_back("resource ");
+	}
+	else if (editBuffer[0] == 's')
+	{
+		completions.emplace_back("select ");
+		completions.emplace_back("strs");
+		completions.emplace_back("strings");
+		completions.emplace_back("signatures");
+		completions.emplace_back("suspicious_blobs");
+
+		completions.emplace_back("str ");
+		completions.emplace_back("string ");
+
+		completions.emplace_back("services");
+		completions.emplace_back("status");
+	}
+	else if (editBuffer[0] == 'i')
+	{
+		completions.emplace_back("is_debuggable");
+		completions.emplace_back("interesting_strings");
+	}
+	else if (editBuffer[0] == 'l')
+	{
+		completions.emplace_back("libs");
+		completions.emplace_back("libs_hash");
+		completions.emplace_back("libh");
+		completions.emplace_back("lib_info ");
+		
+		completions.emplace_back("language");
+		completions.emplace_back("lang");
+		
+	}
+	else if (editBuffer[0] == 'n')
+	{
+		completions.emplace_back("natives");
+	}
+	else if (editBuffer[0] == 'p')
+	{
+		completions.emplace_back("permissions");
+		completions.emplace_back("perms");
+	}
+
+	else if (editBuffer[0] == 'h')
+	{
+		completions.emplace_back("help");
+		completions.emplace_back("hashes ");
+	}
+	else if (editBuffer[0] == 'v')
+	{
+		completions.emplace_back("verify");
+	}
+	else if (editBuffer[0] == 'u')
+	{
+		completions.emplace_back("unpack ");
+	}
+	else if (editBuffer[0] == 'j')
+	{
+		completions.emplace_back("json ");
+		completions.emplace_back("jsonl ");
+	}
+}
+
 void usage()
 {
-	printf("Usage:\n\tAndromeda apk_file_path\n");
+	color::out_printf("Usage:\n\tAndromeda apk_file_path [command]\n");
+	color::out_printf("\tAndromeda --daemon socket_path apk_file_path... (serve commands on the APKs, kept loaded)\n");
+	color::out_printf("\tAndromeda --client socket_path [command] (run commands on the daemon's APKs)\n");
 }
 
 void print_todo()
@@ -20,392 +216,690 @@ void help_commands()
 {
 	color::color_printf(color::FG_YELLOW, "Commands:\n");
 
-	printf("\n");
+	color::out_printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "entry_points [ep]");
-	printf(" - print list of entry points [LIMITED]\n");
+	color::out_printf(" - print list of entry points [LIMITED]\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "entry_points_extended [epe]");
-	printf(" - print all possible entry points\n");
+	color::out_printf(" - print all possible entry points\n");
 
 	// permissions
-	printf("\n");
+	color::out_printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "permissions [perms]");
-	printf(" - permissions requested by the APK file\n");	
+	color::out_printf(" - permissions requested by the APK file\n");	
 	// activities
 	color::color_printf(color::FG_LIGHT_GREEN, "activities");
-	printf(" - Names of activities contained in the APK file\n");
+	color::out_printf(" - Names of activities contained in the APK file\n");
 	// Services
 	color::color_printf(color::FG_LIGHT_GREEN, "services");
-	printf(" - Names of services contained in the APK file\n");
+	color::out_printf(" - Names of services contained in the APK file\n");
 	// Receivers
 	color::color_printf(color::FG_LIGHT_GREEN, "receivers");
-	printf(" - Names of handlers declared in the APK file for receiving broadcasts\n");
+	color::out_printf(" - Names of handlers declared in the APK file for receiving broadcasts\n");
 
-	printf("\n");
+	color::out_printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "classes");
-	printf(" - print all classes from APK file\n");
+	color::out_printf(" - print all classes from APK file\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "class_info [class] class_path");
-	printf(" - print list of methods from a class\n");
+	color::out_printf(" - print list of methods from a class (Tab completes class_path)\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "find_class _str_");
-	printf(" - find a class which contains _str_ string\n");
+	color::out_printf(" - find a class which contains _str_ string (or matches /regex/, /regex/i)\n");
 
-	printf("\n");
+	color::out_printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "methods [funcs]");
-	printf(" - print all methods from APK file\n");
-	color::color_printf(color::FG_LIGHT_GREEN, "disassemble [dis] method_path");
-	printf(" - disassemble a method\n");
+	color::out_printf(" - print all methods from APK file\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "disassemble [dis] [--cfg|--cfg-verbose] method_path [> file_path]");
+	color::out_printf(" - disassemble a method (optionally split into basic blocks or written to a file; Tab completes method_path)\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "cfg_export method_path file_path");
+	color::out_printf(" - write CFG of a method to a Graphviz DOT (or JSON if *.json) file\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "export_disasm dir_path");
+	color::out_printf(" - disassemble all classes into one file per class under 'dir_path'\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "find_method [find_func] _str_");
-	printf(" - find a method which contains _str_ string\n");
+	color::out_printf(" - find a method which contains _str_ string (or matches /regex/, /regex/i)\n");
 
-	printf("\n");
+	color::out_printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "manifest");
-	printf(" - print content of AndroidManifest.xml file\n");
+	color::out_printf(" - print content of AndroidManifest.xml file\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "resource _id_");
+	color::out_printf(" - name and value of resource _id_ (e.g. 0x7f0e001b) from resources.arsc\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "is_debuggable");
-	printf(" - Checks android::debuggable field of AndroidManifest.xml file\n");
+	color::out_printf(" - Checks android::debuggable field of AndroidManifest.xml file\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "certificate");
-	printf(" - print content of root certificate\n");
+	color::out_printf(" - print content of root certificate\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "creation_date");
-	printf(" - print creation date of the application based on a certificate\n");
+	color::out_printf(" - print creation date of the application based on a certificate\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "signatures");
+	color::out_printf(" - APK Signature Scheme v2/v3 signers and certificates\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "verify");
+	color::out_printf(" - verify the v2/v3 signatures: content digests (on all cores) and signed data\n");
 	
 	// libs
-	printf("\n");
+	color::out_printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "libs");
-	printf(" - print list of native library files\n");
+	color::out_printf(" - print list of native library files\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "dump_libs");
-	printf(" - write all lib files to disk\n");
+	color::out_printf(" - write all lib files to disk\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "dump_lib lib_path");
-	printf(" - write 'lib_path' file to disk\n");
+	color::out_printf(" - write 'lib_path' file to disk\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "unpack [directory]");
+	color::out_printf(" - write all files of the APK to disk (default: next to the APK, in _unpacked)\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "lib_info [lib_path]");
+	color::out_printf(" - ELF info of native libs: ABI, NEEDED, JNI exports, packers (details of 'lib_path')\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "natives");
+	color::out_printf(" - native methods of the DEX files and the libs exporting them\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "libs_hash [libh]");
-	printf(" - SHA-1 hashes of lib files\n");
+	color::out_printf(" - SHA-1 hashes of lib files\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "hashes [md5,sha1,sha256,...]");
+	color::out_printf(" - digests of the APK, its DEX files and lib files (default: md5,sha1,sha256)\n");
 	
 	// strings
-	printf("\n");
+	color::out_printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "strings [strs]");
-	printf(" - print the strings of APK (thanks to Strings Constant Pool)\n");
+	color::out_printf(" - print the strings of APK (thanks to Strings Constant Pool)\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "string [str] search_string");
-	printf(" - find \"search_string\" in the strings of APK\n");
-	color::color_printf(color::FG_LIGHT_GREEN, "interesting_strings [???]"); // TODO(lasha): short form
-	printf(" - Interesting/Suspicious strings from the APK file\n");
+	color::out_printf(" - find \"search_string\" in the strings of APK (or /regex/, /regex/i)\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "interesting_strings [???] [rules_file]"); // TODO(lasha): short form
+	color::out_printf(" - Interesting/Suspicious strings from the APK file (rules_file: \"category pattern\" lines)\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "suspicious_blobs [count]");
+	color::out_printf(" - strings and files ranked by entropy and Base64/hex likelihood: packed or encrypted data\n");
+
+	// queries
+	color::out_printf("\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "select table [where condition] [limit count]");
+	color::out_printf(" - query classes, methods, fields, strings or xrefs of the DEX files, e.g.\n");
+	color::out_printf("\tselect method where class ~ \"okhttp\" and calls \"Ljava/lang/Runtime;->exec\" and access & native\n");
+	color::out_printf("\tconditions: column ~ \"text\" (or \"/regex/\"), = != < <= > >=, access & public|static, calls, uses, not, and, or, ( )\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "explain select ...");
+	color::out_printf(" - print the execution plan of a query\n");
 
 	// misc
-	printf("\n");
+	color::out_printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "language [lang]");
-	printf(" - print a language used to write the application\n");
-
-	printf("\n");
+	color::out_printf(" - print a language used to write the application\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "benchmark [bench] [manifest|hash|inflate]");
+	color::out_printf(" - measure parsers throughput on this APK\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "status");
+	color::out_printf(" - progress of the indexing running in the background (DEX files, tables, names, xrefs)\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "json|jsonl command");
+	color::out_printf(" - records of the command as a JSON array or JSON lines, e.g. jsonl strings\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "apks");
+	color::out_printf(" - (--client) APKs loaded by the daemon\n");
+	color::color_printf(color::FG_LIGHT_GREEN, "use n");
+	color::out_printf(" - (--client) run the next commands on the daemon's APK n\n");
+
+	color::out_printf("\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "cls [clr]");
-	printf(": Clear screen\n");
+	color::out_printf(": Clear screen\n");
 	color::color_printf(color::FG_LIGHT_GREEN, "\nexit/quit\n");
-	printf("\n");
+	color::out_printf("\n");
 }
 
-int main(const int argc, char* argv[])
-{
-	utils::clrscr();
-	color_printf(color::FG_LIGHT_RED, "A n d r o m e d a ");
-	color_printf(color::FG_LIGHT_CYAN, " - Interactive Reverse Engineering Tool for Android Applications\n\n");
-	if (argc < 2)
-	{
-		usage();
-		return -1;
-	}
-	// disable buffering
-	setbuf(stdout, nullptr);
+void execute_command(andromeda::apk& apk, const std::string& line);
 
-	const auto full_path = fs::absolute(argv[1]);
-	if (!exists(full_path))
+/*
+	"json command", "jsonl command": the records of the command, as one JSON array or as JSON lines.
+	Whatever the command prints as text (messages, commands without records) is added as "text" records, a line each.
+*/
+void execute_structured(andromeda::apk& apk, const std::string& command, const utils::json_writer::format format)
+{
+	const auto out_file = color::output();
+	char* text = nullptr;
+	size_t text_size = 0;
+	const auto text_file = open_memstream(&text, &text_size);
+	if (text_file == nullptr)
 	{
-		printf("Invalid file path: %ls\n", full_path.wstring().c_str());
-		return -1;
+		color::color_printf(color::FG_LIGHT_RED, "Failed to allocate the text output\n");
+		return;
 	}
 
-	// Setup completion words every time when a user types
-	linenoise::SetCompletionCallback([](const char* editBuffer, std::vector<std::string>& completions)
+	utils::json_writer json(out_file, format);
+	utils::json_writer::current() = &json;
+	color::output() = text_file;
+	execute_command(apk, command);
+	color::output() = out_file;
+	utils::json_writer::current() = nullptr;
+	fclose(text_file);
+
+	// colors removed
+	std::string line{};
+	for (size_t i = 0; i < text_size; i++)
 	{
-		if (editBuffer[0] == 'e')
+		if (text[i] == '\033')
 		{
-			if (strlen(editBuffer) > 1 && editBuffer[1] == 'x')
+			while (i < text_size && text[i] != 'm')
 			{
-				completions.emplace_back("exit");
+				i++;
 			}
-
-			completions.emplace_back("ep");
-			completions.emplace_back("entry_points");
-			completions.emplace_back("epe");
-			completions.emplace_back("entry_points_extended");
-		}
-		else if (editBuffer[0] == 'a')
-		{
-			completions.emplace_back("activities");
 		}
-		else if (editBuffer[0] == 'd')
+		else if (text[i] != '\n')
 		{
-			completions.emplace_back("dis ");
-			completions.emplace_back("disassemble ");
-
-			completions.emplace_back("dump_lib ");
-			completions.emplace_back("dump_libs");
+			line += text[i];
 		}
-		else if (editBuffer[0] == 'c')
+		else if (!line.empty())
 		{
-			completions.emplace_back("class ");
-			completions.emplace_back("class_info ");
-			completions.emplace_back("classes");
-
-			completions.emplace_back("certificate");
-			completions.emplace_back("creation_date");
-
-			if (strlen(editBuffer) > 1 && editBuffer[1] == 'l')
-			{
-				completions.emplace_back("cls");
-				completions.emplace_back("clr");
-			}
+			json.begin_record("text");
+			json.string_field("text", line);
+			json.end_record();
+			line.clear();
 		}
-		else if (editBuffer[0] == 'f')
-		{
-			completions.emplace_back("find_class ");
-			completions.emplace_back("find_method ");
-			completions.emplace_back("find_func ");
+	}
+	if (!line.empty())
+	{
+		json.begin_record("text");
+		json.string_field("text", line);
+		json.end_record();
+	}
+	free(text);
+	json.finish();
+}
 
-			completions.emplace_back("funcs ");
-		}
-		else if (editBuffer[0] == 'm')
-		{
-			completions.emplace_back("manifest");
-			completions.emplace_back("methods");
-		}
-		else if (editBuffer[0] == 'r')
-		{
-			completions.emplace_back("revoke_date");
-			completions.emplace_back("receivers");
-		}
-		else if (editBuffer[0] == 's')
-		{
-			completions.emplace_back("strs");
-			completions.emplace_back("strings");
+void dispatch_command(andromeda::apk& apk, const std::string& line)
+{
+	if ((utils::starts_with(line, "json ") || utils::starts_with(line, "jsonl ")) && utils::json_writer::current() == nullptr)
+	{
+		auto [format, command] = utils::split(line, ' ');
+		execute_structured(apk, command, format == "jsonl" ? utils::json_writer::format::lines : utils::json_writer::format::array);
+	}
+	else if (line == "?" || line == "help")
+	{
+		help_commands();
+	}
+	else if (line == "activities")
+	{
+		apk.dump_activities();
+	}
+	else if (line == "services")
+	{
+		apk.dump_services();
+	}
+	else if (line == "receivers")
+	{
+		apk.dump_receivers();
+	}
+	else if (line == "manifest")
+	{
+		apk.dump_manifest_file();
+	}
+	else if (line == "permissions" || line == "perms")
+	{
+		apk.dump_permissions();
+	}
+	else if (line == "is_debuggable")
+	{
+		apk.is_debuggable();
+	}
 
-			completions.emplace_back("str ");
-			completions.emplace_back("string ");
+	else if (line == "ep" || line == "entry_points")
+	{
+		apk.get_manifest()->dump_entry_points();
+	}
+	else if (line == "epe" || line == "entry_points_extended")
+	{
+		apk.get_manifest()->dump_entry_points(true);
+	}
 
-			completions.emplace_back("services");
-		}
-		else if (editBuffer[0] == 'i')
-		{
-			completions.emplace_back("is_debuggable");
-			completions.emplace_back("interesting_strings");
-		}
-		else if (editBuffer[0] == 'l')
-		{
-			completions.emplace_back("libs");
-			completions.emplace_back("libs_hash");
-			completions.emplace_back("libh");
-			
-			completions.emplace_back("language");
-			completions.emplace_back("lang");
-			
-		}
-		else if (editBuffer[0] == 'p')
+	else if (utils::starts_with(line, "class ") || utils::starts_with(line, "class_info "))
+	{
+		auto [_, class_path] = utils::split(line, ' ');
+		if (!class_path.empty())
 		{
-			completions.emplace_back("permissions");
-			completions.emplace_back("perms");
+			apk.dump_class_methods(class_path);
 		}
-
-		else if (editBuffer[0] == 'h')
+		else
 		{
-			completions.emplace_back("help");
+			color::color_printf(color::FG_LIGHT_RED, "Invalid class path\n");
 		}
-	});
-
-	// PROCESS APK FILE
-	andromeda::apk apk(full_path);
-	if (!apk.is_valid)
+	}
+	else if (line == "classes")
 	{
-		printf("Failed to parse APK file\n");
-		return -1;
+		apk.dump_classes();
 	}
-
-	while (true)
+	else if (utils::starts_with(line, "find_class "))
 	{
-		std::string line;
-		const auto quit = linenoise::Readline("Andromeda> ", line);
-		if (quit || line == "quit" || line == "exit")
+		auto [_, class_part] = utils::split(line, ' ');
+		if (!class_part.empty())
 		{
-			//if (fs::exists(apk.))
-			//{
-			//    fs::remove_all(unpacked_dir);
-			//}
-			break;
+			apk.find_dump_class(class_part);
 		}
-		linenoise::AddHistory(line.c_str());
+	}
 
-		if (line == "?" || line == "help")
+	else if (line == "methods" || line == "funcs")
+	{
+		apk.dump_methods();
+	}
+	else if (utils::starts_with(line, "find_method ") || utils::starts_with(line, "find_func "))
+	{
+		auto [_, method_name] = utils::split(line, ' ');
+		if (!method_name.empty())
 		{
-			help_commands();
+			apk.fin_dump_method(method_name);
 		}
-		else if (line == "activities")
+	}
+	
+	else if (utils::starts_with(line, "dis ") || utils::starts_with(line, "disassemble "))
+	{
+		auto [_, method_path] = utils::split(line, ' ');
+		auto cfg_type = DexDissasembler::CfgType::None;
+		if (utils::starts_with(method_path, "--"))
 		{
-			apk.dump_activities();
+			auto [cfg_option, path] = utils::split(method_path, ' ');
+			if (cfg_option != "--cfg" && cfg_option != "--cfg-verbose")
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Invalid option: %s (--cfg or --cfg-verbose)\n", cfg_option.c_str());
+				return;
+			}
+			cfg_type = cfg_option == "--cfg-verbose" ? DexDissasembler::CfgType::Verbose : DexDissasembler::CfgType::Compact;
+			method_path = path;
 		}
-		else if (line == "services")
+		auto [target_method, out_path] = split_output_redirect(method_path);
+		method_path = target_method;
+
+		if (!method_path.empty())
 		{
-			apk.dump_services();
+			apk.disasm_method(method_path, cfg_type, out_path);
 		}
-		else if (line == "receivers")
+		else
 		{
-			apk.dump_receivers();
+			color::color_printf(color::FG_LIGHT_RED, "Invalid method path\n");
 		}
-		else if (line == "manifest")
+	}
+	else if (utils::starts_with(line, "export_disasm "))
+	{
+		auto [_, dir_path] = utils::split(line, ' ');
+		if (!dir_path.empty())
 		{
-			apk.dump_manifest_file();
+			apk.export_disassembly(dir_path);
 		}
-		else if (line == "permissions" || line == "perms")
+	}
+	else if (utils::starts_with(line, "cfg_export "))
+	{
+		auto [_, arguments] = utils::split(line, ' ');
+		auto [method_path, file_path] = utils::split(arguments, ' ');
+		if (!method_path.empty() && !file_path.empty())
 		{
-			apk.dump_permissions();
+			apk.export_method_cfg(method_path, file_path);
 		}
-		else if (line == "is_debuggable")
+		else
 		{
-			apk.is_debuggable();
+			color::color_printf(color::FG_LIGHT_RED, "Usage: cfg_export method_path file_path\n");
 		}
+	}
 
-		else if (line == "ep" || line == "entry_points")
-		{
-			apk.app_manifest->dump_entry_points();
-		}
-		else if (line == "epe" || line == "entry_points_extended")
-		{
-			apk.app_manifest->dump_entry_points(true);
-		}
 
-		else if (utils::starts_with(line, "class ") || utils::starts_with(line, "class_info "))
+	else if (line == "certificate")
+	{
+		apk.dump_certificate();
+	}
+	else if (line == "creation_date")
+	{
+		apk.dump_creation_date();
+	}
+	else if (line == "revoke_date")
+	{
+		apk.dump_revoke_date();
+	}
+	else if (line == "signatures")
+	{
+		apk.dump_signatures();
+	}
+	else if (line == "verify")
+	{
+		apk.verify();
+	}
+
+	// libs
+	else if (line == "libs")
+	{
+		const auto libs = apk.get_libs();
+		if (const auto json = utils::json_writer::current())
 		{
-			auto [_, class_path] = utils::split(line, ' ');
-			if (!class_path.empty())
+			for (const auto& lib : libs)
 			{
-				apk.dump_class_methods(class_path);
-			}
-			else
-			{
-				color::color_printf(color::FG_LIGHT_RED, "Invalid class path\n");
+				// the archive path, as lib_info and natives give it
+				json->begin_record("lib");
+				json->string_field("path", "lib/" + lib);
+				json->end_record();
 			}
 		}
-		else if (line == "classes")
+		else if (!libs.empty())
 		{
-			apk.dump_classes();
-		}
-		else if (utils::starts_with(line, "find_class "))
-		{
-			auto [_, class_part] = utils::split(line, ' ');
-			if (!class_part.empty())
+			color::color_printf(color::FG_DARK_GRAY, "Libs:\n");
+			for (const auto& lib : libs)
 			{
-				apk.find_dump_class(class_part);
+				color::color_printf(color::FG_GREEN, "\t%s\n", lib.c_str());
 			}
 		}
-
-		else if (line == "methods" || line == "funcs")
-		{
-			apk.dump_methods();
-		}
-		else if (utils::starts_with(line, "find_method ") || utils::starts_with(line, "find_func "))
+	}
+	else if (line == "dump_libs")
+	{
+		apk.get_libs(true);
+	}
+	else if (utils::starts_with(line, "dump_lib "))
+	{
+		auto [_, lib_path] = utils::split(line, ' ');
+		if (!lib_path.empty())
 		{
-			auto [_, method_name] = utils::split(line, ' ');
-			if (!method_name.empty())
-			{
-				apk.fin_dump_method(method_name);
-			}
+			apk.get_libs(true, lib_path);
 		}
-		
-		else if (utils::starts_with(line, "dis ") || utils::starts_with(line, "disassemble "))
+	}
+	else if (line == "unpack" || utils::starts_with(line, "unpack "))
+	{
+		auto [_, directory] = utils::split(line, ' ');
+		apk.unpack(directory);
+	}
+	else if (utils::starts_with(line, "resource "))
+	{
+		auto [_, resource_id] = utils::split(line, ' ');
+		apk.dump_resource(strtoul(resource_id.c_str(), nullptr, 16));
+	}
+	else if (line == "lib_info" || utils::starts_with(line, "lib_info "))
+	{
+		auto [_, lib_path] = utils::split(line, ' ');
+		apk.dump_lib_info(lib_path);
+	}
+	else if (line == "natives")
+	{
+		apk.dump_native_methods();
+	}
+	else if (line == "libs_hash" || line == "libh")
+	{
+		apk.hash_libs();
+	}
+	else if (line == "hashes" || utils::starts_with(line, "hashes "))
+	{
+		auto [_, names] = utils::split(line, ' ');
+		if (names.empty())
 		{
-			auto [_, method_path] = utils::split(line, ' ');
-			if (!method_path.empty())
-			{
-				apk.disasm_method(method_path);
-			}
-			else
-			{
-				color::color_printf(color::FG_LIGHT_RED, "Invalid method path\n");
-			}
+			names = "md5,sha1,sha256";
 		}
+		std::replace(names.begin(), names.end(), ',', ' ');
 
+		std::vector<std::string> algorithms{};
+		utils::split(names, algorithms);
+		apk.dump_hashes(algorithms);
+	}
+	
 
-		else if (line == "certificate")
-		{
-			apk.dump_certificate();
-		}
-		else if (line == "creation_date")
-		{
-			apk.dump_creation_date();
-		}
-		else if (line == "revoke_date")
+	// strings
+	else if (line == "strings" || line == "strs")
+	{
+		apk.dump_strings();
+	}
+	else if (line == "interesting_strings" || utils::starts_with(line, "interesting_strings "))
+	{
+		auto [_, rules_file] = utils::split(line, ' ');
+		apk.dump_interesting_strings(rules_file);
+	}
+	else if (line == "suspicious_blobs" || utils::starts_with(line, "suspicious_blobs "))
+	{
+		auto [_, count] = utils::split(line, ' ');
+		apk.dump_suspicious_blobs(count.empty() ? 50 : strtoul(count.c_str(), nullptr, 10));
+	}
+	else if (utils::starts_with(line, "str ") || utils::starts_with(line, "string "))
+	{
+		auto [_, target_string] = utils::split(line, ' ');
+		if (!target_string.empty())
 		{
-			apk.dump_revoke_date();
+			apk.search_string(target_string);
 		}
+	}
 
-		// libs
-		else if (line == "libs")
-		{
-			const auto libs = apk.get_libs(full_path);
-			if (!libs.empty())
-			{
-				color::color_printf(color::FG_DARK_GRAY, "Libs:\n");
-				for (const auto& lib : libs)
-				{
-					color::color_printf(color::FG_GREEN, "\t%s\n", lib.c_str());
-				}
-			}
-		}
-		else if (line == "dump_libs")
+	// queries
+	else if (utils::starts_with(line, "select ") || utils::starts_with(line, "explain "))
+	{
+		apk.run_query(line);
+	}
+
+	// misc
+	else if (line == "status")
+	{
+		apk.dump_status();
+	}
+	else if (line == "language" || line == "lang")
+	{
+		apk.dump_language();
+	}
+
+	else if (line == "benchmark" || line == "bench" || utils::starts_with(line, "benchmark ") || utils::starts_with(line, "bench "))
+	{
+		auto [_, target] = utils::split(line, ' ');
+		apk.run_benchmark(target);
+	}
+
+	// clear screen
+	else if (line == "clr" || line == "cls" || line == "clear")
+	{
+		utils::clrscr();
+	}
+	// invalid command
+	else
+	{
+		color::color_printf(color::FG_RED, "Invalid command: %s\n", line.c_str());
+		help_commands();
+	}
+}
+
+// runs one command line, from the prompt or from the batch mode arguments; a failed parse (of a corrupt DEX, manifest, ...) is printed
+void execute_command(andromeda::apk& apk, const std::string& line)
+{
+	try
+	{
+		dispatch_command(apk, line);
+	}
+	catch (const std::exception& error)
+	{
+		color::color_printf(color::FG_LIGHT_RED, "Failed: %s\n", error.what());
+	}
+}
+
+/*
+	Commands a daemon runs concurrently on one APK: they only read what the APK builds in the background
+	(manifest, certificate, tables, name index, xrefs). The others build state on first use and run alone on it.
+*/
+bool is_read_only_command(const std::string& line)
+{
+	static const std::set<std::string> commands{
+		"?", "help", "status",
+		"activities", "services", "receivers", "permissions", "perms", "is_debuggable",
+		"ep", "entry_points", "epe", "entry_points_extended",
+		"certificate", "creation_date", "revoke_date",
+		"classes", "methods", "funcs", "strings", "strs",
+	};
+	static const std::vector<std::string> prefixes{
+		"class ", "class_info ", "find_class ", "find_method ", "find_func ", "select ", "explain ",
+	};
+
+	if (utils::starts_with(line, "json ") || utils::starts_with(line, "jsonl "))
+	{
+		return is_read_only_command(utils::split(line, ' ').second);
+	}
+	if (commands.count(line) != 0)
+	{
+		return true;
+	}
+	return std::any_of(prefixes.begin(), prefixes.end(), [&line](const std::string& prefix) { return utils::starts_with(line, prefix); });
+}
+
+// arguments from first on, as one command line
+std::string join_arguments(const int argc, char* argv[], const int first)
+{
+	std::string line{};
+	for (auto i = first; i < argc; i++)
+	{
+		if (i != first)
 		{
-			apk.get_libs(full_path, true);
+			line += ' ';
 		}
-		else if (utils::starts_with(line, "dump_lib "))
+		line += argv[i];
+	}
+	return line;
+}
+
+// --daemon socket_path apk_file_path...
+int run_daemon(const int argc, char* argv[])
+{
+	if (argc < 4)
+	{
+		usage();
+		return -1;
+	}
+
+	andromeda::server server(argv[2], execute_command,
+	                         [](andromeda::apk& apk, const std::string& line, std::vector<std::string>& completions)
+	                         {
+		                         if (!complete_argument(apk, line, completions))
+		                         {
+			                         complete_command(line.c_str(), completions);
+		                         }
+	                         },
+	                         is_read_only_command);
+	for (auto i = 3; i < argc; i++)
+	{
+		const auto full_path = fs::absolute(argv[i]);
+		if (!exists(full_path) || !server.load(full_path))
 		{
-			auto [_, lib_path] = utils::split(line, ' ');
-			if (!lib_path.empty())
-			{
-				apk.get_libs(full_path, true, lib_path);
-			}
+			color::out_printf("Failed to parse APK file: %s\n", full_path.c_str());
+			return -1;
 		}
-		else if (line == "libs_hash" || line == "libh")
+	}
+	return server.run() ? 0 : -1;
+}
+
+// --client socket_path [command]: the prompt (or the command) of a daemon
+int run_client(const int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		usage();
+		return -1;
+	}
+
+	andromeda::client client(argv[2]);
+	if (!client.is_connected())
+	{
+		color::color_printf(color::FG_LIGHT_RED, "No daemon listens on %s\n", argv[2]);
+		return -1;
+	}
+
+	std::string reply{};
+	if (argc > 3)
+	{
+		if (!client.request(join_arguments(argc, argv, 3), reply))
 		{
-			apk.get_libs(full_path, true, "", true);
+			return -1;
 		}
-		
+		fwrite(reply.data(), 1, reply.size(), stdout);
+		return 0;
+	}
 
-		// strings
-		else if (line == "strings" || line == "strs")
+	linenoise::SetCompletionCallback([&client](const char* editBuffer, std::vector<std::string>& completions)
+	{
+		client.complete(editBuffer, completions);
+		if (editBuffer[0] == 'a')
 		{
-			apk.dump_strings();
+			completions.emplace_back("apks");
 		}
-		else if (line == "interesting_strings")
+		else if (editBuffer[0] == 'u')
 		{
-			apk.dump_interesting_strings();
+			completions.emplace_back("use ");
 		}
-		else if (utils::starts_with(line, "str ") || utils::starts_with(line, "string "))
+	});
+
+	while (true)
+	{
+		std::string line;
+		const auto quit = linenoise::Readline("Andromeda> ", line);
+		// piped commands end with the input
+		if (quit || line == "quit" || line == "exit" || (line.empty() && std::cin.eof()))
 		{
-			auto [_, target_string] = utils::split(line, ' ');
-			if (!target_string.empty())
-			{
-				apk.search_string(target_string);
-			}
+			break;
 		}
+		linenoise::AddHistory(line.c_str());
 
-		// misc
-		else if (line == "language" || line == "lang")
+		if (!client.request(line, reply))
 		{
-			apk.dump_language();
+			color::color_printf(color::FG_LIGHT_RED, "The daemon is gone\n");
+			return -1;
 		}
+		fwrite(reply.data(), 1, reply.size(), stdout);
+		fflush(stdout);
+	}
+	return 0;
+}
 
-		// clear screen
-		else if (line == "clr" || line == "cls" || line == "clear")
+int main(const int argc, char* argv[])
+{
+	if (argc > 1 && strcmp(argv[1], "--daemon") == 0)
+	{
+		return run_daemon(argc, argv);
+	}
+	if (argc > 1 && strcmp(argv[1], "--client") == 0)
+	{
+		return run_client(argc, argv);
+	}
+
+	// batch mode: the command given after the APK path is run once, without the prompt
+	const auto batch_mode = argc > 2;
+	if (!batch_mode)
+	{
+		utils::clrscr();
+		color_printf(color::FG_LIGHT_RED, "A n d r o m e d a ");
+		color_printf(color::FG_LIGHT_CYAN, " - Interactive Reverse Engineering Tool for Android Applications\n\n");
+	}
+	if (argc < 2)
+	{
+		usage();
+		return -1;
+	}
+	// fully buffered, flushed before every prompt
+	setvbuf(stdout, nullptr, _IOFBF, 1 << 16);
+
+	const auto full_path = fs::absolute(argv[1]);
+	if (!exists(full_path))
+	{
+		color::out_printf("Invalid file path: %ls\n", full_path.wstring().c_str());
+		return -1;
+	}
+
+	// PROCESS APK FILE
+	andromeda::apk apk(full_path);
+	if (!apk.is_valid)
+	{
+		color::out_printf("Failed to parse APK file\n");
+		return -1;
+	}
+
+	// Setup completion words every time when a user types
+	linenoise::SetCompletionCallback([&apk](const char* editBuffer, std::vector<std::string>& completions)
+	{
+		if (!complete_argument(apk, editBuffer, completions))
 		{
-			utils::clrscr();
+			complete_command(editBuffer, completions);
 		}
-		// invalid command
-		else
+	});
+
+	if (batch_mode)
+	{
+		execute_command(apk, join_arguments(argc, argv, 2));
+		fflush(stdout);
+		return 0;
+	}
+
+	while (true)
+	{
+		fflush(stdout);
+		std::string line;
+		const auto quit = linenoise::Readline("Andromeda> ", line);
+		if (quit || line == "quit" || line == "exit")
 		{
-			color::color_printf(color::FG_RED, "Invalid command: %s\n", line.c_str());
-			help_commands();
+			//if (fs::exists(apk.))
+			//{
+			//    fs::remove_all(unpacked_dir);
+			//}
+			break;
 		}
+		linenoise::AddHistory(line.c_str());
+
+		execute_command(apk, line);
 
 		// loop end
 	}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace utils
+{
+	/*
+		Aho-Corasick automaton: all patterns are found in one pass over the text, whatever their number.
+		After build() it is a full DFA (failure links folded into the transitions) over byte classes:
+		bytes that appear in no pattern share one class, so the table stays small with hundreds of patterns.
+		Matching is ASCII case-insensitive if asked for. Read-only after build(), scans can run in parallel.
+	*/
+	class aho_corasick
+	{
+		bool case_insensitive_;
+		std::vector<std::pair<std::string, uint32_t>> patterns_{}; // pattern, id reported on match
+
+		std::array<uint16_t, 256> byte_class_{};
+		size_t classes_count_ = 1;
+		std::vector<uint32_t> transitions_{}; // state * classes_count_ + class -> state
+		std::vector<uint32_t> output_begin_{}; // ids matched in state s: outputs_[output_begin_[s] .. output_begin_[s + 1])
+		std::vector<uint32_t> outputs_{};
+
+		unsigned char fold(const unsigned char chr) const
+		{
+			return case_insensitive_ && chr >= 'A' && chr <= 'Z' ? chr + ('a' - 'A') : chr;
+		}
+
+	public:
+		explicit aho_corasick(const bool case_insensitive = true) : case_insensitive_(case_insensitive)
+		{
+		}
+
+		// id is what scan() reports, several patterns can share one; empty patterns are ignored
+		void add(const std::string& pattern, const uint32_t id)
+		{
+			if (!pattern.empty())
+			{
+				patterns_.emplace_back(pattern, id);
+			}
+		}
+
+		size_t size() const
+		{
+			return patterns_.size();
+		}
+
+		void build()
+		{
+			// byte classes: one per distinct (folded) byte of the patterns, 0 for all the others
+			byte_class_.fill(0);
+			classes_count_ = 1;
+			for (const auto& pattern : patterns_)
+			{
+				for (const auto chr : pattern.first)
+				{
+					auto& byte_class = byte_class_[fold(static_cast<unsigned char>(chr))];
+					if (byte_class == 0)
+					{
+						byte_class = static_cast<uint16_t>(classes_count_++);
+					}
+				}
+			}
+			if (case_insensitive_)
+			{
+				for (auto chr = 'A'; chr <= 'Z'; chr++)
+				{
+					byte_class_[static_cast<unsigned char>(chr)] = byte_class_[fold(chr)];
+				}
+			}
+
+			// trie, 0 in transitions_ means no edge yet (the root can't be a target)
+			transitions_.assign(classes_count_, 0);
+			std::vector<std::vector<uint32_t>> state_outputs(1);
+			for (const auto& pattern : patterns_)
+			{
+				uint32_t state = 0;
+				for (const auto chr : pattern.first)
+				{
+					const auto byte_class = byte_class_[static_cast<unsigned char>(chr)];
+					auto next = transitions_[state * classes_count_ + byte_class];
+					if (next == 0)
+					{
+						next = static_cast<uint32_t>(state_outputs.size());
+						state_outputs.emplace_back();
+						transitions_.resize(transitions_.size() + classes_count_, 0);
+						transitions_[state * classes_count_ + byte_class] = next;
+					}
+					state = next;
+				}
+				state_outputs[state].push_back(pattern.second);
+			}
+
+			// breadth first: missing edges take the failure state's, outputs inherit the failure state's
+			const auto states_count = state_outputs.size();
+			std::vector<uint32_t> failure(states_count, 0);
+			std::deque<uint32_t> queue{};
+			for (size_t byte_class = 0; byte_class < classes_count_; byte_class++)
+			{
+				const auto next = transitions_[byte_class];
+				if (next != 0)
+				{
+					queue.push_back(next);
+				}
+			}
+			while (!queue.empty())
+			{
+				const auto state = queue.front();
+				queue.pop_front();
+
+				const auto& inherited = state_outputs[failure[state]];
+				state_outputs[state].insert(state_outputs[state].end(), inherited.begin(), inherited.end());
+
+				for (size_t byte_class = 0; byte_class < classes_count_; byte_class++)
+				{
+					auto& next = transitions_[state * classes_count_ + byte_class];
+					const auto fallback = transitions_[failure[state] * classes_count_ + byte_class];
+					if (next == 0)
+					{
+						next = fallback;
+						continue;
+					}
+					failure[next] = fallback;
+					queue.push_back(next);
+				}
+			}
+
+			output_begin_.assign(states_count + 1, 0);
+			outputs_.clear();
+			for (size_t state = 0; state < states_count; state++)
+			{
+				output_begin_[state] = static_cast<uint32_t>(outputs_.size());
+				outputs_.insert(outputs_.end(), state_outputs[state].begin(), state_outputs[state].end());
+			}
+			output_begin_[states_count] = static_cast<uint32_t>(outputs_.size());
+		}
+
+		// on_match(id, end): a pattern with that id ends at text[end - 1]; a pattern is reported at each occurrence
+		template <typename Callback>
+		void scan(const char* text, const size_t size, Callback on_match) const
+		{
+			if (transitions_.empty())
+			{
+				return;
+			}
+
+			uint32_t state = 0;
+			for (size_t i = 0; i < size; i++)
+			{
+				state = transitions_[state * classes_count_ + byte_class_[static_cast<unsigned char>(text[i])]];
+				for (auto output = output_begin_[state]; output != output_begin_[state + 1]; output++)
+				{
+					on_match(outputs_[output], i + 1);
+				}
+			}
+		}
+
+		// class aho_corasick
+	};
+} // namespace utils
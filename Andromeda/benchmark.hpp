@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "color/color.hpp"
+#include "slicer/chronometer.h"
+
+namespace utils
+{
+	/*
+		Micro benchmark runner for the 'benchmark' command.
+		Every case is warmed up once, then repeated until it ran for at least min_ms,
+		so tiny inputs (a manifest is a few KB) still give stable numbers.
+	*/
+	class benchmark
+	{
+	public:
+		struct result
+		{
+			std::string name;
+			size_t iterations = 0;
+			double total_ms = 0;
+			size_t bytes = 0; // processed by one iteration, 0 if throughput makes no sense
+
+			double ms_per_iteration() const
+			{
+				return iterations != 0 ? total_ms / iterations : 0;
+			}
+
+			double mb_per_second() const
+			{
+				return total_ms > 0 ? bytes * iterations / (1024.0 * 1024.0) / (total_ms / 1000.0) : 0;
+			}
+		};
+
+	private:
+		double min_ms_;
+		std::vector<result> results_{};
+
+	public:
+		explicit benchmark(const double min_ms = 200) : min_ms_(min_ms)
+		{
+		}
+
+		template <typename Task>
+		const result& run(const std::string& name, const size_t bytes, Task task)
+		{
+			result current{name, 0, 0, bytes};
+
+			task();
+			for (size_t batch = 1; current.total_ms < min_ms_; batch *= 2)
+			{
+				double batch_ms = 0;
+				{
+					slicer::Chronometer chronometer(batch_ms);
+					for (size_t i = 0; i < batch; i++)
+					{
+						task();
+					}
+				}
+				current.total_ms += batch_ms;
+				current.iterations += batch;
+			}
+
+			results_.emplace_back(current);
+			print(results_.back());
+			return results_.back();
+		}
+
+		static void print(const result& current)
+		{
+			color::color_printf(color::FG_GREEN, "\t%-40s", current.name.c_str());
+			color::out_printf(" %10zu iterations %12.4f ms/iteration", current.iterations, current.ms_per_iteration());
+			if (current.bytes != 0)
+			{
+				color::color_printf(color::FG_LIGHT_CYAN, " %10.2f MB/s", current.mb_per_second());
+			}
+			color::out_printf("\n");
+		}
+
+		const std::vector<result>& results() const
+		{
+			return results_;
+		}
+
+		// class benchmark
+	};
+} // namespace utils
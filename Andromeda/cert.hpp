@@ -18,6 +18,58 @@ namespace andromeda
         std::shared_ptr<char> creation_date{};
         std::shared_ptr<char> revoke_date{};
 
+        static std::shared_ptr<char> bio_to_string(BIO* bio)
+        {
+            char* data = nullptr;
+            const auto size = BIO_get_mem_data(bio, &data);
+            auto text = std::shared_ptr<char>{ new char[size + 1](), std::default_delete<char[]>() };
+            memcpy(text.get(), data, size);
+            BIO_free(bio);
+            return text;
+        }
+
+        void load_certificate(X509* root_cert)
+        {
+            auto x509Bio = BIO_new(BIO_s_mem());
+            X509_print(x509Bio, root_cert);
+            root_certificate = bio_to_string(x509Bio);
+
+            auto start_bio = BIO_new(BIO_s_mem());
+            ASN1_TIME_print(start_bio, X509_get_notBefore(root_cert));
+            creation_date = bio_to_string(start_bio);
+
+            auto end_bio = BIO_new(BIO_s_mem());
+            ASN1_TIME_print(end_bio, X509_get_notAfter(root_cert));
+            revoke_date = bio_to_string(end_bio);
+
+            is_cert = true;
+        }
+
+        // root certificate of a PKCS#7 signature block (META-INF/*.RSA, ...), frees the PKCS7
+        void load_pkcs7(PKCS7* pkcs7_certs)
+        {
+            if (pkcs7_certs == nullptr)
+            {
+                return;
+            }
+
+            const auto i = OBJ_obj2nid(pkcs7_certs->type);
+            STACK_OF(X509) *certs = nullptr;
+            if(i == NID_pkcs7_signed) {
+                certs = pkcs7_certs->d.sign->cert;
+            } else if(i == NID_pkcs7_signedAndEnveloped) {
+                certs = pkcs7_certs->d.signed_and_enveloped->cert;
+            }
+
+            const auto number_of_certs = certs == nullptr ? 0 : sk_X509_num(certs);
+            if (number_of_certs > 0)
+            {
+                // owned by the PKCS7 stack, freed with it
+                load_certificate(sk_X509_value(certs, number_of_certs - 1));
+            }
+            PKCS7_free(pkcs7_certs);
+        }
+
     public:
         
         bool is_certificate() const
@@ -48,56 +100,42 @@ namespace andromeda
                     }
                     const auto pkcs7_certs = d2i_PKCS7_fp(fp, NULL);
                     fclose(fp);
+                    load_pkcs7(pkcs7_certs);
 
-                    const auto i = OBJ_obj2nid(pkcs7_certs->type);
-                    STACK_OF(X509) *certs;
-                    if(i == NID_pkcs7_signed) {
-                        certs = pkcs7_certs->d.sign->cert;
-                    } else if(i == NID_pkcs7_signedAndEnveloped) {
-                        certs = pkcs7_certs->d.signed_and_enveloped->cert;
-                    }
-
-                    const auto number_of_certs = sk_X509_num(certs);
-                    if (number_of_certs == 0)
+                    if (is_cert)
                     {
-                        return;
+                        break;
                     }
-                    
-                    auto root_cert = sk_X509_value(certs, number_of_certs - 1);
-                    const auto end_date = X509_get_notAfter(root_cert);
-                    const auto start_date = X509_get_notBefore(root_cert);
-
-                    auto x509Bio = BIO_new(BIO_s_mem());
-                    X509_print(x509Bio, root_cert);
-                    auto buf_len = BIO_number_written(x509Bio);
-                    root_certificate = std::shared_ptr<char>{ new char[buf_len + 1]() };
-                    BIO_read(x509Bio, root_certificate.get(), buf_len + 1);
-                    BIO_free(x509Bio);
-
-                    auto start_bio = BIO_new(BIO_s_mem());
-                    ASN1_TIME_print(start_bio, start_date);
-                    buf_len = BIO_number_written(start_bio);
-                    creation_date = std::shared_ptr<char>{ new char[buf_len + 1]() };
-                    BIO_read(start_bio, creation_date.get(), buf_len + 1);
-                    BIO_free(start_bio);
-
-                    auto end_bio = BIO_new(BIO_s_mem());
-                    ASN1_TIME_print(end_bio, end_date);
-                    buf_len = BIO_number_written(end_bio);
-                    revoke_date = std::shared_ptr<char>{ new char[buf_len + 1]() };
-                    BIO_read(end_bio, revoke_date.get(), buf_len + 1);
-                    BIO_free(end_bio);
-
-                    X509_free(root_cert);
-                    PKCS7_free(pkcs7_certs);
-
-                    is_cert = true;
-                    break;
 				}
 			}
 
         }
 
+        certificate() = default;
+
+        // DER encoded PKCS#7 signature block, e.g. META-INF/CERT.RSA read from the archive
+        bool load_pkcs7(const unsigned char* der, const size_t size)
+        {
+            if (der != nullptr)
+            {
+                load_pkcs7(d2i_PKCS7(nullptr, &der, static_cast<long>(size)));
+            }
+            return is_cert;
+        }
+
+        // DER encoded X.509, e.g. a signer certificate of the APK Signing Block
+        bool load_der(const unsigned char* der, const size_t size)
+        {
+            const auto x509 = d2i_X509(nullptr, &der, static_cast<long>(size));
+            if (x509 == nullptr)
+            {
+                return false;
+            }
+            load_certificate(x509);
+            X509_free(x509);
+            return is_cert;
+        }
+
         certificate(const certificate&) = default;
 		certificate& operator=(const certificate&) = default;
         
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "utils.hpp"
+#include "dex_tables.hpp"
 
 // slicer
 #include "slicer/dex_format.h"
@@ -18,10 +19,10 @@ namespace andromeda
 	{
 		std::shared_ptr<char> dex_content_ = nullptr;
 		std::shared_ptr<dex::Reader> dex_reader_ = nullptr;
-		std::vector<std::string> dex_classes_;
-		std::vector<std::pair<std::string, std::string>> dex_methods_; // class_path, function_name
-		std::vector<std::string> strings_pool; // thanks to Strings Constant Pool
+		size_t dex_size_ = 0;
 		std::string dex_name_;
+		bool full_ir_created_ = false;
+		std::shared_ptr<dex_tables> tables_{}; // classes, methods, fields, strings as columns
 
 		static std::string name_to_descriptor(const std::string& name)
 		{
@@ -54,6 +55,7 @@ namespace andromeda
 			size_t file_size{};
 			dex_name_ = dex_path.filename().string();
 			dex_content_ = utils::read_file(dex_path.string(), file_size);
+			dex_size_ = file_size;
 			dex_reader_ = std::shared_ptr<dex::Reader>{
 				new dex::Reader((dex::u1*)(dex_content_.get()), file_size)
 			};
@@ -61,6 +63,15 @@ namespace andromeda
 			// ctor
 		}
 
+		// DEX image already in memory, dex_content keeps it alive (e.g. a view into the mapped APK)
+		parsed_dex(std::string dex_name, std::shared_ptr<char> dex_content, const size_t dex_size)
+			: dex_content_(std::move(dex_content)), dex_size_(dex_size), dex_name_(std::move(dex_name))
+		{
+			dex_reader_ = std::shared_ptr<dex::Reader>{
+				new dex::Reader((dex::u1*)(dex_content_.get()), dex_size_)
+			};
+		}
+
 		parsed_dex(const parsed_dex&) = default;
 		parsed_dex& operator=(const parsed_dex&) = default;
 
@@ -69,104 +80,53 @@ namespace andromeda
 			return dex_name_;
 		}
 
-		std::vector<std::string> get_strings()
+		// raw DEX image
+		std::pair<const char*, size_t> get_dex_content() const
 		{
-			if (strings_pool.empty())
-			{
-				dex_reader_->CreateFullIr();
-				auto ir = dex_reader_->GetIr();
-				for (const auto& s : ir->strings)
-				{
-					auto current_string = std::string { s->c_str() };
-					if (!current_string.empty())
-					{
-						current_string = utils::strip(current_string);
-						strings_pool.emplace_back(current_string);
-					}
-				}
-			}
-
-			return strings_pool;
+			return std::make_pair(dex_content_.get(), dex_size_);
 		}
 
-		std::vector<std::string> get_classes()
+		// IR of all classes, once it's created the IR is only read
+		std::shared_ptr<ir::DexFile> get_full_ir()
 		{
-			if (dex_classes_.empty())
+			if (!full_ir_created_)
 			{
-				const auto classes = dex_reader_->ClassDefs();
-				const auto types = dex_reader_->TypeIds();
-				for (const auto& current_class : classes)
-				{
-					const auto type_id = types[current_class.class_idx];
-					const auto descriptor = dex_reader_->GetStringMUTF8(type_id.descriptor_idx);
-					dex_classes_.emplace_back(dex::DescriptorToDecl(descriptor));
-				}
+				dex_reader_->CreateFullIr();
+				full_ir_created_ = true;
 			}
 
-			return dex_classes_;
+			return dex_reader_->GetIr();
 		}
 
-		std::vector<std::pair<std::string, std::string>> get_methods()
+		/*
+			Index sections as columns, names interned in arena (shared by the DEX files of an APK).
+			Built once; DEX files can build theirs in parallel, their tables are read once all of them are built.
+		*/
+		void build_tables(const uint32_t dex_id, const std::shared_ptr<utils::string_arena>& arena)
 		{
-			if (dex_methods_.empty())
+			if (tables_ == nullptr)
 			{
-				dex_reader_->CreateFullIr();
-				auto dex_ir = dex_reader_->GetIr();
-
-				for (auto& current_method : dex_ir->methods)
-				{
-					//printf("%s!%s!%s\n", current_method->parent->Decl().c_str(), current_method->name->c_str(), current_method->prototype->Signature().c_str());
-					dex_methods_.emplace_back(current_method->parent->Decl().c_str(), current_method->name->c_str());
-				}
-
+				tables_ = std::make_shared<dex_tables>(*dex_reader_, dex_content_.get(), dex_size_, dex_id, arena);
 			}
-
-			return dex_methods_;
 		}
 
-		std::vector<std::string> get_class_methods(const std::string& class_path) const
+		// build_tables() first
+		dex_tables& get_tables() const
 		{
-			std::vector<std::string> class_methods;
-
-			const auto class_descriptor = name_to_descriptor(class_path);
-			const auto class_index = dex_reader_->FindClassIndex(class_descriptor.c_str());
-			if (class_index == dex::kNoIndex)
-			{
-				// printf("Can not find a class: %s\n", class_path.c_str());
-				return class_methods;
-			}
-			// printf("class found: %s\n\t%s\n", class_descriptor.c_str(), dex_name.c_str());
-
-			dex_reader_->CreateClassIr(class_index);
-
-			auto dex_ir = dex_reader_->GetIr();
-
-			if (dex_ir->encoded_methods.empty())
-			{
-				return class_methods;
-			}
-			//color_printf(color::FG_DARK_GRAY, "Class: %s\n", class_descriptor.c_str());
-			for (auto& ir_method : dex_ir->encoded_methods)
-			{
-				//color_printf(color::FG_GREEN, "\t%s\n", ir_method->decl->name->c_str());
-				class_methods.emplace_back(ir_method->decl->name->c_str());
-			}
-
-			return class_methods;
-			// get_class_methods
+			return *tables_;
 		}
 
-		bool dump_method(const std::string& method_path) const
+		std::vector<ir::EncodedMethod*> find_encoded_methods(const std::string& method_path) const
 		{
+			std::vector<ir::EncodedMethod*> found_methods;
 			const auto [class_path, function_name] = split_method_path(method_path);
 
-			auto found = false;
 			const auto class_descriptor = name_to_descriptor(class_path);
 			const auto class_index = dex_reader_->FindClassIndex(class_descriptor.c_str());
 			if (class_index == dex::kNoIndex)
 			{
 				// printf("Can not find a class: %s\n\t%s\n", class_descriptor.c_str(), dex_name.c_str());
-				return found;
+				return found_methods;
 			}
 
 			dex_reader_->CreateClassIr(class_index);
@@ -185,13 +145,37 @@ namespace andromeda
 				if (current_function_name != function_name)
 					continue;
 
-				found = true;
-				const auto type = DexDissasembler::CfgType::None;
-				DexDissasembler disasm(dex_ir, type);
-				disasm.DumpMethod(ir_method.get());
+				found_methods.emplace_back(ir_method.get());
+			}
+
+			return found_methods;
+		}
+
+		bool dump_method(const std::string& method_path,
+		                 const DexDissasembler::CfgType type = DexDissasembler::CfgType::None,
+		                 OutputBuffer* out = nullptr) const
+		{
+			const auto methods = find_encoded_methods(method_path);
+			DexDissasembler disasm(dex_reader_->GetIr(), type, out);
+			for (const auto ir_method : methods)
+			{
+				disasm.DumpMethod(ir_method);
+			}
+
+			return !methods.empty();
+		}
+
+		// exports CFGs of all overloads of the method, returns number of exported methods
+		size_t export_method_cfg(const std::string& method_path, CfgExporter& exporter) const
+		{
+			const auto methods = find_encoded_methods(method_path);
+			DexDissasembler disasm(dex_reader_->GetIr(), DexDissasembler::CfgType::Verbose);
+			for (const auto ir_method : methods)
+			{
+				disasm.ExportCfg(ir_method, &exporter);
 			}
 
-			return found;
+			return methods.size();
 		}
 	};
 } // namespace andromeda
@@ -0,0 +1,501 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// slicer
+#include "slicer/dex_bytecode.h"
+#include "slicer/dex_format.h"
+#include "slicer/reader.h"
+
+#include "string_arena.hpp"
+
+namespace andromeda
+{
+	/*
+		Index sections of a DEX file as columns: what queries (query.hpp) and the list/search commands scan.
+		Names are ids of a string arena shared by the DEX files of an APK, each distinct name is stored once for all of them
+		and compared once per search. Classes, fields and methods keep the DEX file's type indexes, types map them to names.
+		Access flags and code sizes come from the class data of the image, references of the bytecode (xrefs) are read when first needed.
+	*/
+	class dex_tables
+	{
+	public:
+		enum class xref_kind : uint8_t
+		{
+			call,
+			field,
+			string,
+			type,
+		};
+
+		struct class_columns
+		{
+			std::vector<uint32_t> type{};
+			std::vector<uint32_t> super{}; // dex::kNoIndex for java.lang.Object
+			std::vector<uint32_t> access{};
+		};
+
+		// every method id of the DEX file, the ones it only calls have no access flags and no code
+		struct method_columns
+		{
+			std::vector<uint32_t> class_type{};
+			std::vector<uint32_t> name{}; // arena id
+			std::vector<uint32_t> proto{}; // arena id of (Ljava/lang/String;I)V
+			std::vector<uint32_t> access{};
+			std::vector<uint32_t> code_size{}; // 16-bit code units
+			std::vector<uint32_t> code_offset{};
+		};
+
+		struct field_columns
+		{
+			std::vector<uint32_t> class_type{};
+			std::vector<uint32_t> name{}; // arena id
+			std::vector<uint32_t> type{};
+			std::vector<uint32_t> access{};
+		};
+
+		// sorted by the referencing method, its xrefs are [method_begin[method], method_begin[method + 1])
+		struct xref_columns
+		{
+			std::vector<uint32_t> from{};
+			std::vector<uint32_t> to{}; // method, field, string or type index, depending on kind
+			std::vector<xref_kind> kind{};
+			std::vector<uint32_t> method_begin{};
+		};
+
+	private:
+		const dex::u1* image_;
+		size_t image_size_;
+		uint32_t dex_id_;
+		std::shared_ptr<utils::string_arena> arena_;
+
+		// DEX file indexes -> arena ids
+		std::vector<uint32_t> strings_{};
+		std::vector<uint32_t> type_descriptors_{}; // Ljava/lang/String;
+		std::vector<uint32_t> type_names_{}; // java.lang.String
+
+		class_columns classes_{};
+		method_columns methods_{};
+		field_columns fields_{};
+		xref_columns xrefs_{};
+		bool xrefs_loaded_ = false;
+
+		template <typename T>
+		const T* image_item(const uint32_t offset, const size_t count = 1) const
+		{
+			if (offset == 0 || offset > image_size_ || (image_size_ - offset) / sizeof(T) < count)
+			{
+				return nullptr;
+			}
+			return reinterpret_cast<const T*>(image_ + offset);
+		}
+
+		// Ljava/lang/String; -> java.lang.String, [I -> int[]; malformed descriptors are kept as they are
+		static std::string descriptor_to_name(std::string_view descriptor)
+		{
+			size_t dimensions = 0;
+			while (dimensions < descriptor.size() && descriptor[dimensions] == '[')
+			{
+				dimensions++;
+			}
+			descriptor.remove_prefix(dimensions);
+
+			std::string name{};
+			if (descriptor.size() >= 2 && descriptor.front() == 'L' && descriptor.back() == ';')
+			{
+				name.assign(descriptor.substr(1, descriptor.size() - 2));
+				std::replace(name.begin(), name.end(), '/', '.');
+			}
+			else
+			{
+				const char* primitives[][2] = {{"V", "void"}, {"Z", "boolean"}, {"B", "byte"}, {"S", "short"}, {"C", "char"},
+				                               {"I", "int"}, {"J", "long"}, {"F", "float"}, {"D", "double"}};
+				name.assign(descriptor);
+				for (const auto& primitive : primitives)
+				{
+					if (descriptor == primitive[0])
+					{
+						name = primitive[1];
+					}
+				}
+			}
+			for (size_t i = 0; i < dimensions; i++)
+			{
+				name += "[]";
+			}
+			return name;
+		}
+
+		// ULEB128 values of the class data, false past the end of the image
+		bool read_uleb128(const dex::u1*& ptr, uint32_t& value) const
+		{
+			uint32_t result = 0;
+			for (auto shift = 0; shift < 35; shift += 7)
+			{
+				if (ptr >= image_ + image_size_)
+				{
+					return false;
+				}
+				const auto byte = *ptr++;
+				result |= static_cast<uint32_t>(byte & 0x7f) << shift;
+				if ((byte & 0x80) == 0)
+				{
+					value = result;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void load_class_data(const dex::ClassDef& class_def)
+		{
+			const auto* ptr = image_item<dex::u1>(class_def.class_data_off);
+			uint32_t static_fields = 0, instance_fields = 0, direct_methods = 0, virtual_methods = 0;
+			if (ptr == nullptr || !read_uleb128(ptr, static_fields) || !read_uleb128(ptr, instance_fields) ||
+				!read_uleb128(ptr, direct_methods) || !read_uleb128(ptr, virtual_methods))
+			{
+				return;
+			}
+
+			// the indexes are deltas, restarting with each list
+			const uint32_t list_sizes[] = {static_fields, instance_fields};
+			for (const auto list_size : list_sizes)
+			{
+				uint32_t field_index = 0;
+				for (uint32_t i = 0; i < list_size; i++)
+				{
+					uint32_t index_delta = 0, access = 0;
+					if (!read_uleb128(ptr, index_delta) || !read_uleb128(ptr, access))
+					{
+						return;
+					}
+					field_index += index_delta;
+					if (field_index < fields_.access.size())
+					{
+						fields_.access[field_index] = access;
+					}
+				}
+			}
+
+			const uint32_t method_list_sizes[] = {direct_methods, virtual_methods};
+			for (const auto list_size : method_list_sizes)
+			{
+				uint32_t method_index = 0;
+				for (uint32_t i = 0; i < list_size; i++)
+				{
+					uint32_t index_delta = 0, access = 0, code_offset = 0;
+					if (!read_uleb128(ptr, index_delta) || !read_uleb128(ptr, access) || !read_uleb128(ptr, code_offset))
+					{
+						return;
+					}
+					method_index += index_delta;
+					if (method_index >= methods_.access.size())
+					{
+						continue;
+					}
+					methods_.access[method_index] = access;
+					const auto* code = image_item<dex::Code>(code_offset);
+					if (code != nullptr && image_item<dex::u2>(code_offset + sizeof(dex::Code), code->insns_size) != nullptr)
+					{
+						methods_.code_offset[method_index] = code_offset;
+						methods_.code_size[method_index] = code->insns_size;
+					}
+				}
+			}
+		}
+
+		// references of one method's bytecode, in the order of its instructions
+		void load_method_xrefs(const uint32_t method_index)
+		{
+			const auto* code = image_item<dex::Code>(methods_.code_offset[method_index]);
+			if (code == nullptr)
+			{
+				return;
+			}
+			const auto add = [&](const xref_kind kind, const uint32_t target, const size_t targets_count)
+			{
+				if (target < targets_count)
+				{
+					xrefs_.from.push_back(method_index);
+					xrefs_.to.push_back(target);
+					xrefs_.kind.push_back(kind);
+				}
+			};
+
+			const auto* insns = code->insns;
+			const size_t insns_size = methods_.code_size[method_index];
+			for (size_t pc = 0; pc < insns_size;)
+			{
+				const auto* insn = insns + pc;
+				// switch and array payloads read their sizes from the next units
+				if (insns_size - pc < 4 && (insn[0] == dex::kPackedSwitchSignature || insn[0] == dex::kSparseSwitchSignature || insn[0] == dex::kArrayDataSignature))
+				{
+					break;
+				}
+				const auto width = dex::GetWidthFromBytecode(insn);
+				if (width == 0 || width > insns_size - pc)
+				{
+					break;
+				}
+
+				const auto opcode = insn[0] & 0xff;
+				if ((opcode >= 0x6e && opcode <= 0x72) || (opcode >= 0x74 && opcode <= 0x78) || opcode == 0xfa || opcode == 0xfb)
+				{
+					// invoke-kind, invoke-kind/range, invoke-polymorphic
+					add(xref_kind::call, insn[1], methods_.name.size());
+				}
+				else if (opcode >= 0x52 && opcode <= 0x6d)
+				{
+					// iget, iput, sget, sput
+					add(xref_kind::field, insn[1], fields_.name.size());
+				}
+				else if (opcode == 0x1a)
+				{
+					add(xref_kind::string, insn[1], strings_.size());
+				}
+				else if (opcode == 0x1b)
+				{
+					add(xref_kind::string, insn[1] | static_cast<uint32_t>(insn[2]) << 16, strings_.size());
+				}
+				else if (opcode == 0x1c || opcode == 0x1f || opcode == 0x20 || (opcode >= 0x22 && opcode <= 0x25))
+				{
+					// const-class, check-cast, instance-of, new-instance, new-array, filled-new-array
+					add(xref_kind::type, insn[1], type_descriptors_.size());
+				}
+				pc += width;
+			}
+		}
+
+	public:
+		// image must outlive the tables, reader is only used while they are built; dex_id is the DEX file's index in its APK
+		dex_tables(const dex::Reader& reader, const char* image, const size_t image_size, const uint32_t dex_id, std::shared_ptr<utils::string_arena> arena)
+			: image_(reinterpret_cast<const dex::u1*>(image)), image_size_(image_size), dex_id_(dex_id), arena_(std::move(arena))
+		{
+			const auto string_ids = reader.StringIds();
+			std::vector<std::string_view> texts{};
+			texts.reserve(string_ids.size());
+			for (size_t i = 0; i < string_ids.size(); i++)
+			{
+				texts.emplace_back(reader.GetStringMUTF8(static_cast<dex::u4>(i)));
+			}
+			strings_ = arena_->intern(texts);
+
+			// other DEX files may be interning: names are built from the image, not read back from the arena
+			const auto type_ids = reader.TypeIds();
+			const auto descriptor = [&](const uint32_t type_index)
+			{
+				const auto string_index = type_index < type_ids.size() ? type_ids[type_index].descriptor_idx : dex::kNoIndex;
+				return string_index < texts.size() ? texts[string_index] : std::string_view{};
+			};
+			std::vector<std::string> names{};
+			names.reserve(type_ids.size());
+			for (uint32_t i = 0; i < type_ids.size(); i++)
+			{
+				type_descriptors_.push_back(string_id(type_ids[i].descriptor_idx));
+				names.push_back(descriptor_to_name(descriptor(i)));
+			}
+			type_names_ = arena_->intern(std::vector<std::string_view>(names.begin(), names.end()));
+
+			// protos are only referenced by methods: their signatures are the methods' column
+			std::vector<std::string> signatures{};
+			for (const auto& proto_id : reader.ProtoIds())
+			{
+				std::string signature = "(";
+				const auto* parameters = image_item<dex::TypeList>(proto_id.parameters_off);
+				if (parameters != nullptr && image_item<dex::TypeItem>(proto_id.parameters_off + sizeof(dex::u4), parameters->size) != nullptr)
+				{
+					for (dex::u4 i = 0; i < parameters->size; i++)
+					{
+						signature += descriptor(parameters->list[i].type_idx);
+					}
+				}
+				signature += ')';
+				signature += descriptor(proto_id.return_type_idx);
+				signatures.push_back(std::move(signature));
+			}
+			const auto proto_signatures = arena_->intern(std::vector<std::string_view>(signatures.begin(), signatures.end()));
+
+			const auto method_ids = reader.MethodIds();
+			methods_.class_type.reserve(method_ids.size());
+			methods_.name.reserve(method_ids.size());
+			methods_.proto.reserve(method_ids.size());
+			for (const auto& method_id : method_ids)
+			{
+				methods_.class_type.push_back(method_id.class_idx);
+				methods_.name.push_back(string_id(method_id.name_idx));
+				methods_.proto.push_back(method_id.proto_idx < proto_signatures.size() ? proto_signatures[method_id.proto_idx] : 0);
+			}
+			methods_.access.assign(method_ids.size(), 0);
+			methods_.code_size.assign(method_ids.size(), 0);
+			methods_.code_offset.assign(method_ids.size(), 0);
+
+			const auto field_ids = reader.FieldIds();
+			for (const auto& field_id : field_ids)
+			{
+				fields_.class_type.push_back(field_id.class_idx);
+				fields_.name.push_back(string_id(field_id.name_idx));
+				fields_.type.push_back(field_id.type_idx);
+			}
+			fields_.access.assign(field_ids.size(), 0);
+
+			const auto class_defs = reader.ClassDefs();
+			for (const auto& class_def : class_defs)
+			{
+				classes_.type.push_back(class_def.class_idx);
+				classes_.super.push_back(class_def.superclass_idx);
+				classes_.access.push_back(class_def.access_flags);
+				load_class_data(class_def);
+			}
+		}
+
+		const class_columns& classes() const
+		{
+			return classes_;
+		}
+
+		const method_columns& methods() const
+		{
+			return methods_;
+		}
+
+		const field_columns& fields() const
+		{
+			return fields_;
+		}
+
+		// decoded from the bytecode of all methods on first use
+		const xref_columns& xrefs()
+		{
+			if (!xrefs_loaded_)
+			{
+				xrefs_.method_begin.reserve(methods_.name.size() + 1);
+				for (uint32_t method_index = 0; method_index < methods_.name.size(); method_index++)
+				{
+					xrefs_.method_begin.push_back(static_cast<uint32_t>(xrefs_.from.size()));
+					load_method_xrefs(method_index);
+				}
+				xrefs_.method_begin.push_back(static_cast<uint32_t>(xrefs_.from.size()));
+				xrefs_loaded_ = true;
+			}
+			return xrefs_;
+		}
+
+		uint32_t dex_id() const
+		{
+			return dex_id_;
+		}
+
+		const utils::string_arena& arena() const
+		{
+			return *arena_;
+		}
+
+		std::string_view text(const uint32_t arena_id) const
+		{
+			return arena_->get(arena_id);
+		}
+
+		size_t strings_count() const
+		{
+			return strings_.size();
+		}
+
+		size_t type_count() const
+		{
+			return type_names_.size();
+		}
+
+		// arena id of a string of the DEX file, 0 ("") if there is no such string
+		uint32_t string_id(const uint32_t index) const
+		{
+			return index < strings_.size() ? strings_[index] : 0;
+		}
+
+		// MUTF-8, as stored in the DEX file
+		std::string_view string(const uint32_t index) const
+		{
+			return text(string_id(index));
+		}
+
+		// arena id of java.lang.String, 0 for dex::kNoIndex
+		uint32_t type_name_id(const uint32_t index) const
+		{
+			return index < type_names_.size() ? type_names_[index] : 0;
+		}
+
+		std::string_view type_name(const uint32_t index) const
+		{
+			return text(type_name_id(index));
+		}
+
+		std::string_view type_descriptor(const uint32_t index) const
+		{
+			return text(index < type_descriptors_.size() ? type_descriptors_[index] : 0);
+		}
+
+		// methods with access flags or code are declared by a class of this DEX file, the others are only referenced
+		bool is_defined(const uint32_t method) const
+		{
+			return methods_.access[method] != 0 || methods_.code_offset[method] != 0;
+		}
+
+		// java.lang.Runtime.exec, what dis takes
+		std::string method_path(const uint32_t index) const
+		{
+			std::string path{type_name(methods_.class_type[index])};
+			path += '.';
+			path += text(methods_.name[index]);
+			return path;
+		}
+
+		// Ljava/lang/Runtime;->exec(Ljava/lang/String;)Ljava/lang/Process;, written to reference
+		void method_reference(const uint32_t index, std::string& reference) const
+		{
+			reference.assign(type_descriptor(methods_.class_type[index]));
+			reference += "->";
+			reference += text(methods_.name[index]);
+			reference += text(methods_.proto[index]);
+		}
+
+		// Landroid/os/Build;->MODEL:Ljava/lang/String;, written to reference
+		void field_reference(const uint32_t index, std::string& reference) const
+		{
+			reference.assign(type_descriptor(fields_.class_type[index]));
+			reference += "->";
+			reference += text(fields_.name[index]);
+			reference += ':';
+			reference += type_descriptor(fields_.type[index]);
+		}
+
+		// what an xref points to, as the disassembler prints it; method and field references are built in buffer
+		std::string_view xref_target(const xref_kind kind, const uint32_t target, std::string& buffer) const
+		{
+			switch (kind)
+			{
+			case xref_kind::call: method_reference(target, buffer); return buffer;
+			case xref_kind::field: field_reference(target, buffer); return buffer;
+			case xref_kind::string: return string(target);
+			default: return type_descriptor(target);
+			}
+		}
+
+		static const char* xref_kind_name(const xref_kind kind)
+		{
+			switch (kind)
+			{
+			case xref_kind::call: return "call";
+			case xref_kind::field: return "field";
+			case xref_kind::string: return "string";
+			default: return "type";
+			}
+		}
+
+		// class dex_tables
+	};
+} // namespace andromeda
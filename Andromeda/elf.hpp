@@ -0,0 +1,474 @@
+#pragma once
+
+#include <elf.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace andromeda
+{
+	/*
+		Read-only view of an ELF shared object (little endian, 32 or 64 bit).
+		The image isn't copied: names are string_views into it, so it must outlive the parser.
+		Every offset read from the file is bounds checked, a corrupted or packed library
+		only yields less information, never an out of range read.
+	*/
+	class elf_file
+	{
+	public:
+		struct section
+		{
+			std::string_view name;
+			uint32_t type;
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		struct symbol
+		{
+			std::string_view name;
+			uint64_t value;
+			uint64_t size;
+			uint8_t type; // STT_*
+			bool is_defined;
+		};
+
+	private:
+		const unsigned char* data_ = nullptr;
+		size_t size_ = 0;
+		bool is_valid_ = false;
+		bool is_64_ = false;
+		uint16_t machine_ = EM_NONE;
+
+		std::vector<section> sections_{};
+		std::vector<symbol> dynamic_symbols_{};
+		std::vector<std::string_view> needed_{};
+		std::string_view soname_{};
+
+		struct load_segment
+		{
+			uint64_t vaddr;
+			uint64_t offset;
+			uint64_t file_size;
+		};
+		std::vector<load_segment> load_segments_{};
+
+		// pointer to count objects of T at offset, nullptr if they don't fit in the image
+		template <typename T>
+		const T* at(const uint64_t offset, const uint64_t count = 1) const
+		{
+			if (offset > size_ || count > (size_ - offset) / sizeof(T))
+			{
+				return nullptr;
+			}
+			return reinterpret_cast<const T*>(data_ + offset);
+		}
+
+		// zero terminated string at offset inside a string table of table_size bytes
+		std::string_view string_at(const uint64_t table_offset, const uint64_t table_size, const uint64_t offset) const
+		{
+			if (table_offset > size_ || table_size > size_ - table_offset || offset >= table_size)
+			{
+				return {};
+			}
+			const auto begin = reinterpret_cast<const char*>(data_ + table_offset + offset);
+			const auto max_length = table_size - offset;
+			size_t length = 0;
+			while (length < max_length && begin[length] != '\0')
+			{
+				length++;
+			}
+			return std::string_view{begin, length};
+		}
+
+		bool vaddr_to_offset(const uint64_t vaddr, uint64_t& offset) const
+		{
+			for (const auto& segment : load_segments_)
+			{
+				if (vaddr >= segment.vaddr && vaddr - segment.vaddr < segment.file_size)
+				{
+					offset = segment.offset + (vaddr - segment.vaddr);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		template <typename Ehdr, typename Phdr, typename Shdr, typename Dyn, typename Sym>
+		void parse()
+		{
+			const auto header = at<Ehdr>(0);
+			if (header == nullptr)
+			{
+				return;
+			}
+			machine_ = header->e_machine;
+			is_valid_ = true;
+
+			// program headers: loadable segments (for address translation) and the dynamic segment
+			uint64_t dynamic_offset = 0, dynamic_size = 0;
+			const auto program_headers = header->e_phentsize == sizeof(Phdr) ? at<Phdr>(header->e_phoff, header->e_phnum) : nullptr;
+			for (size_t i = 0; program_headers != nullptr && i < header->e_phnum; i++)
+			{
+				const auto& program_header = program_headers[i];
+				if (program_header.p_type == PT_LOAD)
+				{
+					load_segments_.push_back(load_segment{program_header.p_vaddr, program_header.p_offset, program_header.p_filesz});
+				}
+				else if (program_header.p_type == PT_DYNAMIC)
+				{
+					dynamic_offset = program_header.p_offset;
+					dynamic_size = program_header.p_filesz;
+				}
+			}
+
+			// section headers, packers often strip or corrupt them
+			uint64_t dynsym_offset = 0, dynsym_size = 0, dynstr_offset = 0, dynstr_size = 0;
+			const auto section_headers = header->e_shentsize == sizeof(Shdr) ? at<Shdr>(header->e_shoff, header->e_shnum) : nullptr;
+			if (section_headers != nullptr && header->e_shstrndx < header->e_shnum)
+			{
+				const auto& names = section_headers[header->e_shstrndx];
+				for (size_t i = 0; i < header->e_shnum; i++)
+				{
+					const auto& section_header = section_headers[i];
+					sections_.push_back(section{string_at(names.sh_offset, names.sh_size, section_header.sh_name),
+					                            section_header.sh_type, section_header.sh_offset, section_header.sh_size});
+
+					if (section_header.sh_type == SHT_DYNSYM && section_header.sh_link < header->e_shnum)
+					{
+						const auto& strings = section_headers[section_header.sh_link];
+						dynsym_offset = section_header.sh_offset;
+						dynsym_size = section_header.sh_size;
+						dynstr_offset = strings.sh_offset;
+						dynstr_size = strings.sh_size;
+					}
+				}
+			}
+
+			// dynamic segment: DT_NEEDED, DT_SONAME and the symbol tables when there are no sections
+			const auto dynamic = dynamic_size != 0 ? at<Dyn>(dynamic_offset, dynamic_size / sizeof(Dyn)) : nullptr;
+			const auto dynamic_count = dynamic != nullptr ? dynamic_size / sizeof(Dyn) : 0;
+			uint64_t strtab_vaddr = 0, strtab_size = 0, symtab_vaddr = 0, hash_vaddr = 0, gnu_hash_vaddr = 0;
+			for (size_t i = 0; i < dynamic_count && dynamic[i].d_tag != DT_NULL; i++)
+			{
+				switch (dynamic[i].d_tag)
+				{
+				case DT_STRTAB: strtab_vaddr = dynamic[i].d_un.d_ptr; break;
+				case DT_STRSZ: strtab_size = dynamic[i].d_un.d_val; break;
+				case DT_SYMTAB: symtab_vaddr = dynamic[i].d_un.d_ptr; break;
+				case DT_HASH: hash_vaddr = dynamic[i].d_un.d_ptr; break;
+				case DT_GNU_HASH: gnu_hash_vaddr = dynamic[i].d_un.d_ptr; break;
+				default: break;
+				}
+			}
+
+			uint64_t strtab_offset = 0;
+			const auto has_strtab = strtab_vaddr != 0 && vaddr_to_offset(strtab_vaddr, strtab_offset);
+			if (has_strtab)
+			{
+				for (size_t i = 0; i < dynamic_count && dynamic[i].d_tag != DT_NULL; i++)
+				{
+					if (dynamic[i].d_tag == DT_NEEDED)
+					{
+						needed_.emplace_back(string_at(strtab_offset, strtab_size, dynamic[i].d_un.d_val));
+					}
+					else if (dynamic[i].d_tag == DT_SONAME)
+					{
+						soname_ = string_at(strtab_offset, strtab_size, dynamic[i].d_un.d_val);
+					}
+				}
+			}
+
+			uint64_t symtab_offset = 0;
+			if (dynsym_size == 0 && has_strtab && symtab_vaddr != 0 && vaddr_to_offset(symtab_vaddr, symtab_offset))
+			{
+				dynsym_offset = symtab_offset;
+				dynsym_size = symbols_count(hash_vaddr, gnu_hash_vaddr) * sizeof(Sym);
+				dynstr_offset = strtab_offset;
+				dynstr_size = strtab_size;
+			}
+
+			const auto symbols = at<Sym>(dynsym_offset, dynsym_size / sizeof(Sym));
+			for (size_t i = 1; symbols != nullptr && i < dynsym_size / sizeof(Sym); i++)
+			{
+				const auto& current = symbols[i];
+				const auto name = string_at(dynstr_offset, dynstr_size, current.st_name);
+				if (name.empty())
+				{
+					continue;
+				}
+				dynamic_symbols_.push_back(symbol{name, current.st_value, current.st_size,
+				                                  static_cast<uint8_t>(current.st_info & 0xf), current.st_shndx != SHN_UNDEF});
+			}
+		}
+
+		// number of dynamic symbols from the hash tables, the only place it is recorded without sections
+		uint64_t symbols_count(const uint64_t hash_vaddr, const uint64_t gnu_hash_vaddr) const
+		{
+			uint64_t offset = 0;
+			if (hash_vaddr != 0 && vaddr_to_offset(hash_vaddr, offset))
+			{
+				const auto hash = at<uint32_t>(offset, 2);
+				return hash != nullptr ? hash[1] : 0; // nchain
+			}
+
+			if (gnu_hash_vaddr != 0 && vaddr_to_offset(gnu_hash_vaddr, offset))
+			{
+				const auto header = at<uint32_t>(offset, 4);
+				if (header == nullptr)
+				{
+					return 0;
+				}
+				const auto buckets_count = header[0], symbols_offset = header[1], bloom_size = header[2];
+				const auto buckets_offset = offset + 16 + uint64_t{bloom_size} * (is_64_ ? 8 : 4);
+				const auto buckets = at<uint32_t>(buckets_offset, buckets_count);
+				if (buckets == nullptr)
+				{
+					return 0;
+				}
+
+				// highest symbol index in a bucket, then follow its chain to the end marker
+				uint32_t last_symbol = 0;
+				for (uint32_t i = 0; i < buckets_count; i++)
+				{
+					last_symbol = std::max(last_symbol, buckets[i]);
+				}
+				if (last_symbol < symbols_offset)
+				{
+					return symbols_offset;
+				}
+				const auto chains_offset = buckets_offset + uint64_t{buckets_count} * 4;
+				for (const uint32_t* chain = nullptr; (chain = at<uint32_t>(chains_offset + uint64_t{last_symbol - symbols_offset} * 4)) != nullptr; last_symbol++)
+				{
+					if (*chain & 1)
+					{
+						break;
+					}
+				}
+				return uint64_t{last_symbol} + 1;
+			}
+
+			return 0;
+		}
+
+	public:
+		elf_file(const unsigned char* data, const size_t size) : data_(data), size_(size)
+		{
+			if (size_ < EI_NIDENT || memcmp(data_, ELFMAG, SELFMAG) != 0 || data_[EI_DATA] != ELFDATA2LSB)
+			{
+				return;
+			}
+
+			is_64_ = data_[EI_CLASS] == ELFCLASS64;
+			if (is_64_)
+			{
+				parse<Elf64_Ehdr, Elf64_Phdr, Elf64_Shdr, Elf64_Dyn, Elf64_Sym>();
+			}
+			else if (data_[EI_CLASS] == ELFCLASS32)
+			{
+				parse<Elf32_Ehdr, Elf32_Phdr, Elf32_Shdr, Elf32_Dyn, Elf32_Sym>();
+			}
+		}
+
+		bool is_valid() const
+		{
+			return is_valid_;
+		}
+
+		bool is_64() const
+		{
+			return is_64_;
+		}
+
+		std::string machine_name() const
+		{
+			switch (machine_)
+			{
+			case EM_ARM: return "ARM";
+			case EM_AARCH64: return "AArch64";
+			case EM_386: return "x86";
+			case EM_X86_64: return "x86-64";
+			case EM_MIPS: return "MIPS";
+			case EM_RISCV: return "RISC-V";
+			default: return "machine " + std::to_string(machine_);
+			}
+		}
+
+		const std::vector<section>& sections() const
+		{
+			return sections_;
+		}
+
+		const std::vector<symbol>& dynamic_symbols() const
+		{
+			return dynamic_symbols_;
+		}
+
+		const std::vector<std::string_view>& needed() const
+		{
+			return needed_;
+		}
+
+		std::string_view soname() const
+		{
+			return soname_;
+		}
+
+		// defined functions/objects visible to other modules
+		std::vector<std::string_view> exports() const
+		{
+			std::vector<std::string_view> names{};
+			for (const auto& current : dynamic_symbols_)
+			{
+				if (current.is_defined && (current.type == STT_FUNC || current.type == STT_OBJECT || current.type == STT_GNU_IFUNC))
+				{
+					names.emplace_back(current.name);
+				}
+			}
+			return names;
+		}
+
+		std::vector<std::string_view> imports() const
+		{
+			std::vector<std::string_view> names{};
+			for (const auto& current : dynamic_symbols_)
+			{
+				if (!current.is_defined)
+				{
+					names.emplace_back(current.name);
+				}
+			}
+			return names;
+		}
+
+		bool has_export(const std::string_view name) const
+		{
+			for (const auto& current : dynamic_symbols_)
+			{
+				if (current.is_defined && current.name == name)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/*
+			Signs of a packed or protected library: known packer markers and names,
+			or an image whose section headers were removed (the loader only needs segments)
+		*/
+		std::vector<std::string> packer_signatures() const
+		{
+			static const std::vector<std::pair<std::string_view, std::string>> markers{
+				{"UPX!", "UPX"},
+				{"jiagu", "Qihoo 360 Jiagu"},
+				{"libsecexe", "Bangcle"},
+				{"libSecShell", "Bangcle"},
+				{"ijiami", "ijiami"},
+				{"libshella", "Tencent Legu"},
+				{"libtup", "Tencent Legu"},
+				{"baiduprotect", "Baidu"},
+				{"libmobisec", "Alibaba"},
+				{"dexprotector", "DexProtector"},
+				{"libprotectClass", "Apkprotect"},
+				{"libnqshield", "NQ Shield"},
+			};
+
+			std::vector<std::string> signatures{};
+			const std::string_view image{reinterpret_cast<const char*>(data_), size_};
+			for (const auto& [marker, packer] : markers)
+			{
+				if (image.find(marker) != std::string_view::npos &&
+					std::find(signatures.begin(), signatures.end(), packer) == signatures.end())
+				{
+					signatures.emplace_back(packer);
+				}
+			}
+
+			if (is_valid_ && sections_.empty())
+			{
+				signatures.emplace_back("no section headers");
+			}
+
+			return signatures;
+		}
+
+		// class elf_file
+	};
+
+	/*
+		JNI short/long native names (Java_<class>_<method>[__<signature>]) to a dotted class path and method name.
+		Escapes: _1 '_', _2 ';', _3 '[', _0xxxx UTF-16 code unit. Returns false if symbol isn't a JNI name.
+	*/
+	inline bool demangle_jni_name(const std::string_view symbol, std::string& class_path, std::string& method_name)
+	{
+		constexpr std::string_view prefix{"Java_"};
+		if (symbol.substr(0, prefix.size()) != prefix)
+		{
+			return false;
+		}
+
+		std::string path{};
+		for (size_t i = prefix.size(); i < symbol.size(); i++)
+		{
+			const auto current = symbol[i];
+			if (current != '_')
+			{
+				path += current;
+				continue;
+			}
+			if (i + 1 >= symbol.size() || symbol[i + 1] == '_')
+			{
+				break; // "__" starts the arguments signature of an overloaded method
+			}
+
+			switch (symbol[i + 1])
+			{
+			case '1': path += '_'; i++; break;
+			case '2': path += ';'; i++; break;
+			case '3': path += '['; i++; break;
+			case '0':
+			{
+				const auto hex = symbol.substr(i + 2, 4);
+				if (hex.size() != 4 || !std::all_of(hex.begin(), hex.end(), [](const unsigned char chr) { return isxdigit(chr) != 0; }))
+				{
+					return false;
+				}
+				const auto code = std::stoul(std::string{hex}, nullptr, 16);
+				if (code < 0x80)
+				{
+					path += static_cast<char>(code);
+				}
+				else if (code < 0x800)
+				{
+					path += static_cast<char>(0xc0 | (code >> 6));
+					path += static_cast<char>(0x80 | (code & 0x3f));
+				}
+				else
+				{
+					path += static_cast<char>(0xe0 | (code >> 12));
+					path += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+					path += static_cast<char>(0x80 | (code & 0x3f));
+				}
+				i += 5;
+				break;
+			}
+			default:
+				path += '.';
+				break;
+			}
+		}
+
+		const auto found = path.find_last_of('.');
+		if (found == std::string::npos || found == 0 || found + 1 == path.size())
+		{
+			return false;
+		}
+		class_path = path.substr(0, found);
+		method_name = path.substr(found + 1);
+		return true;
+	}
+} // namespace andromeda
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace utils
+{
+	/*
+		Shannon entropy and a charset histogram of a string or a file, in one pass over its bytes,
+		with a guess of its encoding: what suspicious_blobs ranks strings and assets by.
+	*/
+	class byte_profile
+	{
+	public:
+		enum class encoding
+		{
+			text,
+			hex,
+			base64,
+			binary,
+		};
+
+		// charset classes counted by the histogram
+		enum charset
+		{
+			lower_hex,   // a-f
+			lower_other, // g-z
+			upper_hex,   // A-F
+			upper_other, // G-Z
+			digit,
+			base64_sign, // + / =
+			base64url_sign, // - _
+			other_printable,
+			control, // < 0x20 but \t \r \n, 0x7f
+			high, // >= 0x80
+			charsets_count,
+		};
+
+	private:
+		static const std::array<uint8_t, 256>& charsets()
+		{
+			static const auto table = []
+			{
+				std::array<uint8_t, 256> classes{};
+				for (auto i = 0; i < 256; i++)
+				{
+					classes[i] = i >= 0x80 ? high : (i < 0x20 && i != '\t' && i != '\r' && i != '\n') || i == 0x7f ? control : other_printable;
+				}
+				for (auto chr = 'a'; chr <= 'z'; chr++) classes[chr] = chr <= 'f' ? lower_hex : lower_other;
+				for (auto chr = 'A'; chr <= 'Z'; chr++) classes[chr] = chr <= 'F' ? upper_hex : upper_other;
+				for (auto chr = '0'; chr <= '9'; chr++) classes[chr] = digit;
+				classes['+'] = classes['/'] = classes['='] = base64_sign;
+				classes['-'] = classes['_'] = base64url_sign;
+				return classes;
+			}();
+			return table;
+		}
+
+		// c * log2(c) for the counts of short inputs
+		static double count_log2(const uint32_t count)
+		{
+			static const auto table = []
+			{
+				std::array<double, 4096> values{};
+				for (size_t i = 1; i < values.size(); i++)
+				{
+					values[i] = i * std::log2(static_cast<double>(i));
+				}
+				return values;
+			}();
+			return count < table.size() ? table[count] : count * std::log2(static_cast<double>(count));
+		}
+
+		size_t size_ = 0;
+		double entropy_ = 0;
+		std::array<uint32_t, charsets_count> charset_counts_{};
+
+	public:
+		byte_profile() = default;
+
+		byte_profile(const unsigned char* data, const size_t size) : size_(size)
+		{
+			if (size == 0)
+			{
+				return;
+			}
+
+			const auto& classes = charsets();
+			double sum = 0;
+			if (size <= 512)
+			{
+				// short strings: only the bins they touch, no 256 entry histogram to clear
+				uint32_t counts[256];
+				for (size_t i = 0; i < size; i++)
+				{
+					counts[data[i]] = 0;
+				}
+				for (size_t i = 0; i < size; i++)
+				{
+					counts[data[i]]++;
+					charset_counts_[classes[data[i]]]++;
+				}
+				for (size_t i = 0; i < size; i++)
+				{
+					// each bin once: zeroed after it is added
+					sum += count_log2(counts[data[i]]);
+					counts[data[i]] = 0;
+				}
+			}
+			else
+			{
+				// four histograms so consecutive equal bytes don't wait on the same counter
+				std::array<std::array<uint32_t, 256>, 4> counts{};
+				size_t i = 0;
+				for (; i + 4 <= size; i += 4)
+				{
+					counts[0][data[i]]++;
+					counts[1][data[i + 1]]++;
+					counts[2][data[i + 2]]++;
+					counts[3][data[i + 3]]++;
+				}
+				for (; i < size; i++)
+				{
+					counts[0][data[i]]++;
+				}
+				for (size_t byte = 0; byte < 256; byte++)
+				{
+					const auto count = counts[0][byte] + counts[1][byte] + counts[2][byte] + counts[3][byte];
+					sum += count_log2(count);
+					charset_counts_[classes[byte]] += count;
+				}
+			}
+			// H = log2(n) - sum(c * log2(c)) / n
+			entropy_ = std::max(0.0, std::log2(static_cast<double>(size)) - sum / size);
+		}
+
+		size_t size() const
+		{
+			return size_;
+		}
+
+		// bits per byte, 0..8
+		double entropy() const
+		{
+			return entropy_;
+		}
+
+		uint32_t count(const charset set) const
+		{
+			return charset_counts_[set];
+		}
+
+		encoding guess_encoding() const
+		{
+			const auto letters_hex = count(lower_hex) + count(upper_hex);
+			const auto letters = letters_hex + count(lower_other) + count(upper_other);
+			const auto alphanumeric = letters + count(digit);
+			if (size_ == 0)
+			{
+				return encoding::text;
+			}
+			// hex: only 0-9 and one case of a-f, not a plain number
+			if (letters_hex + count(digit) == size_ && size_ % 2 == 0 && letters_hex != 0 && (count(lower_hex) == 0 || count(upper_hex) == 0))
+			{
+				return encoding::hex;
+			}
+			// base64: one of its alphabets, both cases and digits
+			const auto signs = std::max(count(base64_sign), count(base64url_sign));
+			if (alphanumeric + signs == size_ && (count(base64_sign) == 0 || count(base64url_sign) == 0) &&
+				count(lower_hex) + count(lower_other) != 0 && count(upper_hex) + count(upper_other) != 0 && count(digit) != 0)
+			{
+				return encoding::base64;
+			}
+			if (count(control) + count(high) > size_ / 8)
+			{
+				return encoding::binary;
+			}
+			return encoding::text;
+		}
+
+		static const char* encoding_name(const encoding value)
+		{
+			switch (value)
+			{
+			case encoding::hex: return "hex";
+			case encoding::base64: return "base64";
+			case encoding::binary: return "binary";
+			default: return "text";
+			}
+		}
+
+		/*
+			Entropy relative to the most an input of this size and encoding can have:
+			a 20 character hex string can't go above 4 bits per character, a 20 character one above log2(20).
+		*/
+		double normalized_entropy() const
+		{
+			double alphabet = 256;
+			switch (guess_encoding())
+			{
+			case encoding::hex: alphabet = 16; break;
+			case encoding::base64: alphabet = 64; break;
+			case encoding::text: alphabet = 95; break;
+			default: break;
+			}
+			const auto max_entropy = std::log2(std::min(alphabet, static_cast<double>(size_)));
+			return max_entropy > 0 ? std::min(1.0, entropy_ / max_entropy) : 0;
+		}
+
+		// ranking of suspicious_blobs: close to random, long, and encoded rank first
+		double suspicion_score() const
+		{
+			if (size_ < 2)
+			{
+				return 0;
+			}
+			const auto value = guess_encoding();
+			const auto encoding_weight = value == encoding::base64 || value == encoding::hex ? 1.25 : 1.0;
+			return normalized_entropy() * std::log2(static_cast<double>(size_)) * encoding_weight;
+		}
+
+		// class byte_profile
+	};
+} // namespace utils
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aho_corasick.hpp"
+#include "color/color.hpp"
+
+namespace andromeda
+{
+	/*
+		Literal indicators looked up in strings (interesting_strings), all of them in one pass.
+		Rules text: one rule per line, "category pattern"; the pattern is the rest of the line,
+		case-insensitive, with \xHH for any byte and \\ for a backslash. '#' starts a comment line.
+	*/
+	class indicator_rules
+	{
+	public:
+		struct rule
+		{
+			size_t category;
+			std::string pattern;
+		};
+
+	private:
+		std::vector<std::string> categories_{};
+		std::vector<rule> rules_{};
+		utils::aho_corasick matcher_{};
+		bool is_built_ = false;
+
+		static int hex_value(const char chr)
+		{
+			if (chr >= '0' && chr <= '9') return chr - '0';
+			if (chr >= 'a' && chr <= 'f') return chr - 'a' + 10;
+			if (chr >= 'A' && chr <= 'F') return chr - 'A' + 10;
+			return -1;
+		}
+
+		// false on a bad escape
+		static bool unescape(const std::string& text, std::string& pattern)
+		{
+			pattern.clear();
+			for (size_t i = 0; i < text.size(); i++)
+			{
+				if (text[i] != '\\')
+				{
+					pattern += text[i];
+				}
+				else if (i + 1 < text.size() && text[i + 1] == '\\')
+				{
+					pattern += '\\';
+					i++;
+				}
+				else if (i + 3 < text.size() && text[i + 1] == 'x' && hex_value(text[i + 2]) >= 0 && hex_value(text[i + 3]) >= 0)
+				{
+					pattern += static_cast<char>(hex_value(text[i + 2]) << 4 | hex_value(text[i + 3]));
+					i += 3;
+				}
+				else
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+	public:
+		// built in rules, used unless a rules file is given (URLs, e-mails, AWS/Google keys are tokens of patterns.hpp)
+		static const char* default_rules()
+		{
+			return R"(# category          pattern
+api-keys            sk_live_
+api-keys            rk_live_
+api-keys            xoxb-
+api-keys            xoxp-
+api-keys            ghp_
+api-keys            -----BEGIN
+api-keys            PRIVATE KEY
+
+root-detection      /system/xbin/su
+root-detection      /system/bin/su
+root-detection      /sbin/su
+root-detection      /su/bin
+root-detection      Superuser.apk
+root-detection      eu.chainfire.supersu
+root-detection      com.topjohnwu.magisk
+root-detection      com.noshufou.android.su
+root-detection      busybox
+root-detection      test-keys
+
+emulator-detection  goldfish
+emulator-detection  ranchu
+emulator-detection  ro.kernel.qemu
+emulator-detection  generic_x86
+emulator-detection  sdk_gphone
+emulator-detection  Genymotion
+emulator-detection  /dev/socket/qemud
+
+hooking             frida
+hooking             de.robv.android.xposed
+hooking             XposedBridge
+hooking             com.saurik.substrate
+
+weak-crypto         AES/ECB
+weak-crypto         DES/
+weak-crypto         DESede
+weak-crypto         RC4
+weak-crypto         /NoPadding
+weak-crypto         PBKDF2WithHmacSHA1
+
+code-loading        DexClassLoader
+code-loading        InMemoryDexClassLoader
+code-loading        PathClassLoader
+code-loading        /system/bin/sh
+code-loading        pm install
+
+sdk-domains         firebaseio.com
+sdk-domains         googleapis.com
+sdk-domains         appspot.com
+sdk-domains         amazonaws.com
+sdk-domains         crashlytics.com
+sdk-domains         graph.facebook.com
+sdk-domains         doubleclick.net
+sdk-domains         appsflyer.com
+sdk-domains         onesignal.com
+sdk-domains         herokuapp.com
+sdk-domains         ngrok.io
+sdk-domains         pastebin.com
+sdk-domains         api.telegram.org
+sdk-domains         discord.com/api/webhooks
+)";
+		}
+
+		/*
+			Adds the rules of text, source names it in the error messages.
+			Bad lines are reported and skipped, returns false if there were any.
+		*/
+		bool load(const std::string& text, const std::string& source)
+		{
+			auto is_okay = true;
+			std::istringstream lines(text);
+			std::string line{};
+			for (size_t line_number = 1; std::getline(lines, line); line_number++)
+			{
+				const auto begin = line.find_first_not_of(" \t\r");
+				if (begin == std::string::npos || line[begin] == '#')
+				{
+					continue;
+				}
+				const auto category_end = line.find_first_of(" \t", begin);
+				const auto pattern_begin = category_end == std::string::npos ? std::string::npos : line.find_first_not_of(" \t", category_end);
+				const auto pattern_end = line.find_last_not_of(" \t\r");
+
+				std::string pattern{};
+				if (pattern_begin == std::string::npos || !unescape(line.substr(pattern_begin, pattern_end + 1 - pattern_begin), pattern))
+				{
+					color::color_printf(color::FG_LIGHT_RED, "[indicators.hpp] %s:%zu: expected \"category pattern\": %s\n",
+					                    source.c_str(), line_number, line.c_str());
+					is_okay = false;
+					continue;
+				}
+
+				const auto category = line.substr(begin, category_end - begin);
+				auto category_index = std::find(categories_.begin(), categories_.end(), category) - categories_.begin();
+				if (category_index == static_cast<ptrdiff_t>(categories_.size()))
+				{
+					categories_.push_back(category);
+				}
+				rules_.push_back(rule{static_cast<size_t>(category_index), pattern});
+				is_built_ = false;
+			}
+			return is_okay;
+		}
+
+		bool load_file(const std::string& file_path)
+		{
+			std::ifstream file(file_path, std::ios::binary);
+			if (!file)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "[indicators.hpp] Failed to open the rules file: %s\n", file_path.c_str());
+				return false;
+			}
+			std::stringstream text{};
+			text << file.rdbuf();
+			return load(text.str(), file_path);
+		}
+
+		// compiles the rules into the matcher, needed before scan()
+		void build()
+		{
+			matcher_ = utils::aho_corasick{};
+			for (size_t i = 0; i < rules_.size(); i++)
+			{
+				matcher_.add(rules_[i].pattern, static_cast<uint32_t>(i));
+			}
+			matcher_.build();
+			is_built_ = true;
+		}
+
+		const std::vector<std::string>& categories() const
+		{
+			return categories_;
+		}
+
+		const std::vector<rule>& rules() const
+		{
+			return rules_;
+		}
+
+		// indexes of the rules found in str, each one once, in the order they were first seen
+		void scan(const std::string_view str, std::vector<uint32_t>& hits) const
+		{
+			hits.clear();
+			if (!is_built_)
+			{
+				return;
+			}
+			matcher_.scan(str.data(), str.size(), [&hits](const uint32_t rule_index, size_t)
+			{
+				if (std::find(hits.begin(), hits.end(), rule_index) == hits.end())
+				{
+					hits.push_back(rule_index);
+				}
+			});
+		}
+
+		// class indicator_rules
+	};
+} // namespace andromeda
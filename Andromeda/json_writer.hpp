@@ -0,0 +1,353 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+
+namespace utils
+{
+	/*
+		Streaming JSON: records (flat objects whose values can also be arrays of strings or numbers) are written
+		as they are made, as JSON lines or as the elements of one array. They are built in a fixed buffer flushed
+		to a stdio stream in large writes; values are escaped straight into it, nothing is allocated per record.
+		Strings are MUTF-8 (DEX strings) or UTF-8: the encoded NUL (C0 80) becomes \u0000, surrogate pairs encoded
+		separately (CESU-8) become one 4-byte UTF-8 character, lone surrogates are escaped, invalid bytes U+FFFD.
+	*/
+	class json_writer
+	{
+	public:
+		enum class format
+		{
+			lines, // JSONL: a record per line
+			array, // one JSON array of the records
+		};
+
+	private:
+		static constexpr size_t buffer_size = 1 << 16;
+
+		FILE* file_;
+		format format_;
+		std::unique_ptr<char[]> buffer_;
+		size_t size_ = 0;
+		size_t records_count_ = 0;
+		bool is_first_value_ = true; // of the record or the array being written
+		bool is_finished_ = false;
+
+		void put(const char chr)
+		{
+			if (size_ == buffer_size)
+			{
+				flush();
+			}
+			buffer_[size_++] = chr;
+		}
+
+		void put(const char* data, const size_t size)
+		{
+			if (size_ + size > buffer_size)
+			{
+				flush();
+				if (size > buffer_size)
+				{
+					fwrite(data, 1, size, file_);
+					return;
+				}
+			}
+			memcpy(&buffer_[size_], data, size);
+			size_ += size;
+		}
+
+		void put(const std::string_view text)
+		{
+			put(text.data(), text.size());
+		}
+
+		void put_escape(const uint32_t unit)
+		{
+			static const char hex[] = "0123456789abcdef";
+			const char escape[6] = {'\\', 'u', hex[unit >> 12 & 0xf], hex[unit >> 8 & 0xf], hex[unit >> 4 & 0xf], hex[unit & 0xf]};
+			put(escape, sizeof(escape));
+		}
+
+		void put_utf8(const uint32_t code_point)
+		{
+			const char bytes[4] = {static_cast<char>(0xf0 | code_point >> 18), static_cast<char>(0x80 | (code_point >> 12 & 0x3f)),
+			                       static_cast<char>(0x80 | (code_point >> 6 & 0x3f)), static_cast<char>(0x80 | (code_point & 0x3f))};
+			put(bytes, sizeof(bytes));
+		}
+
+		static bool is_continuation(const unsigned char byte)
+		{
+			return (byte & 0xc0) == 0x80;
+		}
+
+		// code point of the 3-byte sequence at text[i], 0 if there is none
+		static uint32_t three_bytes(const std::string_view text, const size_t i)
+		{
+			if (i + 2 >= text.size())
+			{
+				return 0;
+			}
+			const auto lead = static_cast<unsigned char>(text[i]);
+			const auto second = static_cast<unsigned char>(text[i + 1]);
+			const auto third = static_cast<unsigned char>(text[i + 2]);
+			if ((lead & 0xf0) != 0xe0 || !is_continuation(second) || !is_continuation(third))
+			{
+				return 0;
+			}
+			const auto code_point = (lead & 0x0fu) << 12 | (second & 0x3fu) << 6 | (third & 0x3fu);
+			return code_point >= 0x800 ? code_point : 0;
+		}
+
+		void put_string(const std::string_view text)
+		{
+			put('"');
+			size_t i = 0;
+			while (i < text.size())
+			{
+				// printable ASCII is copied in runs
+				auto end = i;
+				while (end < text.size())
+				{
+					const auto byte = static_cast<unsigned char>(text[end]);
+					if (byte < 0x20 || byte >= 0x80 || byte == '"' || byte == '\\')
+					{
+						break;
+					}
+					end++;
+				}
+				put(text.data() + i, end - i);
+				i = end;
+				if (i == text.size())
+				{
+					break;
+				}
+
+				const auto byte = static_cast<unsigned char>(text[i]);
+				if (byte < 0x80)
+				{
+					switch (byte)
+					{
+					case '"': put("\\\"", 2); break;
+					case '\\': put("\\\\", 2); break;
+					case '\n': put("\\n", 2); break;
+					case '\r': put("\\r", 2); break;
+					case '\t': put("\\t", 2); break;
+					default: put_escape(byte); break;
+					}
+					i++;
+				}
+				else if (byte == 0xc0 && i + 1 < text.size() && static_cast<unsigned char>(text[i + 1]) == 0x80)
+				{
+					put_escape(0);
+					i += 2;
+				}
+				else if (byte >= 0xc2 && byte <= 0xdf && i + 1 < text.size() && is_continuation(text[i + 1]))
+				{
+					put(text.data() + i, 2);
+					i += 2;
+				}
+				else if (const auto code_point = three_bytes(text, i); code_point != 0)
+				{
+					const auto low = code_point >= 0xd800 && code_point <= 0xdbff ? three_bytes(text, i + 3) : 0;
+					if (low >= 0xdc00 && low <= 0xdfff)
+					{
+						put_utf8(0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00));
+						i += 6;
+					}
+					else if (code_point >= 0xd800 && code_point <= 0xdfff)
+					{
+						put_escape(code_point);
+						i += 3;
+					}
+					else
+					{
+						put(text.data() + i, 3);
+						i += 3;
+					}
+				}
+				else if (byte >= 0xf0 && byte <= 0xf4 && i + 3 < text.size() && is_continuation(text[i + 1]) &&
+					is_continuation(text[i + 2]) && is_continuation(text[i + 3]) &&
+					(byte != 0xf0 || static_cast<unsigned char>(text[i + 1]) >= 0x90) && (byte != 0xf4 || static_cast<unsigned char>(text[i + 1]) < 0x90))
+				{
+					put(text.data() + i, 4);
+					i += 4;
+				}
+				else
+				{
+					put("\xef\xbf\xbd", 3);
+					i++;
+				}
+			}
+			put('"');
+		}
+
+		void put_key(const std::string_view name)
+		{
+			if (!is_first_value_)
+			{
+				put(',');
+			}
+			is_first_value_ = false;
+			put_string(name);
+			put(':');
+		}
+
+		void put_separator()
+		{
+			if (!is_first_value_)
+			{
+				put(',');
+			}
+			is_first_value_ = false;
+		}
+
+		template <typename Number>
+		void put_number(const Number value)
+		{
+			char digits[32];
+			const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+			put(digits, static_cast<size_t>(result.ptr - digits));
+		}
+
+		void put_real(const double value)
+		{
+			if (std::isfinite(value))
+			{
+				put_number(value);
+			}
+			else
+			{
+				put("null", 4);
+			}
+		}
+
+	public:
+		json_writer(FILE* file, const format output_format)
+			: file_(file), format_(output_format), buffer_(new char[buffer_size])
+		{
+		}
+
+		~json_writer()
+		{
+			finish();
+		}
+
+		json_writer(const json_writer&) = delete;
+		json_writer& operator=(const json_writer&) = delete;
+
+		// the writer the commands of this thread emit their records to, nullptr when they print text
+		static json_writer*& current()
+		{
+			thread_local json_writer* writer = nullptr;
+			return writer;
+		}
+
+		// {"type": type, ...
+		void begin_record(const std::string_view type)
+		{
+			if (format_ == format::array)
+			{
+				put(records_count_ == 0 ? "[\n" : ",\n", 2);
+			}
+			put('{');
+			is_first_value_ = true;
+			string_field("type", type);
+		}
+
+		void end_record()
+		{
+			put('}');
+			if (format_ == format::lines)
+			{
+				put('\n');
+			}
+			records_count_++;
+		}
+
+		void string_field(const std::string_view name, const std::string_view value)
+		{
+			put_key(name);
+			put_string(value);
+		}
+
+		template <typename Number, typename = std::enable_if_t<std::is_integral<Number>::value>>
+		void number_field(const std::string_view name, const Number value)
+		{
+			put_key(name);
+			put_number(value);
+		}
+
+		void real_field(const std::string_view name, const double value)
+		{
+			put_key(name);
+			put_real(value);
+		}
+
+		void boolean_field(const std::string_view name, const bool value)
+		{
+			put_key(name);
+			put(value ? std::string_view("true") : std::string_view("false"));
+		}
+
+		// "name": [ ... elements ... ]
+		void begin_array(const std::string_view name)
+		{
+			put_key(name);
+			put('[');
+			is_first_value_ = true;
+		}
+
+		void string_element(const std::string_view value)
+		{
+			put_separator();
+			put_string(value);
+		}
+
+		template <typename Number, typename = std::enable_if_t<std::is_integral<Number>::value>>
+		void number_element(const Number value)
+		{
+			put_separator();
+			put_number(value);
+		}
+
+		void end_array()
+		{
+			put(']');
+			is_first_value_ = false;
+		}
+
+		// closes the array of the records, flushes; nothing can be written afterwards
+		void finish()
+		{
+			if (is_finished_)
+			{
+				return;
+			}
+			is_finished_ = true;
+			if (format_ == format::array)
+			{
+				put(records_count_ == 0 ? "[]\n" : "\n]\n");
+			}
+			flush();
+		}
+
+		void flush()
+		{
+			fwrite(buffer_.get(), 1, size_, file_);
+			size_ = 0;
+		}
+
+		size_t records_count() const
+		{
+			return records_count_;
+		}
+
+		// class json_writer
+	};
+} // namespace utils
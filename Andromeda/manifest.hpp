@@ -2,10 +2,13 @@
 
 #include <vector>
 #include <string>
+#include <cstring>
 #include <algorithm>
 
 #include "color/color.hpp"
-#include "pugixml/pugixml.hpp"
+#include "AxmlParser/AxmlParser.h"
+#include "json_writer.hpp"
+#include "resources.hpp"
 
 namespace andromeda
 {
@@ -50,60 +53,137 @@ namespace andromeda
 			}
 		}
 
-		void emplace_intents(const pugi::xml_node& node, const intent_target type)
+		// raw binary AXML, text XML is only produced when it's printed
+		std::string axml_content_{};
+		mutable std::string xml_content_{};
+
+		// names the app's own resource references in the text XML, optional
+		std::shared_ptr<const resource_table> resources_{};
+
+		// value of the attribute of the current tag, "" if it's not present
+		static std::string attribute(void* axml, const char* name, const bool android_ns = true)
 		{
-			auto name = std::string{node.attribute("android:name").as_string()};
-			auto alias_target = std::string{node.attribute("android:targetActivity").as_string()};
-			if (!alias_target.empty())
+			const auto count = AxmlGetAttrCount(axml);
+			for (uint32_t i = 0; i < count; i++)
 			{
-				name = alias_target;
-			}
+				if (strcmp(AxmlGetAttrName(axml, i), name) != 0)
+				{
+					continue;
+				}
+				const auto is_android = strcmp(AxmlGetAttrPrefix(axml, i), "android") == 0;
+				if (is_android != android_ns)
+				{
+					continue;
+				}
 
-			if (!name.empty() && name[0] == '.' && !manifest_package.empty())
-			{
-				name = manifest_package + name;
+				const auto value = AxmlGetAttrValue(axml, i);
+				std::string attribute_value{value};
+				free(value);
+				return attribute_value;
 			}
 
-			std::vector<std::string> intent_filters{};
-			for (const auto& intent_child : node.child("intent-filter").children("action"))
-			{
-				const auto intent_name = intent_child.attribute("android:name").as_string();
-				intent_filters.emplace_back(intent_name);
-			}
+			return {};
+		}
 
-			if (type == intent_target::service)
-			{
-				services.emplace_back(name, intent_filters);
-			}
-			else if (type == intent_target::activity)
-			{
-				activities.emplace_back(name, intent_filters);
-			}
-			else if (type == intent_target::receiver)
+		std::string full_class_name(const std::string& name) const
+		{
+			if (!name.empty() && name[0] == '.' && !manifest_package.empty())
 			{
-				receivers.emplace_back(name, intent_filters);
+				return manifest_package + name;
 			}
+			return name;
 		}
 
-		bool decode_manifest(const std::string& manifest_path)
+		/*
+			Single streaming pass over the AXML events, only the tags we are interested in are looked at:
+				manifest/uses-permission
+				manifest/application
+				manifest/application/{activity,activity-alias,service,receiver}/intent-filter/action
+		*/
+		bool decode_manifest()
 		{
-			size_t file_size = 0;
-			const auto file_content = utils::read_file(manifest_path, file_size);
-			char* xml_content = nullptr;
-			size_t xml_size = 0;
-			AxmlToXml(&xml_content, &xml_size, file_content.get(), file_size);
-			fs::remove(manifest_path);
-
-			const auto status = utils::write_file(manifest_path, xml_content, xml_size);
-			manifest_content = std::string(xml_content, xml_size);
-			free(xml_content);
-			if (status == false)
+			const auto axml = AxmlOpen(&axml_content_[0], axml_content_.size());
+			if (axml == nullptr)
 			{
-				printf("Failed to write AndroidManifest.xml\n");
 				return false;
 			}
 
-			return true;
+			std::vector<std::string> tags{};
+			std::vector<std::pair<std::string, std::vector<std::string>>>* component_target = nullptr;
+			std::pair<std::string, std::vector<std::string>> component{};
+
+			auto event = AxmlNext(axml);
+			for (; event != AE_ENDDOC && event != AE_ERROR; event = AxmlNext(axml))
+			{
+				if (event == AE_ENDTAG)
+				{
+					if (tags.size() == 3 && component_target != nullptr)
+					{
+						component_target->emplace_back(std::move(component));
+						component_target = nullptr;
+					}
+					if (!tags.empty())
+					{
+						tags.pop_back();
+					}
+					continue;
+				}
+				if (event != AE_STARTTAG)
+				{
+					continue;
+				}
+
+				tags.emplace_back(AxmlGetTagName(axml));
+				const auto& tag = tags.back();
+				const auto depth = tags.size();
+
+				if (depth == 1 && tag == "manifest")
+				{
+					manifest_package = attribute(axml, "package", false);
+				}
+				else if (depth == 2 && tag == "uses-permission")
+				{
+					permissions.emplace_back(attribute(axml, "name"));
+				}
+				else if (depth == 2 && tag == "application")
+				{
+					debuggable = attribute(axml, "debuggable") == "true";
+					application_class_name_ = full_class_name(attribute(axml, "name"));
+				}
+				else if (depth == 3 && tags[1] == "application")
+				{
+					if (tag == "activity" || tag == "activity-alias")
+					{
+						component_target = &activities;
+					}
+					else if (tag == "service")
+					{
+						component_target = &services;
+					}
+					else if (tag == "receiver")
+					{
+						component_target = &receivers;
+					}
+
+					if (component_target != nullptr)
+					{
+						auto name = attribute(axml, "name");
+						const auto alias_target = attribute(axml, "targetActivity");
+						if (!alias_target.empty())
+						{
+							name = alias_target;
+						}
+						component = std::make_pair(full_class_name(name), std::vector<std::string>{});
+					}
+				}
+				else if (depth == 5 && component_target != nullptr && tags[3] == "intent-filter" && tag == "action")
+				{
+					component.second.emplace_back(attribute(axml, "name"));
+				}
+			}
+
+			AxmlClose(axml);
+			return event == AE_ENDDOC;
 		}
 
 	public:
@@ -112,67 +192,56 @@ namespace andromeda
 		std::vector<std::pair<std::string, std::vector<std::string>>> activities{};
 		std::vector<std::pair<std::string, std::vector<std::string>>> services{};
 		std::vector<std::pair<std::string, std::vector<std::string>>> receivers{};
-		std::string manifest_content;
 		bool debuggable = false;
 
-		explicit manifest(const std::string& xml_path)
+		explicit manifest(std::string axml_content) : axml_content_(std::move(axml_content))
 		{
-			const auto status = decode_manifest(xml_path);
+			const auto status = decode_manifest();
 			if (status == false)
 			{
-				printf("Failed to decode manifest file: %s\n", xml_path.c_str());
-				return;
+				color::out_printf("Failed to decode AndroidManifest.xml\n");
 			}
 
-			pugi::xml_document xml_doc;
-			xml_doc.load_file(xml_path.c_str());
-
-			auto is_debug_string = std::string{
-				xml_doc.child("manifest").child("application").attribute("android:debuggable").as_string()
-			};
-			if (!is_debug_string.empty() && is_debug_string == "true")
-			{
-				debuggable = true;
-			}
-
-			// application class
-			application_class_name_ = xml_doc.child("manifest").child("application").attribute("android:name").
-			                                  as_string();
-			manifest_package = std::string{xml_doc.child("manifest").attribute("package").as_string()};
-			if (!application_class_name_.empty() && application_class_name_[0] == '.' && !manifest_package.empty())
-			{
-				application_class_name_ = manifest_package + application_class_name_;
-			}
+			// ctor
+		}
 
-			// permissions
-			for (const auto& child : xml_doc.child("manifest").children("uses-permission"))
-			{
-				const auto permission_name = child.attribute("android:name").as_string();
-				permissions.emplace_back(permission_name);
-			}
-			// activities
-			for (const auto& child : xml_doc.child("manifest").child("application").children("activity"))
-			{
-				emplace_intents(child, intent_target::activity);
-			}
-			for (const auto& child : xml_doc.child("manifest").child("application").children("activity-alias"))
+		// text form of the manifest, converted on first use
+		const std::string& get_content() const
+		{
+			if (xml_content_.empty() && !axml_content_.empty())
 			{
-				emplace_intents(child, intent_target::activity);
+				char* xml_content = nullptr;
+				size_t xml_size = 0;
+				auto axml_content = axml_content_;
+				const auto status = resources_ != nullptr && resources_->is_valid()
+					? AxmlToXmlWithResolver(&xml_content, &xml_size, &axml_content[0], axml_content.size(),
+					                        resource_table::resolve_reference, const_cast<resource_table*>(resources_.get()))
+					: AxmlToXml(&xml_content, &xml_size, &axml_content[0], axml_content.size());
+				if (status == 0)
+				{
+					xml_content_ = std::string(xml_content, xml_size);
+					free(xml_content);
+				}
 			}
 
-			// services
-			for (const auto& child : xml_doc.child("manifest").child("application").children("service"))
-			{
-				emplace_intents(child, intent_target::service);
-			}
+			return xml_content_;
+		}
 
-			// Broadcast receivers
-			for (const auto& child : xml_doc.child("manifest").child("application").children("receiver"))
+		// resources.arsc of the APK, @7f...... references of get_content() become @type/name; the XML is rebuilt only for another table
+		void set_resources(std::shared_ptr<const resource_table> resources)
+		{
+			if (resources == resources_)
 			{
-				emplace_intents(child, intent_target::receiver);
+				return;
 			}
+			resources_ = std::move(resources);
+			xml_content_.clear();
+		}
 
-			// ctor
+		// binary AXML the manifest was decoded from
+		const std::string& get_binary_content() const
+		{
+			return axml_content_;
 		}
 
 		// No copy/move semantics
@@ -188,6 +257,12 @@ namespace andromeda
 		*/
 		void dump_entry_points(bool extended = false)
 		{
+			if (const auto json = utils::json_writer::current())
+			{
+				write_entry_points(*json, extended);
+				return;
+			}
+
 			// application class
 			if (!application_class_name_.empty())
 			{
@@ -249,6 +324,50 @@ namespace andromeda
 			return debuggable;
 		}
 
+		// a record per component: {"type": type, "name": ..., "intents": [...]}
+		static void write_components(utils::json_writer& json, const char* type, const std::vector<std::pair<std::string, std::vector<std::string>>>& components)
+		{
+			for (const auto& [name, intents] : components)
+			{
+				json.begin_record(type);
+				json.string_field("name", name);
+				json.begin_array("intents");
+				for (const auto& intent : intents)
+				{
+					json.string_element(intent);
+				}
+				json.end_array();
+				json.end_record();
+			}
+		}
+
+		// dump_entry_points() as records
+		void write_entry_points(utils::json_writer& json, const bool extended) const
+		{
+			if (!application_class_name_.empty())
+			{
+				json.begin_record("application");
+				json.string_field("name", application_class_name_);
+				json.end_record();
+			}
+			for (const auto& [name, intents] : activities)
+			{
+				if (std::find(intents.begin(), intents.end(), R"(android.intent.action.MAIN)") != intents.end())
+				{
+					json.begin_record("main_activity");
+					json.string_field("name", name);
+					json.end_record();
+					break;
+				}
+			}
+			if (extended)
+			{
+				write_components(json, "activity", activities);
+				write_components(json, "service", services);
+				write_components(json, "receiver", receivers);
+			}
+		}
+
 		// class: manifest
 	};
 } // namespace andromeda
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace utils
+{
+	// read-only memory mapping of a whole file
+	class mapped_file
+	{
+		const unsigned char* data_ = nullptr;
+		size_t size_ = 0;
+
+	public:
+		explicit mapped_file(const std::string& file_path)
+		{
+			const auto fd = open(file_path.c_str(), O_RDONLY);
+			if (fd < 0)
+			{
+				return;
+			}
+
+			struct stat file_stat{};
+			if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+			{
+				const auto mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (mapping != MAP_FAILED)
+				{
+					data_ = static_cast<const unsigned char*>(mapping);
+					size_ = file_stat.st_size;
+				}
+			}
+			close(fd);
+		}
+
+		~mapped_file()
+		{
+			if (data_ != nullptr)
+			{
+				munmap(const_cast<unsigned char*>(data_), size_);
+			}
+		}
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		bool is_valid() const
+		{
+			return data_ != nullptr;
+		}
+
+		const unsigned char* data() const
+		{
+			return data_;
+		}
+
+		size_t size() const
+		{
+			return size_;
+		}
+
+		// read pattern hint for the whole mapping, e.g. MADV_SEQUENTIAL before hashing
+		void advise(const int advice) const
+		{
+			if (data_ != nullptr)
+			{
+				madvise(const_cast<unsigned char*>(data_), size_, advice);
+			}
+		}
+
+		// class mapped_file
+	};
+} // namespace utils
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "digestpp/digestpp.hpp"
+
+namespace utils
+{
+	/*
+		Several digests of the same data in one pass: every chunk is absorbed
+		into all hasher states while it is still hot in the cache.
+		Algorithms are picked by name ("md5", "sha1", "sha256", "sha3-256", ...).
+	*/
+	class multi_hasher
+	{
+		struct digest_state
+		{
+			virtual ~digest_state() = default;
+			virtual void absorb(const unsigned char* data, size_t size) = 0;
+			virtual std::string hexdigest() = 0;
+		};
+
+		template <typename Hasher>
+		struct digest_state_impl : digest_state
+		{
+			Hasher hasher;
+
+			explicit digest_state_impl(Hasher hasher) : hasher(std::move(hasher))
+			{
+			}
+
+			void absorb(const unsigned char* data, const size_t size) override
+			{
+				hasher.absorb(data, size);
+			}
+
+			std::string hexdigest() override
+			{
+				return hasher.hexdigest();
+			}
+		};
+
+		using factory = std::function<std::unique_ptr<digest_state>()>;
+
+		template <typename Hasher, typename... Args>
+		static factory make_factory(Args... args)
+		{
+			return [=]
+			{
+				return std::unique_ptr<digest_state>{new digest_state_impl<Hasher>(Hasher(args...))};
+			};
+		}
+
+		static const std::vector<std::pair<std::string, factory>>& algorithms()
+		{
+			static const std::vector<std::pair<std::string, factory>> registry{
+				{"md5", make_factory<digestpp::md5>()},
+				{"sha1", make_factory<digestpp::sha1>()},
+				{"sha224", make_factory<digestpp::sha224>()},
+				{"sha256", make_factory<digestpp::sha256>()},
+				{"sha384", make_factory<digestpp::sha384>()},
+				{"sha512", make_factory<digestpp::sha512>()},
+				{"sha3-224", make_factory<digestpp::sha3>(224)},
+				{"sha3-256", make_factory<digestpp::sha3>(256)},
+				{"sha3-384", make_factory<digestpp::sha3>(384)},
+				{"sha3-512", make_factory<digestpp::sha3>(512)},
+				{"blake", make_factory<digestpp::blake>(256)},
+				{"blake2b", make_factory<digestpp::blake2b>(512)},
+				{"blake2s", make_factory<digestpp::blake2s>(256)},
+				{"groestl", make_factory<digestpp::groestl>(256)},
+				{"jh", make_factory<digestpp::jh>(256)},
+				{"kupyna", make_factory<digestpp::kupyna>(256)},
+				{"skein256", make_factory<digestpp::skein256>(256)},
+				{"skein512", make_factory<digestpp::skein512>(512)},
+				{"skein1024", make_factory<digestpp::skein1024>(1024)},
+				{"sm3", make_factory<digestpp::sm3>()},
+				{"streebog", make_factory<digestpp::streebog>(256)},
+				{"whirlpool", make_factory<digestpp::whirlpool>()},
+			};
+			return registry;
+		}
+
+		std::vector<std::pair<std::string, std::unique_ptr<digest_state>>> states_{};
+
+	public:
+		// unknown names are skipped, check them with is_supported() first
+		explicit multi_hasher(const std::vector<std::string>& names)
+		{
+			for (const auto& name : names)
+			{
+				for (const auto& [algorithm, create] : algorithms())
+				{
+					if (algorithm == name)
+					{
+						states_.emplace_back(name, create());
+						break;
+					}
+				}
+			}
+		}
+
+		static bool is_supported(const std::string& name)
+		{
+			for (const auto& algorithm : algorithms())
+			{
+				if (algorithm.first == name)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		static std::vector<std::string> supported()
+		{
+			std::vector<std::string> names{};
+			for (const auto& algorithm : algorithms())
+			{
+				names.emplace_back(algorithm.first);
+			}
+			return names;
+		}
+
+		void absorb(const void* data, const size_t size)
+		{
+			for (auto& state : states_)
+			{
+				state.second->absorb(static_cast<const unsigned char*>(data), size);
+			}
+		}
+
+		// name, hex digest; in the order the algorithms were requested
+		std::vector<std::pair<std::string, std::string>> hexdigests()
+		{
+			std::vector<std::pair<std::string, std::string>> digests{};
+			for (auto& state : states_)
+			{
+				digests.emplace_back(state.first, state.second->hexdigest());
+			}
+			return digests;
+		}
+
+		// class multi_hasher
+	};
+} // namespace utils
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "dex.hpp"
+#include "regex.hpp"
+#include "string_arena.hpp"
+#include "thread_pool.hpp"
+#include "trigram_index.hpp"
+#include "utils.hpp"
+
+namespace andromeda
+{
+	/*
+		Class paths and method names of all DEX files, each distinct one once (arena ids): a trigram index of both
+		narrows find_class and find_method to the names that can match, the sorted class paths and the methods
+		every class declares complete class_info and dis arguments as they are typed.
+		Built from the tables of the DEX files, only read afterwards.
+	*/
+	class name_index
+	{
+		std::shared_ptr<utils::string_arena> arena_;
+		std::vector<uint32_t> classes_{}; // class paths
+		std::vector<uint32_t> sorted_classes_{}; // by text
+		std::vector<uint32_t> methods_{}; // method names of all method ids
+		utils::trigram_index class_trigrams_{};
+		utils::trigram_index method_trigrams_{};
+		std::unordered_map<uint32_t, std::vector<uint32_t>> class_methods_{}; // class path -> names of its methods, sorted
+
+		std::string_view text(const uint32_t id) const
+		{
+			return arena_->get(id);
+		}
+
+		bool is_less(const uint32_t a, const uint32_t b) const
+		{
+			return text(a) < text(b);
+		}
+
+		static std::vector<uint32_t> distinct(std::vector<uint32_t> ids)
+		{
+			std::sort(ids.begin(), ids.end());
+			ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+			return ids;
+		}
+
+		/*
+			Memo of search_tables for a query over one set of names: 2 if the name matches, 1 if not.
+			Only the trigram candidates are checked, all names if the query has no literal of 3+ bytes;
+			they are checked in parallel, one copy of the query per worker.
+		*/
+		std::vector<uint8_t> match(const std::vector<uint32_t>& names, const utils::trigram_index& trigrams, const utils::text_query& query) const
+		{
+			std::vector<uint32_t> candidates{};
+			const auto& checked = trigrams.candidates(query.required_literal(), candidates) ? candidates : names;
+
+			std::vector<uint8_t> matched(arena_->size(), 1);
+			auto& pool = utils::thread_pool::shared();
+			std::vector<utils::text_query> queries(pool.size() + 1, query);
+			constexpr size_t chunk_size = 4096;
+			pool.parallel_for((checked.size() + chunk_size - 1) / chunk_size, [&](const size_t worker, const size_t chunk)
+			{
+				const auto end = std::min(checked.size(), (chunk + 1) * chunk_size);
+				for (auto i = chunk * chunk_size; i < end; i++)
+				{
+					if (queries[worker].matches(utils::strip_view(text(checked[i]))))
+					{
+						matched[checked[i]] = 2;
+					}
+				}
+			});
+			return matched;
+		}
+
+		// ids, sorted by text, starting with prefix
+		template <typename Add>
+		void starting_with(const std::vector<uint32_t>& sorted, const std::string_view prefix, Add add) const
+		{
+			auto found = std::lower_bound(sorted.begin(), sorted.end(), prefix, [this](const uint32_t id, const std::string_view value) { return text(id) < value; });
+			for (; found != sorted.end() && text(*found).substr(0, prefix.size()) == prefix; ++found)
+			{
+				if (!add(*found))
+				{
+					break;
+				}
+			}
+		}
+
+	public:
+		// the tables of all dexes are built
+		name_index(const std::vector<parsed_dex>& dexes, std::shared_ptr<utils::string_arena> arena) : arena_(std::move(arena))
+		{
+			for (const auto& dex : dexes)
+			{
+				const auto& tables = dex.get_tables();
+				const auto& methods = tables.methods();
+				for (const auto type : tables.classes().type)
+				{
+					classes_.push_back(tables.type_name_id(type));
+				}
+				methods_.insert(methods_.end(), methods.name.begin(), methods.name.end());
+				for (uint32_t method = 0; method < methods.name.size(); method++)
+				{
+					if (tables.is_defined(method))
+					{
+						class_methods_[tables.type_name_id(methods.class_type[method])].push_back(methods.name[method]);
+					}
+				}
+			}
+			classes_ = distinct(std::move(classes_));
+			methods_ = distinct(std::move(methods_));
+
+			// the trigram indexes read the ids in ascending order, the completions sort copies by text
+			const auto get_text = [this](const uint32_t id) { return text(id); };
+			utils::thread_pool::shared().parallel_for(3, [&](size_t, const size_t part)
+			{
+				if (part == 0)
+				{
+					class_trigrams_ = utils::trigram_index(classes_, get_text);
+				}
+				else if (part == 1)
+				{
+					method_trigrams_ = utils::trigram_index(methods_, get_text);
+				}
+				else
+				{
+					sorted_classes_ = classes_;
+					std::sort(sorted_classes_.begin(), sorted_classes_.end(), [this](const uint32_t a, const uint32_t b) { return is_less(a, b); });
+					for (auto& [_, names] : class_methods_)
+					{
+						names = distinct(std::move(names));
+						std::sort(names.begin(), names.end(), [this](const uint32_t a, const uint32_t b) { return is_less(a, b); });
+					}
+				}
+			});
+		}
+
+		name_index(const name_index&) = delete;
+		name_index& operator=(const name_index&) = delete;
+
+		std::vector<uint8_t> match_classes(const utils::text_query& query) const
+		{
+			return match(classes_, class_trigrams_, query);
+		}
+
+		std::vector<uint8_t> match_methods(const utils::text_query& query) const
+		{
+			return match(methods_, method_trigrams_, query);
+		}
+
+		/*
+			Class paths starting with prefix, sorted; if there are none, the ones containing it (any case).
+			At most limit of them.
+		*/
+		std::vector<std::string> complete_class(const std::string& prefix, const size_t limit) const
+		{
+			std::vector<std::string> completions{};
+			starting_with(sorted_classes_, prefix, [&](const uint32_t id)
+			{
+				completions.emplace_back(text(id));
+				return completions.size() < limit;
+			});
+
+			if (completions.empty() && !prefix.empty())
+			{
+				// a prefix shorter than a trigram checks all of them
+				std::vector<uint32_t> candidates{};
+				const auto is_narrowed = class_trigrams_.candidates(prefix, candidates);
+				std::sort(candidates.begin(), candidates.end(), [this](const uint32_t a, const uint32_t b) { return is_less(a, b); });
+				utils::text_query query(prefix);
+				for (const auto id : is_narrowed ? candidates : sorted_classes_)
+				{
+					if (completions.size() == limit)
+					{
+						break;
+					}
+					if (query.matches(text(id)))
+					{
+						completions.emplace_back(text(id));
+					}
+				}
+			}
+			return completions;
+		}
+
+		/*
+			class.method paths: the methods of the class before the last '.' starting with what follows it
+			(containing it if none starts with it), then the classes completing path, with a '.' for their methods.
+			At most limit of them.
+		*/
+		std::vector<std::string> complete_method(const std::string& path, const size_t limit) const
+		{
+			std::vector<std::string> completions{};
+			const auto dot = path.rfind('.');
+			if (dot != std::string::npos)
+			{
+				const auto class_path = path.substr(0, dot);
+				const auto name = path.substr(dot + 1);
+				const auto found = class_methods_.find(arena_->find(class_path));
+				if (found != class_methods_.end())
+				{
+					const auto add = [&](const uint32_t id)
+					{
+						completions.push_back(class_path + '.' + std::string(text(id)));
+						return completions.size() < limit;
+					};
+					starting_with(found->second, name, add);
+					if (completions.empty() && !name.empty())
+					{
+						utils::text_query query(name);
+						for (const auto id : found->second)
+						{
+							if (query.matches(text(id)) && !add(id))
+							{
+								break;
+							}
+						}
+					}
+				}
+			}
+
+			if (completions.size() < limit)
+			{
+				for (auto& class_path : complete_class(path, limit - completions.size()))
+				{
+					completions.push_back(class_path + '.');
+				}
+			}
+			return completions;
+		}
+
+		size_t classes_count() const
+		{
+			return classes_.size();
+		}
+
+		size_t methods_count() const
+		{
+			return methods_.size();
+		}
+
+		// class name_index
+	};
+} // namespace andromeda
@@ -1,49 +1,479 @@
 #pragma once
 
+#include <cstring>
 #include <string>
-// #include <regex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include <algorithm>
 
 #include "utils.hpp"
 
 namespace andromeda
 {
-    bool is_url(const std::string& str)
+    // what scan_tokens() extracts from a string
+    enum class token_kind
     {
-        const std::vector<std::string> urls {"http://", "https://", "ftp://", "ftps://"};
-        for (const auto& url : urls)
+        url,
+        email,
+        domain,
+        ipv4,
+        jwt,
+        aws_key,
+        google_key,
+        base64,
+        count,
+    };
+
+    inline const char* token_kind_name(const token_kind kind)
+    {
+        switch (kind)
         {
-            if (utils::find_case_insensitive(str, url) != std::string::npos)
-            {
-                return true;
-            }
+        case token_kind::url: return "URLs";
+        case token_kind::email: return "e-Mails";
+        case token_kind::domain: return "Domains";
+        case token_kind::ipv4: return "IP addresses";
+        case token_kind::jwt: return "JWTs";
+        case token_kind::aws_key: return "AWS access keys";
+        case token_kind::google_key: return "Google API keys";
+        case token_kind::base64: return "Base64 blobs";
+        default: return "?";
         }
-        return false;
     }
 
-    bool is_email(const std::string& text)
+    namespace tokens
     {
-        std::vector<std::string> strs{};
-        utils::split(text, strs);
+        // character classes, one table lookup per byte
+        enum : uint16_t
+        {
+            DIGIT = 1 << 0,
+            UPPER = 1 << 1,
+            LOWER = 1 << 2,
+            HYPHEN = 1 << 3,     // -
+            UNDERSCORE = 1 << 4, // _
+            DOT = 1 << 5,        // .
+            BASE64_SIGN = 1 << 6, // + /
+            URL = 1 << 7,        // anything allowed in a URL
+            EMAIL_LOCAL = 1 << 8, // local part of an address
+
+            ALPHA = UPPER | LOWER,
+            ALNUM = ALPHA | DIGIT,
+            LABEL = ALNUM | HYPHEN,               // domain label
+            BASE64 = ALNUM | BASE64_SIGN,
+            BASE64URL = ALNUM | HYPHEN | UNDERSCORE,
+            SCHEME = ALNUM | HYPHEN | DOT,
+        };
 
-        for (const auto& str: strs)
+        struct class_table
         {
-            const auto at_loc = str.find("@");
-            if (at_loc != std::string::npos)
+            uint16_t classes[256]{};
+
+            constexpr class_table()
             {
-                const auto dot_loc = str.find_last_of(".");
-                if (dot_loc != std::string::npos && dot_loc > at_loc)
+                for (auto chr = '0'; chr <= '9'; chr++) classes[static_cast<unsigned char>(chr)] |= DIGIT;
+                for (auto chr = 'A'; chr <= 'Z'; chr++) classes[static_cast<unsigned char>(chr)] |= UPPER;
+                for (auto chr = 'a'; chr <= 'z'; chr++) classes[static_cast<unsigned char>(chr)] |= LOWER;
+                classes['-'] |= HYPHEN;
+                classes['_'] |= UNDERSCORE;
+                classes['.'] |= DOT;
+                classes['+'] |= BASE64_SIGN;
+                classes['/'] |= BASE64_SIGN;
+
+                for (auto chr : "-._~:/?#[]@!$&'()*+,;=%")
+                {
+                    classes[static_cast<unsigned char>(chr)] |= URL;
+                }
+                for (auto chr : ".!#$%&'*+/=?^_`{|}~-")
+                {
+                    classes[static_cast<unsigned char>(chr)] |= EMAIL_LOCAL;
+                }
+                for (auto i = 0; i < 256; i++)
                 {
-                    const auto is_alpha_mail = std::all_of(str.begin() + dot_loc + 1, str.end(), [](char chr)
+                    if (classes[i] & ALNUM)
                     {
-                        return std::isalpha(chr);
-                    });
-                    return is_alpha_mail;
+                        classes[i] |= URL | EMAIL_LOCAL;
+                    }
+                }
+                classes[0] = 0; // the terminators of the string literals above
+            }
+        };
+
+        constexpr class_table table{};
+
+        inline bool is(const char chr, const uint16_t mask)
+        {
+            return (table.classes[static_cast<unsigned char>(chr)] & mask) != 0;
+        }
+
+        // [from, end) starts with count characters of mask, returns their end or nullptr
+        inline const char* expect(const char* from, const char* end, const uint16_t mask, const size_t count)
+        {
+            if (static_cast<size_t>(end - from) < count)
+            {
+                return nullptr;
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                if (!is(from[i], mask))
+                {
+                    return nullptr;
+                }
+            }
+            return from + count;
+        }
+
+        inline const char* skip(const char* from, const char* end, const uint16_t mask)
+        {
+            while (from != end && is(*from, mask))
+            {
+                from++;
+            }
+            return from;
+        }
+
+        inline bool equals_lower(const char* from, const char* end, const char* lower)
+        {
+            for (; *lower != '\0'; from++, lower++)
+            {
+                if (from == end || (*from | 0x20) != *lower)
+                {
+                    return false;
+                }
+            }
+            return from == end;
+        }
+
+        // top level domains that show up in apps; file extensions that are also TLDs (so, py, sh, ...) left out
+        inline bool is_known_tld(const char* from, const char* end)
+        {
+            static const char* const tlds[] = {
+                "com", "net", "org", "info", "biz", "io", "co", "me", "ru", "su", "cn", "tk", "xyz", "top", "app", "dev",
+                "online", "site", "club", "pw", "cc", "ws", "in", "us", "uk", "de", "fr", "it", "es", "nl", "br", "jp", "kr",
+                "ir", "ua", "kz", "by", "eu", "tv", "gg", "ly", "gov", "edu", "ai", "vn", "id", "tr", "pl", "cz", "ch", "ca",
+            };
+            return std::any_of(std::begin(tlds), std::end(tlds), [&](const char* tld) { return equals_lower(from, end, tld); });
+        }
+
+        // first labels of Java packages, "androidx.core.app" is not a domain
+        inline bool is_package_root(const char* from, const char* end)
+        {
+            static const char* const roots[] = {"android", "androidx", "java", "javax", "kotlin", "kotlinx", "dalvik", "sun"};
+            return is_known_tld(from, end) ||
+                std::any_of(std::begin(roots), std::end(roots), [&](const char* root) { return equals_lower(from, end, root); });
+        }
+
+        /*
+            Matchers: the length of the token starting at from, 0 if there is none.
+            Each one is a small DFA over the character classes, they never read past the token and one character.
+        */
+
+        // scheme://host[rest], trailing punctuation isn't part of it
+        inline size_t match_url(const char* from, const char* end)
+        {
+            auto current = from;
+            if (current == end || !is(*current, ALPHA))
+            {
+                return 0;
+            }
+            current = skip(current, end, SCHEME);
+            const auto scheme_size = current - from;
+            if (scheme_size < 2 || end - current < 4 || current[0] != ':' || current[1] != '/' || current[2] != '/' || !is(current[3], ALNUM))
+            {
+                return 0;
+            }
+
+            current = skip(current + 3, end, URL);
+            while (current != from && std::string_view(".,;:!?'\")]}").find(current[-1]) != std::string_view::npos)
+            {
+                current--;
+            }
+            return current - from;
+        }
+
+        // label(.label)+, the end of the last label (last_label: its start) or nullptr if there are less than two
+        inline const char* match_labels(const char* from, const char* end, const char** last_label)
+        {
+            auto current = from;
+            auto labels_count = 0;
+            const char* labels_end = nullptr;
+            while (true)
+            {
+                const auto label_end = skip(current, end, LABEL);
+                if (label_end == current || *current == '-' || label_end[-1] == '-')
+                {
+                    break;
                 }
+                labels_count++;
+                *last_label = current;
+                labels_end = label_end;
+                if (label_end == end || *label_end != '.')
+                {
+                    break;
+                }
+                current = label_end + 1;
             }
+            return labels_count >= 2 ? labels_end : nullptr;
         }
 
-        return false;
+        // local@domain.tld, the TLD alphabetic
+        inline size_t match_email(const char* from, const char* end)
+        {
+            const auto local_end = skip(from, end, EMAIL_LOCAL);
+            if (local_end == from || local_end - from > 64 || local_end == end || *local_end != '@' || *from == '.' || local_end[-1] == '.')
+            {
+                return 0;
+            }
+
+            const char* tld = nullptr;
+            const auto domain_end = match_labels(local_end + 1, end, &tld);
+            if (domain_end == nullptr || domain_end - tld < 2 || skip(tld, domain_end, ALPHA) != domain_end)
+            {
+                return 0;
+            }
+            return domain_end - from;
+        }
+
+        // host name without a scheme: known TLD, not a Java package or a file name with a dot
+        inline size_t match_domain(const char* from, const char* end)
+        {
+            const char* tld = nullptr;
+            const auto domain_end = match_labels(from, end, &tld);
+            if (domain_end == nullptr || (domain_end != end && (is(*domain_end, ALNUM | UNDERSCORE | HYPHEN) || *domain_end == '@' ||
+                (*domain_end == '.' && domain_end + 1 != end && is(domain_end[1], ALNUM)))))
+            {
+                return 0;
+            }
+
+            const auto first_label_end = std::find(from, domain_end, '.');
+            if (!is_known_tld(tld, domain_end) || is_package_root(from, first_label_end))
+            {
+                return 0;
+            }
+            return domain_end - from;
+        }
+
+        // dotted quad, not a part of a longer version string (1.2.3.4.5)
+        inline size_t match_ipv4(const char* from, const char* end)
+        {
+            auto current = from;
+            for (auto octet = 0; octet < 4; octet++)
+            {
+                if (octet != 0)
+                {
+                    if (current == end || *current != '.')
+                    {
+                        return 0;
+                    }
+                    current++;
+                }
+                const auto digits_end = skip(current, end, DIGIT);
+                if (digits_end == current || digits_end - current > 3)
+                {
+                    return 0;
+                }
+                auto value = 0;
+                for (; current != digits_end; current++)
+                {
+                    value = value * 10 + (*current - '0');
+                }
+                if (value > 255)
+                {
+                    return 0;
+                }
+            }
+            if (current != end && (is(*current, ALNUM) || (*current == '.' && current + 1 != end && is(current[1], DIGIT))))
+            {
+                return 0;
+            }
+            return current - from;
+        }
+
+        // header.payload.signature, base64url JSON objects ("eyJ" is '{"')
+        inline size_t match_jwt(const char* from, const char* end)
+        {
+            auto current = from;
+            for (auto part = 0; part < 3; part++)
+            {
+                if (part != 0)
+                {
+                    if (current == end || *current != '.')
+                    {
+                        return 0;
+                    }
+                    current++;
+                }
+                if (part < 2 && (end - current < 3 || current[0] != 'e' || current[1] != 'y' || current[2] != 'J'))
+                {
+                    return 0;
+                }
+                current = skip(current, end, BASE64URL);
+            }
+            return current - from;
+        }
+
+        // AKIA (long-term) / ASIA (temporary) ... + 16 characters
+        inline size_t match_aws_key(const char* from, const char* end)
+        {
+            static const char* const prefixes[] = {"AKIA", "ASIA", "AGPA", "AIDA", "AROA", "AIPA", "ANPA", "ANVA"};
+            if (end - from < 20 || !std::any_of(std::begin(prefixes), std::end(prefixes), [from](const char* prefix) { return memcmp(from, prefix, 4) == 0; }))
+            {
+                return 0;
+            }
+            const auto key_end = expect(from + 4, end, UPPER | DIGIT, 16);
+            return key_end != nullptr && (key_end == end || !is(*key_end, ALNUM)) ? 20 : 0;
+        }
+
+        // AIza + 35 base64url characters
+        inline size_t match_google_key(const char* from, const char* end)
+        {
+            if (end - from < 39 || memcmp(from, "AIza", 4) != 0)
+            {
+                return 0;
+            }
+            const auto key_end = expect(from + 4, end, BASE64URL, 35);
+            return key_end != nullptr && (key_end == end || !is(*key_end, BASE64URL)) ? 39 : 0;
+        }
+
+        // standard alphabet, padded to a multiple of 4, at least 24 characters of mixed case and digits, not a path
+        inline size_t match_base64(const char* from, const char* end)
+        {
+            const auto body_end = skip(from, end, BASE64);
+            auto current = body_end;
+            while (current != end && *current == '=' && current - body_end < 2)
+            {
+                current++;
+            }
+            const auto size = current - from;
+            if (size < 24 || size % 4 != 0 || (current != end && (is(*current, BASE64URL | DOT) || *current == '=')))
+            {
+                return 0;
+            }
+
+            uint16_t seen = 0;
+            size_t slashes = 0;
+            for (auto chr = from; chr != body_end; chr++)
+            {
+                seen |= table.classes[static_cast<unsigned char>(*chr)];
+                slashes += *chr == '/';
+            }
+            return (seen & UPPER) && (seen & LOWER) && (seen & DIGIT) && slashes * 16 <= static_cast<size_t>(size) ? size : 0;
+        }
+    } // namespace tokens
+
+    /*
+        Single pass over text: at every position where a token may start (the previous character can't
+        continue it) the matchers run, the longest token is reported and the scan resumes after it.
+        on_token(kind, span) gets views into text, nothing is allocated.
+    */
+    template <typename Callback>
+    void scan_tokens(const std::string_view text, Callback on_token)
+    {
+        using namespace tokens;
+        const auto begin = text.data();
+        const auto end = begin + text.size();
+
+        for (auto current = begin; current < end;)
+        {
+            const auto previous = current == begin ? 0 : table.classes[static_cast<unsigned char>(current[-1])];
+            const auto chr = table.classes[static_cast<unsigned char>(*current)];
+            if ((chr & (ALNUM | EMAIL_LOCAL)) == 0)
+            {
+                current++;
+                continue;
+            }
+
+            auto best_kind = token_kind::count;
+            size_t best_size = 0;
+            const auto consider = [&](const token_kind kind, const size_t size)
+            {
+                if (size > best_size)
+                {
+                    best_kind = kind;
+                    best_size = size;
+                }
+            };
+
+            if ((previous & BASE64URL) == 0 && *current == 'e')
+            {
+                consider(token_kind::jwt, match_jwt(current, end));
+            }
+            if ((previous & BASE64URL) == 0 && *current == 'A')
+            {
+                consider(token_kind::google_key, match_google_key(current, end));
+            }
+            if ((previous & ALNUM) == 0 && *current == 'A')
+            {
+                consider(token_kind::aws_key, match_aws_key(current, end));
+            }
+            if ((previous & SCHEME) == 0)
+            {
+                consider(token_kind::url, match_url(current, end));
+            }
+            if ((previous & EMAIL_LOCAL) == 0)
+            {
+                consider(token_kind::email, match_email(current, end));
+            }
+            if ((previous & (LABEL | DOT | UNDERSCORE)) == 0 && (current == begin || (current[-1] != '@' && current[-1] != '/')))
+            {
+                consider(token_kind::domain, match_domain(current, end));
+            }
+            if ((previous & (ALNUM | DOT)) == 0 && (chr & DIGIT))
+            {
+                consider(token_kind::ipv4, match_ipv4(current, end));
+            }
+            if ((previous & (BASE64 | HYPHEN | UNDERSCORE | DOT)) == 0)
+            {
+                consider(token_kind::base64, match_base64(current, end));
+            }
+
+            if (best_size == 0)
+            {
+                current++;
+                continue;
+            }
+            on_token(best_kind, std::string_view(current, best_size));
+            current += best_size;
+        }
     }
 
-} // namespace andromeda
\ No newline at end of file
+    /*
+        Distinct tokens of each kind with the number of times they were seen.
+        The views must outlive it (e.g. they point into the DEX string pools).
+    */
+    class token_counts
+    {
+        std::unordered_map<std::string_view, size_t> counts_[static_cast<size_t>(token_kind::count)];
+
+    public:
+        void add(const token_kind kind, const std::string_view token, const size_t count = 1)
+        {
+            counts_[static_cast<size_t>(kind)][token] += count;
+        }
+
+        void merge(const token_counts& other)
+        {
+            for (size_t kind = 0; kind < static_cast<size_t>(token_kind::count); kind++)
+            {
+                for (const auto& token : other.counts_[kind])
+                {
+                    counts_[kind][token.first] += token.second;
+                }
+            }
+        }
+
+        // most frequent first, then alphabetical
+        std::vector<std::pair<std::string_view, size_t>> sorted(const token_kind kind) const
+        {
+            const auto& counts = counts_[static_cast<size_t>(kind)];
+            std::vector<std::pair<std::string_view, size_t>> tokens(counts.begin(), counts.end());
+            std::sort(tokens.begin(), tokens.end(), [](const auto& a, const auto& b)
+            {
+                return a.second != b.second ? a.second > b.second : a.first < b.first;
+            });
+            return tokens;
+        }
+
+        // class token_counts
+    };
+
+} // namespace andromeda
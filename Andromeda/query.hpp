@@ -0,0 +1,994 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "dex_tables.hpp"
+#include "regex.hpp"
+
+namespace andromeda
+{
+	/*
+		Queries over the tables of a DEX file (dex_tables.hpp):
+
+			select <table> [where <condition>] [limit <count>]
+
+		tables: classes (name, super, access), methods (class, name, proto, access, size), fields (class, name, type, access),
+		        strings (value), xrefs (from, to, kind); all of them have dex. Singular names work too.
+		conditions:
+			column ~ "text"    contains text, or matches "/regex/" ("/regex/i")
+			column = "text"    equal, != not equal
+			access & flags     has all the flags: public|static, native, ... or a number
+			size > 100         numbers: = != < <= > >=
+			calls "text"       methods calling a method whose reference (Lcls;->name(args)ret) contains/matches text
+			uses "text"        methods referencing a matching string, field (Lcls;->name:type) or type (Lcls;)
+			not, and, or, ( )
+		e.g. select method where class ~ "okhttp" and calls "Ljava/lang/Runtime;->exec" and access & native
+
+		The planner orders every and/or by cost, so flags and numbers narrow the rows before names are compared
+		and names before the bytecode is searched. Conditions run one after another over a vector of row numbers,
+		each in one tight loop over its column; names are compared once per distinct value, not once per row.
+	*/
+	class query
+	{
+	public:
+		enum class table
+		{
+			classes,
+			methods,
+			fields,
+			strings,
+			xrefs,
+		};
+
+		enum class column
+		{
+			name,
+			class_name,
+			super,
+			proto,
+			type,
+			access,
+			size,
+			value,
+			from,
+			to,
+			kind,
+			dex,
+			calls,
+			uses,
+		};
+
+		struct condition
+		{
+			enum class op
+			{
+				all, // and
+				any, // or
+				negate,
+				contains,
+				equals,
+				not_equals,
+				has_flags,
+				less,
+				less_equal,
+				greater,
+				greater_equal,
+				calls,
+				uses,
+			};
+
+			op operation = op::all;
+			column target = column::name;
+			std::string text{};
+			uint64_t number = 0;
+			bool is_number = false;
+			size_t matcher_index = 0; // contains, calls, uses: text_query of the execution
+			unsigned cost = 0;
+			std::vector<condition> operands{}; // all, any, negate
+		};
+
+		struct access_flag
+		{
+			const char* name;
+			uint32_t value;
+		};
+
+	private:
+		struct token
+		{
+			enum class type
+			{
+				word,
+				string,
+				number,
+				symbol,
+				end,
+			};
+
+			type kind;
+			std::string text;
+			size_t offset;
+		};
+
+		std::vector<token> tokens_{};
+		size_t position_ = 0;
+		std::string error_{};
+
+		table table_ = table::classes;
+		bool has_condition_ = false;
+		condition root_{};
+		size_t limit_ = 0; // 0: no limit
+		std::vector<std::string> matcher_texts_{};
+
+		static const std::vector<std::pair<const char*, column>>& column_names()
+		{
+			static const std::vector<std::pair<const char*, column>> names = {
+				{"name", column::name}, {"class", column::class_name}, {"super", column::super}, {"proto", column::proto},
+				{"type", column::type}, {"access", column::access}, {"size", column::size}, {"value", column::value},
+				{"from", column::from}, {"to", column::to}, {"kind", column::kind}, {"dex", column::dex},
+			};
+			return names;
+		}
+
+		static bool has_column(const table target_table, const column target)
+		{
+			if (target == column::dex)
+			{
+				return true;
+			}
+			switch (target_table)
+			{
+			case table::classes: return target == column::name || target == column::super || target == column::access;
+			case table::methods: return target == column::class_name || target == column::name || target == column::proto ||
+			                            target == column::access || target == column::size;
+			case table::fields: return target == column::class_name || target == column::name || target == column::type || target == column::access;
+			case table::strings: return target == column::value;
+			default: return target == column::from || target == column::to || target == column::kind;
+			}
+		}
+
+		static bool is_numeric(const column target)
+		{
+			return target == column::access || target == column::size;
+		}
+
+		bool tokenize(const std::string& text)
+		{
+			size_t i = 0;
+			while (true)
+			{
+				while (i < text.size() && (text[i] == ' ' || text[i] == '\t'))
+				{
+					i++;
+				}
+				if (i == text.size())
+				{
+					tokens_.push_back(token{token::type::end, "", i});
+					return true;
+				}
+
+				const auto begin = i;
+				const auto chr = text[i];
+				if (chr == '"')
+				{
+					// \" is the only escape, regexes keep their backslashes
+					std::string value{};
+					for (i++; i < text.size() && text[i] != '"'; i++)
+					{
+						if (text[i] == '\\' && i + 1 < text.size() && text[i + 1] == '"')
+						{
+							i++;
+						}
+						value += text[i];
+					}
+					if (i == text.size())
+					{
+						return fail("unterminated string", begin);
+					}
+					i++;
+					tokens_.push_back(token{token::type::string, value, begin});
+				}
+				else if (isalpha(static_cast<unsigned char>(chr)) || chr == '_')
+				{
+					while (i < text.size() && (isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_'))
+					{
+						i++;
+					}
+					auto word = text.substr(begin, i - begin);
+					std::transform(word.begin(), word.end(), word.begin(), [](const unsigned char c) { return static_cast<char>(tolower(c)); });
+					tokens_.push_back(token{token::type::word, word, begin});
+				}
+				else if (isdigit(static_cast<unsigned char>(chr)))
+				{
+					while (i < text.size() && isalnum(static_cast<unsigned char>(text[i])))
+					{
+						i++;
+					}
+					tokens_.push_back(token{token::type::number, text.substr(begin, i - begin), begin});
+				}
+				else if ((chr == '!' || chr == '<' || chr == '>') && i + 1 < text.size() && text[i + 1] == '=')
+				{
+					tokens_.push_back(token{token::type::symbol, text.substr(begin, 2), begin});
+					i += 2;
+				}
+				else if (std::string_view("~=&<>()|").find(chr) != std::string_view::npos)
+				{
+					tokens_.push_back(token{token::type::symbol, std::string(1, chr), begin});
+					i++;
+				}
+				else
+				{
+					return fail(std::string("unexpected '") + chr + "'", begin);
+				}
+			}
+		}
+
+		bool fail(const std::string& message, const size_t offset)
+		{
+			if (error_.empty())
+			{
+				error_ = message + " at offset " + std::to_string(offset);
+			}
+			return false;
+		}
+
+		bool fail_here(const std::string& message)
+		{
+			return fail(message, tokens_[position_].offset);
+		}
+
+		const token& peek() const
+		{
+			return tokens_[position_];
+		}
+
+		bool accept(const token::type kind, const char* text)
+		{
+			if (peek().kind == kind && peek().text == text)
+			{
+				position_++;
+				return true;
+			}
+			return false;
+		}
+
+		bool accept_word(const char* word)
+		{
+			return accept(token::type::word, word);
+		}
+
+		// a number, or access flag names joined by |
+		bool parse_number(condition& leaf)
+		{
+			leaf.number = 0;
+			do
+			{
+				const auto& current = peek();
+				if (current.kind == token::type::number)
+				{
+					char* end = nullptr;
+					const auto value = strtoull(current.text.c_str(), &end, 0);
+					if (*end != '\0')
+					{
+						return fail_here("bad number '" + current.text + "'");
+					}
+					leaf.number |= value;
+				}
+				else if (current.kind == token::type::word && leaf.target == column::access)
+				{
+					const auto& flags = access_flags();
+					const auto flag = std::find_if(flags.begin(), flags.end(), [&current](const access_flag& f) { return current.text == f.name; });
+					if (flag == flags.end())
+					{
+						return fail_here("unknown access flag '" + current.text + "'");
+					}
+					leaf.number |= flag->value;
+				}
+				else
+				{
+					return fail_here(leaf.target == column::access ? "expected access flags" : "expected a number");
+				}
+				position_++;
+			}
+			while (accept(token::type::symbol, "|"));
+			leaf.is_number = true;
+			return true;
+		}
+
+		bool parse_text(condition& leaf)
+		{
+			if (peek().kind != token::type::string)
+			{
+				return fail_here("expected a \"string\"");
+			}
+			leaf.text = peek().text;
+			position_++;
+			return true;
+		}
+
+		bool add_matcher(condition& leaf)
+		{
+			const utils::text_query matcher(leaf.text);
+			if (!matcher.is_valid())
+			{
+				return fail("invalid regex \"" + leaf.text + "\" (" + matcher.error() + ")", tokens_[position_ - 1].offset);
+			}
+			leaf.matcher_index = matcher_texts_.size();
+			matcher_texts_.push_back(leaf.text);
+			return true;
+		}
+
+		bool parse_comparison(condition& leaf)
+		{
+			using op = condition::op;
+			if (peek().kind != token::type::word)
+			{
+				return fail_here("expected a column");
+			}
+
+			const auto relation = peek().text;
+			if (relation == "calls" || relation == "uses")
+			{
+				if (table_ != table::methods)
+				{
+					return fail_here("'" + relation + "' is a condition of methods");
+				}
+				position_++;
+				accept(token::type::symbol, "~");
+				leaf.operation = relation == "calls" ? op::calls : op::uses;
+				leaf.target = relation == "calls" ? column::calls : column::uses;
+				return parse_text(leaf) && add_matcher(leaf);
+			}
+
+			const auto& names = column_names();
+			const auto found = std::find_if(names.begin(), names.end(), [&relation](const auto& name) { return relation == name.first; });
+			if (found == names.end() || !has_column(table_, found->second))
+			{
+				return fail_here("no column '" + relation + "' in " + table_name(table_));
+			}
+			leaf.target = found->second;
+			position_++;
+
+			const auto symbol = peek().kind == token::type::symbol ? peek().text : std::string{};
+			const std::pair<const char*, op> operators[] = {
+				{"~", op::contains}, {"=", op::equals}, {"!=", op::not_equals}, {"&", op::has_flags},
+				{"<", op::less}, {"<=", op::less_equal}, {">", op::greater}, {">=", op::greater_equal},
+			};
+			const auto operation = std::find_if(std::begin(operators), std::end(operators), [&symbol](const auto& o) { return symbol == o.first; });
+			if (operation == std::end(operators))
+			{
+				return fail_here("expected an operator");
+			}
+			leaf.operation = operation->second;
+			position_++;
+
+			const auto text_operator = leaf.operation == op::contains || leaf.operation == op::equals || leaf.operation == op::not_equals;
+			if (!is_numeric(leaf.target))
+			{
+				if (!text_operator)
+				{
+					return fail(std::string("'") + operation->first + "' needs a number column", tokens_[position_ - 1].offset);
+				}
+				return parse_text(leaf) && (leaf.operation != op::contains || add_matcher(leaf));
+			}
+			if (leaf.operation == op::contains)
+			{
+				return fail("'~' needs a text column", tokens_[position_ - 1].offset);
+			}
+			return parse_number(leaf);
+		}
+
+		bool parse_unary(condition& node)
+		{
+			if (accept_word("not"))
+			{
+				node.operation = condition::op::negate;
+				node.operands.emplace_back();
+				return parse_unary(node.operands.back());
+			}
+			if (accept(token::type::symbol, "("))
+			{
+				if (!parse_or(node))
+				{
+					return false;
+				}
+				return accept(token::type::symbol, ")") || fail_here("expected ')'");
+			}
+			return parse_comparison(node);
+		}
+
+		bool parse_and(condition& node)
+		{
+			condition operand{};
+			if (!parse_unary(operand))
+			{
+				return false;
+			}
+			if (peek().kind != token::type::word || peek().text != "and")
+			{
+				node = std::move(operand);
+				return true;
+			}
+			node.operation = condition::op::all;
+			node.operands.push_back(std::move(operand));
+			while (accept_word("and"))
+			{
+				node.operands.emplace_back();
+				if (!parse_unary(node.operands.back()))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool parse_or(condition& node)
+		{
+			condition operand{};
+			if (!parse_and(operand))
+			{
+				return false;
+			}
+			if (peek().kind != token::type::word || peek().text != "or")
+			{
+				node = std::move(operand);
+				return true;
+			}
+			node.operation = condition::op::any;
+			node.operands.push_back(std::move(operand));
+			while (accept_word("or"))
+			{
+				node.operands.emplace_back();
+				if (!parse_and(node.operands.back()))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/*
+			Planner: nested and/or of the same kind are merged, then the operands of each are ordered by cost.
+			Costs: numbers 1; names (one comparison per distinct name) 2, 3 for a regex; string values 4 (all distinct);
+			calls/uses 8, they decode the bytecode. The dex name is one comparison per DEX file: 0.
+		*/
+		void plan(condition& node)
+		{
+			using op = condition::op;
+			switch (node.operation)
+			{
+			case op::all:
+			case op::any:
+			{
+				std::vector<condition> operands{};
+				for (auto& operand : node.operands)
+				{
+					plan(operand);
+					if (operand.operation == node.operation)
+					{
+						for (auto& nested : operand.operands)
+						{
+							operands.push_back(std::move(nested));
+						}
+					}
+					else
+					{
+						operands.push_back(std::move(operand));
+					}
+				}
+				std::stable_sort(operands.begin(), operands.end(), [](const condition& a, const condition& b) { return a.cost < b.cost; });
+				node.operands = std::move(operands);
+				node.cost = 0;
+				for (const auto& operand : node.operands)
+				{
+					node.cost += operand.cost;
+				}
+				break;
+			}
+			case op::negate:
+				plan(node.operands.front());
+				node.cost = node.operands.front().cost;
+				break;
+			case op::calls:
+			case op::uses:
+				node.cost = 8;
+				break;
+			default:
+				if (node.target == column::dex)
+				{
+					node.cost = 0;
+				}
+				else if (is_numeric(node.target))
+				{
+					node.cost = 1;
+				}
+				else if (node.target == column::value)
+				{
+					node.cost = 4;
+				}
+				else
+				{
+					node.cost = node.operation == op::contains && utils::text_query(node.text).is_regex() ? 3 : 2;
+				}
+				break;
+			}
+		}
+
+		static bool uses_bytecode(const condition& node)
+		{
+			if (node.operation == condition::op::calls || node.operation == condition::op::uses)
+			{
+				return true;
+			}
+			return std::any_of(node.operands.begin(), node.operands.end(), [](const condition& operand) { return uses_bytecode(operand); });
+		}
+
+		static std::string describe(const condition& node)
+		{
+			using op = condition::op;
+			const char* operators[] = {"and", "or", "not", "~", "=", "!=", "&", "<", "<=", ">", ">=", "calls", "uses"};
+			const auto operator_name = operators[static_cast<size_t>(node.operation)];
+			if (node.operation == op::all || node.operation == op::any || node.operation == op::negate)
+			{
+				return operator_name;
+			}
+			if (node.operation == op::calls || node.operation == op::uses)
+			{
+				return std::string(operator_name) + " \"" + node.text + "\"";
+			}
+
+			std::string column_name{};
+			for (const auto& [name, value] : column_names())
+			{
+				if (value == node.target)
+				{
+					column_name = name;
+				}
+			}
+			if (node.is_number)
+			{
+				char number[32];
+				snprintf(number, sizeof(number), node.target == column::access ? "0x%llx" : "%llu", static_cast<unsigned long long>(node.number));
+				return column_name + " " + operator_name + " " + number;
+			}
+			return column_name + " " + operator_name + " \"" + node.text + "\"";
+		}
+
+		static void describe_plan(const condition& node, const size_t depth, std::vector<std::pair<size_t, std::string>>& lines)
+		{
+			lines.emplace_back(depth, describe(node) + " (cost " + std::to_string(node.cost) + ")");
+			for (const auto& operand : node.operands)
+			{
+				describe_plan(operand, depth + 1, lines);
+			}
+		}
+
+	public:
+		explicit query(const std::string& text)
+		{
+			if (!tokenize(text))
+			{
+				return;
+			}
+			if (!accept_word("select"))
+			{
+				fail_here("expected 'select'");
+				return;
+			}
+
+			const std::pair<const char*, table> tables[] = {
+				{"class", table::classes}, {"classes", table::classes}, {"method", table::methods}, {"methods", table::methods},
+				{"field", table::fields}, {"fields", table::fields}, {"string", table::strings}, {"strings", table::strings},
+				{"xref", table::xrefs}, {"xrefs", table::xrefs},
+			};
+			const auto found = std::find_if(std::begin(tables), std::end(tables), [this](const auto& t) { return peek().text == t.first; });
+			if (peek().kind != token::type::word || found == std::end(tables))
+			{
+				fail_here("expected classes, methods, fields, strings or xrefs");
+				return;
+			}
+			table_ = found->second;
+			position_++;
+
+			if (accept_word("where"))
+			{
+				if (!parse_or(root_))
+				{
+					return;
+				}
+				has_condition_ = true;
+				plan(root_);
+			}
+			if (accept_word("limit"))
+			{
+				condition count{};
+				count.target = column::size;
+				if (!parse_number(count))
+				{
+					return;
+				}
+				limit_ = static_cast<size_t>(count.number);
+			}
+			if (peek().kind != token::type::end)
+			{
+				fail_here("unexpected '" + peek().text + "'");
+			}
+		}
+
+		bool is_valid() const
+		{
+			return error_.empty();
+		}
+
+		std::string error() const
+		{
+			return error_;
+		}
+
+		table target_table() const
+		{
+			return table_;
+		}
+
+		size_t limit() const
+		{
+			return limit_;
+		}
+
+		// the xrefs of the DEX files are read: the xrefs table, calls and uses
+		bool needs_xrefs() const
+		{
+			return table_ == table::xrefs || (has_condition_ && uses_bytecode(root_));
+		}
+
+		static const char* table_name(const table target)
+		{
+			const char* names[] = {"classes", "methods", "fields", "strings", "xrefs"};
+			return names[static_cast<size_t>(target)];
+		}
+
+		static const std::vector<access_flag>& access_flags()
+		{
+			static const std::vector<access_flag> flags = {
+				{"public", dex::kAccPublic}, {"private", dex::kAccPrivate}, {"protected", dex::kAccProtected},
+				{"static", dex::kAccStatic}, {"final", dex::kAccFinal}, {"synchronized", dex::kAccSynchronized},
+				{"volatile", dex::kAccVolatile}, {"bridge", dex::kAccBridge}, {"transient", dex::kAccTransient},
+				{"varargs", dex::kAccVarargs}, {"native", dex::kAccNative}, {"interface", dex::kAccInterface},
+				{"abstract", dex::kAccAbstract}, {"strict", dex::kAccStrict}, {"synthetic", dex::kAccSynthetic},
+				{"annotation", dex::kAccAnnotation}, {"enum", dex::kAccEnum}, {"constructor", dex::kAccConstructor},
+				{"declared_synchronized", dex::kAccDeclaredSynchronized},
+			};
+			return flags;
+		}
+
+		// the plan, one line per condition: depth, text
+		std::vector<std::pair<size_t, std::string>> describe_plan() const
+		{
+			std::vector<std::pair<size_t, std::string>> lines{};
+			lines.emplace_back(0, std::string("scan ") + table_name(table_));
+			if (has_condition_)
+			{
+				describe_plan(root_, 1, lines);
+			}
+			if (limit_ != 0)
+			{
+				lines.emplace_back(1, "limit " + std::to_string(limit_));
+			}
+			return lines;
+		}
+
+		/*
+			State of the query on one DEX file: its own regexes (their DFA caches) and the memos of the names already compared.
+			One execution per DEX file, executions of different DEX files can run in parallel.
+		*/
+		class execution
+		{
+			using op = condition::op;
+
+			const query& query_;
+			dex_tables& tables_;
+			std::string dex_name_;
+			std::vector<std::unique_ptr<utils::text_query>> matchers_{};
+			std::vector<std::vector<uint8_t>> memos_{}; // per matcher, per name: 0 not compared yet, 1 no, 2 yes
+			std::string text_buffer_{}; // names built for a comparison
+
+			// keeps the rows whose key passes test
+			template <typename KeyOf, typename Test>
+			static void filter_rows(std::vector<uint32_t>& rows, KeyOf key_of, Test test)
+			{
+				size_t kept = 0;
+				for (const auto row : rows)
+				{
+					if (test(key_of(row)))
+					{
+						rows[kept++] = row;
+					}
+				}
+				rows.resize(kept);
+			}
+
+			// text test of a name, once per distinct key; keys past dictionary_size (no name) are compared as ""
+			template <typename TextOf>
+			auto memoized(const condition& leaf, TextOf text_of, const size_t dictionary_size)
+			{
+				auto& memo = memos_[leaf.matcher_index];
+				memo.assign(dictionary_size + 1, 0);
+				auto& matcher = *matchers_[leaf.matcher_index];
+				return [&memo, &matcher, text_of, dictionary_size](const uint32_t key)
+				{
+					const auto slot = std::min<size_t>(key, dictionary_size);
+					if (memo[slot] == 0)
+					{
+						memo[slot] = matcher.matches(text_of(key)) ? 2 : 1;
+					}
+					return memo[slot] == 2;
+				};
+			}
+
+			template <typename KeyOf, typename TextOf>
+			void filter_text(const condition& leaf, std::vector<uint32_t>& rows, KeyOf key_of, TextOf text_of, const size_t dictionary_size)
+			{
+				if (leaf.operation == op::contains)
+				{
+					filter_rows(rows, key_of, memoized(leaf, text_of, dictionary_size));
+					return;
+				}
+				const auto expected = leaf.operation == op::equals;
+				filter_rows(rows, key_of, [&](const uint32_t key) { return (text_of(key) == leaf.text) == expected; });
+			}
+
+			template <typename KeyOf>
+			static void filter_number(const condition& leaf, std::vector<uint32_t>& rows, KeyOf key_of)
+			{
+				const auto number = leaf.number;
+				switch (leaf.operation)
+				{
+				case op::has_flags: filter_rows(rows, key_of, [number](const uint64_t value) { return (value & number) == number; }); break;
+				case op::equals: filter_rows(rows, key_of, [number](const uint64_t value) { return value == number; }); break;
+				case op::not_equals: filter_rows(rows, key_of, [number](const uint64_t value) { return value != number; }); break;
+				case op::less: filter_rows(rows, key_of, [number](const uint64_t value) { return value < number; }); break;
+				case op::less_equal: filter_rows(rows, key_of, [number](const uint64_t value) { return value <= number; }); break;
+				case op::greater: filter_rows(rows, key_of, [number](const uint64_t value) { return value > number; }); break;
+				default: filter_rows(rows, key_of, [number](const uint64_t value) { return value >= number; }); break;
+				}
+			}
+
+			// xref targets of all kinds in one dictionary: methods, fields, strings, types
+			uint32_t target_key(const dex_tables::xref_kind kind, const uint32_t to) const
+			{
+				const auto methods_count = tables_.methods().name.size();
+				const auto fields_count = tables_.fields().name.size();
+				switch (kind)
+				{
+				case dex_tables::xref_kind::call: return to;
+				case dex_tables::xref_kind::field: return static_cast<uint32_t>(methods_count + to);
+				case dex_tables::xref_kind::string: return static_cast<uint32_t>(methods_count + fields_count + to);
+				default: return static_cast<uint32_t>(methods_count + fields_count + tables_.strings_count() + to);
+				}
+			}
+
+			std::string_view target_text(uint32_t key)
+			{
+				const dex_tables::xref_kind kinds[] = {dex_tables::xref_kind::call, dex_tables::xref_kind::field, dex_tables::xref_kind::string};
+				const size_t counts[] = {tables_.methods().name.size(), tables_.fields().name.size(), tables_.strings_count()};
+				for (size_t i = 0; i < 3; i++)
+				{
+					if (key < counts[i])
+					{
+						return tables_.xref_target(kinds[i], key, text_buffer_);
+					}
+					key -= static_cast<uint32_t>(counts[i]);
+				}
+				return tables_.xref_target(dex_tables::xref_kind::type, key, text_buffer_);
+			}
+
+			size_t targets_count() const
+			{
+				return tables_.methods().name.size() + tables_.fields().name.size() + tables_.strings_count() + tables_.type_count();
+			}
+
+			// methods with an xref of the relation whose target matches
+			void filter_relation(const condition& leaf, std::vector<uint32_t>& rows)
+			{
+				const auto& xrefs = tables_.xrefs();
+				const auto wants_calls = leaf.operation == op::calls;
+				auto matches = memoized(leaf, [this](const uint32_t key) { return target_text(key); }, targets_count());
+				filter_rows(rows, [](const uint32_t row) { return row; }, [&](const uint32_t method)
+				{
+					for (auto xref = xrefs.method_begin[method]; xref != xrefs.method_begin[method + 1]; xref++)
+					{
+						if ((xrefs.kind[xref] == dex_tables::xref_kind::call) == wants_calls && matches(target_key(xrefs.kind[xref], xrefs.to[xref])))
+						{
+							return true;
+						}
+					}
+					return false;
+				});
+			}
+
+			void filter_leaf(const condition& leaf, std::vector<uint32_t>& rows)
+			{
+				const auto& tables = tables_;
+				if (leaf.target == column::dex)
+				{
+					// the same for all rows
+					std::vector<uint32_t> dex_row{0};
+					filter_text(leaf, dex_row, [](const uint32_t key) { return key; }, [this](uint32_t) { return std::string_view(dex_name_); }, 1);
+					if (dex_row.empty())
+					{
+						rows.clear();
+					}
+					return;
+				}
+				if (leaf.operation == op::calls || leaf.operation == op::uses)
+				{
+					filter_relation(leaf, rows);
+					return;
+				}
+
+				// names are arena ids: one comparison per distinct name of the APK
+				const auto name_text = [&tables](const uint32_t key) { return tables.text(key); };
+				const auto names_count = tables.arena().size();
+				switch (query_.table_)
+				{
+				case table::classes:
+				{
+					const auto& classes = tables.classes();
+					if (leaf.target == column::access)
+						filter_number(leaf, rows, [&classes](const uint32_t row) { return classes.access[row]; });
+					else if (leaf.target == column::super)
+						filter_text(leaf, rows, [&](const uint32_t row) { return tables.type_name_id(classes.super[row]); }, name_text, names_count);
+					else
+						filter_text(leaf, rows, [&](const uint32_t row) { return tables.type_name_id(classes.type[row]); }, name_text, names_count);
+					break;
+				}
+				case table::methods:
+				{
+					const auto& methods = tables.methods();
+					if (leaf.target == column::access)
+						filter_number(leaf, rows, [&methods](const uint32_t row) { return methods.access[row]; });
+					else if (leaf.target == column::size)
+						filter_number(leaf, rows, [&methods](const uint32_t row) { return methods.code_size[row]; });
+					else if (leaf.target == column::class_name)
+						filter_text(leaf, rows, [&](const uint32_t row) { return tables.type_name_id(methods.class_type[row]); }, name_text, names_count);
+					else if (leaf.target == column::proto)
+						filter_text(leaf, rows, [&methods](const uint32_t row) { return methods.proto[row]; }, name_text, names_count);
+					else
+						filter_text(leaf, rows, [&methods](const uint32_t row) { return methods.name[row]; }, name_text, names_count);
+					break;
+				}
+				case table::fields:
+				{
+					const auto& fields = tables.fields();
+					if (leaf.target == column::access)
+						filter_number(leaf, rows, [&fields](const uint32_t row) { return fields.access[row]; });
+					else if (leaf.target == column::class_name)
+						filter_text(leaf, rows, [&](const uint32_t row) { return tables.type_name_id(fields.class_type[row]); }, name_text, names_count);
+					else if (leaf.target == column::type)
+						filter_text(leaf, rows, [&](const uint32_t row) { return tables.type_name_id(fields.type[row]); }, name_text, names_count);
+					else
+						filter_text(leaf, rows, [&fields](const uint32_t row) { return fields.name[row]; }, name_text, names_count);
+					break;
+				}
+				case table::strings:
+					filter_text(leaf, rows, [&tables](const uint32_t row) { return tables.string_id(row); }, name_text, names_count);
+					break;
+				default:
+				{
+					const auto& xrefs = tables_.xrefs();
+					if (leaf.target == column::from)
+						filter_text(leaf, rows, [&xrefs](const uint32_t row) { return xrefs.from[row]; },
+						            [&tables](const uint32_t key) { return tables.method_path(key); }, tables.methods().name.size());
+					else if (leaf.target == column::kind)
+						filter_text(leaf, rows, [&xrefs](const uint32_t row) { return static_cast<uint32_t>(xrefs.kind[row]); },
+						            [](const uint32_t key) { return std::string_view(dex_tables::xref_kind_name(static_cast<dex_tables::xref_kind>(key))); }, 4);
+					else
+						filter_text(leaf, rows, [this, &xrefs](const uint32_t row) { return target_key(xrefs.kind[row], xrefs.to[row]); },
+						            [this](const uint32_t key) { return target_text(key); }, targets_count());
+					break;
+				}
+				}
+			}
+
+			// keeps the rows for which node is true
+			void filter(const condition& node, std::vector<uint32_t>& rows)
+			{
+				switch (node.operation)
+				{
+				case op::all:
+					for (const auto& operand : node.operands)
+					{
+						if (rows.empty())
+						{
+							break;
+						}
+						filter(operand, rows);
+					}
+					break;
+				case op::any:
+				{
+					// each operand only sees the rows the previous ones rejected
+					std::vector<uint32_t> accepted{}, remaining = rows;
+					for (const auto& operand : node.operands)
+					{
+						auto passed = remaining;
+						filter(operand, passed);
+						std::vector<uint32_t> rejected{};
+						std::set_difference(remaining.begin(), remaining.end(), passed.begin(), passed.end(), std::back_inserter(rejected));
+						accepted.insert(accepted.end(), passed.begin(), passed.end());
+						remaining = std::move(rejected);
+					}
+					std::sort(accepted.begin(), accepted.end());
+					rows = std::move(accepted);
+					break;
+				}
+				case op::negate:
+				{
+					auto passed = rows;
+					filter(node.operands.front(), passed);
+					std::vector<uint32_t> rejected{};
+					std::set_difference(rows.begin(), rows.end(), passed.begin(), passed.end(), std::back_inserter(rejected));
+					rows = std::move(rejected);
+					break;
+				}
+				default:
+					filter_leaf(node, rows);
+					break;
+				}
+			}
+
+		public:
+			execution(const query& owner, dex_tables& tables, std::string dex_name)
+				: query_(owner), tables_(tables), dex_name_(std::move(dex_name)), memos_(owner.matcher_texts_.size())
+			{
+				for (const auto& text : owner.matcher_texts_)
+				{
+					matchers_.push_back(std::make_unique<utils::text_query>(text));
+				}
+			}
+
+			// row numbers of the table that pass the conditions, in order
+			std::vector<uint32_t> run()
+			{
+				size_t rows_count = 0;
+				switch (query_.table_)
+				{
+				case table::classes: rows_count = tables_.classes().type.size(); break;
+				case table::methods: rows_count = tables_.methods().name.size(); break;
+				case table::fields: rows_count = tables_.fields().name.size(); break;
+				case table::strings: rows_count = tables_.strings_count(); break;
+				default: rows_count = tables_.xrefs().from.size(); break;
+				}
+
+				std::vector<uint32_t> rows(rows_count);
+				for (size_t i = 0; i < rows_count; i++)
+				{
+					rows[i] = static_cast<uint32_t>(i);
+				}
+				if (query_.has_condition_)
+				{
+					filter(query_.root_, rows);
+				}
+				if (query_.limit_ != 0 && rows.size() > query_.limit_)
+				{
+					rows.resize(query_.limit_);
+				}
+				return rows;
+			}
+
+			// class execution
+		};
+
+		// class query
+	};
+} // namespace andromeda
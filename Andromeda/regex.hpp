@@ -0,0 +1,1001 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace utils
+{
+	/*
+		Regular expressions searched in linear time, RE2 style: the pattern is compiled to a Thompson NFA
+		and run as a DFA built lazily, one state per set of NFA threads, so there is no backtracking and
+		no input can make a search slow. Syntax: literals, ., [classes] and [^negated], \d \w \s (and \D \W \S),
+		\xHH, groups (also (?:...)), |, * + ? {m} {m,} {m,n}, ^ and $ (whole input). Bytes, not UTF-8 code points;
+		no captures or backreferences, \b is not supported.
+		A literal every match has to contain is extracted from the pattern, search() looks for it first.
+		The DFA cache makes search() non-const: parallel code searches with a copy per worker.
+	*/
+	class regex
+	{
+		using byte_set = std::bitset<256>;
+
+		enum class op : uint8_t
+		{
+			byte, // consumes a byte of sets[set], goes to out
+			split, // to out and out1
+			jump,
+			assert_begin,
+			assert_end,
+			match,
+		};
+
+		struct instruction
+		{
+			op code;
+			uint32_t out = 0;
+			uint32_t out1 = 0;
+			uint32_t set = 0;
+		};
+
+		struct program
+		{
+			std::vector<instruction> instructions{};
+			std::vector<byte_set> sets{};
+		};
+
+		// syntax tree, only needed while compiling
+		struct node
+		{
+			enum class type
+			{
+				empty,
+				bytes,
+				concat,
+				alternate,
+				repeat,
+				begin,
+				end,
+			} kind = type::empty;
+			byte_set set{};
+			std::vector<std::unique_ptr<node>> children{};
+			int min = 0;
+			int max = 0; // -1: unbounded
+		};
+
+		static constexpr int max_repeat = 1000;
+		static constexpr size_t max_instructions = 100000;
+		static constexpr size_t max_dfa_states = 2048;
+
+		std::shared_ptr<const program> program_{};
+		std::string required_{};
+		bool case_insensitive_ = false;
+		std::string error_{};
+
+		// parser state
+		std::string pattern_{};
+		size_t position_ = 0;
+
+		// lazy DFA: states are sorted lists of instructions (byte, match and pending assert_end)
+		struct dfa_state
+		{
+			std::vector<uint32_t> threads;
+			bool is_match;
+			int8_t matches_at_end; // -1 not computed yet
+		};
+		std::vector<dfa_state> states_{};
+		std::vector<int32_t> transitions_{}; // state * 256 + byte, -1 not computed yet
+		std::map<std::vector<uint32_t>, int32_t> state_ids_{};
+		size_t flushes_ = 0;
+		std::vector<uint32_t> unanchored_threads_{}; // the pattern restarting at every position
+		std::vector<uint32_t> visited_{};
+		uint32_t visit_mark_ = 0;
+
+		bool fail(const std::string& message)
+		{
+			if (error_.empty())
+			{
+				error_ = message + " at offset " + std::to_string(position_);
+			}
+			return false;
+		}
+
+		bool at_end() const
+		{
+			return position_ >= pattern_.size();
+		}
+
+		static byte_set digits()
+		{
+			byte_set set{};
+			for (auto chr = '0'; chr <= '9'; chr++) set.set(static_cast<unsigned char>(chr));
+			return set;
+		}
+
+		static byte_set word_bytes()
+		{
+			auto set = digits();
+			for (auto chr = 'a'; chr <= 'z'; chr++) set.set(static_cast<unsigned char>(chr));
+			for (auto chr = 'A'; chr <= 'Z'; chr++) set.set(static_cast<unsigned char>(chr));
+			set.set('_');
+			return set;
+		}
+
+		static byte_set spaces()
+		{
+			byte_set set{};
+			for (const auto chr : {' ', '\t', '\n', '\r', '\f', '\v'}) set.set(static_cast<unsigned char>(chr));
+			return set;
+		}
+
+		static int hex_value(const char chr)
+		{
+			if (chr >= '0' && chr <= '9') return chr - '0';
+			if (chr >= 'a' && chr <= 'f') return chr - 'a' + 10;
+			if (chr >= 'A' && chr <= 'F') return chr - 'A' + 10;
+			return -1;
+		}
+
+		/*
+			Escape after '\', position_ on the escaped character. A class escape (\d ...) sets is_class,
+			a single byte is returned in chr.
+		*/
+		bool parse_escape(byte_set& set, bool& is_class, unsigned char& chr)
+		{
+			if (at_end())
+			{
+				return fail("trailing \\");
+			}
+			is_class = true;
+			const auto escaped = pattern_[position_++];
+			switch (escaped)
+			{
+			case 'd': set = digits(); return true;
+			case 'D': set = ~digits(); return true;
+			case 'w': set = word_bytes(); return true;
+			case 'W': set = ~word_bytes(); return true;
+			case 's': set = spaces(); return true;
+			case 'S': set = ~spaces(); return true;
+			case 'b':
+			case 'B': return fail("word boundaries are not supported");
+			default: break;
+			}
+
+			is_class = false;
+			switch (escaped)
+			{
+			case 'n': chr = '\n'; break;
+			case 't': chr = '\t'; break;
+			case 'r': chr = '\r'; break;
+			case 'f': chr = '\f'; break;
+			case 'v': chr = '\v'; break;
+			case '0': chr = '\0'; break;
+			case 'x':
+				if (position_ + 2 > pattern_.size() || hex_value(pattern_[position_]) < 0 || hex_value(pattern_[position_ + 1]) < 0)
+				{
+					return fail("\\x needs two hex digits");
+				}
+				chr = static_cast<unsigned char>(hex_value(pattern_[position_]) << 4 | hex_value(pattern_[position_ + 1]));
+				position_ += 2;
+				break;
+			default:
+				if ((escaped >= 'a' && escaped <= 'z') || (escaped >= 'A' && escaped <= 'Z') || (escaped >= '0' && escaped <= '9'))
+				{
+					return fail(std::string("unknown escape \\") + escaped);
+				}
+				chr = static_cast<unsigned char>(escaped); // \. \/ \\ \( ...
+				break;
+			}
+			return true;
+		}
+
+		// [...] after '['
+		bool parse_class(byte_set& set)
+		{
+			auto negate = false;
+			if (!at_end() && pattern_[position_] == '^')
+			{
+				negate = true;
+				position_++;
+			}
+			for (auto first = true; ; first = false)
+			{
+				if (at_end())
+				{
+					return fail("missing ]");
+				}
+				if (pattern_[position_] == ']' && !first)
+				{
+					position_++;
+					break;
+				}
+
+				auto low = static_cast<unsigned char>(pattern_[position_++]);
+				if (low == '\\')
+				{
+					byte_set escaped{};
+					auto is_class = false;
+					if (!parse_escape(escaped, is_class, low))
+					{
+						return false;
+					}
+					if (is_class)
+					{
+						set |= escaped;
+						continue;
+					}
+				}
+
+				// range a-b, a '-' before ']' is literal
+				if (position_ + 1 < pattern_.size() && pattern_[position_] == '-' && pattern_[position_ + 1] != ']')
+				{
+					position_++;
+					auto high = static_cast<unsigned char>(pattern_[position_++]);
+					if (high == '\\')
+					{
+						byte_set escaped{};
+						auto is_class = false;
+						if (!parse_escape(escaped, is_class, high))
+						{
+							return false;
+						}
+						if (is_class)
+						{
+							return fail("class escape as the end of a range");
+						}
+					}
+					if (high < low)
+					{
+						return fail("reversed range");
+					}
+					for (auto byte = static_cast<unsigned>(low); byte <= high; byte++)
+					{
+						set.set(byte);
+					}
+					continue;
+				}
+				set.set(low);
+			}
+			if (case_insensitive_)
+			{
+				fold_case(set);
+			}
+			if (negate)
+			{
+				set.flip();
+			}
+			return true;
+		}
+
+		static void fold_case(byte_set& set)
+		{
+			for (auto chr = 'a'; chr <= 'z'; chr++)
+			{
+				const auto upper = static_cast<unsigned char>(chr - 'a' + 'A');
+				if (set[static_cast<unsigned char>(chr)] || set[upper])
+				{
+					set.set(static_cast<unsigned char>(chr));
+					set.set(upper);
+				}
+			}
+		}
+
+		std::unique_ptr<node> make_bytes(const byte_set& set) const
+		{
+			std::unique_ptr<node> result{new node{}};
+			result->kind = node::type::bytes;
+			result->set = set;
+			if (case_insensitive_)
+			{
+				fold_case(result->set);
+			}
+			return result;
+		}
+
+		std::unique_ptr<node> parse_atom()
+		{
+			const auto chr = pattern_[position_++];
+			switch (chr)
+			{
+			case '(':
+			{
+				if (pattern_.compare(position_, 2, "?:") == 0)
+				{
+					position_ += 2;
+				}
+				else if (!at_end() && pattern_[position_] == '?')
+				{
+					fail("unsupported group");
+					return nullptr;
+				}
+				auto inner = parse_alternate();
+				if (inner == nullptr)
+				{
+					return nullptr;
+				}
+				if (at_end() || pattern_[position_] != ')')
+				{
+					fail("missing )");
+					return nullptr;
+				}
+				position_++;
+				return inner;
+			}
+			case '[':
+			{
+				byte_set set{};
+				return parse_class(set) ? make_bytes(set) : nullptr;
+			}
+			case '.':
+			{
+				byte_set set{};
+				set.set();
+				set.reset('\n');
+				return make_bytes(set);
+			}
+			case '^':
+			case '$':
+			{
+				std::unique_ptr<node> result{new node{}};
+				result->kind = chr == '^' ? node::type::begin : node::type::end;
+				return result;
+			}
+			case '\\':
+			{
+				byte_set set{};
+				auto is_class = false;
+				unsigned char escaped = 0;
+				if (!parse_escape(set, is_class, escaped))
+				{
+					return nullptr;
+				}
+				if (!is_class)
+				{
+					set.set(escaped);
+				}
+				return make_bytes(set);
+			}
+			case '*':
+			case '+':
+			case '?':
+				position_--;
+				fail("nothing to repeat");
+				return nullptr;
+			default:
+			{
+				byte_set set{};
+				set.set(static_cast<unsigned char>(chr));
+				return make_bytes(set);
+			}
+			}
+		}
+
+		// {m}, {m,}, {m,n} after '{'; false (position_ unchanged) if it isn't one, then '{' is a literal
+		bool parse_bounds(int& min, int& max)
+		{
+			auto current = position_;
+			const auto parse_number = [&](int& value)
+			{
+				const auto begin = current;
+				value = 0;
+				while (current < pattern_.size() && pattern_[current] >= '0' && pattern_[current] <= '9' && value <= max_repeat)
+				{
+					value = value * 10 + (pattern_[current++] - '0');
+				}
+				return current != begin;
+			};
+
+			if (!parse_number(min))
+			{
+				return false;
+			}
+			max = min;
+			if (current < pattern_.size() && pattern_[current] == ',')
+			{
+				current++;
+				if (!parse_number(max))
+				{
+					max = -1;
+				}
+			}
+			if (current >= pattern_.size() || pattern_[current] != '}')
+			{
+				return false;
+			}
+			position_ = current + 1;
+			return true;
+		}
+
+		std::unique_ptr<node> parse_repeat()
+		{
+			auto atom = parse_atom();
+			while (atom != nullptr && !at_end())
+			{
+				int min = 0;
+				int max = 0;
+				const auto chr = pattern_[position_];
+				if (chr == '*' || chr == '+' || chr == '?')
+				{
+					position_++;
+					min = chr == '+' ? 1 : 0;
+					max = chr == '?' ? 1 : -1;
+				}
+				else if (chr == '{')
+				{
+					position_++;
+					if (!parse_bounds(min, max))
+					{
+						position_--;
+						break;
+					}
+					if (min > max_repeat || max > max_repeat || (max != -1 && max < min))
+					{
+						fail("bad repetition count");
+						return nullptr;
+					}
+				}
+				else
+				{
+					break;
+				}
+				// lazy quantifiers match the same inputs
+				if (!at_end() && pattern_[position_] == '?')
+				{
+					position_++;
+				}
+
+				std::unique_ptr<node> repeat{new node{}};
+				repeat->kind = node::type::repeat;
+				repeat->min = min;
+				repeat->max = max;
+				repeat->children.push_back(std::move(atom));
+				atom = std::move(repeat);
+			}
+			return atom;
+		}
+
+		std::unique_ptr<node> parse_concat()
+		{
+			std::unique_ptr<node> concat{new node{}};
+			concat->kind = node::type::concat;
+			while (!at_end() && pattern_[position_] != '|' && pattern_[position_] != ')')
+			{
+				auto item = parse_repeat();
+				if (item == nullptr)
+				{
+					return nullptr;
+				}
+				concat->children.push_back(std::move(item));
+			}
+			return concat;
+		}
+
+		std::unique_ptr<node> parse_alternate()
+		{
+			std::unique_ptr<node> alternate{new node{}};
+			alternate->kind = node::type::alternate;
+			while (true)
+			{
+				auto branch = parse_concat();
+				if (branch == nullptr)
+				{
+					return nullptr;
+				}
+				alternate->children.push_back(std::move(branch));
+				if (at_end() || pattern_[position_] != '|')
+				{
+					break;
+				}
+				position_++;
+			}
+			return alternate->children.size() == 1 ? std::move(alternate->children.front()) : std::move(alternate);
+		}
+
+		/*
+			Literals of a node for the prefilter: exact is the one string it matches (is_exact),
+			required the longest string all of its matches contain.
+		*/
+		struct literal_info
+		{
+			bool is_exact = false;
+			std::string exact{};
+			std::string required{};
+		};
+
+		literal_info literals(const node& current) const
+		{
+			literal_info info{};
+			switch (current.kind)
+			{
+			case node::type::empty:
+			case node::type::begin:
+			case node::type::end:
+				info.is_exact = true;
+				break;
+			case node::type::bytes:
+			{
+				// one byte, or one letter in both cases when case-insensitive
+				const auto count = current.set.count();
+				for (size_t byte = 0; byte < 256 && !info.is_exact; byte++)
+				{
+					if (current.set[byte] && (count == 1 || (count == 2 && byte >= 'a' && byte <= 'z' && current.set[byte - 'a' + 'A'])))
+					{
+						info.is_exact = true;
+						info.exact = std::string(1, static_cast<char>(byte));
+					}
+				}
+				info.required = info.exact;
+				break;
+			}
+			case node::type::concat:
+			{
+				info.is_exact = true;
+				std::string run{};
+				for (const auto& child : current.children)
+				{
+					const auto child_info = literals(*child);
+					if (child_info.is_exact)
+					{
+						run += child_info.exact;
+						continue;
+					}
+					info.is_exact = false;
+					if (run.size() > info.required.size()) info.required = run;
+					if (child_info.required.size() > info.required.size()) info.required = child_info.required;
+					run.clear();
+				}
+				if (run.size() > info.required.size()) info.required = run;
+				if (info.is_exact) info.exact = run;
+				break;
+			}
+			case node::type::repeat:
+			{
+				const auto child_info = literals(*current.children.front());
+				if (current.min >= 1)
+				{
+					info.required = child_info.required;
+				}
+				if (child_info.is_exact && current.min == current.max && child_info.exact.size() * current.min <= 256)
+				{
+					info.is_exact = true;
+					for (auto i = 0; i < current.min; i++) info.exact += child_info.exact;
+					info.required = info.exact;
+				}
+				break;
+			}
+			case node::type::alternate:
+				break;
+			}
+			return info;
+		}
+
+		uint32_t emit(program& compiled, const op code, const uint32_t out = 0, const uint32_t out1 = 0, const uint32_t set = 0) const
+		{
+			compiled.instructions.push_back(instruction{code, out, out1, set});
+			return static_cast<uint32_t>(compiled.instructions.size() - 1);
+		}
+
+		// emits current so that it continues at the next instruction
+		bool compile(const node& current, program& compiled)
+		{
+			if (compiled.instructions.size() > max_instructions)
+			{
+				return fail("pattern too large");
+			}
+
+			auto next = [&compiled] { return static_cast<uint32_t>(compiled.instructions.size()); };
+			switch (current.kind)
+			{
+			case node::type::empty:
+				return true;
+			case node::type::begin:
+				emit(compiled, op::assert_begin, next() + 1);
+				return true;
+			case node::type::end:
+				emit(compiled, op::assert_end, next() + 1);
+				return true;
+			case node::type::bytes:
+				compiled.sets.push_back(current.set);
+				emit(compiled, op::byte, next() + 1, 0, static_cast<uint32_t>(compiled.sets.size() - 1));
+				return true;
+			case node::type::concat:
+				for (const auto& child : current.children)
+				{
+					if (!compile(*child, compiled))
+					{
+						return false;
+					}
+				}
+				return true;
+			case node::type::alternate:
+			{
+				// split to this branch or the next one, every branch jumps past the last
+				std::vector<uint32_t> jumps{};
+				for (size_t i = 0; i < current.children.size(); i++)
+				{
+					const auto is_last = i + 1 == current.children.size();
+					const auto split = is_last ? 0 : emit(compiled, op::split, next() + 1);
+					if (!compile(*current.children[i], compiled))
+					{
+						return false;
+					}
+					if (!is_last)
+					{
+						jumps.push_back(emit(compiled, op::jump));
+						compiled.instructions[split].out1 = next();
+					}
+				}
+				for (const auto jump : jumps)
+				{
+					compiled.instructions[jump].out = next();
+				}
+				return true;
+			}
+			case node::type::repeat:
+			{
+				const auto& child = *current.children.front();
+				for (auto i = 0; i < current.min; i++)
+				{
+					if (!compile(child, compiled))
+					{
+						return false;
+					}
+				}
+				if (current.max == -1)
+				{
+					// loop: split to the body or out, the body jumps back to the split
+					const auto split = emit(compiled, op::split, next() + 1);
+					if (!compile(child, compiled))
+					{
+						return false;
+					}
+					emit(compiled, op::jump, split);
+					compiled.instructions[split].out1 = next();
+					return true;
+				}
+				// up to max - min optional copies, each one skipping to the end
+				std::vector<uint32_t> splits{};
+				for (auto i = current.min; i < current.max; i++)
+				{
+					splits.push_back(emit(compiled, op::split, next() + 1));
+					if (!compile(child, compiled))
+					{
+						return false;
+					}
+				}
+				for (const auto split : splits)
+				{
+					compiled.instructions[split].out1 = next();
+				}
+				return true;
+			}
+			}
+			return true;
+		}
+
+		// instructions reachable from threads without consuming a byte; assert_begin passes only at_begin
+		void closure(std::vector<uint32_t> stack, const bool at_begin, const bool at_end, std::vector<uint32_t>& result)
+		{
+			const auto& instructions = program_->instructions;
+			if (++visit_mark_ == 0)
+			{
+				std::fill(visited_.begin(), visited_.end(), 0);
+				visit_mark_ = 1;
+			}
+			result.clear();
+			while (!stack.empty())
+			{
+				const auto pc = stack.back();
+				stack.pop_back();
+				if (visited_[pc] == visit_mark_)
+				{
+					continue;
+				}
+				visited_[pc] = visit_mark_;
+
+				const auto& current = instructions[pc];
+				switch (current.code)
+				{
+				case op::byte:
+				case op::match:
+					result.push_back(pc);
+					break;
+				case op::split:
+					stack.push_back(current.out1);
+					stack.push_back(current.out);
+					break;
+				case op::jump:
+					stack.push_back(current.out);
+					break;
+				case op::assert_begin:
+					if (at_begin)
+					{
+						stack.push_back(current.out);
+					}
+					break;
+				case op::assert_end:
+					if (at_end)
+					{
+						stack.push_back(current.out);
+					}
+					else
+					{
+						result.push_back(pc); // pending, passes once the input ends
+					}
+					break;
+				}
+			}
+			std::sort(result.begin(), result.end());
+		}
+
+		int32_t intern(std::vector<uint32_t> threads)
+		{
+			const auto found = state_ids_.find(threads);
+			if (found != state_ids_.end())
+			{
+				return found->second;
+			}
+
+			if (states_.size() >= max_dfa_states)
+			{
+				// RE2 style: the cache is dropped and rebuilt, the search goes on from this state
+				flushes_++;
+				states_.clear();
+				transitions_.clear();
+				state_ids_.clear();
+			}
+			const auto is_match = std::any_of(threads.begin(), threads.end(), [this](const uint32_t pc)
+			{
+				return program_->instructions[pc].code == op::match;
+			});
+			const auto id = static_cast<int32_t>(states_.size());
+			state_ids_.emplace(threads, id);
+			states_.push_back(dfa_state{std::move(threads), is_match, -1});
+			transitions_.resize(transitions_.size() + 256, -1);
+			return id;
+		}
+
+		int32_t step(const int32_t state, const unsigned char byte)
+		{
+			const auto cached = transitions_[state * 256 + byte];
+			if (cached != -1)
+			{
+				return cached;
+			}
+
+			std::vector<uint32_t> targets{};
+			for (const auto pc : states_[state].threads)
+			{
+				const auto& current = program_->instructions[pc];
+				if (current.code == op::byte && program_->sets[current.set][byte])
+				{
+					targets.push_back(current.out);
+				}
+			}
+			std::vector<uint32_t> threads{};
+			closure(std::move(targets), false, false, threads);
+			threads.insert(threads.end(), unanchored_threads_.begin(), unanchored_threads_.end());
+			std::sort(threads.begin(), threads.end());
+			threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+
+			const auto flushes = flushes_;
+			const auto next = intern(std::move(threads));
+			if (flushes == flushes_)
+			{
+				transitions_[state * 256 + byte] = next;
+			}
+			return next;
+		}
+
+		bool matches_at_end(const int32_t state, const bool at_begin)
+		{
+			auto& current = states_[state];
+			if (current.matches_at_end == -1 || at_begin)
+			{
+				std::vector<uint32_t> threads{};
+				closure(current.threads, at_begin, true, threads);
+				const auto result = std::any_of(threads.begin(), threads.end(), [this](const uint32_t pc)
+				{
+					return program_->instructions[pc].code == op::match;
+				});
+				if (at_begin)
+				{
+					return result;
+				}
+				current.matches_at_end = result ? 1 : 0;
+			}
+			return current.matches_at_end == 1;
+		}
+
+	public:
+		regex() = default;
+
+		explicit regex(const std::string& pattern, const bool case_insensitive = false)
+			: case_insensitive_(case_insensitive), pattern_(pattern)
+		{
+			auto root = parse_alternate();
+			if (root != nullptr && !at_end())
+			{
+				fail("unmatched )");
+			}
+			if (!error_.empty() || root == nullptr)
+			{
+				return;
+			}
+
+			auto compiled = std::make_shared<program>();
+			if (!compile(*root, *compiled))
+			{
+				return;
+			}
+			emit(*compiled, op::match);
+			program_ = compiled;
+			required_ = literals(*root).required;
+			visited_.assign(program_->instructions.size(), 0);
+
+			std::vector<uint32_t> threads{};
+			closure({0}, false, false, threads);
+			unanchored_threads_ = threads;
+		}
+
+		bool is_valid() const
+		{
+			return program_ != nullptr;
+		}
+
+		const std::string& error() const
+		{
+			return error_;
+		}
+
+		// longest literal every match contains, "" if there is none
+		const std::string& required_literal() const
+		{
+			return required_;
+		}
+
+		bool is_case_insensitive() const
+		{
+			return case_insensitive_;
+		}
+
+		// true if the pattern matches somewhere in text
+		bool search(const std::string_view text)
+		{
+			if (!is_valid())
+			{
+				return false;
+			}
+
+			std::vector<uint32_t> threads{};
+			closure({0}, true, text.empty(), threads);
+			auto state = intern(threads);
+			if (states_[state].is_match)
+			{
+				return true;
+			}
+			if (text.empty())
+			{
+				return matches_at_end(state, true);
+			}
+
+			for (const auto chr : text)
+			{
+				state = step(state, static_cast<unsigned char>(chr));
+				if (states_[state].is_match)
+				{
+					return true;
+				}
+			}
+			return matches_at_end(state, false);
+		}
+
+		// class regex
+	};
+
+	/*
+		What str / find_class / find_method look for: "/pattern/" or "/pattern/i" is a regex,
+		anything else a case-insensitive substring. Copies are independent (one per worker).
+	*/
+	class text_query
+	{
+		std::string substring_{};
+		std::string literal_{}; // substring_, or the regex's required literal
+		bool literal_case_insensitive_ = true;
+		std::shared_ptr<regex> regex_{};
+
+		static char fold(const char chr)
+		{
+			return chr >= 'A' && chr <= 'Z' ? static_cast<char>(chr | 0x20) : chr;
+		}
+
+		bool contains_literal(const std::string_view text) const
+		{
+			if (literal_.empty())
+			{
+				return true;
+			}
+			if (!literal_case_insensitive_)
+			{
+				return text.find(literal_) != std::string_view::npos;
+			}
+			// literal_ is lower case: candidates are the positions of its first byte, in either case
+			const auto first = literal_[0];
+			for (size_t i = 0; i + literal_.size() <= text.size(); i++)
+			{
+				if (fold(text[i]) == first &&
+					std::equal(literal_.begin() + 1, literal_.end(), text.begin() + i + 1, [](const char a, const char b) { return a == fold(b); }))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+	public:
+		explicit text_query(const std::string& query)
+		{
+			const auto last_slash = query.rfind('/');
+			const auto flags = last_slash == std::string::npos ? std::string{} : query.substr(last_slash + 1);
+			if (query.size() >= 2 && query.front() == '/' && last_slash != 0 && (flags.empty() || flags == "i"))
+			{
+				regex_ = std::make_shared<regex>(query.substr(1, last_slash - 1), flags == "i");
+				literal_ = regex_->required_literal();
+				literal_case_insensitive_ = flags == "i";
+				if (literal_case_insensitive_)
+				{
+					std::transform(literal_.begin(), literal_.end(), literal_.begin(), fold);
+				}
+				return;
+			}
+			substring_ = query;
+			std::transform(query.begin(), query.end(), std::back_inserter(literal_), fold);
+		}
+
+		text_query(const text_query& other)
+			: substring_(other.substring_), literal_(other.literal_), literal_case_insensitive_(other.literal_case_insensitive_),
+			  regex_(other.regex_ != nullptr ? std::make_shared<regex>(*other.regex_) : nullptr)
+		{
+		}
+
+		text_query& operator=(const text_query&) = delete;
+
+		bool is_regex() const
+		{
+			return regex_ != nullptr;
+		}
+
+		bool is_valid() const
+		{
+			return regex_ == nullptr || regex_->is_valid();
+		}
+
+		std::string error() const
+		{
+			return regex_ != nullptr ? regex_->error() : std::string{};
+		}
+
+		// what every match contains (lower case if the query ignores case), "" if nothing is known
+		const std::string& required_literal() const
+		{
+			return literal_;
+		}
+
+		bool matches(const std::string_view text)
+		{
+			// the literal prefilter rejects most candidates before the DFA runs
+			if (!contains_literal(text))
+			{
+				return false;
+			}
+			return regex_ == nullptr || regex_->search(text);
+		}
+
+		// class text_query
+	};
+} // namespace utils
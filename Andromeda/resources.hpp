@@ -0,0 +1,427 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "AxmlParser/AxmlParser.h"
+
+namespace andromeda
+{
+	/*
+		resources.arsc, read in place from the APK mapping (or the inflated entry):
+			- string pools are decoded once by the AXML parser's string pool code
+			- values are not copied out, the index keeps one 16 byte record per resource ID,
+			  sorted for binary search; the default configuration wins over the others
+		https://android.googlesource.com/platform/frameworks/base/+/master/libs/androidfw/include/androidfw/ResourceTypes.h
+	*/
+	class resource_table
+	{
+		// ResChunk_header types
+		enum : uint16_t
+		{
+			chunk_string_pool = 0x0001,
+			chunk_table = 0x0002,
+			chunk_package = 0x0200,
+			chunk_type = 0x0201,
+		};
+
+		// Res_value data types
+		enum : uint8_t
+		{
+			value_reference = 0x01,
+			value_attribute = 0x02,
+			value_string = 0x03,
+			value_float = 0x04,
+			value_dimension = 0x05,
+			value_fraction = 0x06,
+			value_int_dec = 0x10,
+			value_int_hex = 0x11,
+			value_boolean = 0x12,
+			value_color_first = 0x1c,
+			value_color_last = 0x1f,
+		};
+
+		using string_pool = std::unique_ptr<void, void (*)(void*)>;
+
+		struct package
+		{
+			uint32_t id;
+			string_pool type_strings{nullptr, AxmlCloseStringPool};
+			string_pool key_strings{nullptr, AxmlCloseStringPool};
+		};
+
+		struct entry
+		{
+			uint32_t id;
+			uint32_t key;     // index in the key strings of the package
+			uint32_t data;    // Res_value data: string index, referenced ID, integer...
+			uint8_t type;     // Res_value data type, 0 for bags (styles, arrays, plurals...)
+			uint8_t package_index;
+			uint8_t is_default;
+			uint8_t is_bag;
+		};
+
+		std::shared_ptr<const void> owner_;
+		const unsigned char* data_ = nullptr;
+		size_t size_ = 0;
+
+		string_pool strings_{nullptr, AxmlCloseStringPool};
+		std::vector<package> packages_{};
+		std::vector<entry> entries_{};
+
+		// "@type/name" texts handed to the AXML parser, they have to stay alive while it runs
+		mutable std::unordered_map<uint32_t, std::string> reference_names_{};
+
+		uint16_t u16(const size_t offset) const
+		{
+			return offset + 2 <= size_ ? data_[offset] | data_[offset + 1] << 8 : 0;
+		}
+
+		uint32_t u32(const size_t offset) const
+		{
+			return offset + 4 <= size_ ? data_[offset] | data_[offset + 1] << 8 | data_[offset + 2] << 16 | uint32_t{data_[offset + 3]} << 24 : 0;
+		}
+
+		static std::string pool_string(void* pool, const uint32_t index)
+		{
+			if (pool == nullptr)
+			{
+				return {};
+			}
+			size_t length = 0;
+			const auto text = AxmlGetPoolString(pool, index, &length);
+			return std::string(text, length);
+		}
+
+		void parse_entry(const size_t offset, const size_t end, const uint32_t id, const uint8_t package_index, const bool is_default)
+		{
+			if (offset + 8 > end)
+			{
+				return;
+			}
+
+			entry current{id, 0, 0, 0, package_index, is_default, 0};
+			const auto size = u16(offset);
+			const auto flags = u16(offset + 2);
+			if (flags & 0x8)
+			{
+				// compact entry: key in the size field, data type in the high byte of the flags
+				current.key = size;
+				current.type = static_cast<uint8_t>(flags >> 8);
+				current.data = u32(offset + 4);
+			}
+			else
+			{
+				current.key = u32(offset + 4);
+				if (flags & 0x1)
+				{
+					current.is_bag = 1;
+				}
+				else if (offset + size + 8 <= end)
+				{
+					current.type = data_[offset + size + 3];
+					current.data = u32(offset + size + 4);
+				}
+				else
+				{
+					return;
+				}
+			}
+			entries_.push_back(current);
+		}
+
+		void parse_type(const size_t offset, const size_t size, const uint8_t package_index)
+		{
+			const auto header_size = u16(offset + 2);
+			if (header_size < 28 || header_size > size)
+			{
+				return;
+			}
+
+			const auto type_id = data_[offset + 8];
+			const auto flags = data_[offset + 9];
+			const auto entry_count = u32(offset + 12);
+			const auto entries_start = u32(offset + 16);
+			const auto end = offset + size;
+
+			// ResTable_config: everything after its size field is zero for the default configuration
+			const auto config_size = std::min<size_t>(u32(offset + 20), header_size - 20);
+			auto is_default = true;
+			for (size_t i = 4; i < config_size && is_default; i++)
+			{
+				is_default = data_[offset + 20 + i] == 0;
+			}
+
+			const auto is_sparse = (flags & 0x01) != 0;
+			const auto is_offset16 = (flags & 0x02) != 0;
+			const size_t offset_size = is_sparse ? 4 : is_offset16 ? 2 : 4;
+			if (entries_start > size || entry_count > (entries_start - std::min<size_t>(header_size, entries_start)) / offset_size)
+			{
+				return;
+			}
+
+			const auto id_base = uint32_t{packages_[package_index].id} << 24 | uint32_t{type_id} << 16;
+			for (uint32_t i = 0; i < entry_count; i++)
+			{
+				const auto position = offset + header_size + i * offset_size;
+				uint32_t index = i;
+				size_t entry_offset = 0;
+				if (is_sparse)
+				{
+					index = u16(position);
+					entry_offset = size_t{u16(position + 2)} * 4;
+				}
+				else if (is_offset16)
+				{
+					const auto value = u16(position);
+					if (value == 0xffff)
+					{
+						continue;
+					}
+					entry_offset = size_t{value} * 4;
+				}
+				else
+				{
+					const auto value = u32(position);
+					if (value == 0xffffffff)
+					{
+						continue;
+					}
+					entry_offset = value;
+				}
+
+				parse_entry(offset + entries_start + entry_offset, end, id_base | index, package_index, is_default);
+			}
+		}
+
+		void parse_package(const size_t offset, const size_t size)
+		{
+			// header, id, name[128] (UTF-16), typeStrings, lastPublicType, keyStrings, lastPublicKey, ...
+			const auto header_size = u16(offset + 2);
+			if (header_size < 284 || header_size > size || packages_.size() == 0xff)
+			{
+				return;
+			}
+
+			package current{u32(offset + 8)};
+			const auto type_strings = u32(offset + 268);
+			const auto key_strings = u32(offset + 276);
+			if (type_strings >= header_size && type_strings < size)
+			{
+				current.type_strings.reset(AxmlOpenStringPool(reinterpret_cast<const char*>(data_ + offset + type_strings), size - type_strings));
+			}
+			if (key_strings >= header_size && key_strings < size)
+			{
+				current.key_strings.reset(AxmlOpenStringPool(reinterpret_cast<const char*>(data_ + offset + key_strings), size - key_strings));
+			}
+			packages_.emplace_back(std::move(current));
+			const auto package_index = static_cast<uint8_t>(packages_.size() - 1);
+
+			for (size_t chunk = offset + header_size; chunk + 8 <= offset + size;)
+			{
+				const auto chunk_size = u32(chunk + 4);
+				if (chunk_size < 8 || chunk_size > offset + size - chunk)
+				{
+					break;
+				}
+				if (u16(chunk) == chunk_type)
+				{
+					parse_type(chunk, chunk_size, package_index);
+				}
+				chunk += chunk_size;
+			}
+		}
+
+		const entry* find(const uint32_t id) const
+		{
+			const auto found = std::lower_bound(entries_.begin(), entries_.end(), id,
+			                                    [](const entry& current, const uint32_t value) { return current.id < value; });
+			return found != entries_.end() && found->id == id ? &*found : nullptr;
+		}
+
+	public:
+		// data has to stay valid as long as owner is alive (the APK mapping or the inflated entry)
+		resource_table(std::shared_ptr<const void> owner, const unsigned char* data, const size_t size)
+			: owner_(std::move(owner)), data_(data), size_(size)
+		{
+			if (data_ == nullptr || u16(0) != chunk_table)
+			{
+				return;
+			}
+
+			const auto end = std::min<size_t>(u32(4), size_);
+			for (size_t chunk = u16(2); chunk + 8 <= end;)
+			{
+				const auto chunk_size = u32(chunk + 4);
+				if (chunk_size < 8 || chunk_size > end - chunk)
+				{
+					break;
+				}
+
+				const auto type = u16(chunk);
+				if (type == chunk_string_pool && strings_ == nullptr)
+				{
+					strings_.reset(AxmlOpenStringPool(reinterpret_cast<const char*>(data_ + chunk), chunk_size));
+				}
+				else if (type == chunk_package)
+				{
+					parse_package(chunk, chunk_size);
+				}
+				chunk += chunk_size;
+			}
+
+			// one record per ID, the default configuration first
+			std::stable_sort(entries_.begin(), entries_.end(), [](const entry& left, const entry& right)
+			{
+				return left.id != right.id ? left.id < right.id : left.is_default > right.is_default;
+			});
+			entries_.erase(std::unique(entries_.begin(), entries_.end(), [](const entry& left, const entry& right)
+			{
+				return left.id == right.id;
+			}), entries_.end());
+			entries_.shrink_to_fit();
+		}
+
+		resource_table(const resource_table&) = delete;
+		resource_table& operator=(const resource_table&) = delete;
+
+		bool is_valid() const
+		{
+			return strings_ != nullptr && !packages_.empty();
+		}
+
+		size_t size() const
+		{
+			return entries_.size();
+		}
+
+		// "type/name", e.g. "string/app_name"; empty if the ID is unknown
+		std::string name(const uint32_t id) const
+		{
+			const auto found = find(id);
+			if (found == nullptr)
+			{
+				return {};
+			}
+			const auto& current = packages_[found->package_index];
+			return pool_string(current.type_strings.get(), (id >> 16 & 0xff) - 1) + '/' + pool_string(current.key_strings.get(), found->key);
+		}
+
+		// value of a resource in the default configuration, references are followed
+		std::string value(const uint32_t id, const int depth = 0) const
+		{
+			const auto found = find(id);
+			if (found == nullptr)
+			{
+				return {};
+			}
+			if (found->is_bag)
+			{
+				return '@' + name(id);
+			}
+
+			char text[64] = {};
+			const auto data = found->data;
+			switch (found->type)
+			{
+			case value_string:
+				return pool_string(strings_.get(), data);
+			case value_reference:
+				if (depth < 8 && find(data) != nullptr)
+				{
+					return value(data, depth + 1);
+				}
+				snprintf(text, sizeof(text), "@%08X", data);
+				break;
+			case value_attribute:
+				snprintf(text, sizeof(text), "?%08X", data);
+				break;
+			case value_float:
+			{
+				float number;
+				memcpy(&number, &data, sizeof(number));
+				snprintf(text, sizeof(text), "%g", number);
+				break;
+			}
+			case value_dimension:
+			case value_fraction:
+			{
+				static const float radix[] = {0.00390625f, 3.051758E-005f, 1.192093E-007f, 4.656613E-010f};
+				static const char* dimensions[] = {"px", "dip", "sp", "pt", "in", "mm", "", ""};
+				static const char* fractions[] = {"%", "%p", "", "", "", "", "", ""};
+				snprintf(text, sizeof(text), "%f%s", static_cast<float>(data & 0xffffff00) * radix[data >> 4 & 0x03],
+				         found->type == value_dimension ? dimensions[data & 0x07] : fractions[data & 0x07]);
+				break;
+			}
+			case value_int_hex:
+				snprintf(text, sizeof(text), "0x%08x", data);
+				break;
+			case value_boolean:
+				return data == 0 ? "false" : "true";
+			default:
+				if (found->type >= value_color_first && found->type <= value_color_last)
+				{
+					snprintf(text, sizeof(text), "#%08x", data);
+				}
+				else if (found->type >= value_int_dec)
+				{
+					snprintf(text, sizeof(text), "%d", static_cast<int32_t>(data));
+				}
+				break;
+			}
+			return text;
+		}
+
+		// AxmlResolver_t: references to the app's resources are shown as @type/name
+		static const char* resolve_reference(void* context, const uint32_t id)
+		{
+			const auto table = static_cast<const resource_table*>(context);
+			auto found = table->reference_names_.find(id);
+			if (found == table->reference_names_.end())
+			{
+				const auto resource_name = table->name(id);
+				if (resource_name.empty())
+				{
+					return nullptr;
+				}
+				found = table->reference_names_.emplace(id, '@' + resource_name).first;
+			}
+			return found->second.c_str();
+		}
+
+		// string resources (default configuration) for which is_match(std::string_view) is true: name, value
+		template <typename Predicate>
+		std::vector<std::pair<std::string, std::string>> search_strings(Predicate is_match) const
+		{
+			std::vector<std::pair<std::string, std::string>> matches{};
+			if (strings_ == nullptr)
+			{
+				return matches;
+			}
+
+			for (const auto& current : entries_)
+			{
+				if (current.type != value_string || current.is_bag)
+				{
+					continue;
+				}
+
+				size_t length = 0;
+				const auto text = AxmlGetPoolString(strings_.get(), current.data, &length);
+				if (length != 0 && is_match(std::string_view(text, length)))
+				{
+					matches.emplace_back(name(current.id), std::string(text, length));
+				}
+			}
+			return matches;
+		}
+
+		// class resource_table
+	};
+} // namespace andromeda
@@ -0,0 +1,405 @@
+#pragma once
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "APK.hpp"
+#include "utils.hpp"
+
+namespace andromeda
+{
+	/*
+		Messages over the daemon socket: 4 bytes of size (big endian), then the bytes.
+		A request is a command line, its reply is everything the command printed (colors included).
+		A request starting with '\t' asks for the Tab completions of the rest of the line, one per reply line.
+	*/
+	namespace message
+	{
+		// a request is a line typed at the prompt, bigger ones are dropped with the connection
+		constexpr uint32_t max_request_size = 1 << 20;
+
+		inline bool write_all(const int fd, const char* data, size_t size)
+		{
+			while (size != 0)
+			{
+				const auto written = write(fd, data, size);
+				if (written < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (written <= 0)
+				{
+					return false;
+				}
+				data += written;
+				size -= static_cast<size_t>(written);
+			}
+			return true;
+		}
+
+		inline bool read_all(const int fd, char* data, size_t size)
+		{
+			while (size != 0)
+			{
+				const auto count = read(fd, data, size);
+				if (count < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (count <= 0)
+				{
+					return false;
+				}
+				data += count;
+				size -= static_cast<size_t>(count);
+			}
+			return true;
+		}
+
+		inline bool send(const int fd, const std::string_view payload)
+		{
+			const auto size = static_cast<uint32_t>(payload.size());
+			const char header[4] = {static_cast<char>(size >> 24), static_cast<char>(size >> 16), static_cast<char>(size >> 8), static_cast<char>(size)};
+			return write_all(fd, header, sizeof(header)) && write_all(fd, payload.data(), payload.size());
+		}
+
+		// false when the peer is gone, or the message is bigger than max_size
+		inline bool receive(const int fd, std::string& payload, const uint32_t max_size = UINT32_MAX)
+		{
+			unsigned char header[4];
+			if (!read_all(fd, reinterpret_cast<char*>(header), sizeof(header)))
+			{
+				return false;
+			}
+			const auto size = static_cast<uint32_t>(header[0]) << 24 | static_cast<uint32_t>(header[1]) << 16 |
+				static_cast<uint32_t>(header[2]) << 8 | header[3];
+			if (size > max_size)
+			{
+				return false;
+			}
+			payload.resize(size);
+			return read_all(fd, &payload[0], size);
+		}
+
+		// false if path doesn't fit a socket address
+		inline bool make_address(const std::string& path, sockaddr_un& address)
+		{
+			memset(&address, 0, sizeof(address));
+			address.sun_family = AF_UNIX;
+			if (path.empty() || path.size() >= sizeof(address.sun_path))
+			{
+				return false;
+			}
+			memcpy(address.sun_path, path.c_str(), path.size());
+			return true;
+		}
+
+		// -1 if nothing listens on path
+		inline int connect_to(const std::string& path)
+		{
+			sockaddr_un address{};
+			if (!make_address(path, address))
+			{
+				return -1;
+			}
+			const auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (fd < 0)
+			{
+				return -1;
+			}
+			if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+			{
+				close(fd);
+				return -1;
+			}
+			return fd;
+		}
+	} // namespace message
+
+	/*
+		Daemon mode: the APKs stay loaded (and keep indexing in the background), clients send command lines over
+		a Unix domain socket and get back what the commands printed. Each connection is served by its own thread,
+		printing into its reply (color::output()).
+		Commands only reading what an APK has built (lists, searches, queries, manifest info) run concurrently,
+		the others (disassembly, resources, files, ...) build state on first use and run alone on their APK:
+		a reader-writer lock per APK.
+		'apks' lists the loaded APKs, 'use n' switches the APK the connection's commands run on (the first one at first).
+	*/
+	class server
+	{
+	public:
+		using command = std::function<void(apk&, const std::string&)>;
+		using completion = std::function<void(apk&, const std::string&, std::vector<std::string>&)>;
+		using read_only = std::function<bool(const std::string&)>;
+
+	private:
+		struct loaded_apk
+		{
+			std::string path;
+			std::unique_ptr<apk> value;
+			std::shared_mutex mutex{};
+		};
+
+		std::string socket_path_;
+		std::vector<std::unique_ptr<loaded_apk>> apks_{};
+		command execute_;
+		completion complete_;
+		read_only is_read_only_;
+
+		static std::string& bound_path()
+		{
+			static std::string path{};
+			return path;
+		}
+
+		static void on_signal(int)
+		{
+			unlink(bound_path().c_str());
+			_exit(0);
+		}
+
+		void dump_apks(const size_t current) const
+		{
+			for (size_t i = 0; i < apks_.size(); i++)
+			{
+				color::color_printf(i == current ? color::FG_LIGHT_GREEN : color::FG_GREEN, "%c %zu: ", i == current ? '*' : ' ', i);
+				color::out_printf("%s\n", apks_[i]->path.c_str());
+			}
+		}
+
+		// runs a request with color::output() going to the reply
+		std::string reply(const std::string& request, size_t& current)
+		{
+			char* buffer = nullptr;
+			size_t size = 0;
+			const auto out_file = open_memstream(&buffer, &size);
+			if (out_file == nullptr)
+			{
+				return "Failed to allocate the reply\n";
+			}
+			color::output() = out_file;
+
+			auto& loaded = *apks_[current];
+			if (!request.empty() && request[0] == '\t')
+			{
+				std::vector<std::string> completions{};
+				{
+					std::shared_lock<std::shared_mutex> lock(loaded.mutex);
+					complete_(*loaded.value, request.substr(1), completions);
+				}
+				for (const auto& line : completions)
+				{
+					color::out_printf("%s\n", line.c_str());
+				}
+			}
+			else if (request == "apks")
+			{
+				dump_apks(current);
+			}
+			else if (utils::starts_with(request, "use "))
+			{
+				const auto [_, index] = utils::split(request, ' ');
+				char* end = nullptr;
+				const auto selected = strtoul(index.c_str(), &end, 10);
+				if (index.empty() || *end != '\0' || selected >= apks_.size())
+				{
+					color::color_printf(color::FG_LIGHT_RED, "Invalid APK index: %s\n", index.c_str());
+				}
+				else
+				{
+					current = selected;
+					dump_apks(current);
+				}
+			}
+			else if (is_read_only_(request))
+			{
+				std::shared_lock<std::shared_mutex> lock(loaded.mutex);
+				execute_(*loaded.value, request);
+			}
+			else
+			{
+				std::unique_lock<std::shared_mutex> lock(loaded.mutex);
+				execute_(*loaded.value, request);
+			}
+
+			color::output() = stdout;
+			fclose(out_file);
+			std::string result(buffer, size);
+			free(buffer);
+			return result;
+		}
+
+		void serve(const int fd)
+		{
+			size_t current = 0;
+			std::string request{};
+			while (message::receive(fd, request, message::max_request_size))
+			{
+				if (!message::send(fd, reply(request, current)))
+				{
+					break;
+				}
+			}
+			close(fd);
+		}
+
+	public:
+		server(std::string socket_path, command execute, completion complete, read_only is_read_only)
+			: socket_path_(std::move(socket_path)), execute_(std::move(execute)), complete_(std::move(complete)),
+			  is_read_only_(std::move(is_read_only))
+		{
+		}
+
+		server(const server&) = delete;
+		server& operator=(const server&) = delete;
+
+		// false if the APK can't be parsed
+		bool load(const std::string& path)
+		{
+			auto loaded = std::make_unique<loaded_apk>();
+			loaded->path = path;
+			loaded->value = std::make_unique<apk>(path);
+			if (!loaded->value->is_valid)
+			{
+				return false;
+			}
+			apks_.push_back(std::move(loaded));
+			return true;
+		}
+
+		/*
+			Listens on the socket and serves clients until SIGINT/SIGTERM, which remove the socket file.
+			A socket file nobody listens on (a daemon that was killed) is replaced. Returns false if it can't listen.
+		*/
+		bool run()
+		{
+			sockaddr_un address{};
+			if (apks_.empty() || !message::make_address(socket_path_, address))
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Invalid socket path: %s\n", socket_path_.c_str());
+				return false;
+			}
+			const auto running = message::connect_to(socket_path_);
+			if (running >= 0)
+			{
+				close(running);
+				color::color_printf(color::FG_LIGHT_RED, "A daemon already listens on %s\n", socket_path_.c_str());
+				return false;
+			}
+			unlink(socket_path_.c_str());
+
+			const auto listener = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (listener < 0 || bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0)
+			{
+				color::color_printf(color::FG_LIGHT_RED, "Failed to listen on %s: %s\n", socket_path_.c_str(), strerror(errno));
+				if (listener >= 0)
+				{
+					close(listener);
+				}
+				return false;
+			}
+
+			// clients going away mid-reply are write errors, not signals
+			signal(SIGPIPE, SIG_IGN);
+			bound_path() = socket_path_;
+			signal(SIGINT, on_signal);
+			signal(SIGTERM, on_signal);
+
+			color::color_printf(color::FG_LIGHT_GREEN, "Serving %zu APK(s) on %s\n", apks_.size(), socket_path_.c_str());
+			dump_apks(0);
+			fflush(stdout);
+
+			while (true)
+			{
+				const auto fd = accept(listener, nullptr, nullptr);
+				if (fd < 0)
+				{
+					if (errno == EINTR || errno == ECONNABORTED)
+					{
+						continue;
+					}
+					color::color_printf(color::FG_LIGHT_RED, "accept failed: %s\n", strerror(errno));
+					close(listener);
+					return false;
+				}
+				std::thread([this, fd] { serve(fd); }).detach();
+			}
+		}
+
+		// class server
+	};
+
+	/*
+		Client of a daemon: request() sends a command line and returns what it printed,
+		complete() the Tab completions the daemon gives for a line.
+	*/
+	class client
+	{
+		int fd_ = -1;
+
+	public:
+		explicit client(const std::string& socket_path) : fd_(message::connect_to(socket_path))
+		{
+			signal(SIGPIPE, SIG_IGN);
+		}
+
+		~client()
+		{
+			if (fd_ >= 0)
+			{
+				close(fd_);
+			}
+		}
+
+		client(const client&) = delete;
+		client& operator=(const client&) = delete;
+
+		bool is_connected() const
+		{
+			return fd_ >= 0;
+		}
+
+		// false if the daemon is gone
+		bool request(const std::string& line, std::string& reply)
+		{
+			if (fd_ < 0 || !message::send(fd_, line) || !message::receive(fd_, reply))
+			{
+				close(fd_);
+				fd_ = -1;
+				return false;
+			}
+			return true;
+		}
+
+		void complete(const std::string& line, std::vector<std::string>& completions)
+		{
+			std::string reply{};
+			if (!request('\t' + line, reply))
+			{
+				return;
+			}
+			std::istringstream lines(reply);
+			for (std::string completion; std::getline(lines, completion);)
+			{
+				completions.push_back(completion);
+			}
+		}
+
+		// class client
+	};
+} // namespace andromeda
@@ -0,0 +1,621 @@
+#pragma once
+
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
+#include "digestpp/digestpp.hpp"
+
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+namespace andromeda
+{
+	// bytes inside the mapped APK, nothing is copied out of it
+	struct byte_span
+	{
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+	};
+
+	// little endian reader over a byte_span, any read past the end clears is_ok() and returns zeros
+	class byte_reader
+	{
+		const unsigned char* data_;
+		size_t left_;
+		bool is_ok_ = true;
+
+	public:
+		explicit byte_reader(const byte_span span) : data_(span.data), left_(span.size)
+		{
+		}
+
+		bool is_ok() const
+		{
+			return is_ok_;
+		}
+
+		bool empty() const
+		{
+			return left_ == 0 || !is_ok_;
+		}
+
+		byte_span bytes(const size_t size)
+		{
+			if (!is_ok_ || size > left_)
+			{
+				is_ok_ = false;
+				return {};
+			}
+			const byte_span span{data_, size};
+			data_ += size;
+			left_ -= size;
+			return span;
+		}
+
+		uint32_t u32()
+		{
+			const auto span = bytes(4);
+			return span.data == nullptr ? 0 : span.data[0] | span.data[1] << 8 | span.data[2] << 16 | uint32_t{span.data[3]} << 24;
+		}
+
+		uint64_t u64()
+		{
+			const uint64_t low = u32();
+			return low | uint64_t{u32()} << 32;
+		}
+
+		// uint32 length followed by that many bytes
+		byte_span length_prefixed()
+		{
+			return bytes(u32());
+		}
+	};
+
+	/*
+		APK Signing Block (APK Signature Scheme v2/v3/v3.1), read from the mapped APK:
+		it sits right before the ZIP central directory, found through the end of central directory record.
+		The ID-value pairs are split and the signers of the v2/v3/v3.1 schemes parsed when the block is opened,
+		so signers() only reads and can be called from several threads.
+		https://source.android.com/docs/security/features/apksigning/v2
+	*/
+	class apk_signing_block
+	{
+	public:
+		enum : uint32_t
+		{
+			scheme_v2 = 0x7109871a,
+			scheme_v3 = 0xf05368c0,
+			scheme_v31 = 0x1b93ad61,
+		};
+
+		struct signer
+		{
+			byte_span signed_data{};
+			std::vector<std::pair<uint32_t, byte_span>> digests{}; // signature algorithm id, content digest
+			std::vector<byte_span> certificates{};                 // DER X.509, the first one is the signer's
+			std::vector<std::pair<uint32_t, byte_span>> signatures{}; // signature algorithm id, signature of signed_data
+			byte_span public_key{};                                // DER SubjectPublicKeyInfo
+			uint32_t min_sdk = 0;
+			uint32_t max_sdk = 0;
+		};
+
+		// result of checking one signer's digest against the APK contents, or one of its signatures
+		struct digest_check
+		{
+			size_t signer_index;
+			uint32_t algorithm;
+			bool is_supported;
+			bool is_matching;
+		};
+
+		struct signature_check
+		{
+			size_t signer_index;
+			uint32_t algorithm;
+			bool is_supported;
+			bool is_valid;
+		};
+
+		static constexpr size_t chunk_size = 1 << 20;
+
+	private:
+		const unsigned char* data_ = nullptr;
+		size_t size_ = 0;
+		bool is_present_ = false;
+
+		uint64_t block_offset_ = 0;
+		uint64_t block_size_ = 0;
+		uint64_t cd_offset_ = 0;
+		uint64_t eocd_offset_ = 0;
+
+		std::vector<std::pair<uint32_t, byte_span>> pairs_{};
+		std::map<uint32_t, std::vector<signer>> signers_{};
+		std::map<size_t, std::vector<unsigned char>> content_digests_{}; // digest size in bits -> content digest
+
+		static uint32_t read_u32(const unsigned char* p)
+		{
+			return p[0] | p[1] << 8 | p[2] << 16 | uint32_t{p[3]} << 24;
+		}
+
+		// end of central directory record, scanned backwards over the maximal comment length
+		bool find_eocd()
+		{
+			constexpr size_t eocd_size = 22;
+			if (size_ < eocd_size)
+			{
+				return false;
+			}
+
+			const auto lowest = size_ - eocd_size > 0xffff ? size_ - eocd_size - 0xffff : 0;
+			for (auto offset = size_ - eocd_size + 1; offset-- > lowest;)
+			{
+				if (read_u32(data_ + offset) == 0x06054b50 &&
+					offset + eocd_size + (data_[offset + 20] | data_[offset + 21] << 8) == size_)
+				{
+					eocd_offset_ = offset;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		std::vector<signer> parse_signers(const byte_span value, const uint32_t scheme) const
+		{
+			std::vector<signer> signers{};
+			byte_reader signers_reader(value);
+			byte_reader sequence(signers_reader.length_prefixed());
+			while (!sequence.empty())
+			{
+				byte_reader signer_reader(sequence.length_prefixed());
+				signer current{};
+
+				current.signed_data = signer_reader.length_prefixed();
+				if (scheme != scheme_v2)
+				{
+					current.min_sdk = signer_reader.u32();
+					current.max_sdk = signer_reader.u32();
+				}
+
+				// a truncated record rejects the signer (and the ones after it), nothing is made up from zeros
+				auto is_complete = true;
+				byte_reader signatures(signer_reader.length_prefixed());
+				while (is_complete && !signatures.empty())
+				{
+					byte_reader signature(signatures.length_prefixed());
+					const auto algorithm = signature.u32();
+					const auto value = signature.length_prefixed();
+					is_complete = signatures.is_ok() && signature.is_ok();
+					if (is_complete)
+					{
+						current.signatures.emplace_back(algorithm, value);
+					}
+				}
+				current.public_key = signer_reader.length_prefixed();
+
+				byte_reader signed_data(current.signed_data);
+				byte_reader digests(signed_data.length_prefixed());
+				while (is_complete && !digests.empty())
+				{
+					byte_reader digest(digests.length_prefixed());
+					const auto algorithm = digest.u32();
+					const auto value = digest.length_prefixed();
+					is_complete = digests.is_ok() && digest.is_ok();
+					if (is_complete)
+					{
+						current.digests.emplace_back(algorithm, value);
+					}
+				}
+				byte_reader certificates(signed_data.length_prefixed());
+				while (is_complete && !certificates.empty())
+				{
+					const auto certificate = certificates.length_prefixed();
+					is_complete = certificates.is_ok();
+					if (is_complete)
+					{
+						current.certificates.emplace_back(certificate);
+					}
+				}
+
+				if (!is_complete || !signer_reader.is_ok() || !signed_data.is_ok())
+				{
+					break;
+				}
+				signers.emplace_back(current);
+			}
+
+			return signers;
+		}
+
+		/*
+			Content digest: the ZIP entries, the central directory and the EOCD (with its central directory
+			offset pointing at the signing block) are cut into 1 MB chunks; every chunk is digested
+			as 0xa5 | uint32 size | chunk, then 0x5a | uint32 count | chunk digests gives the result.
+			Chunks are independent, they are spread over the thread pool and each one goes through
+			all the requested hashers (SHA-256 and/or SHA-512) while it is in the cache.
+		*/
+		void compute_content_digests(const std::set<size_t>& digest_bits)
+		{
+			const auto need_sha256 = digest_bits.count(256) != 0;
+			const auto need_sha512 = digest_bits.count(512) != 0;
+			if (!need_sha256 && !need_sha512)
+			{
+				return;
+			}
+
+			auto eocd = std::vector<unsigned char>(data_ + eocd_offset_, data_ + size_);
+			for (auto i = 0; i < 4; i++)
+			{
+				eocd[16 + i] = static_cast<unsigned char>(block_offset_ >> (8 * i));
+			}
+
+			std::vector<byte_span> chunks{};
+			const byte_span sections[] = {
+				{data_, block_offset_},
+				{data_ + cd_offset_, eocd_offset_ - cd_offset_},
+				{eocd.data(), eocd.size()},
+			};
+			for (const auto& section : sections)
+			{
+				for (size_t offset = 0; offset < section.size; offset += chunk_size)
+				{
+					chunks.push_back(byte_span{section.data + offset, std::min(chunk_size, section.size - offset)});
+				}
+			}
+
+			const auto write_prefix = [](unsigned char (&prefix)[5], const unsigned char marker, const size_t value)
+			{
+				prefix[0] = marker;
+				for (auto i = 0; i < 4; i++)
+				{
+					prefix[1 + i] = static_cast<unsigned char>(value >> (8 * i));
+				}
+			};
+
+			std::vector<unsigned char> sha256_chunks(need_sha256 ? chunks.size() * 32 : 0);
+			std::vector<unsigned char> sha512_chunks(need_sha512 ? chunks.size() * 64 : 0);
+			utils::thread_pool::shared().parallel_for(chunks.size(), [&](size_t, const size_t item_index)
+			{
+				const auto& chunk = chunks[item_index];
+				unsigned char prefix[5];
+				write_prefix(prefix, 0xa5, chunk.size);
+				if (need_sha256)
+				{
+					digestpp::sha256().absorb(prefix, sizeof(prefix)).absorb(chunk.data, chunk.size)
+					                  .digest(&sha256_chunks[item_index * 32], 32);
+				}
+				if (need_sha512)
+				{
+					digestpp::sha512().absorb(prefix, sizeof(prefix)).absorb(chunk.data, chunk.size)
+					                  .digest(&sha512_chunks[item_index * 64], 64);
+				}
+			});
+
+			unsigned char prefix[5];
+			write_prefix(prefix, 0x5a, chunks.size());
+			if (need_sha256)
+			{
+				auto& digest = content_digests_[256];
+				digest.resize(32);
+				digestpp::sha256().absorb(prefix, sizeof(prefix)).absorb(sha256_chunks.data(), sha256_chunks.size())
+				                  .digest(digest.data(), digest.size());
+			}
+			if (need_sha512)
+			{
+				auto& digest = content_digests_[512];
+				digest.resize(64);
+				digestpp::sha512().absorb(prefix, sizeof(prefix)).absorb(sha512_chunks.data(), sha512_chunks.size())
+				                  .digest(digest.data(), digest.size());
+			}
+		}
+
+		// digest and padding used to check a signature of the signed data, false for unknown algorithms
+		static bool signature_parameters(const uint32_t algorithm, const EVP_MD*& md, bool& is_pss)
+		{
+			is_pss = algorithm == 0x0101 || algorithm == 0x0102;
+			switch (algorithm)
+			{
+			case 0x0101: case 0x0103: case 0x0201: case 0x0301:
+			case 0x0421: case 0x0423: case 0x0425:
+				md = EVP_sha256();
+				return true;
+			case 0x0102: case 0x0104: case 0x0202:
+				md = EVP_sha512();
+				return true;
+			default:
+				return false;
+			}
+		}
+
+	public:
+		apk_signing_block(const unsigned char* data, const size_t size) : data_(data), size_(size)
+		{
+			if (data_ == nullptr || !find_eocd())
+			{
+				return;
+			}
+
+			// the block ends with its size and the magic, right before the central directory
+			const auto cd_size = read_u32(data_ + eocd_offset_ + 12);
+			cd_offset_ = read_u32(data_ + eocd_offset_ + 16);
+			if (cd_offset_ + cd_size != eocd_offset_ || cd_offset_ < 24 ||
+				memcmp(data_ + cd_offset_ - 16, "APK Sig Block 42", 16) != 0)
+			{
+				return;
+			}
+
+			byte_reader footer(byte_span{data_ + cd_offset_ - 24, 8});
+			block_size_ = footer.u64();
+			if (block_size_ < 24 || block_size_ > cd_offset_ - 8)
+			{
+				return;
+			}
+			block_offset_ = cd_offset_ - block_size_ - 8;
+
+			byte_reader header(byte_span{data_ + block_offset_, 8});
+			if (header.u64() != block_size_)
+			{
+				return;
+			}
+
+			byte_reader pairs(byte_span{data_ + block_offset_ + 8, block_size_ - 24});
+			while (!pairs.empty())
+			{
+				const auto pair_size = pairs.u64();
+				if (pair_size < 4 || pair_size > SIZE_MAX)
+				{
+					break;
+				}
+				byte_reader pair(pairs.bytes(pair_size));
+				const auto id = pair.u32();
+				pairs_.emplace_back(id, pair.bytes(pair_size - 4));
+			}
+			is_present_ = true;
+
+			// parsed once here: the certificate task and the commands read the signers from different threads
+			for (const auto& [id, value] : pairs_)
+			{
+				if ((id == scheme_v2 || id == scheme_v3 || id == scheme_v31) && signers_.count(id) == 0)
+				{
+					signers_[id] = parse_signers(value, id);
+				}
+			}
+		}
+
+		bool is_present() const
+		{
+			return is_present_;
+		}
+
+		uint64_t offset() const
+		{
+			return block_offset_;
+		}
+
+		uint64_t size() const
+		{
+			return block_size_ + 8;
+		}
+
+		// ID-value pairs of the block: signature schemes, padding, source stamps...
+		const std::vector<std::pair<uint32_t, byte_span>>& pairs() const
+		{
+			return pairs_;
+		}
+
+		bool has_scheme(const uint32_t scheme) const
+		{
+			for (const auto& pair : pairs_)
+			{
+				if (pair.first == scheme)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// signers of a scheme block, none if the block has no such scheme
+		const std::vector<signer>& signers(const uint32_t scheme) const
+		{
+			static const std::vector<signer> none{};
+			const auto found = signers_.find(scheme);
+			return found != signers_.end() ? found->second : none;
+		}
+
+		static std::string scheme_name(const uint32_t scheme)
+		{
+			switch (scheme)
+			{
+			case scheme_v2: return "v2";
+			case scheme_v3: return "v3";
+			case scheme_v31: return "v3.1";
+			case 0x42726577: return "padding";
+			case 0x6dff800d: return "source stamp";
+			case 0x2146444e: return "Play metadata";
+			default:
+				char name[32];
+				snprintf(name, sizeof(name), "0x%08x", scheme);
+				return name;
+			}
+		}
+
+		static std::string algorithm_name(const uint32_t algorithm)
+		{
+			switch (algorithm)
+			{
+			case 0x0101: return "RSASSA-PSS with SHA2-256";
+			case 0x0102: return "RSASSA-PSS with SHA2-512";
+			case 0x0103: return "RSASSA-PKCS1-v1_5 with SHA2-256";
+			case 0x0104: return "RSASSA-PKCS1-v1_5 with SHA2-512";
+			case 0x0201: return "ECDSA with SHA2-256";
+			case 0x0202: return "ECDSA with SHA2-512";
+			case 0x0301: return "DSA with SHA2-256";
+			case 0x0421: return "RSASSA-PKCS1-v1_5 with SHA2-256 (verity)";
+			case 0x0423: return "ECDSA with SHA2-256 (verity)";
+			case 0x0425: return "DSA with SHA2-256 (verity)";
+			default:
+				char name[32];
+				snprintf(name, sizeof(name), "unknown 0x%04x", algorithm);
+				return name;
+			}
+		}
+
+		// chunk digest size in bits (256 or 512) of a signature algorithm, 0 for the unsupported verity ones
+		static size_t content_digest_bits(const uint32_t algorithm)
+		{
+			switch (algorithm)
+			{
+			case 0x0101: case 0x0103: case 0x0201: case 0x0301: return 256;
+			case 0x0102: case 0x0104: case 0x0202: return 512;
+			default: return 0;
+			}
+		}
+
+		// bytes covered by the content digests: everything but the signing block
+		uint64_t content_size() const
+		{
+			return is_present_ ? block_offset_ + (size_ - cd_offset_) : 0;
+		}
+
+		/*
+			Recomputes the content digests of the APK and compares them with the ones each signer signed.
+			The digests of every scheme in the block are computed in the same pass and kept,
+			so checking v2 and then v3 reads the APK once.
+		*/
+		std::vector<digest_check> verify_content_digests(const uint32_t scheme)
+		{
+			std::set<size_t> missing_bits{};
+			for (const auto& pair : pairs_)
+			{
+				for (const auto& current : signers(pair.first))
+				{
+					for (const auto& digest : current.digests)
+					{
+						const auto bits = content_digest_bits(digest.first);
+						if (bits != 0 && content_digests_.count(bits) == 0)
+						{
+							missing_bits.insert(bits);
+						}
+					}
+				}
+			}
+			compute_content_digests(missing_bits);
+
+			std::vector<digest_check> checks{};
+			const auto& scheme_signers = signers(scheme);
+			for (size_t i = 0; i < scheme_signers.size(); i++)
+			{
+				for (const auto& [algorithm, expected] : scheme_signers[i].digests)
+				{
+					const auto found = content_digests_.find(content_digest_bits(algorithm));
+					if (found == content_digests_.end())
+					{
+						checks.push_back(digest_check{i, algorithm, false, false});
+						continue;
+					}
+
+					const auto& digest = found->second;
+					checks.push_back(digest_check{i, algorithm, true, digest.size() == expected.size &&
+					                                                    memcmp(digest.data(), expected.data, expected.size) == 0});
+				}
+			}
+
+			return checks;
+		}
+
+		// checks every signature of the signed data against the signer's public key
+		std::vector<signature_check> verify_signatures(const uint32_t scheme)
+		{
+			std::vector<signature_check> checks{};
+			const auto& scheme_signers = signers(scheme);
+			for (size_t i = 0; i < scheme_signers.size(); i++)
+			{
+				const auto& current = scheme_signers[i];
+				auto key_data = current.public_key.data;
+				const auto public_key = d2i_PUBKEY(nullptr, &key_data, static_cast<long>(current.public_key.size));
+
+				for (const auto& [algorithm, signature] : current.signatures)
+				{
+					const EVP_MD* md = nullptr;
+					auto is_pss = false;
+					if (public_key == nullptr || !signature_parameters(algorithm, md, is_pss))
+					{
+						checks.push_back(signature_check{i, algorithm, false, false});
+						continue;
+					}
+
+					auto is_valid = false;
+					const auto context = EVP_MD_CTX_new();
+					EVP_PKEY_CTX* key_context = nullptr;
+					if (context != nullptr && EVP_DigestVerifyInit(context, &key_context, md, nullptr, public_key) == 1)
+					{
+						if (is_pss)
+						{
+							EVP_PKEY_CTX_set_rsa_padding(key_context, RSA_PKCS1_PSS_PADDING);
+							EVP_PKEY_CTX_set_rsa_pss_saltlen(key_context, EVP_MD_size(md));
+						}
+						is_valid = EVP_DigestVerify(context, signature.data, signature.size,
+						                            current.signed_data.data, current.signed_data.size) == 1;
+					}
+					EVP_MD_CTX_free(context);
+					checks.push_back(signature_check{i, algorithm, true, is_valid});
+				}
+
+				EVP_PKEY_free(public_key);
+			}
+
+			return checks;
+		}
+
+		// as apksigner: the signer signs with exactly the algorithms of the digests listed in its signed data
+		static bool has_matching_algorithms(const signer& current)
+		{
+			std::set<uint32_t> signature_algorithms{};
+			std::set<uint32_t> digest_algorithms{};
+			for (const auto& signature : current.signatures)
+			{
+				signature_algorithms.insert(signature.first);
+			}
+			for (const auto& digest : current.digests)
+			{
+				digest_algorithms.insert(digest.first);
+			}
+			return !signature_algorithms.empty() && signature_algorithms == digest_algorithms;
+		}
+
+		// the public key of a signer has to be the one of its first certificate
+		static bool is_public_key_certified(const signer& current)
+		{
+			if (current.certificates.empty())
+			{
+				return false;
+			}
+
+			auto der_data = current.certificates.front().data;
+			const auto x509 = d2i_X509(nullptr, &der_data, static_cast<long>(current.certificates.front().size));
+			if (x509 == nullptr)
+			{
+				return false;
+			}
+
+			auto is_matching = false;
+			unsigned char* key_der = nullptr;
+			const auto key_size = i2d_PUBKEY(X509_get0_pubkey(x509), &key_der);
+			if (key_size > 0)
+			{
+				is_matching = static_cast<size_t>(key_size) == current.public_key.size &&
+				              memcmp(key_der, current.public_key.data, key_size) == 0;
+				OPENSSL_free(key_der);
+			}
+			X509_free(x509);
+			return is_matching;
+		}
+
+		// class apk_signing_block
+	};
+} // namespace andromeda
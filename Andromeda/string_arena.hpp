@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace utils
+{
+	/*
+		Append-only pool of distinct strings: each one is stored once, in large blocks, and named by a dense 32-bit id.
+		Id 0 is "". Interning is thread safe; reading while another thread interns is not, owners intern everything first.
+	*/
+	class string_arena
+	{
+		static constexpr size_t block_size = 1 << 20;
+
+		std::vector<std::unique_ptr<char[]>> blocks_{};
+		size_t block_capacity_ = 0;
+		size_t block_used_ = 0;
+		size_t bytes_ = 0;
+
+		std::vector<std::string_view> strings_{}; // id -> text
+		// open addressing table of ids (0 is a free slot), at most half full: 8 to 16 bytes a string instead of a map node
+		std::vector<uint32_t> slots_{};
+		std::mutex mutex_{};
+
+		size_t find_slot(const std::string_view text) const
+		{
+			const auto mask = slots_.size() - 1;
+			auto slot = std::hash<std::string_view>{}(text) & mask;
+			while (slots_[slot] != 0 && strings_[slots_[slot]] != text)
+			{
+				slot = (slot + 1) & mask;
+			}
+			return slot;
+		}
+
+		void grow()
+		{
+			slots_.assign(slots_.empty() ? 1024 : slots_.size() * 2, 0);
+			for (uint32_t id = 1; id < strings_.size(); id++)
+			{
+				slots_[find_slot(strings_[id])] = id;
+			}
+		}
+
+		uint32_t intern_locked(const std::string_view text)
+		{
+			if (text.empty())
+			{
+				return 0;
+			}
+			auto slot = find_slot(text);
+			if (slots_[slot] != 0)
+			{
+				return slots_[slot];
+			}
+
+			if (text.size() > block_capacity_ - block_used_)
+			{
+				block_capacity_ = std::max(block_size, text.size());
+				blocks_.emplace_back(new char[block_capacity_]);
+				block_used_ = 0;
+			}
+			auto* data = blocks_.back().get() + block_used_;
+			memcpy(data, text.data(), text.size());
+			block_used_ += text.size();
+			bytes_ += text.size();
+
+			const auto id = static_cast<uint32_t>(strings_.size());
+			strings_.emplace_back(data, text.size());
+			if (strings_.size() * 2 > slots_.size())
+			{
+				grow();
+			}
+			else
+			{
+				slots_[slot] = id;
+			}
+			return id;
+		}
+
+	public:
+		string_arena()
+		{
+			strings_.emplace_back();
+			grow();
+		}
+
+		string_arena(const string_arena&) = delete;
+		string_arena& operator=(const string_arena&) = delete;
+
+		uint32_t intern(const std::string_view text)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return intern_locked(text);
+		}
+
+		// ids of all texts, under one lock
+		std::vector<uint32_t> intern(const std::vector<std::string_view>& texts)
+		{
+			std::vector<uint32_t> ids(texts.size());
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (size_t i = 0; i < texts.size(); i++)
+			{
+				ids[i] = intern_locked(texts[i]);
+			}
+			return ids;
+		}
+
+		// id of an interned text, 0 if it wasn't
+		uint32_t find(const std::string_view text) const
+		{
+			return text.empty() ? 0 : slots_[find_slot(text)];
+		}
+
+		std::string_view get(const uint32_t id) const
+		{
+			return strings_[id];
+		}
+
+		// number of ids: dictionaries indexed by id have this size
+		size_t size() const
+		{
+			return strings_.size();
+		}
+
+		// text bytes stored, each distinct string once
+		size_t bytes() const
+		{
+			return bytes_;
+		}
+
+		// class string_arena
+	};
+} // namespace utils
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utils
+{
+	/*
+		Tasks run one after another on a background thread, in the order they were added; a task's dependencies
+		are added before it. wait() runs a task that hasn't started yet on the calling thread (its dependencies first),
+		so whoever needs a result waits for it and what it depends on, never for the tasks queued before it.
+		Tasks can use the shared thread_pool for their own parallelism.
+		A task that throws (or whose dependency failed) is failed: wait() rethrows its error, to every caller.
+	*/
+	class task_graph
+	{
+	public:
+		enum class state
+		{
+			pending,
+			running,
+			done,
+			failed,
+		};
+
+		// what a task reports while it runs: done of total items
+		struct progress
+		{
+			std::atomic<size_t> done{0};
+			std::atomic<size_t> total{0};
+		};
+
+		// returns a short summary of what the task built, shown by status()
+		using work = std::function<std::string(progress&)>;
+
+		struct task_status
+		{
+			std::string name;
+			state value;
+			size_t done;
+			size_t total;
+			double elapsed_ms;
+			std::string summary;
+		};
+
+	private:
+		using clock = std::chrono::steady_clock;
+
+		struct task
+		{
+			std::string name;
+			std::vector<size_t> dependencies;
+			work run;
+			std::atomic<state> value{state::pending};
+			progress items{};
+			clock::time_point started{};
+			double elapsed_ms = 0;
+			std::string summary{};
+			std::exception_ptr error{};
+		};
+
+		std::vector<std::unique_ptr<task>> tasks_{};
+		mutable std::mutex mutex_{};
+		std::condition_variable done_cv_{};
+		std::thread runner_{};
+		std::atomic<bool> stop_{false};
+
+		static bool is_finished(const state value)
+		{
+			return value == state::done || value == state::failed;
+		}
+
+		static std::string describe(const std::exception_ptr& error)
+		{
+			try
+			{
+				std::rethrow_exception(error);
+			}
+			catch (const std::exception& exception)
+			{
+				return exception.what();
+			}
+			catch (...)
+			{
+				return "unknown error";
+			}
+		}
+
+		// never throws: the error of the task, or of a dependency, is kept for wait()
+		void run(const size_t index)
+		{
+			auto& current = *tasks_[index];
+			std::exception_ptr error{};
+			try
+			{
+				for (const auto dependency : current.dependencies)
+				{
+					wait(dependency);
+				}
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			auto expected = state::pending;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (!current.value.compare_exchange_strong(expected, state::running))
+				{
+					return;
+				}
+				current.started = clock::now();
+			}
+
+			std::string summary{};
+			if (error == nullptr)
+			{
+				try
+				{
+					summary = current.run(current.items);
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				current.elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - current.started).count();
+				current.summary = error == nullptr ? std::move(summary) : describe(error);
+				current.error = error;
+				current.value = error == nullptr ? state::done : state::failed;
+			}
+			done_cv_.notify_all();
+		}
+
+	public:
+		task_graph() = default;
+		task_graph(const task_graph&) = delete;
+		task_graph& operator=(const task_graph&) = delete;
+
+		// the running task is finished, the ones not started yet are dropped
+		~task_graph()
+		{
+			stop_ = true;
+			if (runner_.joinable())
+			{
+				runner_.join();
+			}
+		}
+
+		// before start(); dependencies are ids returned by add()
+		size_t add(std::string name, std::vector<size_t> dependencies, work run)
+		{
+			auto added = std::make_unique<task>();
+			added->name = std::move(name);
+			added->dependencies = std::move(dependencies);
+			added->run = std::move(run);
+			tasks_.push_back(std::move(added));
+			return tasks_.size() - 1;
+		}
+
+		void start()
+		{
+			runner_ = std::thread([this]
+			{
+				for (size_t i = 0; i < tasks_.size() && !stop_; i++)
+				{
+					run(i);
+				}
+			});
+		}
+
+		// blocks until the task is finished, runs it here if it hasn't started; rethrows the error of a failed task
+		void wait(const size_t index)
+		{
+			auto& current = *tasks_[index];
+			if (current.value != state::done)
+			{
+				run(index);
+				std::unique_lock<std::mutex> lock(mutex_);
+				done_cv_.wait(lock, [&] { return is_finished(current.value); });
+			}
+			if (current.value == state::failed)
+			{
+				std::rethrow_exception(current.error);
+			}
+		}
+
+		bool is_done(const size_t index) const
+		{
+			return tasks_[index]->value == state::done;
+		}
+
+		std::vector<task_status> status() const
+		{
+			std::vector<task_status> statuses{};
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (const auto& current : tasks_)
+			{
+				const auto value = current->value.load();
+				const auto elapsed_ms = value == state::running
+					? std::chrono::duration<double, std::milli>(clock::now() - current->started).count()
+					: current->elapsed_ms;
+				statuses.push_back(task_status{current->name, value, current->items.done, current->items.total, elapsed_ms, current->summary});
+			}
+			return statuses;
+		}
+
+		// class task_graph
+	};
+} // namespace utils
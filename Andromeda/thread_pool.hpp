@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils
+{
+	class thread_pool
+	{
+		std::vector<std::thread> workers_{};
+		std::deque<std::function<void()>> tasks_{};
+		std::mutex tasks_mutex_{};
+		std::condition_variable tasks_cv_{};
+		bool stop_ = false;
+
+		// pops and runs one queued task, returns false if the queue is empty
+		bool run_pending_task()
+		{
+			std::function<void()> task;
+			{
+				std::lock_guard<std::mutex> lock(tasks_mutex_);
+				if (tasks_.empty())
+				{
+					return false;
+				}
+				task = std::move(tasks_.front());
+				tasks_.pop_front();
+			}
+			task();
+			return true;
+		}
+
+		void worker_loop()
+		{
+			while (true)
+			{
+				std::function<void()> task;
+				{
+					std::unique_lock<std::mutex> lock(tasks_mutex_);
+					tasks_cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+					if (stop_ && tasks_.empty())
+					{
+						return;
+					}
+					task = std::move(tasks_.front());
+					tasks_.pop_front();
+				}
+				task();
+			}
+		}
+
+	public:
+		explicit thread_pool(size_t threads_count = std::thread::hardware_concurrency())
+		{
+			if (threads_count == 0)
+			{
+				threads_count = 1;
+			}
+			for (size_t i = 0; i < threads_count; i++)
+			{
+				workers_.emplace_back([this] { worker_loop(); });
+			}
+		}
+
+		~thread_pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(tasks_mutex_);
+				stop_ = true;
+			}
+			tasks_cv_.notify_all();
+			for (auto& worker : workers_)
+			{
+				worker.join();
+			}
+		}
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		// process wide pool, sized to the number of hardware threads
+		static thread_pool& shared()
+		{
+			static thread_pool pool;
+			return pool;
+		}
+
+		size_t size() const
+		{
+			return workers_.size();
+		}
+
+		template <typename Task>
+		std::future<typename std::result_of<Task()>::type> submit(Task task)
+		{
+			using result_type = typename std::result_of<Task()>::type;
+			auto packaged = std::make_shared<std::packaged_task<result_type()>>(std::move(task));
+			auto result = packaged->get_future();
+			{
+				std::lock_guard<std::mutex> lock(tasks_mutex_);
+				tasks_.emplace_back([packaged] { (*packaged)(); });
+			}
+			tasks_cv_.notify_one();
+			return result;
+		}
+
+		/*
+			Runs task(worker_index, item_index) for every item in [0, items_count).
+			The calling thread takes part as worker 0, pool threads are 1..size(),
+			so per-worker state can be kept in a vector of size() + 1 elements.
+			While waiting, the caller runs queued tasks so nested calls can't deadlock.
+		*/
+		template <typename Task>
+		void parallel_for(const size_t items_count, Task task)
+		{
+			if (items_count == 0)
+			{
+				return;
+			}
+
+			std::atomic<size_t> next_item{0};
+			std::atomic<size_t> running{0};
+			const auto work = [&](const size_t worker_index)
+			{
+				for (auto i = next_item++; i < items_count; i = next_item++)
+				{
+					task(worker_index, i);
+				}
+			};
+
+			const auto helpers_count = std::min(size(), items_count - 1);
+			running = helpers_count;
+			for (size_t i = 0; i < helpers_count; i++)
+			{
+				{
+					std::lock_guard<std::mutex> lock(tasks_mutex_);
+					tasks_.emplace_back([&work, &running, i]
+					{
+						work(i + 1);
+						--running;
+					});
+				}
+				tasks_cv_.notify_one();
+			}
+
+			work(0);
+			while (running != 0)
+			{
+				if (!run_pending_task())
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		// class thread_pool
+	};
+} // namespace utils
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace utils
+{
+	/*
+		Inverted index of the trigrams (3 consecutive bytes, ASCII case folded) of a set of names named by ids.
+		A name containing a literal contains all of its trigrams: the intersection of their lists is a small
+		superset of the names to check, instead of all of them. Posting lists are sorted, one flat array.
+	*/
+	class trigram_index
+	{
+		std::vector<uint32_t> trigrams_{}; // sorted
+		std::vector<uint32_t> begin_{}; // ids of trigrams_[i] are postings_[begin_[i], begin_[i + 1])
+		std::vector<uint32_t> postings_{};
+
+		static uint32_t fold(const char chr)
+		{
+			return static_cast<uint8_t>(chr >= 'A' && chr <= 'Z' ? chr | 0x20 : chr);
+		}
+
+		static uint32_t trigram(const char* text)
+		{
+			return fold(text[0]) << 16 | fold(text[1]) << 8 | fold(text[2]);
+		}
+
+		// postings of a trigram, empty if no name has it
+		std::pair<const uint32_t*, const uint32_t*> postings(const uint32_t value) const
+		{
+			const auto found = std::lower_bound(trigrams_.begin(), trigrams_.end(), value);
+			if (found == trigrams_.end() || *found != value)
+			{
+				return {nullptr, nullptr};
+			}
+			const auto index = found - trigrams_.begin();
+			return {postings_.data() + begin_[index], postings_.data() + begin_[index + 1]};
+		}
+
+	public:
+		trigram_index() = default;
+
+		// get_text(id) is the name of id, ids are ascending
+		template <typename GetText>
+		trigram_index(const std::vector<uint32_t>& ids, GetText get_text)
+		{
+			std::vector<uint64_t> pairs{}; // trigram << 32 | id
+			for (const auto id : ids)
+			{
+				const std::string_view text = get_text(id);
+				for (size_t i = 0; i + 3 <= text.size(); i++)
+				{
+					pairs.push_back(static_cast<uint64_t>(trigram(text.data() + i)) << 32 | id);
+				}
+			}
+			// the pairs are in the order of the ids: a stable sort by trigram (two 12-bit radix passes) orders them by both
+			std::vector<uint64_t> sorted(pairs.size());
+			for (const auto shift : {32, 44})
+			{
+				std::vector<uint32_t> begins(4096 + 1, 0);
+				for (const auto pair : pairs)
+				{
+					begins[(pair >> shift & 0xfff) + 1]++;
+				}
+				std::partial_sum(begins.begin(), begins.end(), begins.begin());
+				for (const auto pair : pairs)
+				{
+					sorted[begins[pair >> shift & 0xfff]++] = pair;
+				}
+				pairs.swap(sorted);
+			}
+			sorted = {};
+			pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+			postings_.reserve(pairs.size());
+			for (const auto pair : pairs)
+			{
+				const auto value = static_cast<uint32_t>(pair >> 32);
+				if (trigrams_.empty() || trigrams_.back() != value)
+				{
+					trigrams_.push_back(value);
+					begin_.push_back(static_cast<uint32_t>(postings_.size()));
+				}
+				postings_.push_back(static_cast<uint32_t>(pair));
+			}
+			begin_.push_back(static_cast<uint32_t>(postings_.size()));
+		}
+
+		/*
+			Ids of the names that may contain literal (case folded), sorted: they still have to be checked.
+			False if literal is shorter than a trigram, then any name may contain it.
+		*/
+		bool candidates(const std::string_view literal, std::vector<uint32_t>& ids) const
+		{
+			ids.clear();
+			if (literal.size() < 3)
+			{
+				return false;
+			}
+
+			std::vector<std::pair<const uint32_t*, const uint32_t*>> lists{};
+			for (size_t i = 0; i + 3 <= literal.size(); i++)
+			{
+				const auto list = postings(trigram(literal.data() + i));
+				if (list.first == list.second)
+				{
+					return true;
+				}
+				lists.push_back(list);
+			}
+			// shortest list first, the intersection only shrinks
+			std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) { return a.second - a.first < b.second - b.first; });
+			ids.assign(lists.front().first, lists.front().second);
+			std::vector<uint32_t> common{};
+			for (size_t i = 1; i < lists.size() && !ids.empty(); i++)
+			{
+				common.clear();
+				std::set_intersection(ids.begin(), ids.end(), lists[i].first, lists[i].second, std::back_inserter(common));
+				ids.swap(common);
+			}
+			return true;
+		}
+
+		size_t trigrams_count() const
+		{
+			return trigrams_.size();
+		}
+
+		size_t memory_size() const
+		{
+			return (trigrams_.size() + begin_.size() + postings_.size()) * sizeof(uint32_t);
+		}
+
+		// class trigram_index
+	};
+} // namespace utils
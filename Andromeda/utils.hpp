@@ -3,6 +3,7 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <fstream>
 #include <iterator>
@@ -30,7 +31,7 @@ namespace utils
 		const auto in_file = fopen(file_path.c_str(), "rb");
 		if (in_file == nullptr)
 		{
-			printf("failed to open file: %s\n", file_path.c_str());
+			color::out_printf("failed to open file: %s\n", file_path.c_str());
 			return {};
 		}
 		fseek(in_file, 0, SEEK_END);
@@ -101,79 +102,6 @@ namespace utils
 		                  });
 	}
 
-	// return unziped path and named in ziped file
-	inline std::pair<std::string, std::vector<std::string>> unzip_file(const fs::path& file_path, const bool full_unpack = true)
-	{	
-		std::string unpacked_path{};
-		std::vector<std::string> file_pathes{};
-
-		mz_zip_archive zip_archive;
-		memset(&zip_archive, 0, sizeof(zip_archive));
-
-		const auto status = mz_zip_reader_init_file(&zip_archive, file_path.string().c_str(), 0);
-		if (!status)
-			return std::make_pair(unpacked_path, file_pathes);
-		const auto file_count = mz_zip_reader_get_num_files(&zip_archive);
-		if (file_count == 0)
-		{
-			mz_zip_reader_end(&zip_archive);
-			return std::make_pair(unpacked_path, file_pathes);
-		}
-		// printf("number_of_files: %zu\n", file_count);
-
-		unpacked_path = file_path.parent_path().string() + '/' + file_path.filename().string() + "_unpacked";
-		if (fs::exists(unpacked_path))
-		{
-			fs::remove_all(unpacked_path);
-		}
-		fs::create_directory(unpacked_path);
-
-		for (auto i = 0; i < file_count; i++)
-		{
-			mz_zip_archive_file_stat file_stat;
-			if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat))
-			{
-				printf("failed to get file stat. index: %d\n", i);
-				continue;
-			}
-			const std::string file_name{file_stat.m_filename};
-			file_pathes.emplace_back(file_name);
-			const auto dest_file = unpacked_path + '/' + file_name;
-			if (mz_zip_reader_is_file_a_directory(&zip_archive, i))
-			{
-				continue;
-			}
-
-			const auto under_dir = file_name.find('/') != std::string::npos;
-			if (under_dir)
-			{
-				const auto is_cert_dir = file_name.find("META-INF") != std::string::npos;
-				if (!full_unpack && !is_cert_dir)
-				{
-					continue;
-				}
-
-				const fs::path under_dir_path{dest_file};
-				const std::string under_dir_full = under_dir_path.parent_path();
-				if (!fs::exists(under_dir_full))
-				{
-					fs::create_directories(under_dir_full);
-				}
-			}
-
-			const auto is_okay = mz_zip_reader_extract_to_file(&zip_archive, i, dest_file.c_str(), 0);
-			if (!is_okay)
-			{
-				color::color_printf(color::FG_LIGHT_RED, "[utils.hpp] Failed to unpack file: %s\n", file_name.c_str());
-			}
-
-			// printf("%s\n", file_stat.m_filename);
-		}
-
-		mz_zip_reader_end(&zip_archive);
-		return std::make_pair(unpacked_path, file_pathes);
-	}
-
 	template <typename T>
 	inline size_t find_case_insensitive(T data, T to_search, const size_t pos = 0)
 	{
@@ -194,6 +122,18 @@ namespace utils
 		return str.substr(first, (last - first + 1));
 	}
 
+	// strip() without a copy
+	inline std::string_view strip_view(std::string_view str)
+	{
+		const auto first = str.find_first_not_of(" \n\r");
+		if (first == std::string_view::npos)
+		{
+			return str;
+		}
+		const auto last = str.find_last_not_of(" \n\r");
+		return str.substr(first, last - first + 1);
+	}
+
 	inline std::string read_file_content(const std::string& file_path)
 	{
 		std::ifstream file_stream(file_path, std::ios::binary);
@@ -206,6 +146,6 @@ namespace utils
 
 	inline void clrscr()
 	{
-		printf("\033[2J\033[1;1H");
+		color::out_printf("\033[2J\033[1;1H");
 	}
 } // namespace utils
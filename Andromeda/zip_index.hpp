@@ -0,0 +1,512 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+
+#include "miniz/miniz.h"
+#include "thread_pool.hpp"
+
+// stock zlib next to miniz: miniz is built with MINIZ_NO_ZLIB_COMPATIBLE_NAMES (see the Makefile)
+#include <zlib.h>
+
+namespace utils
+{
+	/*
+		Long-lived reader of an archive in memory (the mapped APK): opening it only reads the
+		central directory, files are then found through a name index and read on demand.
+		The miniz reader is not thread-safe, parallel code takes one per worker from a reader_pool.
+	*/
+	class zip_index
+	{
+	public:
+		struct entry
+		{
+			mz_uint file_index;
+			std::string file_name;
+			mz_uint64 size;
+			mz_uint64 compressed_size;
+			mz_uint64 local_header_offset;
+			mz_uint16 method;
+			mz_uint32 crc32;
+		};
+
+		// decompressor of deflated entries: zlib, miniz only when asked for, e.g. to compare them in 'benchmark inflate'
+		enum class inflate_backend
+		{
+			miniz,
+			zlib,
+		};
+
+		// what extract_to_directory did with an entry
+		enum class extract_status
+		{
+			written,
+			failed,   // damaged, or a name escaping the directory
+			replaced, // a later entry has the same path (case aside), it is the one written
+		};
+
+		// bytes of an entry: a view into the archive if it is stored, an inflated copy otherwise
+		struct entry_content
+		{
+			const unsigned char* data = nullptr;
+			size_t size = 0;
+			bool is_stored = false;
+			std::shared_ptr<void> inflated{};
+		};
+
+		// one miniz reader per thread_pool worker over the same archive bytes, each opened on first use
+		class reader_pool
+		{
+			const unsigned char* data_;
+			size_t size_;
+			std::vector<mz_zip_archive> readers_;
+			std::vector<char> is_open_;
+
+		public:
+			reader_pool(const unsigned char* data, const size_t size, const size_t workers_count)
+				: data_(data), size_(size), readers_(workers_count), is_open_(workers_count, 0)
+			{
+				for (auto& reader : readers_)
+				{
+					memset(&reader, 0, sizeof(reader));
+				}
+			}
+
+			~reader_pool()
+			{
+				for (size_t i = 0; i < readers_.size(); i++)
+				{
+					if (is_open_[i])
+					{
+						mz_zip_reader_end(&readers_[i]);
+					}
+				}
+			}
+
+			reader_pool(const reader_pool&) = delete;
+			reader_pool& operator=(const reader_pool&) = delete;
+
+			// nullptr if the archive can't be opened
+			mz_zip_archive* get(const size_t worker_index)
+			{
+				auto& reader = readers_[worker_index];
+				if (!is_open_[worker_index])
+				{
+					if (!mz_zip_reader_init_mem(&reader, data_, size_, MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY))
+					{
+						return nullptr;
+					}
+					is_open_[worker_index] = 1;
+				}
+				return &reader;
+			}
+
+			// class reader_pool
+		};
+
+	private:
+		const unsigned char* data_ = nullptr;
+		size_t size_ = 0;
+
+		mz_zip_archive zip_archive_{};
+		bool is_open_ = false;
+
+		std::vector<entry> entries_{}; // central directory order, directories left out
+		std::unordered_map<std::string, size_t> entry_by_name_{};
+
+	public:
+		zip_index(const unsigned char* data, const size_t size) : data_(data), size_(size)
+		{
+			memset(&zip_archive_, 0, sizeof(zip_archive_));
+			// lookups go through entry_by_name_, miniz doesn't have to sort its copy of the directory
+			if (data_ == nullptr || !mz_zip_reader_init_mem(&zip_archive_, data_, size_, MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY))
+			{
+				return;
+			}
+			is_open_ = true;
+
+			const auto file_count = mz_zip_reader_get_num_files(&zip_archive_);
+			entries_.reserve(file_count);
+			entry_by_name_.reserve(file_count);
+			for (mz_uint i = 0; i < file_count; i++)
+			{
+				mz_zip_archive_file_stat file_stat;
+				if (!mz_zip_reader_file_stat(&zip_archive_, i, &file_stat) || file_stat.m_is_directory)
+				{
+					continue;
+				}
+
+				entry_by_name_.emplace(file_stat.m_filename, entries_.size());
+				entries_.push_back(entry{i, file_stat.m_filename, file_stat.m_uncomp_size, file_stat.m_comp_size,
+				                         file_stat.m_local_header_ofs, file_stat.m_method, file_stat.m_crc32});
+			}
+		}
+
+		~zip_index()
+		{
+			if (is_open_)
+			{
+				mz_zip_reader_end(&zip_archive_);
+			}
+		}
+
+		zip_index(const zip_index&) = delete;
+		zip_index& operator=(const zip_index&) = delete;
+
+		bool is_valid() const
+		{
+			return is_open_;
+		}
+
+		const unsigned char* data() const
+		{
+			return data_;
+		}
+
+		size_t size() const
+		{
+			return size_;
+		}
+
+		const std::vector<entry>& entries() const
+		{
+			return entries_;
+		}
+
+		// nullptr if the archive has no such file
+		const entry* find(const std::string& file_name) const
+		{
+			const auto found = entry_by_name_.find(file_name);
+			return found == entry_by_name_.end() ? nullptr : &entries_[found->second];
+		}
+
+		// files whose names start with prefix
+		std::vector<entry> get_entries(const std::string& prefix) const
+		{
+			std::vector<entry> matching{};
+			for (const auto& current : entries_)
+			{
+				if (current.file_name.compare(0, prefix.size(), prefix) == 0)
+				{
+					matching.push_back(current);
+				}
+			}
+			return matching;
+		}
+
+		// offset of the entry's (compressed) data, 0 if the local header doesn't fit in the archive
+		size_t get_data_offset(const entry& current) const
+		{
+			// local header: 30 bytes + name + extra field
+			const auto header_offset = current.local_header_offset;
+			if (header_offset + 30 > size_)
+			{
+				return 0;
+			}
+
+			const auto header = data_ + header_offset;
+			const auto signature = header[0] | header[1] << 8 | header[2] << 16 | uint32_t{header[3]} << 24;
+			const auto data_offset = header_offset + 30 + (header[26] | header[27] << 8) + (header[28] | header[29] << 8);
+			if (signature != 0x04034b50 || data_offset > size_ || current.compressed_size > size_ - data_offset)
+			{
+				return 0;
+			}
+			return data_offset;
+		}
+
+		/*
+			Raw deflate stream inflated by zlib in one call: the size is known from the central directory,
+			so the output goes straight into its final buffer, checked against the entry's CRC-32
+		*/
+		static bool inflate_zlib(const unsigned char* source, const size_t source_size, unsigned char* destination,
+		                         const size_t destination_size, const uint32_t expected_crc)
+		{
+			if (source_size > UINT_MAX || destination_size > UINT_MAX)
+			{
+				return false;
+			}
+
+			z_stream stream{};
+			if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+			{
+				return false;
+			}
+			stream.next_in = const_cast<Bytef*>(source);
+			stream.avail_in = static_cast<uInt>(source_size);
+			stream.next_out = destination;
+			stream.avail_out = static_cast<uInt>(destination_size);
+
+			const auto status = inflate(&stream, Z_FINISH);
+			const auto is_okay = status == Z_STREAM_END && stream.total_out == destination_size;
+			inflateEnd(&stream);
+
+			return is_okay && crc32(0, destination, static_cast<uInt>(destination_size)) == expected_crc;
+		}
+
+		entry_content get_content(const entry& current, const inflate_backend backend = inflate_backend::zlib)
+		{
+			return read_content(current, zip_archive_, backend);
+		}
+
+		// contents of entries in their order, inflated on the thread pool
+		std::vector<entry_content> get_contents(const std::vector<entry>& entries) const
+		{
+			std::vector<entry_content> contents(entries.size());
+			for_each_content(entries, [&contents](const size_t index, const entry_content& content)
+			{
+				contents[index] = content;
+			});
+			return contents;
+		}
+
+		/*
+			consume(index, content) for every entry, on the thread pool: only the entries being worked on
+			are in memory at a time. content.data is nullptr if the entry couldn't be read.
+		*/
+		template <typename Consumer>
+		void for_each_content(const std::vector<entry>& entries, Consumer consume) const
+		{
+			for_each_parallel(entries, [&](const size_t index, mz_zip_archive* reader)
+			{
+				consume(index, reader != nullptr ? read_content(entries[index], *reader) : entry_content{});
+			});
+		}
+
+		/*
+			Writes the entries under directory on the thread pool, streamed: stored entries straight from
+			the archive, deflated ones through a small zlib buffer. Names escaping directory ("../", absolute)
+			aren't written. Entries with the same path (ignoring case, for case-insensitive filesystems) would be
+			written by two workers at once: only the last one is, as a sequential extraction would leave it.
+		*/
+		std::vector<extract_status> extract_to_directory(const std::vector<entry>& entries, const std::string& directory) const
+		{
+			std::vector<extract_status> statuses(entries.size(), extract_status::failed);
+			std::vector<std::string> file_paths(entries.size());
+			std::unordered_map<std::string, size_t> last_entries{};
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				if (!is_safe_path(entries[i].file_name))
+				{
+					continue;
+				}
+				auto folded_name = entries[i].file_name;
+				std::transform(folded_name.begin(), folded_name.end(), folded_name.begin(), [](const unsigned char chr) { return static_cast<char>(tolower(chr)); });
+				const auto [found, is_inserted] = last_entries.emplace(folded_name, i);
+				if (!is_inserted)
+				{
+					statuses[found->second] = extract_status::replaced;
+					file_paths[found->second].clear();
+					found->second = i;
+				}
+
+				// directories first, concurrent create_directories of the same parent would race
+				file_paths[i] = directory + '/' + entries[i].file_name;
+				const auto parent_path = fs::path(file_paths[i]).parent_path();
+				std::error_code error{};
+				if (!fs::exists(parent_path, error))
+				{
+					fs::create_directories(parent_path, error);
+				}
+			}
+
+			for_each_parallel(entries, [&](const size_t index, mz_zip_archive* reader)
+			{
+				if (!file_paths[index].empty())
+				{
+					statuses[index] = write_file(entries[index], file_paths[index], reader) ? extract_status::written : extract_status::failed;
+				}
+			});
+			return statuses;
+		}
+
+		/*
+			Streams a deflated entry through zlib into a small buffer, for consumers that don't need it whole
+			(digests). Only the archive bytes are read, so it can run on any thread.
+			false if the entry is damaged (consume may have seen part of it by then)
+		*/
+		template <typename Consumer>
+		bool inflate_chunks(const entry& current, Consumer consume) const
+		{
+			const auto data_offset = get_data_offset(current);
+			if (current.method != MZ_DEFLATED || data_offset == 0)
+			{
+				return false;
+			}
+
+			z_stream stream{};
+			if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+			{
+				return false;
+			}
+
+			std::vector<unsigned char> buffer(256 * 1024);
+			auto source = data_ + data_offset;
+			auto source_left = current.compressed_size;
+			uLong crc = crc32(0, nullptr, 0);
+			auto status = Z_OK;
+			while (status == Z_OK)
+			{
+				if (stream.avail_in == 0)
+				{
+					const auto input_size = static_cast<uInt>(std::min<mz_uint64>(source_left, 1u << 30));
+					stream.next_in = const_cast<Bytef*>(source);
+					stream.avail_in = input_size;
+					source += input_size;
+					source_left -= input_size;
+				}
+				stream.next_out = buffer.data();
+				stream.avail_out = static_cast<uInt>(buffer.size());
+
+				// Z_BUF_ERROR once a truncated stream can't make progress
+				status = inflate(&stream, Z_NO_FLUSH);
+				if (status != Z_OK && status != Z_STREAM_END)
+				{
+					break;
+				}
+				const auto produced = buffer.size() - stream.avail_out;
+				crc = crc32(crc, buffer.data(), static_cast<uInt>(produced));
+				consume(buffer.data(), produced);
+			}
+			const auto is_okay = status == Z_STREAM_END && stream.total_out == current.size && crc == current.crc32;
+			inflateEnd(&stream);
+
+			return is_okay;
+		}
+
+		bool extract_to_file(const entry& current, const std::string& file_path)
+		{
+			return write_file(current, file_path, &zip_archive_);
+		}
+
+	private:
+		/*
+			Runs task(index, reader) for every entry on the thread pool, largest first so one big entry
+			doesn't end up alone at the tail. reader is the worker's own, nullptr if it couldn't be opened.
+		*/
+		template <typename Task>
+		void for_each_parallel(const std::vector<entry>& entries, Task task) const
+		{
+			std::vector<size_t> order(entries.size());
+			for (size_t i = 0; i < order.size(); i++)
+			{
+				order[i] = i;
+			}
+			std::sort(order.begin(), order.end(), [&entries](const size_t a, const size_t b)
+			{
+				return entries[a].size > entries[b].size;
+			});
+
+			auto& pool = thread_pool::shared();
+			reader_pool readers(data_, size_, pool.size() + 1);
+			pool.parallel_for(order.size(), [&](const size_t worker_index, const size_t item_index)
+			{
+				task(order[item_index], readers.get(worker_index));
+			});
+		}
+
+		entry_content read_content(const entry& current, mz_zip_archive& reader, const inflate_backend backend = inflate_backend::zlib) const
+		{
+			entry_content content{};
+			const auto data_offset = get_data_offset(current);
+
+			// stored entry: a view into the archive
+			if (current.method == 0 && current.compressed_size == current.size && data_offset != 0)
+			{
+				content.data = data_ + data_offset;
+				content.size = current.size;
+				content.is_stored = true;
+				return content;
+			}
+
+			if (current.method == MZ_DEFLATED && data_offset != 0 && backend == inflate_backend::zlib)
+			{
+				const auto inflated = static_cast<unsigned char*>(malloc(std::max<size_t>(current.size, 1)));
+				if (inflated != nullptr && inflate_zlib(data_ + data_offset, current.compressed_size, inflated, current.size, current.crc32))
+				{
+					content.inflated = std::shared_ptr<void>{inflated, free};
+					content.data = inflated;
+					content.size = current.size;
+					return content;
+				}
+				// miniz gets a second chance and reports the error
+				free(inflated);
+			}
+
+			size_t size = 0;
+			const auto inflated = mz_zip_reader_extract_to_heap(&reader, current.file_index, &size, 0);
+			if (inflated != nullptr)
+			{
+				content.inflated = std::shared_ptr<void>{inflated, mz_free};
+				content.data = static_cast<const unsigned char*>(inflated);
+				content.size = size;
+			}
+			return content;
+		}
+
+		// file_path is overwritten, reader (may be nullptr) is only needed for entries neither stored nor deflated
+		bool write_file(const entry& current, const std::string& file_path, mz_zip_archive* reader) const
+		{
+			const auto data_offset = get_data_offset(current);
+			const auto is_stored = current.method == 0 && current.compressed_size == current.size && data_offset != 0;
+			const auto use_zlib = current.method == MZ_DEFLATED && data_offset != 0;
+			if (!is_stored && !use_zlib)
+			{
+				return reader != nullptr && mz_zip_reader_extract_to_file(reader, current.file_index, file_path.c_str(), 0);
+			}
+
+			const auto file = fopen(file_path.c_str(), "wb");
+			if (file == nullptr)
+			{
+				return false;
+			}
+			auto is_okay = true;
+			if (is_stored)
+			{
+				is_okay = fwrite(data_ + data_offset, 1, current.size, file) == current.size;
+			}
+			else
+			{
+				is_okay = inflate_chunks(current, [&](const unsigned char* data, const size_t size)
+				{
+					is_okay = is_okay && fwrite(data, 1, size, file) == size;
+				}) && is_okay;
+			}
+			is_okay = fclose(file) == 0 && is_okay;
+
+			if (!is_okay)
+			{
+				remove(file_path.c_str());
+			}
+			return is_okay;
+		}
+
+		// relative and staying below the extraction directory
+		static bool is_safe_path(const std::string& file_name)
+		{
+			if (file_name.empty() || file_name[0] == '/')
+			{
+				return false;
+			}
+			for (const auto& part : fs::path(file_name))
+			{
+				if (part == "..")
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+
+		// class zip_index
+	};
+} // namespace utils
@@ -9,6 +9,11 @@
 #include <string.h>
 #include <stdarg.h>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AXML_HAVE_SSE2 1
+#endif
+
 #ifdef _WIN32	/* Windows */
 
 #pragma warning(disable:4996)
@@ -66,10 +71,13 @@ typedef struct {
 	uint32_t count;		/* count of all strings */
 	uint32_t* offsets;	/* each string's offset in raw data block */
 
-	unsigned char* data;	/* raw data block, contains all strings encoded by UTF-16LE */
+	unsigned char* data;	/* raw data block, contains all strings encoded by UTF-16LE; points into the chunk */
 	size_t len;		/* length of raw data block */
+	int isUTF8;		/* raw data block is encoded by UTF-8 instead */
 
-	unsigned char** strings;/* string table, point to strings encoded by UTF-8 */
+	char** strings;		/* string table, point to strings encoded by UTF-8 */
+	uint32_t* lengths;	/* bytes of each UTF-8 string, without terminal zero */
+	char* pool;		/* all decoded strings, built once when the chunk is parsed */
 } StringTable_t;
 
 /* attribute structure within tag */
@@ -110,10 +118,16 @@ typedef struct {
 	uint32_t text;		/* when tag is text, its content */
 
 	AttrStack_t* attr;	/* attributes */
+
+	AxmlEvent_t event;	/* last returned event, per parser so documents can be parsed again */
+
+	AxmlResolver_t resolver;	/* optional, names references to the app's resources */
+	void* resolverCtx;
 } Parser_t;
 
 #define UTF8_FLAG (1 << 8)
-unsigned char isUTF8 = 0;
+
+static char emptyString[] = "";
 
 /* get a 4-byte integer, and mark as parsed */
 /* uses byte oprations to avoid little or big-endian conflict */
@@ -122,19 +136,11 @@ GetInt32(Parser_t* ap)
 {
 	uint32_t value = 0;
 	unsigned char* p = ap->buf + ap->cur;
-	value = p[0] | p[1] << 8 | p[2] << 16 | p[3] << 24;
+	value = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
 	ap->cur += 4;
 	return value;
 }
 
-static void
-CopyData(Parser_t* ap, unsigned char* to, size_t size)
-{
-	memcpy(to, ap->buf + ap->cur, size);
-	ap->cur += size;
-	return;
-}
-
 /* skip some uknown of useless fields, don't parse them */
 static void
 SkipInt32(Parser_t* ap, size_t num)
@@ -170,91 +176,335 @@ ParseHeadChunk(Parser_t* ap)
 	return 0;
 }
 
+/** \brief Convert UTF-16LE string into UTF-8 string
+ *
+ *  You must call this function with to=NULL firstly to get UTF-8 size;
+ *  then you should alloc enough memory to the string;
+ *  at last call this function again to convert actually.
+ *  \param to Pointer to target UTF-8 string
+ *  \param from Pointer to source UTF-16LE string
+ *  \param nch Count of UTF-16LE characters, including terminal zero
+ *  \retval -1 Converting error.
+ *  \retval positive Bytes of UTF-8 string, including terminal zero.
+ */
+static size_t
+UTF16LEtoUTF8(unsigned char* to, unsigned char* from, size_t nch)
+{
+	size_t total = 0;
+	while (nch > 0)
+	{
+		uint32_t ucs4;
+		size_t count;
+
+		/* utf-16le -> ucs-4, defined in RFC 2781 */
+		ucs4 = from[0] + (from[1] << 8);
+		from += 2;
+		nch--;
+		if (ucs4 < 0xd800 || ucs4 > 0xdfff)
+		{
+			;
+		}
+		else if (ucs4 >= 0xd800 && ucs4 <= 0xdbff)
+		{
+			unsigned int ext;
+			if (nch <= 0)
+				return -1;
+			ext = from[0] + (from[1] << 8);
+			from += 2;
+			nch--;
+			if (ext < 0xdc00 || ext >0xdfff)
+				return -1;
+			ucs4 = ((ucs4 & 0x3ff) << 10) + (ext & 0x3ff) + 0x10000;
+		}
+		else
+		{
+			return -1;
+		}
+
+		/* ucs-4 -> utf-8, defined in RFC 2279 */
+		if (ucs4 < 0x80) count = 1;
+		else if (ucs4 < 0x800) count = 2;
+		else if (ucs4 < 0x10000) count = 3;
+		else if (ucs4 < 0x200000) count = 4;
+		else if (ucs4 < 0x4000000) count = 5;
+		else if (ucs4 < 0x80000000) count = 6;
+		else return 0;
+
+		total += count;
+		if (to == NULL)
+			continue;
+
+		switch (count)
+		{
+		case 6: to[5] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0x4000000;
+		case 5:	to[4] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0x200000;
+		case 4: to[3] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0x10000;
+		case 3: to[2] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0x800;
+		case 2: to[1] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0xc0;
+		case 1: to[0] = ucs4; break;
+		}
+		to += count;
+	}
+	if (to != NULL)
+		to[0] = '\0';
+	return total + 1;
+}
+
+/* string lengths in the pool are 1 or 2 units, the high bit of the first unit marks the long form */
+static size_t
+GetUTF16Length(const unsigned char** p, const unsigned char* end)
+{
+	size_t len;
+	if (end - *p < 2)
+		return (size_t)-1;
+	len = (*p)[0] | (*p)[1] << 8;
+	*p += 2;
+	if (len & 0x8000)
+	{
+		if (end - *p < 2)
+			return (size_t)-1;
+		len = ((len & 0x7fff) << 16) | (*p)[0] | (*p)[1] << 8;
+		*p += 2;
+	}
+	return len;
+}
+
+static size_t
+GetUTF8Length(const unsigned char** p, const unsigned char* end)
+{
+	size_t len;
+	if (end - *p < 1)
+		return (size_t)-1;
+	len = (*p)[0];
+	*p += 1;
+	if (len & 0x80)
+	{
+		if (end - *p < 1)
+			return (size_t)-1;
+		len = ((len & 0x7f) << 8) | (*p)[0];
+		*p += 1;
+	}
+	return len;
+}
+
+/* if all nch UTF-16LE characters are ASCII, narrow them into to[] and return 1 */
 static int
-ParseStringChunk(Parser_t* ap)
+NarrowASCII(char* to, const unsigned char* from, size_t nch)
 {
-	uint32_t chunkSize;
+	size_t i = 0;
+#ifdef AXML_HAVE_SSE2
+	const __m128i nonAscii = _mm_set1_epi16((short)0xff80);
+	for (; i + 16 <= nch; i += 16)
+	{
+		__m128i lo = _mm_loadu_si128((const __m128i*)(from + i * 2));
+		__m128i hi = _mm_loadu_si128((const __m128i*)(from + i * 2 + 16));
+		__m128i any = _mm_and_si128(_mm_or_si128(lo, hi), nonAscii);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(any, _mm_setzero_si128())) != 0xffff)
+			return 0;
+		_mm_storeu_si128((__m128i*)(to + i), _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for (; i < nch; i++)
+	{
+		if (from[i * 2] >= 0x80 || from[i * 2 + 1] != 0)
+			return 0;
+		to[i] = (char)from[i * 2];
+	}
+	return 1;
+}
 
-	uint32_t styleCount;
-	uint32_t stringOffset;
-	uint32_t styleOffset;
+/* returns the raw characters of string id and their count, NULL when it's out of the data block */
+static const unsigned char*
+GetRawString(StringTable_t* st, uint32_t id, size_t* nch)
+{
+	const unsigned char* p;
+	const unsigned char* end = st->data + st->len;
 
-	uint32_t flags;
+	if (st->offsets[id] >= st->len)
+		return NULL;
+	p = st->data + st->offsets[id];
 
-	size_t i;
+	if (st->isUTF8)
+	{
+		/* UTF-16 length first, then the UTF-8 bytes count */
+		if (GetUTF8Length(&p, end) == (size_t)-1)
+			return NULL;
+		*nch = GetUTF8Length(&p, end);
+		if (*nch == (size_t)-1 || *nch > (size_t)(end - p))
+			return NULL;
+	}
+	else
+	{
+		*nch = GetUTF16Length(&p, end);
+		if (*nch == (size_t)-1 || *nch > (size_t)(end - p) / 2)
+			return NULL;
+	}
+	return p;
+}
 
-	/* chunk type */
-	if (GetInt32(ap) != CHUNK_STRING)
+/* converts the whole string table into one pool of zero terminated UTF-8 strings */
+static int
+DecodeStringTable(StringTable_t* st)
+{
+	size_t total = 0;
+	size_t nch;
+	char* cur;
+	uint32_t i;
+
+	st->strings = NULL;
+	st->lengths = NULL;
+	st->pool = NULL;
+
+	/* upper bound of the pool: a UTF-16 unit never takes more than 3 UTF-8 bytes */
+	for (i = 0; i < st->count; i++)
 	{
-		fprintf(stderr, "Error: not valid string chunk.\n");
+		if (GetRawString(st, i, &nch) != NULL)
+			total += (st->isUTF8 ? nch : nch * 3) + 1;
+	}
+
+	st->strings = (char**)malloc(st->count * sizeof(char*));
+	st->lengths = (uint32_t*)malloc(st->count * sizeof(uint32_t));
+	st->pool = (char*)malloc(total + 1);
+	if (st->strings == NULL || st->lengths == NULL || st->pool == NULL)
+	{
+		free(st->strings);
+		free(st->lengths);
+		free(st->pool);
+		st->strings = NULL;
+		st->lengths = NULL;
+		st->pool = NULL;
 		return -1;
 	}
 
-	/* chunk size */
-	chunkSize = GetInt32(ap);
+	cur = st->pool;
+	for (i = 0; i < st->count; i++)
+	{
+		const unsigned char* raw = GetRawString(st, i, &nch);
+		size_t size;
 
-	/* count of strings */
-	ap->st->count = GetInt32(ap);
+		st->strings[i] = emptyString;
+		st->lengths[i] = 0;
+		if (raw == NULL)
+			continue;
 
-	/* count of styles */
-	styleCount = GetInt32(ap);
+		if (st->isUTF8)
+		{
+			memcpy(cur, raw, nch);
+			size = nch;
+		}
+		else if (NarrowASCII(cur, raw, nch))
+		{
+			size = nch;
+		}
+		else
+		{
+			size = UTF16LEtoUTF8((unsigned char*)cur, (unsigned char*)raw, nch);
+			if (size == (size_t)-1 || size == 0)
+				continue;
+			size--;	/* terminal zero */
+		}
 
-	/* flags field */
-	flags = GetInt32(ap);
-	isUTF8 = ((flags & UTF8_FLAG) != 0);
+		cur[size] = '\0';
+		st->strings[i] = cur;
+		st->lengths[i] = (uint32_t)size;
+		cur += size + 1;
+	}
 
-	/* offset of string raw data in chunk */
-	stringOffset = GetInt32(ap);
+	return 0;
+}
 
-	/* offset of style w=raw data in chunk */
-	styleOffset = GetInt32(ap);
+static uint32_t
+ReadInt32(const unsigned char* p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
 
-	/* strings' offsets table */
-	ap->st->offsets = (uint32_t*)malloc(ap->st->count * sizeof(uint32_t));
-	if (ap->st->offsets == NULL)
+/* reads a string pool chunk in place: the raw strings are referenced, not copied, and decoded once */
+static int
+LoadStringTable(StringTable_t* st, const unsigned char* chunk, size_t size)
+{
+	uint32_t chunkSize;
+	uint32_t styleCount;
+	uint32_t stringOffset;
+	uint32_t styleOffset;
+	uint32_t flags;
+	size_t end;
+	size_t i;
+
+	st->offsets = NULL;
+	st->data = NULL;
+	st->strings = NULL;
+	st->lengths = NULL;
+	st->pool = NULL;
+
+	/* chunk type */
+	if (size < 28 || ReadInt32(chunk) != CHUNK_STRING)
 	{
-		fprintf(stderr, "Error: init strings' offsets table.\n");
+		fprintf(stderr, "Error: not valid string chunk.\n");
 		return -1;
 	}
 
-	for (i = 0; i < ap->st->count; i++)
-		ap->st->offsets[i] = GetInt32(ap);
+	chunkSize = ReadInt32(chunk + 4);
+	st->count = ReadInt32(chunk + 8);
+	styleCount = ReadInt32(chunk + 12);
+	flags = ReadInt32(chunk + 16);
+	st->isUTF8 = ((flags & UTF8_FLAG) != 0);
+	stringOffset = ReadInt32(chunk + 20);
+	styleOffset = ReadInt32(chunk + 24);
+
+	/* string data ends where the styles start */
+	end = styleOffset ? styleOffset : chunkSize;
+	if (chunkSize > size || st->count > (chunkSize - 28) / 4 ||
+		styleCount > (chunkSize - 28) / 4 - st->count ||
+		stringOffset > end || end > chunkSize)
+	{
+		fprintf(stderr, "Error: not valid string chunk.\n");
+		return -1;
+	}
 
-	/* init string table */
-	ap->st->strings = (unsigned char**)malloc(ap->st->count * sizeof(unsigned char*));
-	if (ap->st->strings == NULL)
+	/* strings' offsets table */
+	st->offsets = (uint32_t*)malloc(st->count * sizeof(uint32_t) + 1);
+	if (st->offsets == NULL)
 	{
-		fprintf(stderr, "Error: init string table.\n");
-		free(ap->st->offsets);
-		ap->st->offsets = NULL;
+		fprintf(stderr, "Error: init strings' offsets table.\n");
 		return -1;
 	}
-	for (i = 0; i < ap->st->count; i++)
-		ap->st->strings[i] = NULL;
 
-	/* skip style offset table */
-	if (styleCount != 0)
-		SkipInt32(ap, styleCount);
+	for (i = 0; i < st->count; i++)
+		st->offsets[i] = ReadInt32(chunk + 28 + 4 * i);
 
-	/* save string raw data */
-	ap->st->len = (styleOffset ? styleOffset : chunkSize) - stringOffset;
-	ap->st->data = (unsigned char*)malloc(ap->st->len);
-	if (ap->st->data == NULL)
+	st->data = (unsigned char*)chunk + stringOffset;
+	st->len = end - stringOffset;
+
+	/* decode every string once, lookups are plain array accesses afterwards */
+	if (DecodeStringTable(st) != 0)
 	{
-		fprintf(stderr, "Error: init string raw data.\n");
-		free(ap->st->strings);
-		ap->st->strings = NULL;
-		free(ap->st->offsets);
-		ap->st->offsets = NULL;
+		fprintf(stderr, "Error: init string table.\n");
+		free(st->offsets);
+		st->offsets = NULL;
 		return -1;
 	}
 
-	CopyData(ap, ap->st->data, ap->st->len);
+	return 0;
+}
 
-	/* skip style raw data */
-	if (styleOffset != 0)
-		SkipInt32(ap, (chunkSize - styleOffset) / 4);
+static void
+FreeStringTable(StringTable_t* st)
+{
+	free(st->strings);
+	free(st->lengths);
+	free(st->pool);
+	free(st->offsets);
+}
+
+static int
+ParseStringChunk(Parser_t* ap)
+{
+	if (LoadStringTable(ap->st, ap->buf + ap->cur, ap->size - ap->cur) != 0)
+		return -1;
 
+	/* chunk size, checked against the buffer by LoadStringTable */
+	ap->cur += ReadInt32(ap->buf + ap->cur + 4);
 	return 0;
 }
 
@@ -316,7 +566,12 @@ AxmlOpen(char* buffer, size_t size)
 	ap->tagUri = (uint32_t)(-1);
 	ap->text = (uint32_t)(-1);
 
-	ap->st = (StringTable_t*)malloc(sizeof(StringTable_t));
+	ap->event = AE_UNINITIALIZED;
+
+	ap->resolver = NULL;
+	ap->resolverCtx = NULL;
+
+	ap->st = (StringTable_t*)calloc(1, sizeof(StringTable_t));
 	if (ap->st == NULL)
 	{
 		fprintf(stderr, "Error: init string table struct.\n");
@@ -329,6 +584,7 @@ AxmlOpen(char* buffer, size_t size)
 		ParseStringChunk(ap) != 0 ||
 		ParseResourceChunk(ap) != 0)
 	{
+		FreeStringTable(ap->st);
 		free(ap->st);
 		free(ap);
 		return NULL;
@@ -341,7 +597,6 @@ int
 AxmlClose(void* axml)
 {
 	Parser_t* ap;
-	uint32_t i;
 
 	if (axml == NULL)
 	{
@@ -351,19 +606,22 @@ AxmlClose(void* axml)
 
 	ap = (Parser_t*)axml;
 
-	if (ap->st->data)
-		free(ap->st->data);
+	while (ap->attr != NULL)
+	{
+		AttrStack_t* attr = ap->attr;
+		ap->attr = attr->next;
+		free(attr->list);
+		free(attr);
+	}
 
-	if (ap->st->strings)
+	while (ap->nsList != NULL)
 	{
-		for (i = 0; i < ap->st->count; i++)
-			if (ap->st->strings[i])
-				free(ap->st->strings[i]);
-		free(ap->st->strings);
+		NsRecord_t* ns = ap->nsList;
+		ap->nsList = ns->next;
+		free(ns);
 	}
 
-	if (ap->st->offsets)
-		free(ap->st->offsets);
+	FreeStringTable(ap->st);
 
 	if (ap->st)
 		free(ap->st);
@@ -377,26 +635,24 @@ AxmlClose(void* axml)
 AxmlEvent_t
 AxmlNext(void* axml)
 {
-	static AxmlEvent_t event;
-
 	Parser_t* ap;
 	uint32_t chunkType;
 
+	ap = (Parser_t*)axml;
+
 	/* when init */
-	if (event == AE_UNINITIALIZED)
+	if (ap->event == AE_UNINITIALIZED)
 	{
-		event = AE_STARTDOC;
-		return event;
+		ap->event = AE_STARTDOC;
+		return ap->event;
 	}
 
-	ap = (Parser_t*)axml;
-
 	/* when buffer ends */
 	if (NoMoreData(ap))
-		event = AE_ENDDOC;
+		ap->event = AE_ENDDOC;
 
-	if (event == AE_ENDDOC)
-		return event;
+	if (ap->event == AE_ENDDOC)
+		return ap->event;
 
 	/* common chunk head */
 	chunkType = GetInt32(ap);
@@ -446,7 +702,7 @@ AxmlNext(void* axml)
 		attr->next = ap->attr;
 		ap->attr = attr;
 
-		event = AE_STARTTAG;
+		ap->event = AE_STARTTAG;
 	}
 	else if (chunkType == CHUNK_ENDTAG)
 	{
@@ -464,7 +720,7 @@ AxmlNext(void* axml)
 			free(attr);
 		}
 
-		event = AE_ENDTAG;
+		ap->event = AE_ENDTAG;
 	}
 	else if (chunkType == CHUNK_STARTNS)
 	{
@@ -508,132 +764,33 @@ AxmlNext(void* axml)
 	{
 		ap->text = GetInt32(ap);
 		SkipInt32(ap, 2);	/* unknown fields */
-		event = AE_TEXT;
+		ap->event = AE_TEXT;
 	}
 	else
 	{
-		event = AE_ERROR;
+		ap->event = AE_ERROR;
 	}
 
-	return event;
-}
-
-/** \brief Convert UTF-16LE string into UTF-8 string
- *
- *  You must call this function with to=NULL firstly to get UTF-8 size;
- *  then you should alloc enough memory to the string;
- *  at last call this function again to convert actually.
- *  \param to Pointer to target UTF-8 string
- *  \param from Pointer to source UTF-16LE string
- *  \param nch Count of UTF-16LE characters, including terminal zero
- *  \retval -1 Converting error.
- *  \retval positive Bytes of UTF-8 string, including terminal zero.
- */
-static size_t
-UTF16LEtoUTF8(unsigned char* to, unsigned char* from, size_t nch)
-{
-	size_t total = 0;
-	while (nch > 0)
-	{
-		uint32_t ucs4;
-		size_t count;
-
-		/* utf-16le -> ucs-4, defined in RFC 2781 */
-		ucs4 = from[0] + (from[1] << 8);
-		from += 2;
-		nch--;
-		if (ucs4 < 0xd800 || ucs4 > 0xdfff)
-		{
-			;
-		}
-		else if (ucs4 >= 0xd800 && ucs4 <= 0xdbff)
-		{
-			unsigned int ext;
-			if (nch <= 0)
-				return -1;
-			ext = from[0] + (from[1] << 8);
-			from += 2;
-			nch--;
-			if (ext < 0xdc00 || ext >0xdfff)
-				return -1;
-			ucs4 = ((ucs4 & 0x3ff) << 10) + (ext & 0x3ff) + 0x10000;
-		}
-		else
-		{
-			return -1;
-		}
-
-		/* ucs-4 -> utf-8, defined in RFC 2279 */
-		if (ucs4 < 0x80) count = 1;
-		else if (ucs4 < 0x800) count = 2;
-		else if (ucs4 < 0x10000) count = 3;
-		else if (ucs4 < 0x200000) count = 4;
-		else if (ucs4 < 0x4000000) count = 5;
-		else if (ucs4 < 0x80000000) count = 6;
-		else return 0;
-
-		total += count;
-		if (to == NULL)
-			continue;
-
-		switch (count)
-		{
-		case 6: to[5] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0x4000000;
-		case 5:	to[4] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0x200000;
-		case 4: to[3] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0x10000;
-		case 3: to[2] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0x800;
-		case 2: to[1] = 0x80 | (ucs4 & 0x3f); ucs4 >>= 6; ucs4 |= 0xc0;
-		case 1: to[0] = ucs4; break;
-		}
-		to += count;
-	}
-	if (to != NULL)
-		to[0] = '\0';
-	return total + 1;
+	return ap->event;
 }
 
 static char*
 GetString(Parser_t* ap, uint32_t id)
 {
-	static char* emptyString = "";
-
-	unsigned char* offset;
-	uint16_t chNum;
-	size_t size;
-
 	/* out of index range */
 	if (id >= ap->st->count)
 		return emptyString;
 
-	/* already parsed, directly use previous result */
-	if (ap->st->strings[id] != NULL)
-		return (char*)(ap->st->strings[id]);
-
-	/* point to string's raw data */
-	offset = ap->st->data + ap->st->offsets[id];
-
-	/* its first 2 bytes is string's characters count */
-	if (isUTF8) {
-		size = *(uint8_t*)offset;
-		chNum = *(uint8_t*)(offset + 1);
-		ap->st->strings[id] = (unsigned char*)malloc(chNum);
-		memcpy(ap->st->strings[id], offset + 2, chNum);
-		//		ap->st->strings[id][chNum] = 0;
-	}
-	else {
-		chNum = *(uint16_t*)offset;
-		size = UTF16LEtoUTF8(NULL, offset + 2, (size_t)chNum);
-		if (size == (size_t)-1)
-			return emptyString;
-		ap->st->strings[id] = (unsigned char*)malloc(size);
-		if (ap->st->strings[id] == NULL)
-			return emptyString;
-
-		UTF16LEtoUTF8(ap->st->strings[id], offset + 2, (size_t)chNum);
-	}
+	return ap->st->strings[id];
+}
 
+static size_t
+GetStringLength(Parser_t* ap, uint32_t id)
+{
+	if (id >= ap->st->count)
+		return 0;
 
-	return (char*)(ap->st->strings[id]);
+	return ap->st->lengths[id];
 }
 
 char*
@@ -707,99 +864,117 @@ AxmlGetAttrName(void* axml, uint32_t i)
 	return GetString(ap, ap->attr->list[i].name);
 }
 
-char*
-AxmlGetAttrValue(void* axml, uint32_t i)
+/* formats attribute i, string values point straight into the string table, others into tmp[32] */
+static const char*
+FormatAttrValue(Parser_t* ap, uint32_t i, char* tmp, size_t* len)
 {
 	static float RadixTable[] = { 0.00390625f, 3.051758E-005f, 1.192093E-007f, 4.656613E-010f };
 	static const char* DimemsionTable[] = { "px", "dip", "sp", "pt", "in", "mm", "", "" };
 	static const char* FractionTable[] = { "%", "%p", "", "", "", "", "", "" };
 
-	Parser_t* ap;
 	uint32_t type;
 	uint32_t data;
-	char* buf;
+	int n = 0;
 
-	ap = (Parser_t*)axml;
 	type = ap->attr->list[i].type;
 
 	if (type == ATTR_STRING)
 	{
-		char* str;
-		str = GetString(ap, ap->attr->list[i].string);
-
-		/* free by user */
-		buf = (char*)malloc(strlen(str) + 1);
-
-		memset(buf, 0, strlen(str) + 1);
-		strncpy(buf, str, strlen(str));
-
-		return buf;
+		*len = GetStringLength(ap, ap->attr->list[i].string);
+		return GetString(ap, ap->attr->list[i].string);
 	}
 
 	data = ap->attr->list[i].data;
 
-	/* free by user */
-	buf = (char*)malloc(32);
-	memset(buf, 0, 32);
-
 	if (type == ATTR_NULL)
 	{
 		;
 	}
 	else if (type == ATTR_REFERENCE)
 	{
-		if (data >> 24 == 1)
-			snprintf(buf, 18, "@android:%08X", data);
+		const char* resolved = NULL;
+		if (data >> 24 != 1 && ap->resolver != NULL)
+			resolved = ap->resolver(ap->resolverCtx, data);
+
+		if (resolved != NULL)
+		{
+			*len = strlen(resolved);
+			return resolved;
+		}
+		else if (data >> 24 == 1)
+			n = snprintf(tmp, 18, "@android:%08X", data);
 		else
-			snprintf(buf, 10, "@%08X", data);
+			n = snprintf(tmp, 10, "@%08X", data);
 	}
 	else if (type == ATTR_ATTRIBUTE)
 	{
 		if (data >> 24 == 1)
-			snprintf(buf, 18, "?android:%08x", data);
+			n = snprintf(tmp, 18, "?android:%08x", data);
 		else
-			snprintf(buf, 10, "?%08X", data);
+			n = snprintf(tmp, 10, "?%08X", data);
 	}
 	else if (type == ATTR_FLOAT)
 	{
-		snprintf(buf, 20, "%g", *(float*)& data);
+		n = snprintf(tmp, 20, "%g", *(float*)& data);
 	}
 	else if (type == ATTR_DIMENSION)
 	{
-		snprintf(buf, 20, "%f%s",
+		n = snprintf(tmp, 20, "%f%s",
 			(float)(data & 0xffffff00) * RadixTable[(data >> 4) & 0x03],
 			DimemsionTable[data & 0x0f]);
 	}
 	else if (type == ATTR_FRACTION)
 	{
-		snprintf(buf, 20, "%f%s",
+		n = snprintf(tmp, 20, "%f%s",
 			(float)(data & 0xffffff00) * RadixTable[(data >> 4) & 0x03],
 			FractionTable[data & 0x0f]);
 	}
 	else if (type == ATTR_HEX)
 	{
-		snprintf(buf, 11, "0x%08x", data);
+		n = snprintf(tmp, 11, "0x%08x", data);
 	}
 	else if (type == ATTR_BOOLEAN)
 	{
-		if (data == 0)
-			strncpy(buf, "false", 32);
-		else
-			strncpy(buf, "true", 32);
+		*len = data == 0 ? 5 : 4;
+		return data == 0 ? "false" : "true";
 	}
 	else if (type >= ATTR_FIRSTCOLOR && type <= ATTR_LASTCOLOR)
 	{
-		snprintf(buf, 10, "#%08x", data);
+		n = snprintf(tmp, 10, "#%08x", data);
 	}
 	else if (type >= ATTR_FIRSTINT && type <= ATTR_LASTINT)
 	{
-		snprintf(buf, 32, "%d", data);
+		n = snprintf(tmp, 32, "%d", data);
 	}
 	else
 	{
-		snprintf(buf, 32, "<0x%x, type 0x%02x>", data, type);
+		n = snprintf(tmp, 32, "<0x%x, type 0x%02x>", data, type);
 	}
 
+	tmp[n < 0 ? 0 : n] = '\0';
+	*len = strlen(tmp);
+	return tmp;
+}
+
+char*
+AxmlGetAttrValue(void* axml, uint32_t i)
+{
+	Parser_t* ap;
+	const char* value;
+	char tmp[32];
+	size_t len;
+	char* buf;
+
+	ap = (Parser_t*)axml;
+	value = FormatAttrValue(ap, i, tmp, &len);
+
+	/* free by user */
+	buf = (char*)malloc(len + 1);
+	if (buf == NULL)
+		return NULL;
+
+	memcpy(buf, value, len);
+	buf[len] = '\0';
 	return buf;
 }
 
@@ -833,6 +1008,71 @@ AxmlGetNsUri(void* axml)
 	return GetString(ap, ap->nsList->uri);
 }
 
+void
+AxmlSetResolver(void* axml, AxmlResolver_t resolver, void* ctx)
+{
+	Parser_t* ap;
+	ap = (Parser_t*)axml;
+	ap->resolver = resolver;
+	ap->resolverCtx = ctx;
+}
+
+void*
+AxmlOpenStringPool(const char* chunk, size_t size)
+{
+	StringTable_t* st;
+
+	if (chunk == NULL)
+	{
+		fprintf(stderr, "Error: AxmlOpenStringPool get an invalid parameter.\n");
+		return NULL;
+	}
+
+	st = (StringTable_t*)calloc(1, sizeof(StringTable_t));
+	if (st == NULL)
+		return NULL;
+
+	if (LoadStringTable(st, (const unsigned char*)chunk, size) != 0)
+	{
+		free(st);
+		return NULL;
+	}
+
+	return (void*)st;
+}
+
+uint32_t
+AxmlGetPoolStringCount(void* pool)
+{
+	return ((StringTable_t*)pool)->count;
+}
+
+const char*
+AxmlGetPoolString(void* pool, uint32_t i, size_t* len)
+{
+	StringTable_t* st;
+	st = (StringTable_t*)pool;
+
+	if (i >= st->count)
+	{
+		*len = 0;
+		return emptyString;
+	}
+
+	*len = st->lengths[i];
+	return st->strings[i];
+}
+
+void
+AxmlCloseStringPool(void* pool)
+{
+	if (pool == NULL)
+		return;
+
+	FreeStringTable((StringTable_t*)pool);
+	free(pool);
+}
+
 typedef struct {
 	char* data;
 	size_t size;
@@ -855,43 +1095,79 @@ InitBuff(Buff_t* buf)
 	return 0;
 }
 
+/* makes room for len more bytes, the buffer grows geometrically */
 static int
-PrintToBuff(Buff_t* buf, size_t maxlen, const char* format, ...)
+ReserveBuff(Buff_t* buf, size_t len)
 {
-	va_list ap;
-	size_t len;
+	char* data;
+	size_t size;
 
-	if (maxlen >= buf->size - buf->cur)
-	{
-		buf->size += 32 * 1024;
-		buf->data = (char*)realloc(buf->data, buf->size);
-		if (buf->data == NULL)
-		{
-			fprintf(stderr, "Error: realloc buffer.\n");
-			return -1;
-		}
-	}
+	if (len < buf->size - buf->cur)
+		return 0;
 
-	va_start(ap, format);
-	vsnprintf(buf->data + buf->cur, buf->size - buf->cur, format, ap);
-	va_end(ap);
+	size = buf->size;
+	while (len >= size - buf->cur)
+		size *= 2;
 
-	len = strlen(buf->data + buf->cur);
-	if (len > maxlen)
+	data = (char*)realloc(buf->data, size);
+	if (data == NULL)
 	{
-		fprintf(stderr, "Error: length more than expected.\n");
+		fprintf(stderr, "Error: realloc buffer.\n");
 		return -1;
 	}
+	buf->data = data;
+	buf->size = size;
+	return 0;
+}
+
+static int
+AppendToBuff(Buff_t* buf, const char* str, size_t len)
+{
+	if (ReserveBuff(buf, len) != 0)
+		return -1;
+	memcpy(buf->data + buf->cur, str, len);
+	buf->cur += len;
+	return 0;
+}
+
+static int
+AppendIndentToBuff(Buff_t* buf, int tabCnt)
+{
+	size_t len = tabCnt > 0 ? (size_t)tabCnt * 4 : 0;
+	if (ReserveBuff(buf, len) != 0)
+		return -1;
+	memset(buf->data + buf->cur, ' ', len);
 	buf->cur += len;
 	return 0;
 }
 
+/* prefix:name, or just name when there is no prefix */
+static int
+AppendQNameToBuff(Buff_t* buf, const char* prefix, size_t prefixLen, const char* name, size_t nameLen)
+{
+	if (prefixLen != 0 &&
+		(AppendToBuff(buf, prefix, prefixLen) != 0 || AppendToBuff(buf, ":", 1) != 0))
+		return -1;
+	return AppendToBuff(buf, name, nameLen);
+}
+
 int
 AxmlToXml(char** outbuf, size_t* outsize, char* inbuf, size_t insize)
 {
+	return AxmlToXmlWithResolver(outbuf, outsize, inbuf, insize, NULL, NULL);
+}
+
+int
+AxmlToXmlWithResolver(char** outbuf, size_t* outsize, char* inbuf, size_t insize,
+	AxmlResolver_t resolver, void* ctx)
+{
+	static const char xmlHeader[] = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+
 	void* axml;
+	Parser_t* ap;
 	AxmlEvent_t event;
 	Buff_t buf;
+	int status = 0;
 
 	int tabCnt = 0;
 
@@ -900,84 +1176,90 @@ AxmlToXml(char** outbuf, size_t* outsize, char* inbuf, size_t insize)
 
 	axml = AxmlOpen(inbuf, insize);
 	if (axml == NULL)
+	{
+		free(buf.data);
 		return -1;
+	}
+	ap = (Parser_t*)axml;
+	AxmlSetResolver(axml, resolver, ctx);
 
-	while ((event = AxmlNext(axml)) != AE_ENDDOC)
+	while (status == 0 && (event = AxmlNext(axml)) != AE_ENDDOC)
 	{
-		char* prefix;
-		char* name;
-		char* value;
+		const char* value;
+		char tmp[32];
+		size_t len;
+		uint32_t prefix;
 		uint32_t i, n;
 
 		switch (event) {
 		case AE_STARTDOC:
-			PrintToBuff(&buf, 50, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n");
+			status = AppendToBuff(&buf, xmlHeader, sizeof(xmlHeader) - 1);
 			break;
 
 		case AE_STARTTAG:
-			PrintToBuff(&buf, tabCnt * 4 + 1, "%*s", tabCnt * 4, "");
+			status |= AppendIndentToBuff(&buf, tabCnt);
 			tabCnt++;
 
-			prefix = AxmlGetTagPrefix(axml);
-			name = AxmlGetTagName(axml);
-			if (strlen(prefix) != 0)
-				PrintToBuff(&buf, strlen(prefix) + strlen(name) + 5, "<%s:%s ", prefix, name);
-			else
-				PrintToBuff(&buf, strlen(name) + 3, "<%s ", name);
+			value = AxmlGetTagPrefix(axml);
+			status |= AppendToBuff(&buf, "<", 1);
+			status |= AppendQNameToBuff(&buf, value, strlen(value),
+				GetString(ap, ap->tagName), GetStringLength(ap, ap->tagName));
+			status |= AppendToBuff(&buf, " ", 1);
 
 			if (AxmlNewNamespace(axml))
 			{
-				Parser_t* ap;
-				ap = (Parser_t*)axml;
 				for (NsRecord_t* ns = ap->nsList; ns != NULL; ns = ns->next)
 				{
-					prefix = GetString(ap, ns->prefix);
-					name = GetString(ap, ns->uri);
-					PrintToBuff(&buf, strlen(prefix) + strlen(name) + 12, "xmlns:%s=\"%s\" ", prefix, name);
+					status |= AppendToBuff(&buf, "xmlns:", 6);
+					status |= AppendToBuff(&buf, GetString(ap, ns->prefix), GetStringLength(ap, ns->prefix));
+					status |= AppendToBuff(&buf, "=\"", 2);
+					status |= AppendToBuff(&buf, GetString(ap, ns->uri), GetStringLength(ap, ns->uri));
+					status |= AppendToBuff(&buf, "\" ", 2);
 				}
 			}
 
 			n = AxmlGetAttrCount(axml);
 			for (i = 0; i < n; i++)
 			{
-				prefix = AxmlGetAttrPrefix(axml, i);
-				name = AxmlGetAttrName(axml, i);
-				value = AxmlGetAttrValue(axml, i);
-
-				if (strlen(prefix) != 0)
-					PrintToBuff(&buf, strlen(prefix) + strlen(name) + strlen(value) + 8,
-						"%s:%s=\"%s\" ", prefix, name, value);
-				else
-					PrintToBuff(&buf, strlen(name) + strlen(value) + 6, "%s=\"%s\" ", name, value);
-
-				/* must manually free attribute value here */
-				free(value);
+				prefix = 0xffffffff;
+				for (NsRecord_t* ns = ap->nsList; ns != NULL; ns = ns->next)
+				{
+					if (ns->uri == ap->attr->list[i].uri)
+						prefix = ns->prefix;
+				}
+
+				status |= AppendQNameToBuff(&buf, GetString(ap, prefix), GetStringLength(ap, prefix),
+					GetString(ap, ap->attr->list[i].name), GetStringLength(ap, ap->attr->list[i].name));
+				status |= AppendToBuff(&buf, "=\"", 2);
+
+				/* values are appended in place, no per-attribute copy */
+				value = FormatAttrValue(ap, i, tmp, &len);
+				status |= AppendToBuff(&buf, value, len);
+				status |= AppendToBuff(&buf, "\" ", 2);
 			}
 
-			PrintToBuff(&buf, 3, ">\n");
+			status |= AppendToBuff(&buf, ">\n", 2);
 			break;
 
 		case AE_ENDTAG:
 			--tabCnt;
-			PrintToBuff(&buf, tabCnt * 4 + 1, "%*s", tabCnt * 4, "");
-
-			prefix = AxmlGetTagPrefix(axml);
-			name = AxmlGetTagName(axml);
-			if (strlen(prefix) != 0)
-				PrintToBuff(&buf, strlen(prefix) + strlen(name) + 7, "</%s:%s>\n", prefix, name);
-			else
-				PrintToBuff(&buf, strlen(name) + 5, "</%s>\n", name);
+			status |= AppendIndentToBuff(&buf, tabCnt);
+
+			value = AxmlGetTagPrefix(axml);
+			status |= AppendToBuff(&buf, "</", 2);
+			status |= AppendQNameToBuff(&buf, value, strlen(value),
+				GetString(ap, ap->tagName), GetStringLength(ap, ap->tagName));
+			status |= AppendToBuff(&buf, ">\n", 2);
 			break;
 
 		case AE_TEXT:
-			name = AxmlGetText(axml);
-			PrintToBuff(&buf, strlen(name) + 2, "%s\n", name);
+			status |= AppendToBuff(&buf, GetString(ap, ap->text), GetStringLength(ap, ap->text));
+			status |= AppendToBuff(&buf, "\n", 1);
 			break;
 
 		case AE_ERROR:
 			fprintf(stderr, "Error: AxmlNext() returns a AE_ERROR event.\n");
-			AxmlClose(axml);
-			return -1;
+			status = -1;
 			break;
 
 		default:
@@ -987,8 +1269,14 @@ AxmlToXml(char** outbuf, size_t* outsize, char* inbuf, size_t insize)
 
 	AxmlClose(axml);
 
+	if (status != 0)
+	{
+		free(buf.data);
+		return -1;
+	}
+
 	(*outbuf) = buf.data;
 	(*outsize) = buf.cur;
 
 	return 0;
-}
\ No newline at end of file
+}
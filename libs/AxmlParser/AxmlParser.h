@@ -5,6 +5,7 @@
 #ifndef AXMLPARSER_H
 #define AXMLPARSER_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef enum {
@@ -17,6 +18,9 @@ typedef enum {
 	AE_ERROR,
 } AxmlEvent_t;
 
+/* text of a reference to one of the app's resources (0x7fXXXXXX, ...), NULL to keep @XXXXXXXX */
+typedef const char* (*AxmlResolver_t)(void* ctx, uint32_t resId);
+
 #ifdef __cplusplus
 #if __cplusplus
 extern "C" {
@@ -43,7 +47,17 @@ extern "C" {
 
 	int AxmlClose(void* axml);
 
+	void AxmlSetResolver(void* axml, AxmlResolver_t resolver, void* ctx);
+
 	int AxmlToXml(char** outbuf, size_t* outsize, char* inbuf, size_t insize);
+	int AxmlToXmlWithResolver(char** outbuf, size_t* outsize, char* inbuf, size_t insize,
+		AxmlResolver_t resolver, void* ctx);
+
+	/* string pool chunk (e.g. of resources.arsc), decoded once; the chunk must outlive the pool */
+	void* AxmlOpenStringPool(const char* chunk, size_t size);
+	uint32_t AxmlGetPoolStringCount(void* pool);
+	const char* AxmlGetPoolString(void* pool, uint32_t i, size_t* len);
+	void AxmlCloseStringPool(void* pool);
 
 #ifdef __cplusplus
 #if __cplusplus
@@ -27,15 +27,33 @@ namespace color
 		FG_WHITE = 97
 	};
 
+	// where this thread prints: stdout, or the reply of the request a daemon thread is serving
+	inline FILE*& output()
+	{
+		thread_local FILE* file = stdout;
+		return file;
+	}
+
+	// printf to output()
+	inline int out_printf(const char* __restrict __fmt, ...)
+	{
+		va_list args;
+		va_start(args, __fmt);
+		const auto written = vfprintf(output(), __fmt, args);
+		va_end(args);
+		return written;
+	}
+
 	inline void color_printf(const code code, const char* __restrict __fmt, ...)
 	{
 		va_list args;
 		va_start(args, __fmt);
 
-		printf("\033[%dm", static_cast<int>(code));
-		vprintf(__fmt, args);
+		auto file = output();
+		fprintf(file, "\033[%dm", static_cast<int>(code));
+		vfprintf(file, __fmt, args);
 		va_end(args);
-		printf("\033[%dm", static_cast<int>(FG_DEFAULT));
+		fprintf(file, "\033[%dm", static_cast<int>(FG_DEFAULT));
 		// fflush(stdout);
 	}
 } // namespace color
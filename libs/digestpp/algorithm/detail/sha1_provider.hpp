@@ -8,6 +8,7 @@ This code is written by kerukuro and released into public domain.
 #include "../../detail/functions.hpp"
 #include "../../detail/absorb_data.hpp"
 #include "constants/sha1_constants.hpp"
+#include "sha_ni.hpp"
 #include <array>
 
 namespace digestpp
@@ -95,6 +96,13 @@ public:
 private:
 	inline void transform(const unsigned char* data, size_t num_blks)
 	{
+#ifdef DIGESTPP_HAS_SHA_NI
+		if (sha_ni::enabled().load(std::memory_order_relaxed))
+		{
+			sha_ni::sha1_transform(H.data(), data, num_blks);
+			return;
+		}
+#endif
 		for (uint64_t blk = 0; blk < num_blks; blk++)
 		{
 			uint32_t M[16];
@@ -9,6 +9,7 @@ This code is written by kerukuro and released into public domain.
 #include "../../detail/absorb_data.hpp"
 #include "../../detail/validate_hash_size.hpp"
 #include "constants/sha2_constants.hpp"
+#include "sha_ni.hpp"
 #include <array>
 
 namespace digestpp
@@ -201,6 +202,14 @@ public:
 private:
 	inline void transform(const unsigned char* data, size_t num_blks)
 	{
+#ifdef DIGESTPP_HAS_SHA_NI
+		// SHA-224 and SHA-256 only, the extensions have no 64-bit variant
+		if (N == 256 && sha_ni::enabled().load(std::memory_order_relaxed))
+		{
+			sha_ni::sha256_transform(reinterpret_cast<uint32_t*>(H.data()), sha256_constants<void>::K, data, num_blks);
+			return;
+		}
+#endif
 		for (size_t blk = 0; blk < num_blks; blk++)
 		{
 			T M[16];
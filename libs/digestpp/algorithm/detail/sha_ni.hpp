@@ -0,0 +1,173 @@
+/*
+SHA-1 and SHA-256 block transforms using the x86 SHA extensions (SHA-NI).
+Selected at runtime with cpuid, the portable providers are used when the CPU lacks them.
+*/
+
+#ifndef DIGESTPP_PROVIDERS_SHA_NI_HPP
+#define DIGESTPP_PROVIDERS_SHA_NI_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <utility>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define DIGESTPP_HAS_SHA_NI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#define DIGESTPP_SHA_NI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+
+namespace digestpp
+{
+
+namespace detail
+{
+
+namespace sha_ni
+{
+
+// true if the CPU supports SHA-NI (and the SSSE3/SSE4.1 the transforms also need)
+inline bool supported()
+{
+#ifdef DIGESTPP_HAS_SHA_NI
+	static const bool has_sha_ni = []
+	{
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			return false;
+		const bool has_ssse3 = (ecx & (1u << 9)) != 0;
+		const bool has_sse41 = (ecx & (1u << 19)) != 0;
+		if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+			return false;
+		return has_ssse3 && has_sse41 && (ebx & (1u << 29)) != 0;
+	}();
+	return has_sha_ni;
+#else
+	return false;
+#endif
+}
+
+// switch used by the providers, can be turned off to measure the portable code while other threads hash
+inline std::atomic<bool>& enabled()
+{
+	static std::atomic<bool> use_sha_ni{supported()};
+	return use_sha_ni;
+}
+
+#ifdef DIGESTPP_HAS_SHA_NI
+
+// group G of 4 rounds, all indexes are compile time constants so the 20 groups unroll into straight code
+template<int G>
+DIGESTPP_SHA_NI_TARGET
+inline void sha1_rounds(__m128i& abcd, __m128i& e_prev, __m128i* msg)
+{
+	// e for this group, derived from abcd as it was before the previous group
+	const __m128i e = G == 0 ? _mm_add_epi32(e_prev, msg[0]) : _mm_sha1nexte_epu32(e_prev, msg[G & 3]);
+	e_prev = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e, G / 5);
+
+	// message schedule: W[n] = msg2(msg1(W[n-4], W[n-3]) ^ W[n-2], W[n-1]), one step of it per group
+	if (G >= 1 && G <= 16)
+		msg[(G + 3) & 3] = _mm_sha1msg1_epu32(msg[(G + 3) & 3], msg[G & 3]);
+	if (G >= 2 && G <= 17)
+		msg[(G + 2) & 3] = _mm_xor_si128(msg[(G + 2) & 3], msg[G & 3]);
+	if (G >= 3 && G <= 18)
+		msg[(G + 1) & 3] = _mm_sha1msg2_epu32(msg[(G + 1) & 3], msg[G & 3]);
+}
+
+template<int... G>
+DIGESTPP_SHA_NI_TARGET
+inline void sha1_all_rounds(__m128i& abcd, __m128i& e_prev, __m128i* msg, std::integer_sequence<int, G...>)
+{
+	(sha1_rounds<G>(abcd, e_prev, msg), ...);
+}
+
+DIGESTPP_SHA_NI_TARGET
+inline void sha1_transform(uint32_t* state, const unsigned char* data, size_t num_blks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+	__m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+	__m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+	for (size_t blk = 0; blk < num_blks; blk++, data += 64)
+	{
+		const __m128i abcd_save = abcd;
+		const __m128i e_save = e0;
+
+		__m128i msg[4];
+		for (int i = 0; i < 4; i++)
+			msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16)), mask);
+
+		__m128i e_prev = e0;
+		sha1_all_rounds(abcd, e_prev, msg, std::make_integer_sequence<int, 20>());
+
+		e0 = _mm_sha1nexte_epu32(e_prev, e_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+	state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+}
+
+// k: the 64 SHA-256 round constants
+DIGESTPP_SHA_NI_TARGET
+inline void sha256_transform(uint32_t* state, const uint32_t* k, const unsigned char* data, size_t num_blks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+	// state is kept as ABEF / CDGH, the layout sha256rnds2 works on
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+	for (size_t blk = 0; blk < num_blks; blk++, data += 64)
+	{
+		const __m128i abef_save = state0;
+		const __m128i cdgh_save = state1;
+
+		__m128i msg[4];
+		for (int i = 0; i < 4; i++)
+			msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16)), mask);
+
+		// 16 groups of 4 rounds, W for the group g >= 4 is built from the previous four
+		for (int g = 0; g < 16; g++)
+		{
+			if (g >= 4)
+			{
+				const __m128i w = _mm_add_epi32(_mm_sha256msg1_epu32(msg[g & 3], msg[(g + 1) & 3]),
+					_mm_alignr_epi8(msg[(g + 3) & 3], msg[(g + 2) & 3], 4));
+				msg[g & 3] = _mm_sha256msg2_epu32(w, msg[(g + 3) & 3]);
+			}
+
+			__m128i wk = _mm_add_epi32(msg[g & 3], _mm_loadu_si128(reinterpret_cast<const __m128i*>(k + g * 4)));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+			wk = _mm_shuffle_epi32(wk, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
+		}
+
+		state0 = _mm_add_epi32(state0, abef_save);
+		state1 = _mm_add_epi32(state1, cdgh_save);
+	}
+
+	// back to ABCD / EFGH
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+
+#endif // DIGESTPP_HAS_SHA_NI
+
+} // namespace sha_ni
+
+} // namespace detail
+
+} // namespace digestpp
+
+#endif
@@ -25,6 +25,9 @@
 #include <cinttypes>
 #include <cmath>
 #include <sstream>
+#include <algorithm>
+#include <tuple>
+#include <unordered_map>
 
 #include "color/color.hpp"
 
@@ -48,6 +51,300 @@ static std::string MethodDeclaration(const ir::Proto *proto)
     return ss.str();
 }
 
+namespace
+{
+    // Maps every instruction covered by a basic block to the block index
+    using BlocksMap = std::unordered_map<const lir::Instruction *, size_t>;
+
+    struct BytecodeVisitor : public lir::Visitor
+    {
+        lir::Bytecode *bytecode = nullptr;
+        bool Visit(lir::Bytecode *instr) override
+        {
+            bytecode = instr;
+            return true;
+        }
+    };
+
+    struct CodeLocationVisitor : public lir::Visitor
+    {
+        lir::Label *label = nullptr;
+        bool Visit(lir::CodeLocation *location) override
+        {
+            label = location->label;
+            return true;
+        }
+    };
+
+    struct SwitchTargetsVisitor : public lir::Visitor
+    {
+        std::vector<lir::Label *> targets;
+        bool Visit(lir::PackedSwitchPayload *packed_switch) override
+        {
+            targets = packed_switch->targets;
+            return true;
+        }
+        bool Visit(lir::SparseSwitchPayload *sparse_switch) override
+        {
+            for (const auto &switch_case : sparse_switch->switch_cases)
+            {
+                targets.push_back(switch_case.target);
+            }
+            return true;
+        }
+    };
+
+    // Tracks the try regions which are active while walking the instructions
+    // and emits an edge to every handler for each throwing bytecode
+    struct ExceptionEdgesVisitor : public lir::Visitor
+    {
+        const BlocksMap &blocks_map;
+        const lir::ControlFlowGraph &cfg;
+        std::vector<CfgEdge> &edges;
+        std::unordered_map<const lir::TryBlockBegin *, const lir::TryBlockEnd *> try_ends;
+        std::vector<const lir::TryBlockEnd *> active_tries;
+        bool collect_ends = true;
+
+        ExceptionEdgesVisitor(const BlocksMap &blocks_map, const lir::ControlFlowGraph &cfg, std::vector<CfgEdge> &edges)
+            : blocks_map(blocks_map), cfg(cfg), edges(edges) {}
+
+        bool Visit(lir::TryBlockBegin *try_begin) override
+        {
+            if (!collect_ends)
+            {
+                const auto it = try_ends.find(try_begin);
+                if (it != try_ends.end())
+                {
+                    active_tries.push_back(it->second);
+                }
+            }
+            return true;
+        }
+
+        bool Visit(lir::TryBlockEnd *try_end) override
+        {
+            if (collect_ends)
+            {
+                try_ends[try_end->try_begin] = try_end;
+            }
+            else
+            {
+                active_tries.erase(std::remove(active_tries.begin(), active_tries.end(), try_end), active_tries.end());
+            }
+            return true;
+        }
+
+        bool Visit(lir::Bytecode *bytecode) override
+        {
+            if (collect_ends || active_tries.empty() ||
+                (dex::GetFlagsFromOpcode(bytecode->opcode) & dex::kThrow) == 0)
+            {
+                return true;
+            }
+            const auto it = blocks_map.find(bytecode);
+            if (it == blocks_map.end())
+            {
+                return true;
+            }
+            const auto from = cfg.basic_blocks[it->second].id;
+            for (const auto try_end : active_tries)
+            {
+                for (const auto &handler : try_end->handlers)
+                {
+                    AddEdge(from, handler.label);
+                }
+                if (try_end->catch_all != nullptr)
+                {
+                    AddEdge(from, try_end->catch_all);
+                }
+            }
+            return true;
+        }
+
+        void AddEdge(int from, const lir::Instruction *target);
+    };
+
+    // Finds the block starting at (or after) the specified instruction,
+    // labels in front of try/payload directives are not part of any block
+    int FindBlockId(const BlocksMap &blocks_map, const lir::ControlFlowGraph &cfg, const lir::Instruction *instr)
+    {
+        for (; instr != nullptr; instr = instr->next)
+        {
+            const auto it = blocks_map.find(instr);
+            if (it != blocks_map.end())
+            {
+                return cfg.basic_blocks[it->second].id;
+            }
+        }
+        return 0;
+    }
+
+    void ExceptionEdgesVisitor::AddEdge(int from, const lir::Instruction *target)
+    {
+        const auto to = FindBlockId(blocks_map, cfg, target);
+        if (to != 0)
+        {
+            edges.push_back({from, to, CfgEdge::Kind::Exception});
+        }
+    }
+
+    const char *EdgeKindName(CfgEdge::Kind kind)
+    {
+        switch (kind)
+        {
+        case CfgEdge::Kind::Branch:
+            return "branch";
+        case CfgEdge::Kind::Switch:
+            return "switch";
+        case CfgEdge::Kind::Exception:
+            return "exception";
+        default:
+            return "fallthrough";
+        }
+    }
+} // namespace
+
+std::vector<CfgEdge> CollectCfgEdges(const lir::ControlFlowGraph &cfg, bool model_exceptions)
+{
+    std::vector<CfgEdge> edges;
+
+    BlocksMap blocks_map;
+    for (size_t i = 0; i < cfg.basic_blocks.size(); ++i)
+    {
+        const auto &block = cfg.basic_blocks[i];
+        for (auto instr = block.region.first; instr != nullptr; instr = instr->next)
+        {
+            blocks_map[instr] = i;
+            if (instr == block.region.last)
+            {
+                break;
+            }
+        }
+    }
+
+    const auto add_edge = [&](int from, const lir::Instruction *target, CfgEdge::Kind kind) {
+        const auto to = FindBlockId(blocks_map, cfg, target);
+        if (to != 0)
+        {
+            edges.push_back({from, to, kind});
+        }
+    };
+
+    for (const auto &block : cfg.basic_blocks)
+    {
+        // the block may end with annotations, look for the last bytecode
+        lir::Bytecode *last_bytecode = nullptr;
+        for (auto instr = block.region.last; instr != nullptr; instr = instr->prev)
+        {
+            BytecodeVisitor visitor;
+            instr->Accept(&visitor);
+            if (visitor.bytecode != nullptr || instr == block.region.first)
+            {
+                last_bytecode = visitor.bytecode;
+                break;
+            }
+        }
+
+        const dex::OpcodeFlags flags = last_bytecode != nullptr ? dex::GetFlagsFromOpcode(last_bytecode->opcode) : static_cast<dex::OpcodeFlags>(dex::kContinue);
+        if ((flags & (dex::kBranch | dex::kSwitch)) != 0)
+        {
+            CodeLocationVisitor location;
+            for (auto op : last_bytecode->operands)
+            {
+                op->Accept(&location);
+            }
+            if (location.label != nullptr && (flags & dex::kBranch) != 0)
+            {
+                add_edge(block.id, location.label, CfgEdge::Kind::Branch);
+            }
+            else if (location.label != nullptr)
+            {
+                SwitchTargetsVisitor switch_targets;
+                for (auto instr = location.label->next; instr != nullptr; instr = instr->next)
+                {
+                    if (instr->Accept(&switch_targets))
+                    {
+                        break;
+                    }
+                }
+                for (const auto target : switch_targets.targets)
+                {
+                    add_edge(block.id, target, CfgEdge::Kind::Switch);
+                }
+            }
+        }
+        if ((flags & dex::kContinue) != 0)
+        {
+            add_edge(block.id, block.region.last->next, CfgEdge::Kind::Fallthrough);
+        }
+    }
+
+    if (model_exceptions && !cfg.basic_blocks.empty())
+    {
+        ExceptionEdgesVisitor visitor(blocks_map, cfg, edges);
+        for (auto instr : cfg.code_ir->instructions)
+        {
+            instr->Accept(&visitor);
+        }
+        visitor.collect_ends = false;
+        for (auto instr : cfg.code_ir->instructions)
+        {
+            instr->Accept(&visitor);
+        }
+    }
+
+    std::sort(edges.begin(), edges.end(), [](const CfgEdge &a, const CfgEdge &b) {
+        return std::tie(a.from, a.to, a.kind) < std::tie(b.from, b.to, b.kind);
+    });
+    edges.erase(std::unique(edges.begin(), edges.end(), [](const CfgEdge &a, const CfgEdge &b) {
+                    return a.from == b.from && a.to == b.to && a.kind == b.kind;
+                }),
+                edges.end());
+
+    return edges;
+}
+
+// Builds a smali-like list of access flags, ex: "public static final "
+static std::string AccessFlags(dex::u4 access_flags, bool is_method)
+{
+    static const struct
+    {
+        dex::u4 flag;
+        const char *name;
+        const char *method_name;
+    } flags_names[] = {
+        {dex::kAccPublic, "public", "public"},
+        {dex::kAccPrivate, "private", "private"},
+        {dex::kAccProtected, "protected", "protected"},
+        {dex::kAccStatic, "static", "static"},
+        {dex::kAccFinal, "final", "final"},
+        {dex::kAccSynchronized, "", "synchronized"},
+        {dex::kAccVolatile, "volatile", "bridge"},
+        {dex::kAccTransient, "transient", "varargs"},
+        {dex::kAccNative, "", "native"},
+        {dex::kAccInterface, "interface", ""},
+        {dex::kAccAbstract, "abstract", "abstract"},
+        {dex::kAccStrict, "", "strictfp"},
+        {dex::kAccSynthetic, "synthetic", "synthetic"},
+        {dex::kAccAnnotation, "annotation", ""},
+        {dex::kAccEnum, "enum", ""},
+        {dex::kAccConstructor, "", "constructor"},
+        {dex::kAccDeclaredSynchronized, "", "declared-synchronized"},
+    };
+
+    std::string flags;
+    for (const auto &flag_name : flags_names)
+    {
+        const auto name = is_method ? flag_name.method_name : flag_name.name;
+        if ((access_flags & flag_name.flag) != 0 && name[0] != '\0')
+        {
+            flags += name;
+            flags += ' ';
+        }
+    }
+    return flags;
+}
+
 void PrintCodeIrVisitor::StartInstruction(const lir::Instruction *instr)
 {
     if (cfg_ == nullptr || current_block_index_ >= cfg_->basic_blocks.size())
@@ -57,7 +354,7 @@ void PrintCodeIrVisitor::StartInstruction(const lir::Instruction *instr)
     const lir::BasicBlock &current_block = cfg_->basic_blocks[current_block_index_];
     if (instr == current_block.region.first)
     {
-        printf("............................. begin block %d .............................\n", current_block.id);
+        out_->Printf("............................. begin block %d .............................\n", current_block.id);
     }
 }
 
@@ -70,7 +367,17 @@ void PrintCodeIrVisitor::EndInstruction(const lir::Instruction *instr)
     const lir::BasicBlock &current_block = cfg_->basic_blocks[current_block_index_];
     if (instr == current_block.region.last)
     {
-        printf(".............................. end block %d ..............................\n", current_block.id);
+        out_->Printf(".............................. end block %d ..............................\n", current_block.id);
+        if (cfg_edges_ != nullptr)
+        {
+            // edges are sorted by the source block
+            const auto successors = std::equal_range(cfg_edges_->begin(), cfg_edges_->end(), CfgEdge{current_block.id, 0},
+                                                     [](const CfgEdge &a, const CfgEdge &b) { return a.from < b.from; });
+            for (auto it = successors.first; it != successors.second; ++it)
+            {
+                out_->ColorPrintf(color::FG_DARK_GRAY, "\t-> block %d (%s)\n", it->to, EdgeKindName(it->kind));
+            }
+        }
         ++current_block_index_;
     }
 }
@@ -78,16 +385,16 @@ void PrintCodeIrVisitor::EndInstruction(const lir::Instruction *instr)
 bool PrintCodeIrVisitor::Visit(lir::Bytecode *bytecode)
 {
     StartInstruction(bytecode);
-    printf("\t%5u| ", bytecode->offset);
-    color::color_printf(color::FG_LIGHT_CYAN, "%s", dex::GetOpcodeName(bytecode->opcode));
+    out_->Printf("\t%5u| ", bytecode->offset);
+    out_->ColorPrintf(color::FG_LIGHT_CYAN, "%s", dex::GetOpcodeName(bytecode->opcode));
     bool first = true;
     for (auto op : bytecode->operands)
     {
-        printf(first ? " " : ", ");
+        out_->Append(first ? " " : ", ");
         op->Accept(this);
         first = false;
     }
-    printf("\n");
+    out_->Append("\n");
     EndInstruction(bytecode);
     return true;
 }
@@ -95,13 +402,13 @@ bool PrintCodeIrVisitor::Visit(lir::Bytecode *bytecode)
 bool PrintCodeIrVisitor::Visit(lir::PackedSwitchPayload *packed_switch)
 {
     StartInstruction(packed_switch);
-    printf("\t%5u| packed-switch-payload\n", packed_switch->offset);
+    out_->Printf("\t%5u| packed-switch-payload\n", packed_switch->offset);
     int key = packed_switch->first_key;
     for (auto target : packed_switch->targets)
     {
-        printf("\t\t%5d: ", key++);
-        printf("Label_%d", target->id);
-        printf("\n");
+        out_->Printf("\t\t%5d: ", key++);
+        out_->Printf("Label_%d", target->id);
+        out_->Append("\n");
     }
     EndInstruction(packed_switch);
     return true;
@@ -110,12 +417,12 @@ bool PrintCodeIrVisitor::Visit(lir::PackedSwitchPayload *packed_switch)
 bool PrintCodeIrVisitor::Visit(lir::SparseSwitchPayload *sparse_switch)
 {
     StartInstruction(sparse_switch);
-    printf("\t%5u| sparse-switch-payload\n", sparse_switch->offset);
+    out_->Printf("\t%5u| sparse-switch-payload\n", sparse_switch->offset);
     for (auto &switchCase : sparse_switch->switch_cases)
     {
-        printf("\t\t%5d: ", switchCase.key);
-        printf("Label_%d", switchCase.target->id);
-        printf("\n");
+        out_->Printf("\t\t%5d: ", switchCase.key);
+        out_->Printf("Label_%d", switchCase.target->id);
+        out_->Append("\n");
     }
     EndInstruction(sparse_switch);
     return true;
@@ -124,67 +431,67 @@ bool PrintCodeIrVisitor::Visit(lir::SparseSwitchPayload *sparse_switch)
 bool PrintCodeIrVisitor::Visit(lir::ArrayData *array_data)
 {
     StartInstruction(array_data);
-    printf("\t%5u| fill-array-data-payload\n", array_data->offset);
+    out_->Printf("\t%5u| fill-array-data-payload\n", array_data->offset);
     EndInstruction(array_data);
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::CodeLocation *target)
 {
-    printf("Label_%d", target->label->id);
+    out_->Printf("Label_%d", target->label->id);
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::Const32 *const32)
 {
-    printf("#%+d (0x%08x | ", const32->u.s4_value, const32->u.u4_value);
+    out_->Printf("#%+d (0x%08x | ", const32->u.s4_value, const32->u.u4_value);
     if (std::isnan(const32->u.float_value))
     {
-        printf("NaN)");
+        out_->Append("NaN)");
     }
     else
     {
-        printf("%#.6g)", const32->u.float_value);
+        out_->Printf("%#.6g)", const32->u.float_value);
     }
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::Const64 *const64)
 {
-    printf("#%+" PRId64 " (0x%016" PRIx64 " | ", const64->u.s8_value, const64->u.u8_value);
+    out_->Printf("#%+" PRId64 " (0x%016" PRIx64 " | ", const64->u.s8_value, const64->u.u8_value);
     if (std::isnan(const64->u.double_value))
     {
-        printf("NaN)");
+        out_->Append("NaN)");
     }
     else
     {
-        printf("%#.6g)", const64->u.double_value);
+        out_->Printf("%#.6g)", const64->u.double_value);
     }
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::VReg *vreg)
 {
-    color::color_printf(color::FG_LIGHT_BLUE, "v%d", vreg->reg);
+    out_->ColorPrintf(color::FG_LIGHT_BLUE, "v%d", vreg->reg);
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::VRegPair *vreg_pair)
 {
-    color::color_printf(color::FG_LIGHT_BLUE, "v%d:v%d", vreg_pair->base_reg, vreg_pair->base_reg + 1);
+    out_->ColorPrintf(color::FG_LIGHT_BLUE, "v%d:v%d", vreg_pair->base_reg, vreg_pair->base_reg + 1);
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::VRegList *vreg_list)
 {
     bool first = true;
-    printf("{");
+    out_->Append("{");
     for (auto reg : vreg_list->registers)
     {
-        color::color_printf(color::FG_LIGHT_BLUE, "%sv%d", (first ? "" : ","), reg);
+        out_->ColorPrintf(color::FG_LIGHT_BLUE, "%sv%d", (first ? "" : ","), reg);
         first = false;
     }
-    printf("}");
+    out_->Append("}");
     return true;
 }
 
@@ -192,11 +499,11 @@ bool PrintCodeIrVisitor::Visit(lir::VRegRange *vreg_range)
 {
     if (vreg_range->count == 0)
     {
-        printf("{}");
+        out_->Append("{}");
     }
     else
     {
-        printf("{v%d..v%d}", vreg_range->base_reg,
+        out_->Printf("{v%d..v%d}", vreg_range->base_reg,
                vreg_range->base_reg + vreg_range->count - 1);
     }
     return true;
@@ -206,61 +513,61 @@ bool PrintCodeIrVisitor::Visit(lir::String *string)
 {
     if (string->ir_string == nullptr)
     {
-        printf("<null>");
+        out_->Append("<null>");
         return true;
     }
     auto ir_string = string->ir_string;
-    printf("\"");
+    out_->Append("\"");
     for (const char *p = ir_string->c_str(); *p != '\0'; ++p)
     {
         if (::isprint(*p))
         {
-            printf("%c", *p);
+            out_->Append(*p);
         }
         else
         {
             switch (*p)
             {
             case '\'':
-                printf("\\'");
+                out_->Append("\\'");
                 break;
             case '\"':
-                printf("\\\"");
+                out_->Append("\\\"");
                 break;
             case '\?':
-                printf("\\?");
+                out_->Append("\\?");
                 break;
             case '\\':
-                printf("\\\\");
+                out_->Append("\\\\");
                 break;
             case '\a':
-                printf("\\a");
+                out_->Append("\\a");
                 break;
             case '\b':
-                printf("\\b");
+                out_->Append("\\b");
                 break;
             case '\f':
-                printf("\\f");
+                out_->Append("\\f");
                 break;
             case '\n':
-                printf("\\n");
+                out_->Append("\\n");
                 break;
             case '\r':
-                printf("\\r");
+                out_->Append("\\r");
                 break;
             case '\t':
-                printf("\\t");
+                out_->Append("\\t");
                 break;
             case '\v':
-                printf("\\v");
+                out_->Append("\\v");
                 break;
             default:
-                printf("\\x%02x", *p);
+                out_->Printf("\\x%02x", *p);
                 break;
             }
         }
     }
-    printf("\"");
+    out_->Append("\"");
     return true;
 }
 
@@ -268,7 +575,7 @@ bool PrintCodeIrVisitor::Visit(lir::Type *type)
 {
     SLICER_CHECK(type->index != dex::kNoIndex);
     auto ir_type = type->ir_type;
-    printf("%s", ir_type->Decl().c_str());
+    out_->Printf("%s", ir_type->Decl().c_str());
     return true;
 }
 
@@ -276,7 +583,7 @@ bool PrintCodeIrVisitor::Visit(lir::Field *field)
 {
     SLICER_CHECK(field->index != dex::kNoIndex);
     auto ir_field = field->ir_field;
-    color::color_printf(color::FG_LIGHT_GRAY, "%s.%s", ir_field->parent->Decl().c_str(), ir_field->name->c_str());
+    out_->ColorPrintf(color::FG_LIGHT_GRAY, "%s.%s", ir_field->parent->Decl().c_str(), ir_field->name->c_str());
     return true;
 }
 
@@ -284,28 +591,24 @@ bool PrintCodeIrVisitor::Visit(lir::Method *method)
 {
     SLICER_CHECK(method->index != dex::kNoIndex);
     auto ir_method = method->ir_method;
-    color::color_printf(color::FG_GREEN, "%s", ir_method->parent->Decl().c_str());
-    printf(".");
-    color::color_printf(color::FG_LIGHT_YELLOW, "%s%s",
+    out_->ColorPrintf(color::FG_GREEN, "%s", ir_method->parent->Decl().c_str());
+    out_->Append(".");
+    out_->ColorPrintf(color::FG_LIGHT_YELLOW, "%s%s",
             ir_method->name->c_str(),
             MethodDeclaration(ir_method->prototype).c_str());
-    // printf("%s.%s%s",
-    //        ir_method->parent->Decl().c_str(),
-    //        ir_method->name->c_str(),
-    //        MethodDeclaration(ir_method->prototype).c_str());
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::LineNumber *line_number)
 {
-    printf("%d", line_number->line);
+    out_->Printf("%d", line_number->line);
     return true;
 }
 
 bool PrintCodeIrVisitor::Visit(lir::Label *label)
 {
     StartInstruction(label);
-    printf("Label_%d:%s\n", label->id, (label->aligned ? " <aligned>" : ""));
+    out_->Printf("Label_%d:%s\n", label->id, (label->aligned ? " <aligned>" : ""));
     EndInstruction(label);
     return true;
 }
@@ -313,7 +616,7 @@ bool PrintCodeIrVisitor::Visit(lir::Label *label)
 bool PrintCodeIrVisitor::Visit(lir::TryBlockBegin *try_begin)
 {
     StartInstruction(try_begin);
-    printf("\t.try_begin_%d\n", try_begin->id);
+    out_->Printf("\t.try_begin_%d\n", try_begin->id);
     EndInstruction(try_begin);
     return true;
 }
@@ -321,15 +624,15 @@ bool PrintCodeIrVisitor::Visit(lir::TryBlockBegin *try_begin)
 bool PrintCodeIrVisitor::Visit(lir::TryBlockEnd *try_end)
 {
     StartInstruction(try_end);
-    printf("\t.try_end_%d\n", try_end->try_begin->id);
+    out_->Printf("\t.try_end_%d\n", try_end->try_begin->id);
     for (const auto &handler : try_end->handlers)
     {
-        printf("\t  catch(%s) : Label_%d\n", handler.ir_type->Decl().c_str(),
+        out_->Printf("\t  catch(%s) : Label_%d\n", handler.ir_type->Decl().c_str(),
                handler.label->id);
     }
     if (try_end->catch_all != nullptr)
     {
-        printf("\t  catch(...) : Label_%d\n", try_end->catch_all->id);
+        out_->Printf("\t  catch(...) : Label_%d\n", try_end->catch_all->id);
     }
     EndInstruction(try_end);
     return true;
@@ -338,15 +641,15 @@ bool PrintCodeIrVisitor::Visit(lir::TryBlockEnd *try_end)
 bool PrintCodeIrVisitor::Visit(lir::DbgInfoHeader *dbg_header)
 {
     StartInstruction(dbg_header);
-    printf("\t.params");
+    out_->Append("\t.params");
     bool first = true;
     for (auto paramName : dbg_header->param_names)
     {
-        printf(first ? " " : ", ");
-        printf("\"%s\"", paramName ? paramName->c_str() : "?");
+        out_->Append(first ? " " : ", ");
+        out_->Printf("\"%s\"", paramName ? paramName->c_str() : "?");
         first = false;
     }
-    printf("\n");
+    out_->Append("\n");
     EndInstruction(dbg_header);
     return true;
 }
@@ -387,17 +690,17 @@ bool PrintCodeIrVisitor::Visit(lir::DbgInfoAnnotation *annotation)
     }
     if (!skip)
     {
-        printf("\t%s", name);
+        out_->Printf("\t%s", name);
 
         bool first = true;
         for (auto op : annotation->operands)
         {
-            printf(first ? " " : ", ");
+            out_->Append(first ? " " : ", ");
             op->Accept(this);
             first = false;
         }
 
-        printf("\n");
+        out_->Append("\n");
     }
     EndInstruction(annotation);
     return true;
@@ -411,14 +714,63 @@ void DexDissasembler::DumpAllMethods() const
     }
 }
 
+DexDissasembler::DexDissasembler(std::shared_ptr<ir::DexFile> dex_ir, CfgType cfg_type, OutputBuffer *out)
+    : dex_ir_(dex_ir), cfg_type_(cfg_type), out_(out)
+{
+    if (out_ == nullptr)
+    {
+        default_sink_.reset(new FileSink(stdout, true));
+        default_out_.reset(new OutputBuffer(default_sink_.get()));
+        out_ = default_out_.get();
+    }
+}
+
+void DexDissasembler::DumpClass(ir::Class *ir_class) const
+{
+    out_->Printf(".class %s%s\n", AccessFlags(ir_class->access_flags, false).c_str(), ir_class->type->Decl().c_str());
+    if (ir_class->super_class != nullptr)
+    {
+        out_->Printf(".super %s\n", ir_class->super_class->Decl().c_str());
+    }
+    if (ir_class->source_file != nullptr)
+    {
+        out_->Printf(".source \"%s\"\n", ir_class->source_file->c_str());
+    }
+    if (ir_class->interfaces != nullptr)
+    {
+        for (auto type : ir_class->interfaces->types)
+        {
+            out_->Printf(".implements %s\n", type->Decl().c_str());
+        }
+    }
+
+    for (const auto fields : {&ir_class->static_fields, &ir_class->instance_fields})
+    {
+        for (auto ir_field : *fields)
+        {
+            out_->Printf(".field %s%s:%s\n", AccessFlags(ir_field->access_flags, false).c_str(),
+                         ir_field->decl->name->c_str(), ir_field->decl->type->Decl().c_str());
+        }
+    }
+
+    for (const auto methods : {&ir_class->direct_methods, &ir_class->virtual_methods})
+    {
+        for (auto ir_method : *methods)
+        {
+            DumpMethod(ir_method);
+        }
+    }
+}
+
 void DexDissasembler::DumpMethod(ir::EncodedMethod *ir_method) const
 {
-    printf("\nmethod %s.%s%s\n{\n",
-           ir_method->decl->parent->Decl().c_str(),
-           ir_method->decl->name->c_str(),
-           MethodDeclaration(ir_method->decl->prototype).c_str());
+    out_->Printf("\nmethod %s%s.%s%s\n{\n",
+                 AccessFlags(ir_method->access_flags, true).c_str(),
+                 ir_method->decl->parent->Decl().c_str(),
+                 ir_method->decl->name->c_str(),
+                 MethodDeclaration(ir_method->decl->prototype).c_str());
     Dissasemble(ir_method);
-    printf("}\n");
+    out_->Append("}\n");
 }
 
 void DexDissasembler::Dissasemble(ir::EncodedMethod *ir_method) const
@@ -436,6 +788,141 @@ void DexDissasembler::Dissasemble(ir::EncodedMethod *ir_method) const
     default:
         break;
     }
-    PrintCodeIrVisitor visitor(dex_ir_, cfg.get());
+    std::vector<CfgEdge> edges;
+    if (cfg)
+    {
+        edges = CollectCfgEdges(*cfg, cfg_type_ == CfgType::Verbose);
+    }
+    PrintCodeIrVisitor visitor(dex_ir_, out_, cfg.get(), cfg ? &edges : nullptr);
     code_ir.Accept(&visitor);
 }
+
+void DexDissasembler::ExportCfg(ir::EncodedMethod *ir_method, CfgExporter *exporter) const
+{
+    lir::CodeIr code_ir(ir_method, dex_ir_);
+    const auto model_exceptions = cfg_type_ != CfgType::Compact;
+    const lir::ControlFlowGraph cfg(&code_ir, model_exceptions);
+    const auto edges = CollectCfgEdges(cfg, model_exceptions);
+    exporter->Export(ir_method, cfg, edges);
+}
+
+CfgExporter::CfgExporter(OutputBuffer *out, Format format)
+    : out_(out), format_(format)
+{
+    if (format_ == Format::Dot)
+    {
+        out_->Append("digraph cfg {\n\tnode [shape=box, fontname=\"monospace\"];\n");
+    }
+    else
+    {
+        out_->Append("{\"methods\": [");
+    }
+}
+
+CfgExporter::~CfgExporter()
+{
+    out_->Append(format_ == Format::Dot ? "}\n" : "\n]}\n");
+}
+
+// Escapes a string for both DOT and JSON double-quoted literals
+void CfgExporter::WriteEscaped(const char *str)
+{
+    for (auto p = str; *p != '\0'; ++p)
+    {
+        const auto chr = static_cast<unsigned char>(*p);
+        if (chr == '"' || chr == '\\')
+        {
+            out_->Append('\\');
+            out_->Append(*p);
+        }
+        else if (chr < 0x20)
+        {
+            if (format_ == Format::Json)
+            {
+                out_->Printf("\\u%04x", chr);
+            }
+            else
+            {
+                out_->Printf("\\x%02x", chr);
+            }
+        }
+        else
+        {
+            out_->Append(*p);
+        }
+    }
+}
+
+void CfgExporter::Export(ir::EncodedMethod *ir_method, const lir::ControlFlowGraph &cfg, const std::vector<CfgEdge> &edges)
+{
+    const auto method_index = methods_count_++;
+    const auto method_decl = ir_method->decl->parent->Decl() + "." + ir_method->decl->name->c_str() +
+                             MethodDeclaration(ir_method->decl->prototype);
+
+    if (format_ == Format::Dot)
+    {
+        out_->Printf("\tsubgraph cluster_%zu {\n\t\tlabel=\"", method_index);
+        WriteEscaped(method_decl.c_str());
+        out_->Append("\";\n");
+        for (const auto &block : cfg.basic_blocks)
+        {
+            out_->Printf("\t\tm%zu_b%d [label=\"block %d\\l", method_index, block.id, block.id);
+            for (auto instr = block.region.first; instr != nullptr; instr = instr->next)
+            {
+                BytecodeVisitor visitor;
+                instr->Accept(&visitor);
+                if (visitor.bytecode != nullptr)
+                {
+                    out_->Printf("%5u| %s\\l", visitor.bytecode->offset, dex::GetOpcodeName(visitor.bytecode->opcode));
+                }
+                if (instr == block.region.last)
+                {
+                    break;
+                }
+            }
+            out_->Append("\"];\n");
+        }
+        for (const auto &edge : edges)
+        {
+            static const char *edge_styles[] = {"", " [color=green]", " [color=blue]", " [color=red, style=dashed]"};
+            out_->Printf("\t\tm%zu_b%d -> m%zu_b%d%s;\n", method_index, edge.from, method_index, edge.to,
+                    edge_styles[static_cast<int>(edge.kind)]);
+        }
+        out_->Append("\t}\n");
+        return;
+    }
+
+    out_->Append(method_index == 0 ? "\n{\"method\": \"" : ",\n{\"method\": \"");
+    WriteEscaped(method_decl.c_str());
+    out_->Append("\", \"blocks\": [");
+    for (size_t i = 0; i < cfg.basic_blocks.size(); ++i)
+    {
+        const auto &block = cfg.basic_blocks[i];
+        out_->Printf("%s\n\t{\"id\": %d, \"start\": %u, \"end\": %u, \"instructions\": [", (i == 0 ? "" : ","),
+                block.id, block.region.first->offset, block.region.last->offset);
+        auto first = true;
+        for (auto instr = block.region.first; instr != nullptr; instr = instr->next)
+        {
+            BytecodeVisitor visitor;
+            instr->Accept(&visitor);
+            if (visitor.bytecode != nullptr)
+            {
+                out_->Printf("%s{\"offset\": %u, \"opcode\": \"%s\"}", (first ? "" : ", "), visitor.bytecode->offset,
+                        dex::GetOpcodeName(visitor.bytecode->opcode));
+                first = false;
+            }
+            if (instr == block.region.last)
+            {
+                break;
+            }
+        }
+        out_->Append("]}");
+    }
+    out_->Append("],\n\"edges\": [");
+    for (size_t i = 0; i < edges.size(); ++i)
+    {
+        out_->Printf("%s\n\t{\"from\": %d, \"to\": %d, \"kind\": \"%s\"}", (i == 0 ? "" : ","), edges[i].from,
+                edges[i].to, EdgeKindName(edges[i].kind));
+    }
+    out_->Append("]}");
+}
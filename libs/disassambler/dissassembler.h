@@ -21,14 +21,40 @@
 #include "slicer/dex_ir.h"
 #include "slicer/control_flow_graph.h"
 
+#include "output_buffer.h"
+
 #include <memory>
+#include <cstdio>
+#include <vector>
+
+// A directed edge between two basic blocks (ids as in lir::BasicBlock::id)
+struct CfgEdge
+{
+    enum class Kind
+    {
+        Fallthrough,
+        Branch,
+        Switch,
+        Exception
+    };
+
+    int from = 0;
+    int to = 0;
+    Kind kind = Kind::Fallthrough;
+};
+
+// The slicer CFG only models basic blocks, the edges are recovered from
+// the last bytecode of every block (branch/switch targets, fallthrough)
+// and, if requested, from the try/catch regions covering throwing bytecodes
+std::vector<CfgEdge> CollectCfgEdges(const lir::ControlFlowGraph &cfg, bool model_exceptions);
 
 // Code IR formatting visitor
 class PrintCodeIrVisitor : public lir::Visitor
 {
 public:
-    PrintCodeIrVisitor(std::shared_ptr<ir::DexFile> dex_ir, lir::ControlFlowGraph *cfg)
-        : dex_ir_(dex_ir), cfg_(cfg) {}
+    PrintCodeIrVisitor(std::shared_ptr<ir::DexFile> dex_ir, OutputBuffer *out, lir::ControlFlowGraph *cfg,
+                       const std::vector<CfgEdge> *cfg_edges = nullptr)
+        : dex_ir_(dex_ir), out_(out), cfg_(cfg), cfg_edges_(cfg_edges) {}
 
 private:
     virtual bool Visit(lir::Bytecode *bytecode) override;
@@ -58,10 +84,43 @@ private:
 
 private:
     std::shared_ptr<ir::DexFile> dex_ir_;
+    OutputBuffer *out_ = nullptr;
     lir::ControlFlowGraph *cfg_ = nullptr;
+    const std::vector<CfgEdge> *cfg_edges_ = nullptr;
     size_t current_block_index_ = 0;
 };
 
+// Writes the CFG of one or more methods as Graphviz DOT or JSON.
+// Records are appended to the output buffer as the blocks are walked,
+// so huge methods never materialize as a single string
+class CfgExporter
+{
+public:
+    enum class Format
+    {
+        Dot,
+        Json
+    };
+
+    CfgExporter(OutputBuffer *out, Format format);
+    ~CfgExporter();
+
+    CfgExporter(const CfgExporter &) = delete;
+    CfgExporter &operator=(const CfgExporter &) = delete;
+
+    void Export(ir::EncodedMethod *ir_method, const lir::ControlFlowGraph &cfg, const std::vector<CfgEdge> &edges);
+
+    size_t exported_methods() const { return methods_count_; }
+
+private:
+    void WriteEscaped(const char *str);
+
+private:
+    OutputBuffer *out_ = nullptr;
+    Format format_ = Format::Dot;
+    size_t methods_count_ = 0;
+};
+
 // A .dex bytecode dissasembler using lir::CodeIr
 class DexDissasembler
 {
@@ -78,14 +137,17 @@ public:
     };
 
 public:
-    explicit DexDissasembler(std::shared_ptr<ir::DexFile> dex_ir, CfgType cfg_type = CfgType::None)
-        : dex_ir_(dex_ir), cfg_type_(cfg_type) {}
+    // the listing goes to 'out', or to (colored) stdout if it's not specified
+    explicit DexDissasembler(std::shared_ptr<ir::DexFile> dex_ir, CfgType cfg_type = CfgType::None,
+                             OutputBuffer *out = nullptr);
 
     DexDissasembler(const DexDissasembler &) = delete;
     DexDissasembler &operator=(const DexDissasembler &) = delete;
 
     void DumpAllMethods() const;
+    void DumpClass(ir::Class *ir_class) const;
     void DumpMethod(ir::EncodedMethod *ir_method) const;
+    void ExportCfg(ir::EncodedMethod *ir_method, CfgExporter *exporter) const;
 
 private:
     void Dissasemble(ir::EncodedMethod *ir_method) const;
@@ -93,4 +155,7 @@ private:
 private:
     std::shared_ptr<ir::DexFile> dex_ir_;
     CfgType cfg_type_ = CfgType::None;
+    OutputBuffer *out_ = nullptr;
+    std::unique_ptr<OutputSink> default_sink_;
+    std::unique_ptr<OutputBuffer> default_out_;
 };
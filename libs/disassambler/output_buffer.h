@@ -0,0 +1,150 @@
+// Buffered text output of the disassembler
+
+#pragma once
+
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <string>
+
+#include "color/color.hpp"
+
+// Destination of the rendered text
+class OutputSink
+{
+public:
+    virtual ~OutputSink() = default;
+
+    // ANSI color sequences are only emitted for sinks which can display them
+    virtual bool Colored() const { return false; }
+    virtual void Write(const char *data, size_t size) = 0;
+};
+
+// stdio stream: stdout (terminal, with colors) or a plain file
+class FileSink : public OutputSink
+{
+public:
+    explicit FileSink(FILE *file, bool colored = false)
+        : file_(file), colored_(colored) {}
+
+    bool Colored() const override { return colored_; }
+    void Write(const char *data, size_t size) override { fwrite(data, 1, size, file_); }
+
+    // retargets the sink, lets a worker reuse one buffer for many files
+    void Reset(FILE *file) { file_ = file; }
+
+private:
+    FILE *file_ = nullptr;
+    bool colored_ = false;
+};
+
+// In-memory string
+class StringSink : public OutputSink
+{
+public:
+    void Write(const char *data, size_t size) override { str_.append(data, size); }
+
+    std::string &str() { return str_; }
+
+private:
+    std::string str_;
+};
+
+// Reusable text buffer in front of a sink. Tokens are appended to memory
+// and handed to the sink in large chunks, not one write per token
+class OutputBuffer
+{
+public:
+    static constexpr size_t kFlushThreshold = 256 * 1024;
+
+    explicit OutputBuffer(OutputSink *sink)
+        : sink_(sink), colored_(sink->Colored())
+    {
+        buffer_.reserve(kFlushThreshold + 4096);
+    }
+
+    ~OutputBuffer() { Flush(); }
+
+    OutputBuffer(const OutputBuffer &) = delete;
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+    void Append(const char *str, size_t size)
+    {
+        buffer_.append(str, size);
+        if (buffer_.size() >= kFlushThreshold)
+        {
+            Flush();
+        }
+    }
+
+    void Append(const char *str) { Append(str, strlen(str)); }
+    void Append(const std::string &str) { Append(str.data(), str.size()); }
+    void Append(char chr) { Append(&chr, 1); }
+
+    void Printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        va_list args;
+        va_start(args, format);
+        VPrintf(format, args);
+        va_end(args);
+    }
+
+    void ColorPrintf(color::code code, const char *format, ...) __attribute__((format(printf, 3, 4)))
+    {
+        SetColor(code);
+        va_list args;
+        va_start(args, format);
+        VPrintf(format, args);
+        va_end(args);
+        SetColor(color::FG_DEFAULT);
+    }
+
+    void SetColor(color::code code)
+    {
+        if (colored_)
+        {
+            char sequence[16];
+            const auto size = snprintf(sequence, sizeof(sequence), "\033[%dm", static_cast<int>(code));
+            Append(sequence, size);
+        }
+    }
+
+    // hands the buffered text over to the sink, the buffer memory is kept for reuse
+    void Flush()
+    {
+        if (!buffer_.empty())
+        {
+            sink_->Write(buffer_.data(), buffer_.size());
+            buffer_.clear();
+        }
+    }
+
+private:
+    void VPrintf(const char *format, va_list args)
+    {
+        va_list args_copy;
+        va_copy(args_copy, args);
+
+        // format straight into the buffer tail, retry once if it did not fit
+        const auto offset = buffer_.size();
+        buffer_.resize(offset + 128);
+        auto size = vsnprintf(&buffer_[offset], 128, format, args);
+        if (size >= 128)
+        {
+            buffer_.resize(offset + size + 1);
+            vsnprintf(&buffer_[offset], size + 1, format, args_copy);
+        }
+        va_end(args_copy);
+        buffer_.resize(offset + (size > 0 ? size : 0));
+
+        if (buffer_.size() >= kFlushThreshold)
+        {
+            Flush();
+        }
+    }
+
+private:
+    OutputSink *sink_ = nullptr;
+    bool colored_ = false;
+    std::string buffer_;
+};